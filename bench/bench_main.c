@@ -0,0 +1,381 @@
+#define _GNU_SOURCE
+#include "bvh.h"
+#include "framebuffer.h"
+#include "harness.h"
+#include "list.h"
+#include "obj_parser.h"
+#include "obj_writer.h"
+#include "orientation.h"
+#include "pipeline.h"
+#include "render.h"
+#include <ftw.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define VECTOR_BATCH 4096
+
+static char temp_dir[64] = "";
+
+static int remove_entry(const char *path, const struct stat *st, int type,
+                        struct FTW *ftw) {
+  (void)st;
+  (void)ftw;
+  return type == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static void remove_temp_dir(void) {
+  if (temp_dir[0] == '\0')
+    return;
+  // children first, so each directory is empty when it is removed
+  if (nftw(temp_dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS) != 0)
+    fprintf(stderr, "Could not remove %s\n", temp_dir);
+}
+
+// Size of the file at path in bytes, -1 if it cannot be read
+static long file_size(const char *path) {
+  FILE *in = fopen(path, "r");
+  if (in == NULL)
+    return -1;
+  long size = fseek(in, 0, SEEK_END) == 0 ? ftell(in) : -1;
+  fclose(in);
+  return size;
+}
+
+// Writes a flat (n x n) triangulated grid in [-0.5, 0.5]^2 with exactly
+// `faces` faces and returns its path; files are cached for the whole run
+static const char *grid_obj_path(int64_t faces) {
+  static char path[128];
+  if (temp_dir[0] == '\0') {
+    strcpy(temp_dir, "/tmp/spinning_cube_bench_XXXXXX");
+    if (mkdtemp(temp_dir) == NULL) {
+      temp_dir[0] = '\0';
+      return NULL;
+    }
+    atexit(remove_temp_dir);
+  }
+  snprintf(path, sizeof(path), "%s/grid_%lld.obj", temp_dir, (long long)faces);
+  if (access(path, R_OK) == 0)
+    return path;
+
+  FILE *out = fopen(path, "w");
+  if (out == NULL)
+    return NULL;
+  int64_t n = (int64_t)ceil(sqrt((double)faces / 2.0));
+  for (int64_t y = 0; y <= n; ++y)
+    for (int64_t x = 0; x <= n; ++x)
+      fprintf(out, "v %f %f 0.0\n", (double)x / n - 0.5, (double)y / n - 0.5);
+  int64_t written = 0;
+  for (int64_t y = 0; y < n && written < faces; ++y) {
+    for (int64_t x = 0; x < n && written < faces; ++x) {
+      int64_t a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 1, d = c + 1;
+      fprintf(out, "f %lld %lld %lld\n", (long long)a, (long long)b,
+              (long long)d);
+      if (++written < faces)
+        fprintf(out, "f %lld %lld %lld\n", (long long)a, (long long)d,
+                (long long)c);
+      ++written;
+    }
+  }
+  if (fclose(out) != 0)
+    return NULL;
+  return path;
+}
+
+static int load_grid(obj_scene_data *scene, int64_t faces) {
+  const char *path = grid_obj_path(faces);
+  return path != NULL && parse_obj_scene(scene, (char *)path);
+}
+
+static void BM_parse_obj_scene(bench_state *state) {
+  const char *path = grid_obj_path(state->arg);
+  if (path == NULL) {
+    bench_skip(state, "could not generate mesh");
+    return;
+  }
+  long size = file_size(path);
+  if (size < 0) {
+    bench_skip(state, "could not read mesh");
+    return;
+  }
+
+  while (bench_keep_running(state)) {
+    obj_scene_data scene;
+    if (!parse_obj_scene(&scene, (char *)path)) {
+      bench_skip(state, "could not parse mesh");
+      return;
+    }
+    bench_pause_timing(state);
+    delete_obj_data(&scene);
+    bench_resume_timing(state);
+  }
+  state->items_processed = state->iterations * state->arg;
+  state->bytes_processed = state->iterations * size;
+}
+
+// Writes the grid back out, as objconvert does; bytes are the output's
+static void BM_write_obj_scene(bench_state *state) {
+  obj_scene_data scene;
+  if (!load_grid(&scene, state->arg)) {
+    bench_skip(state, "could not generate mesh");
+    return;
+  }
+  char path[96];
+  snprintf(path, sizeof(path), "%s/written.obj", temp_dir);
+  while (bench_keep_running(state)) {
+    if (!obj_write_scene(&scene, path, NULL)) {
+      bench_skip(state, "could not write mesh");
+      break;
+    }
+  }
+  if (!state->skipped) {
+    long size = file_size(path);
+    if (size < 0)
+      bench_skip(state, "could not read written mesh");
+    state->bytes_processed = state->iterations * size;
+    state->items_processed = state->iterations * state->arg;
+  }
+  delete_obj_data(&scene);
+}
+
+// Coordinates as parsed from 6 decimals (arg 0) or as computed (arg 1),
+// which need all 17 digits
+static void BM_format_double(bench_state *state) {
+  double *values = malloc(sizeof(double) * VECTOR_BATCH);
+  for (int i = 0; i < VECTOR_BATCH; ++i) {
+    double t = (i * 7919 % VECTOR_BATCH) / (double)VECTOR_BATCH - 0.5;
+    values[i] = state->arg == 0 ? round(t * 1e6) / 1e6 : t / 3;
+  }
+  char text[OBJ_DOUBLE_TEXT_SIZE + 1];
+  int64_t bytes = 0;
+  while (bench_keep_running(state))
+    for (int i = 0; i < VECTOR_BATCH; ++i)
+      bytes += obj_format_double(text, values[i]);
+  state->items_processed = state->iterations * VECTOR_BATCH;
+  state->bytes_processed = bytes;
+  free(values);
+}
+
+static void BM_list_add_item(bench_state *state) {
+  static int dummy;
+  while (bench_keep_running(state)) {
+    list listo;
+    list_make(&listo, 10, 1);
+    for (int64_t i = 0; i < state->arg; ++i)
+      list_add_item(&listo, &dummy, NULL);
+    bench_pause_timing(state);
+    list_free(&listo);
+    bench_resume_timing(state);
+  }
+  state->items_processed = state->iterations * state->arg;
+}
+
+static void BM_rotate(bench_state *state) {
+  vec3 *points = malloc(sizeof(vec3) * VECTOR_BATCH);
+  for (int i = 0; i < VECTOR_BATCH; ++i) {
+    points[i].x = (float)i;
+    points[i].y = (float)(i * 7 % 13);
+    points[i].z = 1.0f;
+  }
+  float angle = 0;
+  while (bench_keep_running(state)) {
+    for (int i = 0; i < VECTOR_BATCH; ++i)
+      rotate(&points[i], angle / 5, angle, angle / 3);
+    angle += 0.1f;
+  }
+  state->items_processed = state->iterations * VECTOR_BATCH;
+  free(points);
+}
+
+// The same tumble as BM_rotate, integrated as a quaternion and applied as
+// one matrix per batch
+static void BM_orientation(bench_state *state) {
+  vec3 *points = malloc(sizeof(vec3) * VECTOR_BATCH);
+  for (int i = 0; i < VECTOR_BATCH; ++i) {
+    points[i].x = (float)i;
+    points[i].y = (float)(i * 7 % 13);
+    points[i].z = 1.0f;
+  }
+  orientation spin;
+  orientation_init(&spin, (const float[3]){0.1f / 5, 0.1f, 0.1f / 3});
+  while (bench_keep_running(state)) {
+    float R[3][3];
+    quat_to_matrix(spin.current, R);
+    for (int i = 0; i < VECTOR_BATCH; ++i) {
+      float x = points[i].x, y = points[i].y, z = points[i].z;
+      points[i].x = R[0][0] * x + R[0][1] * y + R[0][2] * z;
+      points[i].y = R[1][0] * x + R[1][1] * y + R[1][2] * z;
+      points[i].z = R[2][0] * x + R[2][1] * y + R[2][2] * z;
+    }
+    orientation_step(&spin);
+  }
+  state->items_processed = state->iterations * VECTOR_BATCH;
+  free(points);
+}
+
+static void BM_project_vertices(bench_state *state) {
+  obj_scene_data scene, transformed;
+  if (!load_grid(&scene, state->arg) || !load_grid(&transformed, state->arg)) {
+    bench_skip(state, "could not load mesh");
+    return;
+  }
+  float R[3][3];
+  rotation_matrix(R, 0, 0.5f, 0);
+  transform_model(&scene, &transformed, R, MODEL_DISTANCE);
+  struct obj_vector *projected =
+      calloc(scene.vertex_count, sizeof(struct obj_vector));
+  while (bench_keep_running(state))
+    project_vertices(&transformed, projected, 160, 48);
+  state->items_processed = state->iterations * scene.vertex_count;
+  free(projected);
+  delete_obj_data(&scene);
+  delete_obj_data(&transformed);
+}
+
+// Terminal sizes are passed as the width, the height keeps a 10:3 aspect
+static void BM_draw_line(bench_state *state) {
+  framebuffer fb;
+  framebuffer_init(&fb, (int)state->arg, (int)(state->arg * 3 / 10));
+  framebuffer_clear(&fb, BACKGROUND_CHAR);
+  while (bench_keep_running(state))
+    draw_line(&fb, 1, 1, fb.height - 2, fb.width - 2);
+  state->items_processed = state->iterations;
+  framebuffer_free(&fb);
+}
+
+// How draw_faces_bench draws
+typedef enum face_drawer {
+  DRAW_FACES,        // draw_faces, which tests every cell in ASCII
+  DRAW_GENERIC,      // the kernels' rasters dispatched at run time
+  DRAW_SPECIALIZED,  // the kernel select_face_kernel picks
+} face_drawer;
+
+// Outlines of a 1000 face grid. draw_faces and draw_outlines_generic decide
+// the raster, colour and corner count per edge, the kernel has them
+// compiled in. In ASCII draw_faces scans the whole screen per edge, so the
+// generic version, which visits the bounding box as the kernel does, is the
+// baseline for the specialisation.
+static void draw_faces_bench(bench_state *state, framebuffer_mode mode,
+                             face_drawer drawer) {
+  obj_scene_data scene, transformed;
+  if (!load_grid(&scene, 1000) || !load_grid(&transformed, 1000)) {
+    bench_skip(state, "could not load mesh");
+    return;
+  }
+  framebuffer fb;
+  framebuffer_init(&fb, (int)state->arg, (int)(state->arg * 3 / 10));
+  framebuffer_set_mode(&fb, mode);
+  float R[3][3];
+  rotation_matrix(R, 0.3f, 0.5f, 0);
+  transform_model(&scene, &transformed, R, MODEL_DISTANCE);
+  struct obj_vector *projected =
+      calloc(scene.vertex_count, sizeof(struct obj_vector));
+  project_vertices(&transformed, projected, framebuffer_raster_width(&fb),
+                   framebuffer_raster_height(&fb));
+  face_kernel kernel = select_face_kernel(&fb, face_arity(&scene), false);
+  while (bench_keep_running(state)) {
+    framebuffer_clear(&fb, BACKGROUND_CHAR);
+    if (drawer == DRAW_SPECIALIZED)
+      kernel(&fb, &transformed, projected, NULL, 0);
+    else if (drawer == DRAW_GENERIC)
+      draw_outlines_generic(&fb, &transformed, projected, NULL, 0);
+    else
+      draw_faces(&fb, &transformed, projected);
+  }
+  state->items_processed = state->iterations * scene.face_count;
+  free(projected);
+  framebuffer_free(&fb);
+  delete_obj_data(&scene);
+  delete_obj_data(&transformed);
+}
+
+static void BM_draw_faces(bench_state *state) {
+  draw_faces_bench(state, FRAMEBUFFER_ASCII, DRAW_FACES);
+}
+
+static void BM_draw_face_generic(bench_state *state) {
+  draw_faces_bench(state, FRAMEBUFFER_ASCII, DRAW_GENERIC);
+}
+
+static void BM_draw_face_kernel(bench_state *state) {
+  draw_faces_bench(state, FRAMEBUFFER_ASCII, DRAW_SPECIALIZED);
+}
+
+static void BM_draw_faces_braille(bench_state *state) {
+  draw_faces_bench(state, FRAMEBUFFER_BRAILLE, DRAW_FACES);
+}
+
+static void BM_draw_face_kernel_braille(bench_state *state) {
+  draw_faces_bench(state, FRAMEBUFFER_BRAILLE, DRAW_SPECIALIZED);
+}
+
+static void BM_bvh_build(bench_state *state) {
+  obj_scene_data scene;
+  if (!load_grid(&scene, state->arg)) {
+    bench_skip(state, "could not load mesh");
+    return;
+  }
+  while (bench_keep_running(state)) {
+    bvh b;
+    bvh_build(&b, &scene, 0);
+    bench_pause_timing(state);
+    bvh_free(&b);
+    bench_resume_timing(state);
+  }
+  state->items_processed = state->iterations * scene.face_count;
+  delete_obj_data(&scene);
+}
+
+static void BM_bvh_pick(bench_state *state) {
+  obj_scene_data scene;
+  if (!load_grid(&scene, state->arg)) {
+    bench_skip(state, "could not load mesh");
+    return;
+  }
+  bvh b;
+  bvh_build(&b, &scene, 0);
+  int i = 0;
+  while (bench_keep_running(state)) {
+    // rays straight down onto the grid, sweeping across it
+    float origin[3] = {(i % 97) / 97.f - 0.5f, (i % 89) / 89.f - 0.5f, 1.f};
+    float dir[3] = {0.001f, 0.002f, -1.f};
+    float t;
+    bvh_pick(&b, &scene, origin, dir, &t);
+    ++i;
+  }
+  state->items_processed = state->iterations;
+  bvh_free(&b);
+  delete_obj_data(&scene);
+}
+
+int main(int argc, char **argv) {
+  static const int64_t face_counts[] = {1000, 10000, 100000, 1000000,
+                                        10000000};
+  static const int64_t list_sizes[] = {1000, 100000, 1000000};
+  static const int64_t vertex_faces[] = {1000, 100000};
+  static const int64_t terminal_widths[] = {80, 160, 320};
+  static const int64_t format_kinds[] = {0, 1};
+
+  bench_register("BM_parse_obj_scene", BM_parse_obj_scene, face_counts, 5);
+  bench_register("BM_write_obj_scene", BM_write_obj_scene, face_counts, 4);
+  bench_register("BM_format_double", BM_format_double, format_kinds, 2);
+  bench_register("BM_list_add_item", BM_list_add_item, list_sizes, 3);
+  bench_register("BM_rotate", BM_rotate, NULL, 0);
+  bench_register("BM_orientation", BM_orientation, NULL, 0);
+  bench_register("BM_project_vertices", BM_project_vertices, vertex_faces, 2);
+  bench_register("BM_draw_line", BM_draw_line, terminal_widths, 3);
+  bench_register("BM_draw_faces", BM_draw_faces, terminal_widths, 3);
+  bench_register("BM_draw_face_generic", BM_draw_face_generic, terminal_widths,
+                 3);
+  bench_register("BM_draw_face_kernel", BM_draw_face_kernel, terminal_widths,
+                 3);
+  bench_register("BM_draw_faces_braille", BM_draw_faces_braille,
+                 terminal_widths, 3);
+  bench_register("BM_draw_face_kernel_braille", BM_draw_face_kernel_braille,
+                 terminal_widths, 3);
+  bench_register("BM_bvh_build", BM_bvh_build, vertex_faces, 2);
+  bench_register("BM_bvh_pick", BM_bvh_pick, vertex_faces, 2);
+  return bench_run_all(argc, argv);
+}
@@ -0,0 +1,264 @@
+#include "harness.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_BENCHMARKS 64
+#define MAX_ARGS 16
+
+typedef struct bench_entry {
+  const char *name;
+  bench_fn fn;
+  int64_t args[MAX_ARGS];
+  int arg_count;
+} bench_entry;
+
+typedef struct bench_result {
+  char name[128];
+  int64_t iterations;
+  double real_ns;
+  double cpu_ns;
+  double items_per_second;
+  double bytes_per_second;
+  const char *label;
+  bool skipped;
+} bench_result;
+
+static bench_entry registry[MAX_BENCHMARKS];
+static int registry_count = 0;
+
+static double real_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double cpu_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+bool bench_keep_running(bench_state *state) {
+  if (state->skipped)
+    return false;
+  if (!state->running && state->remaining == state->iterations) {
+    bench_resume_timing(state);
+  }
+  if (state->remaining-- > 0)
+    return true;
+  bench_pause_timing(state);
+  return false;
+}
+
+void bench_pause_timing(bench_state *state) {
+  if (!state->running)
+    return;
+  state->real_seconds += real_now() - state->start_real;
+  state->cpu_seconds += cpu_now() - state->start_cpu;
+  state->running = false;
+}
+
+void bench_resume_timing(bench_state *state) {
+  if (state->running)
+    return;
+  state->start_real = real_now();
+  state->start_cpu = cpu_now();
+  state->running = true;
+}
+
+void bench_skip(bench_state *state, const char *reason) {
+  state->skipped = true;
+  state->label = reason;
+}
+
+void bench_register(const char *name, bench_fn fn, const int64_t *args,
+                    int arg_count) {
+  if (registry_count == MAX_BENCHMARKS || arg_count > MAX_ARGS) {
+    fprintf(stderr, "Too many benchmarks registered, dropping %s\n", name);
+    return;
+  }
+  bench_entry *entry = &registry[registry_count++];
+  entry->name = name;
+  entry->fn = fn;
+  entry->arg_count = arg_count;
+  for (int i = 0; i < arg_count; ++i)
+    entry->args[i] = args[i];
+}
+
+static void run_one(const bench_entry *entry, int64_t arg, bool has_arg,
+                    double min_time, bench_result *result) {
+  if (has_arg)
+    snprintf(result->name, sizeof(result->name), "%s/%lld", entry->name,
+             (long long)arg);
+  else
+    snprintf(result->name, sizeof(result->name), "%s", entry->name);
+
+  int64_t iterations = 1;
+  bench_state state;
+  for (;;) {
+    memset(&state, 0, sizeof(state));
+    state.arg = arg;
+    state.iterations = iterations;
+    state.remaining = iterations;
+    entry->fn(&state);
+    if (state.skipped || state.real_seconds >= min_time ||
+        iterations >= 1000000000)
+      break;
+    // same growth rule as Google Benchmark: aim past min_time, at most 10x
+    double multiplier = state.real_seconds > 0
+                            ? min_time * 1.4 / state.real_seconds
+                            : 10.0;
+    if (multiplier > 10.0)
+      multiplier = 10.0;
+    int64_t next = (int64_t)(iterations * multiplier);
+    iterations = next > iterations ? next : iterations + 1;
+  }
+
+  result->iterations = state.iterations;
+  result->skipped = state.skipped;
+  result->label = state.label;
+  result->real_ns = state.real_seconds * 1e9 / state.iterations;
+  result->cpu_ns = state.cpu_seconds * 1e9 / state.iterations;
+  result->items_per_second =
+      state.real_seconds > 0 ? state.items_processed / state.real_seconds : 0;
+  result->bytes_per_second =
+      state.real_seconds > 0 ? state.bytes_processed / state.real_seconds : 0;
+}
+
+static void print_json_string(const char *s) {
+  putchar('"');
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\')
+      putchar('\\');
+    putchar(*s);
+  }
+  putchar('"');
+}
+
+static void print_json_header(void) {
+  char date[64];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+  printf("{\n  \"context\": {\n");
+  printf("    \"date\": \"%s\",\n", date);
+  printf("    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+#ifdef NDEBUG
+  printf("    \"library_build_type\": \"release\"\n");
+#else
+  printf("    \"library_build_type\": \"debug\"\n");
+#endif
+  printf("  },\n  \"benchmarks\": [");
+}
+
+static void print_json_result(const bench_result *r, bool first) {
+  printf("%s\n    {\n      \"name\": ", first ? "" : ",");
+  print_json_string(r->name);
+  printf(",\n      \"run_type\": \"iteration\",\n");
+  if (r->skipped) {
+    printf("      \"error_occurred\": true,\n      \"error_message\": ");
+    print_json_string(r->label ? r->label : "skipped");
+    printf("\n    }");
+    return;
+  }
+  printf("      \"iterations\": %lld,\n", (long long)r->iterations);
+  printf("      \"real_time\": %.3f,\n", r->real_ns);
+  printf("      \"cpu_time\": %.3f,\n", r->cpu_ns);
+  printf("      \"time_unit\": \"ns\"");
+  if (r->items_per_second > 0)
+    printf(",\n      \"items_per_second\": %.3f", r->items_per_second);
+  if (r->bytes_per_second > 0)
+    printf(",\n      \"bytes_per_second\": %.3f", r->bytes_per_second);
+  if (r->label) {
+    printf(",\n      \"label\": ");
+    print_json_string(r->label);
+  }
+  printf("\n    }");
+}
+
+static void print_console_result(const bench_result *r) {
+  if (r->skipped) {
+    printf("%-40s ERROR OCCURRED: '%s'\n", r->name,
+           r->label ? r->label : "skipped");
+    return;
+  }
+  printf("%-40s %15.0f ns %15.0f ns %12lld", r->name, r->real_ns, r->cpu_ns,
+         (long long)r->iterations);
+  if (r->items_per_second > 0)
+    printf(" items/s=%.4g", r->items_per_second);
+  if (r->bytes_per_second > 0)
+    printf(" bytes/s=%.4g", r->bytes_per_second);
+  if (r->label)
+    printf(" %s", r->label);
+  putchar('\n');
+}
+
+int bench_run_all(int argc, char **argv) {
+  const char *filter = NULL;
+  bool json = false;
+  double min_time = 0.5;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--benchmark_filter=", 19) == 0) {
+      filter = argv[i] + 19;
+    } else if (strcmp(argv[i], "--benchmark_format=json") == 0) {
+      json = true;
+    } else if (strcmp(argv[i], "--benchmark_format=console") == 0) {
+      json = false;
+    } else if (strncmp(argv[i], "--benchmark_min_time=", 21) == 0) {
+      min_time = atof(argv[i] + 21);
+    } else if (strcmp(argv[i], "--benchmark_list_tests") == 0) {
+      for (int b = 0; b < registry_count; ++b)
+        printf("%s\n", registry[b].name);
+      return 0;
+    } else {
+      fprintf(stderr,
+              "Unknown option '%s'\n"
+              "Usage: %s [--benchmark_filter=substring]"
+              " [--benchmark_format=json|console]"
+              " [--benchmark_min_time=seconds] [--benchmark_list_tests]\n",
+              argv[i], argv[0]);
+      return 1;
+    }
+  }
+
+  if (json)
+    print_json_header();
+  else
+    printf("%-40s %18s %18s %12s\n", "Benchmark", "Time", "CPU",
+           "Iterations");
+
+  bool first = true;
+  for (int b = 0; b < registry_count; ++b) {
+    const bench_entry *entry = &registry[b];
+    int runs = entry->arg_count > 0 ? entry->arg_count : 1;
+    for (int a = 0; a < runs; ++a) {
+      bench_result result;
+      memset(&result, 0, sizeof(result));
+      int64_t arg = entry->arg_count > 0 ? entry->args[a] : 0;
+      // the filter is matched against the full name including the argument
+      char full_name[128];
+      if (entry->arg_count > 0)
+        snprintf(full_name, sizeof(full_name), "%s/%lld", entry->name,
+                 (long long)arg);
+      else
+        snprintf(full_name, sizeof(full_name), "%s", entry->name);
+      if (filter != NULL && strstr(full_name, filter) == NULL)
+        continue;
+
+      run_one(entry, arg, entry->arg_count > 0, min_time, &result);
+      if (json)
+        print_json_result(&result, first);
+      else
+        print_console_result(&result);
+      fflush(stdout);
+      first = false;
+    }
+  }
+
+  if (json)
+    printf("\n  ]\n}\n");
+  return 0;
+}
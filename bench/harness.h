@@ -0,0 +1,40 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Minimal Google-Benchmark-style harness. A benchmark does its setup, then
+// loops `while (bench_keep_running(state))` around the code being measured;
+// the harness reruns it with more iterations until the minimum time is met.
+
+typedef struct bench_state {
+  int64_t arg;        // the registered argument, e.g. a face count
+  int64_t iterations; // iterations requested for this run
+  int64_t items_processed;
+  int64_t bytes_processed;
+  const char *label;
+  // internal
+  int64_t remaining;
+  double start_real;
+  double start_cpu;
+  double real_seconds;
+  double cpu_seconds;
+  bool running;
+  bool skipped;
+} bench_state;
+
+typedef void (*bench_fn)(bench_state *state);
+
+bool bench_keep_running(bench_state *state);
+void bench_pause_timing(bench_state *state);
+void bench_resume_timing(bench_state *state);
+// Marks the run as skipped, e.g. when an input could not be generated
+void bench_skip(bench_state *state, const char *reason);
+
+void bench_register(const char *name, bench_fn fn, const int64_t *args,
+                    int arg_count);
+// Parses --benchmark_* flags, runs everything and prints the report
+int bench_run_all(int argc, char **argv);
+
+#endif
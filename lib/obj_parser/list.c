@@ -39,7 +39,7 @@ void list_make(list *listo, int start_size, char growable)
 	listo->growable = growable;
 }
 
-int list_add_item(list *listo, void *item, char *name)
+int list_add_item(list *listo, void *item, const char *name)
 {
 	int name_length;
 	char *new_name;
@@ -57,7 +57,8 @@ int list_add_item(list *listo, void *item, char *name)
 	{
 		name_length = strlen(name);
 		new_name = (char*) malloc(sizeof(char) * name_length + 1);
-		strncpy(new_name, name, name_length);
+		memcpy(new_name, name, name_length);
+		new_name[name_length] = '\0';
 		listo->names[listo->item_count] = new_name;
 	}
 
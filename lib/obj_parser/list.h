@@ -1,6 +1,10 @@
 #ifndef __LIST_H
 #define __LIST_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct
 {
 	int item_count;
@@ -12,7 +16,7 @@ typedef struct
 } list;
 
 void list_make(list *listo, int size, char growable);
-int list_add_item(list *listo, void *item, char *name);
+int list_add_item(list *listo, void *item, const char *name);
 char* list_print_items(list *listo);
 void* list_get_name(list *listo, char *name);
 void* list_get_index(list *listo, int indx);
@@ -26,4 +30,9 @@ void list_print_list(list *listo);
 void list_free(list *listo);
 
 void test_list();
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
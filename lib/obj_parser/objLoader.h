@@ -6,11 +6,15 @@
 class objLoader
 {
 public:
-	objLoader() {}
+	objLoader() : data() {}
 	~objLoader()
 	{
 		delete_obj_data(&data);
 	}
+	// the lists below point into data, which only one loader can free;
+	// objMesh is the owning, movable alternative
+	objLoader(const objLoader &) = delete;
+	objLoader &operator=(const objLoader &) = delete;
 
 	int load(char *filename);
 
@@ -0,0 +1,65 @@
+#include "objMesh.h"
+
+#include <cstring>
+
+void objMesh::stringPoolDeleter::operator()(obj_string_pool *pool) const
+{
+	obj_string_pool_free(pool);
+	delete pool;
+}
+
+std::optional<objMesh> objMesh::load(const char *filename)
+{
+	obj_scene_data scene;
+	if(!parse_obj_scene(&scene, const_cast<char *>(filename)))
+		return std::nullopt;
+	return fromScene(scene);
+}
+
+// copies the items behind the parser's pointer lists into one buffer
+template <typename T>
+static std::vector<T> gather(T **items, int count)
+{
+	std::vector<T> buffer;
+	buffer.reserve(count);
+	for(int i=0; i<count; i++)
+		buffer.push_back(*items[i]);
+	return buffer;
+}
+
+objMesh objMesh::fromScene(obj_scene_data &scene)
+{
+	objMesh mesh;
+	mesh.positionBuffer = gather(scene.vertex_list, scene.vertex_count);
+	mesh.normalBuffer = gather(scene.vertex_normal_list, scene.vertex_normal_count);
+	mesh.textureBuffer = gather(scene.vertex_texture_list, scene.vertex_texture_count);
+	mesh.faceBuffer = gather(scene.face_list, scene.face_count);
+	mesh.materialBuffer = gather(scene.material_list, scene.material_count);
+
+	// the materials keep pointing into the pool, which the mesh takes over
+	mesh.strings.reset(new obj_string_pool(scene.strings));
+	obj_string_pool_init(&scene.strings);
+	delete_obj_data(&scene);
+	std::memset(&scene, 0, sizeof(scene));
+
+	int vertexCount = static_cast<int>(mesh.positionBuffer.size());
+	mesh.indexBuffer.reserve(3 * mesh.faceBuffer.size());
+	mesh.triangleFaceBuffer.reserve(mesh.faceBuffer.size());
+	for(std::size_t f=0; f<mesh.faceBuffer.size(); f++)
+	{
+		const obj_face &face = mesh.faceBuffer[f];
+		bool valid = true;
+		for(int j=0; j<face.vertex_count; j++)
+			valid = valid && face.vertex_index[j] >= 0 && face.vertex_index[j] < vertexCount;
+		if(!valid)
+			continue;
+		for(int j=1; j+1<face.vertex_count; j++)
+		{
+			mesh.indexBuffer.push_back(static_cast<std::uint32_t>(face.vertex_index[0]));
+			mesh.indexBuffer.push_back(static_cast<std::uint32_t>(face.vertex_index[j]));
+			mesh.indexBuffer.push_back(static_cast<std::uint32_t>(face.vertex_index[j + 1]));
+			mesh.triangleFaceBuffer.push_back(static_cast<std::uint32_t>(f));
+		}
+	}
+	return mesh;
+}
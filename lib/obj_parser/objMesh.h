@@ -0,0 +1,94 @@
+#ifndef OBJ_MESH_H
+#define OBJ_MESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <vector>
+
+#include "obj_parser.h"
+
+// One triangle of an objMesh, referring into the mesh's buffers
+struct objTriangle
+{
+	const obj_vector &a;
+	const obj_vector &b;
+	const obj_vector &c;
+	int face;	// index into faces()
+	int material;	// index into materials(), -1 for none
+};
+
+// A parsed model that owns its data. Positions, normals, texture
+// coordinates, faces and materials each sit in one contiguous buffer, and
+// faces are also triangulated into an index buffer, so renderers read them
+// through spans without copying. Moving hands the buffers over, copying is
+// not allowed since there is exactly one owner of the material strings.
+class objMesh
+{
+public:
+	// Parses an OBJ file and its material libraries
+	static std::optional<objMesh> load(const char *filename);
+	// Takes over a parsed scene; `scene` is freed and must not be used
+	static objMesh fromScene(obj_scene_data &scene);
+
+	objMesh(objMesh &&) noexcept = default;
+	objMesh &operator=(objMesh &&) noexcept = default;
+	objMesh(const objMesh &) = delete;
+	objMesh &operator=(const objMesh &) = delete;
+	~objMesh() = default;
+
+	std::span<const obj_vector> positions() const { return positionBuffer; }
+	std::span<const obj_vector> normals() const { return normalBuffer; }
+	std::span<const obj_vector> textureCoordinates() const { return textureBuffer; }
+	// as parsed: up to MAX_VERTEX_COUNT corners, indices into the buffers
+	// above or -1
+	std::span<const obj_face> faces() const { return faceBuffer; }
+	// material names and texture paths stay valid as long as the mesh
+	std::span<const obj_material> materials() const { return materialBuffer; }
+
+	// Three position indices per triangle. Faces are split into fans and
+	// triangles with a missing or out of range corner are left out, so
+	// every index is valid.
+	std::span<const std::uint32_t> indices() const { return indexBuffer; }
+	// the face each triangle of indices() came from
+	std::span<const std::uint32_t> triangleFaces() const { return triangleFaceBuffer; }
+	std::size_t triangleCount() const { return triangleFaceBuffer.size(); }
+
+	objTriangle triangle(std::size_t t) const
+	{
+		const obj_face &face = faceBuffer[triangleFaceBuffer[t]];
+		return {positionBuffer[indexBuffer[3 * t]], positionBuffer[indexBuffer[3 * t + 1]],
+			positionBuffer[indexBuffer[3 * t + 2]], static_cast<int>(triangleFaceBuffer[t]),
+			face.material_index};
+	}
+
+	// Every triangle in order, e.g. for(auto [a, b, c, face, material] : mesh.triangles())
+	auto triangles() const
+	{
+		return std::views::iota(std::size_t{0}, triangleCount())
+			| std::views::transform([this](std::size_t t) { return triangle(t); });
+	}
+
+private:
+	struct stringPoolDeleter
+	{
+		void operator()(obj_string_pool *pool) const;
+	};
+
+	objMesh() = default;
+
+	std::vector<obj_vector> positionBuffer;
+	std::vector<obj_vector> normalBuffer;
+	std::vector<obj_vector> textureBuffer;
+	std::vector<obj_face> faceBuffer;
+	std::vector<obj_material> materialBuffer;
+	std::vector<std::uint32_t> indexBuffer;
+	std::vector<std::uint32_t> triangleFaceBuffer;
+	// names and paths of materialBuffer
+	std::unique_ptr<obj_string_pool, stringPoolDeleter> strings;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include "obj_parser.h"
 #include "list.h"
 #include "string_extra.h"
@@ -46,40 +47,68 @@ void obj_set_material_defaults(obj_material *mtl)
 	mtl->glossy = 98;
 	mtl->shiny = 0;
 	mtl->refract_index = 1;
-	mtl->texture_filename[0] = '\0';
+	mtl->name = "";
+	mtl->texture_filename = "";
 }
 
+// reads the next token as a number, missing values read as zero
+double obj_next_double(const char *delimiters)
+{
+	char *token = strtok(NULL, delimiters);
+	return token == NULL ? 0.0 : atof(token);
+}
+
+// copies the next token into a fixed size buffer, always terminated
+void obj_next_string(char *dest, int size, const char *delimiters)
+{
+	char *token = strtok(NULL, delimiters);
+	dest[0] = '\0';
+	if(token == NULL)
+		return;
+	strncpy(dest, token, size - 1);
+	dest[size - 1] = '\0';
+}
+
+// parses up to MAX_VERTEX_COUNT "v/vt/vn" groups, unused slots are left 0;
+// extra vertices on the line are ignored since the arrays are fixed size
 int obj_parse_vertex_index(int *vertex_index, int *texture_index, int *normal_index)
 {
 	char *temp_str;
 	char *token;
 	int vertex_count = 0;
 
-	
-	while( (token = strtok(NULL, WHITESPACE)) != NULL)
+	for(int i=0; i<MAX_VERTEX_COUNT; i++)
 	{
+		vertex_index[i] = 0;
 		if(texture_index != NULL)
-			texture_index[vertex_count] = 0;
+			texture_index[i] = 0;
 		if(normal_index != NULL)
-		normal_index[vertex_count] = 0;
-
+			normal_index[i] = 0;
+	}
+	
+	while( vertex_count < MAX_VERTEX_COUNT && (token = strtok(NULL, WHITESPACE)) != NULL)
+	{
 		vertex_index[vertex_count] = atoi( token );
 		
 		if(contains(token, "//"))  //normal only
 		{
 			temp_str = strchr(token, '/');
 			temp_str++;
-			normal_index[vertex_count] = atoi( ++temp_str );
+			if(normal_index != NULL)
+				normal_index[vertex_count] = atoi( ++temp_str );
 		}
 		else if(contains(token, "/"))
 		{
 			temp_str = strchr(token, '/');
-			texture_index[vertex_count] = atoi( ++temp_str );
+			if(texture_index != NULL)
+				texture_index[vertex_count] = atoi( temp_str + 1 );
+			temp_str++;
 
 			if(contains(temp_str, "/"))
 			{
 				temp_str = strchr(temp_str, '/');
-				normal_index[vertex_count] = atoi( ++temp_str );
+				if(normal_index != NULL)
+					normal_index[vertex_count] = atoi( ++temp_str );
 			}
 		}
 		
@@ -134,7 +163,7 @@ obj_plane* obj_parse_plane(obj_growable_scene_data *scene)
 obj_light_point* obj_parse_light_point(obj_growable_scene_data *scene)
 {
 	obj_light_point *o= (obj_light_point*)malloc(sizeof(obj_light_point));
-	o->pos_index = obj_convert_to_list_index(scene->vertex_list.item_count, atoi( strtok(NULL, WHITESPACE)) );
+	o->pos_index = obj_convert_to_list_index(scene->vertex_list.item_count, (int)obj_next_double(WHITESPACE));
 	return o;
 }
 
@@ -162,22 +191,31 @@ obj_light_disc* obj_parse_light_disc(obj_growable_scene_data *scene)
 obj_vector* obj_parse_vector()
 {
 	obj_vector *v = (obj_vector*)malloc(sizeof(obj_vector));
-	v->e[0] = atof( strtok(NULL, WHITESPACE));
-	v->e[1] = atof( strtok(NULL, WHITESPACE));
-	v->e[2] = atof( strtok(NULL, WHITESPACE));
+	v->e[0] = obj_next_double(WHITESPACE);
+	v->e[1] = obj_next_double(WHITESPACE);
+	v->e[2] = obj_next_double(WHITESPACE);
 	return v;
 }
 
 void obj_parse_camera(obj_growable_scene_data *scene, obj_camera *camera)
 {
-	int indices[3];
+	int indices[MAX_VERTEX_COUNT];
 	obj_parse_vertex_index(indices, NULL, NULL);
 	camera->camera_pos_index = obj_convert_to_list_index(scene->vertex_list.item_count, indices[0]);
 	camera->camera_look_point_index = obj_convert_to_list_index(scene->vertex_list.item_count, indices[1]);
 	camera->camera_up_norm_index = obj_convert_to_list_index(scene->vertex_normal_list.item_count, indices[2]);
 }
 
-int obj_parse_mtl_file(char *filename, list *material_list)
+// the pool's copy of the next token, read into a buffer of `size`
+const char* obj_next_pooled_string(obj_string_pool *strings, int size, const char *delimiters)
+{
+	char buffer[OBJ_FILENAME_LENGTH > MATERIAL_NAME_SIZE ? OBJ_FILENAME_LENGTH : MATERIAL_NAME_SIZE];
+	obj_next_string(buffer, size, delimiters);
+	const char *pooled = obj_string_pool_intern(strings, buffer);
+	return pooled != NULL ? pooled : "";
+}
+
+int obj_parse_mtl_file(char *filename, list *material_list, obj_string_pool *strings, int quiet)
 {
 	int line_number = 0;
 	char *current_token;
@@ -190,11 +228,10 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 	mtl_file_stream = fopen( filename, "r");
 	if(mtl_file_stream == 0)
 	{
-		fprintf(stderr, "Error reading file: %s\n", filename);
+		if(!quiet)
+			fprintf(stderr, "Error reading file: %s\n", filename);
 		return 0;
 	}
-		
-	list_make(material_list, 10, 1);
 
 	while( fgets(current_line, OBJ_LINE_SIZE, mtl_file_stream) )
 	{
@@ -214,57 +251,57 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 			obj_set_material_defaults(current_mtl);
 			
 			// get the name
-			strncpy(current_mtl->name, strtok(NULL, " \t"), MATERIAL_NAME_SIZE);
-			list_add_item(material_list, current_mtl, current_mtl->name);
+			current_mtl->name = obj_next_pooled_string(strings, MATERIAL_NAME_SIZE, WHITESPACE);
+			list_add_item(material_list, current_mtl, NULL);
 		}
 		
 		//ambient
 		else if( strequal(current_token, "Ka") && material_open)
 		{
-			current_mtl->amb[0] = atof( strtok(NULL, " \t"));
-			current_mtl->amb[1] = atof( strtok(NULL, " \t"));
-			current_mtl->amb[2] = atof( strtok(NULL, " \t"));
+			current_mtl->amb[0] = obj_next_double(" \t");
+			current_mtl->amb[1] = obj_next_double(" \t");
+			current_mtl->amb[2] = obj_next_double(" \t");
 		}
 
 		//diff
 		else if( strequal(current_token, "Kd") && material_open)
 		{
-			current_mtl->diff[0] = atof( strtok(NULL, " \t"));
-			current_mtl->diff[1] = atof( strtok(NULL, " \t"));
-			current_mtl->diff[2] = atof( strtok(NULL, " \t"));
+			current_mtl->diff[0] = obj_next_double(" \t");
+			current_mtl->diff[1] = obj_next_double(" \t");
+			current_mtl->diff[2] = obj_next_double(" \t");
 		}
 		
 		//specular
 		else if( strequal(current_token, "Ks") && material_open)
 		{
-			current_mtl->spec[0] = atof( strtok(NULL, " \t"));
-			current_mtl->spec[1] = atof( strtok(NULL, " \t"));
-			current_mtl->spec[2] = atof( strtok(NULL, " \t"));
+			current_mtl->spec[0] = obj_next_double(" \t");
+			current_mtl->spec[1] = obj_next_double(" \t");
+			current_mtl->spec[2] = obj_next_double(" \t");
 		}
 		//shiny
 		else if( strequal(current_token, "Ns") && material_open)
 		{
-			current_mtl->shiny = atof( strtok(NULL, " \t"));
+			current_mtl->shiny = obj_next_double(" \t");
 		}
 		//transparent
 		else if( strequal(current_token, "d") && material_open)
 		{
-			current_mtl->trans = atof( strtok(NULL, " \t"));
+			current_mtl->trans = obj_next_double(" \t");
 		}
 		//reflection
 		else if( strequal(current_token, "r") && material_open)
 		{
-			current_mtl->reflect = atof( strtok(NULL, " \t"));
+			current_mtl->reflect = obj_next_double(" \t");
 		}
 		//glossy
 		else if( strequal(current_token, "sharpness") && material_open)
 		{
-			current_mtl->glossy = atof( strtok(NULL, " \t"));
+			current_mtl->glossy = obj_next_double(" \t");
 		}
 		//refract index
 		else if( strequal(current_token, "Ni") && material_open)
 		{
-			current_mtl->refract_index = atof( strtok(NULL, " \t"));
+			current_mtl->refract_index = obj_next_double(" \t");
 		}
 		// illumination type
 		else if( strequal(current_token, "illum") && material_open)
@@ -273,9 +310,9 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 		// texture map
 		else if( strequal(current_token, "map_Ka") && material_open)
 		{
-			strncpy(current_mtl->texture_filename, strtok(NULL, " \t"), OBJ_FILENAME_LENGTH);
+			current_mtl->texture_filename = obj_next_pooled_string(strings, OBJ_FILENAME_LENGTH, WHITESPACE);
 		}
-		else
+		else if(!quiet)
 		{
 			fprintf(stderr, "Unknown command '%s' in material file %s at line %i:\n\t%s\n",
 					current_token, filename, line_number, current_line);
@@ -289,6 +326,138 @@ int obj_parse_mtl_file(char *filename, list *material_list)
 
 }
 
+typedef struct obj_mtl_cache_entry
+{
+	char *filename;
+	long long mtime_ns;
+	long long size;
+	obj_material *materials;
+	int material_count;
+	obj_string_pool strings;	// of materials
+} obj_mtl_cache_entry;
+
+obj_mtl_cache_entry* obj_mtl_cache_find(obj_mtl_cache *cache, char *filename)
+{
+	for(int i=0; i<cache->entries.item_count; i++)
+	{
+		obj_mtl_cache_entry *entry = (obj_mtl_cache_entry*)cache->entries.items[i];
+		if(strequal(entry->filename, filename))
+			return entry;
+	}
+	return NULL;
+}
+
+// copies mtl with its strings moved into `strings`
+void obj_copy_material(obj_material *copy, const obj_material *mtl, obj_string_pool *strings)
+{
+	memcpy(copy, mtl, sizeof(obj_material));
+	copy->name = obj_string_pool_intern(strings, mtl->name);
+	copy->texture_filename = obj_string_pool_intern(strings, mtl->texture_filename);
+	if(copy->name == NULL)
+		copy->name = "";
+	if(copy->texture_filename == NULL)
+		copy->texture_filename = "";
+}
+
+void obj_add_material_copy(list *material_list, obj_material *mtl, obj_string_pool *strings)
+{
+	obj_material *copy = (obj_material*) malloc(sizeof(obj_material));
+	obj_copy_material(copy, mtl, strings);
+	list_add_item(material_list, copy, NULL);
+}
+
+// material lists carry no names of their own, the pooled name in each
+// material is the only copy; matches like list_find
+int obj_find_material(list *material_list, const char *name)
+{
+	size_t length = strlen(name);
+	for(int i=0; i<material_list->item_count; i++)
+	{
+		obj_material *mtl = (obj_material*)material_list->items[i];
+		if(strncmp(mtl->name, name, length) == 0)
+			return i;
+	}
+	return -1;
+}
+
+// parses a material library, or copies it from the cache when the file on
+// disk is the one that was parsed last time
+int obj_load_mtl_file(obj_growable_scene_data *growable_data, char *filename)
+{
+	struct stat file_info;
+	obj_mtl_cache *cache = growable_data->mtl_cache;
+
+	if(cache == NULL || stat(filename, &file_info) != 0)
+		return obj_parse_mtl_file(filename, &growable_data->material_list, &growable_data->strings, growable_data->quiet);
+
+	long long mtime_ns = (long long)file_info.st_mtim.tv_sec * 1000000000LL + file_info.st_mtim.tv_nsec;
+	obj_mtl_cache_entry *entry = obj_mtl_cache_find(cache, filename);
+	if(entry != NULL && entry->mtime_ns == mtime_ns && entry->size == (long long)file_info.st_size)
+	{
+		cache->hits++;
+		for(int i=0; i<entry->material_count; i++)
+			obj_add_material_copy(&growable_data->material_list, &entry->materials[i], &growable_data->strings);
+		return 1;
+	}
+
+	list parsed;
+	list_make(&parsed, 10, 1);
+	if(obj_parse_mtl_file(filename, &parsed, &growable_data->strings, growable_data->quiet) == 0)
+	{
+		list_free(&parsed);
+		return 0;
+	}
+	cache->misses++;
+
+	if(entry == NULL)
+	{
+		entry = (obj_mtl_cache_entry*) malloc(sizeof(obj_mtl_cache_entry));
+		entry->filename = (char*) malloc(strlen(filename) + 1);
+		strcpy(entry->filename, filename);
+		obj_string_pool_init(&entry->strings);
+		list_add_item(&cache->entries, entry, NULL);
+	}
+	else
+	{
+		free(entry->materials);
+		obj_string_pool_free(&entry->strings);
+	}
+	entry->mtime_ns = mtime_ns;
+	entry->size = (long long)file_info.st_size;
+	entry->material_count = parsed.item_count;
+	entry->materials = (obj_material*) malloc(sizeof(obj_material) * (parsed.item_count > 0 ? parsed.item_count : 1));
+
+	// the scene takes the parsed materials, the cache keeps copies
+	for(int i=0; i<parsed.item_count; i++)
+	{
+		obj_material *mtl = (obj_material*)parsed.items[i];
+		obj_copy_material(&entry->materials[i], mtl, &entry->strings);
+		list_add_item(&growable_data->material_list, mtl, NULL);
+	}
+	list_free(&parsed);
+	return 1;
+}
+
+void obj_mtl_cache_init(obj_mtl_cache *cache)
+{
+	list_make(&cache->entries, 4, 1);
+	cache->hits = 0;
+	cache->misses = 0;
+}
+
+void obj_mtl_cache_free(obj_mtl_cache *cache)
+{
+	for(int i=0; i<cache->entries.item_count; i++)
+	{
+		obj_mtl_cache_entry *entry = (obj_mtl_cache_entry*)cache->entries.items[i];
+		free(entry->materials);
+		free(entry->filename);
+		obj_string_pool_free(&entry->strings);
+		free(entry);
+	}
+	list_free(&cache->entries);
+}
+
 int obj_parse_obj_file(obj_growable_scene_data *growable_data, char *filename)
 {
 	FILE* obj_file_stream;
@@ -300,7 +469,8 @@ int obj_parse_obj_file(obj_growable_scene_data *growable_data, char *filename)
 	obj_file_stream = fopen( filename, "r");
 	if(obj_file_stream == 0)
 	{
-		fprintf(stderr, "Error reading file: %s\n", filename);
+		if(!growable_data->quiet)
+			fprintf(stderr, "Error reading file: %s\n", filename);
 		return 0;
 	}
 
@@ -391,19 +561,22 @@ int obj_parse_obj_file(obj_growable_scene_data *growable_data, char *filename)
 		
 		else if( strequal(current_token, "c") ) //camera
 		{
+			free(growable_data->camera);
 			growable_data->camera = (obj_camera*) malloc(sizeof(obj_camera));
 			obj_parse_camera(growable_data, growable_data->camera);
 		}
 		
 		else if( strequal(current_token, "usemtl") ) // usemtl
 		{
-			current_material = list_find(&growable_data->material_list, strtok(NULL, WHITESPACE));
+			char *material_name = strtok(NULL, WHITESPACE);
+			current_material = material_name == NULL ? -1 : obj_find_material(&growable_data->material_list, material_name);
 		}
 		
 		else if( strequal(current_token, "mtllib") ) // mtllib
 		{
-			strncpy(growable_data->material_filename, strtok(NULL, WHITESPACE), OBJ_FILENAME_LENGTH);
-			obj_parse_mtl_file(growable_data->material_filename, &growable_data->material_list);
+			char material_filename[OBJ_FILENAME_LENGTH];
+			obj_next_string(material_filename, OBJ_FILENAME_LENGTH, WHITESPACE);
+			obj_load_mtl_file(growable_data, material_filename);
 			continue;
 		}
 		
@@ -414,7 +587,7 @@ int obj_parse_obj_file(obj_growable_scene_data *growable_data, char *filename)
 		else if( strequal(current_token, "g") ) // group
 		{ }		
 
-		else
+		else if(!growable_data->quiet)
 		{
 			printf("Unknown command '%s' in scene code at line %i: \"%s\".\n",
 					current_token, line_number, current_line);
@@ -442,6 +615,8 @@ void obj_init_temp_storage(obj_growable_scene_data *growable_data)
 	list_make(&growable_data->light_disc_list, 10, 1);
 	
 	list_make(&growable_data->material_list, 10, 1);	
+	growable_data->mtl_cache = NULL;
+	obj_string_pool_init(&growable_data->strings);
 	
 	growable_data->camera = NULL;
 }
@@ -463,6 +638,25 @@ void obj_free_temp_storage(obj_growable_scene_data *growable_data)
 	obj_free_half_list(&growable_data->material_list);
 }
 
+// releases the lists themselves when parsing failed and nothing is handed out
+void obj_discard_temp_storage(obj_growable_scene_data *growable_data)
+{
+	list_free(&growable_data->vertex_list);
+	list_free(&growable_data->vertex_normal_list);
+	list_free(&growable_data->vertex_texture_list);
+	
+	list_free(&growable_data->face_list);
+	list_free(&growable_data->sphere_list);
+	list_free(&growable_data->plane_list);
+	
+	list_free(&growable_data->light_point_list);
+	list_free(&growable_data->light_quad_list);
+	list_free(&growable_data->light_disc_list);
+	
+	list_free(&growable_data->material_list);
+	obj_string_pool_free(&growable_data->strings);
+}
+
 void delete_obj_data(obj_scene_data *data_out)
 {
 	int i;
@@ -502,6 +696,7 @@ void delete_obj_data(obj_scene_data *data_out)
 	free(data_out->material_list);
 
 	free(data_out->camera);
+	obj_string_pool_free(&data_out->strings);
 }
 
 void obj_copy_to_out_storage(obj_scene_data *data_out, obj_growable_scene_data *growable_data)
@@ -535,15 +730,27 @@ void obj_copy_to_out_storage(obj_scene_data *data_out, obj_growable_scene_data *
 	data_out->material_list = (obj_material**)growable_data->material_list.items;
 	
 	data_out->camera = growable_data->camera;
+	// the scene takes over the strings
+	data_out->strings = growable_data->strings;
 }
 
 int parse_obj_scene(obj_scene_data *data_out, char *filename)
+{
+	return parse_obj_scene_cached(data_out, filename, NULL, 0);
+}
+
+int parse_obj_scene_cached(obj_scene_data *data_out, char *filename, obj_mtl_cache *cache, int quiet)
 {
 	obj_growable_scene_data growable_data;
 
 	obj_init_temp_storage(&growable_data);
+	growable_data.mtl_cache = cache;
+	growable_data.quiet = quiet;
 	if( obj_parse_obj_file(&growable_data, filename) == 0)
+	{
+		obj_discard_temp_storage(&growable_data);
 		return 0;
+	}
 	
 	//print_vector(NORMAL, "Max bounds are: ", &growable_data->extreme_dimensions[1]);
 	//print_vector(NORMAL, "Min bounds are: ", &growable_data->extreme_dimensions[0]);
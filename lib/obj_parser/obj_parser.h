@@ -2,6 +2,11 @@
 #define OBJ_PARSER_H
 
 #include "list.h"
+#include "string_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #define OBJ_FILENAME_LENGTH 500
 #define MATERIAL_NAME_SIZE 255
@@ -36,9 +41,9 @@ typedef struct obj_vector {
   double e[3];
 } obj_vector;
 
+// Names and paths are read into buffers of MATERIAL_NAME_SIZE and
+// OBJ_FILENAME_LENGTH while parsing, then kept in the scene's string pool
 typedef struct obj_material {
-  char name[MATERIAL_NAME_SIZE];
-  char texture_filename[OBJ_FILENAME_LENGTH];
   double amb[3];
   double diff[3];
   double spec[3];
@@ -48,6 +53,9 @@ typedef struct obj_material {
   double shiny;
   double glossy;
   double refract_index;
+  // rarely needed while rendering, kept out of the way of the numbers
+  const char *name;
+  const char *texture_filename; // "" when there is none
 } obj_material;
 
 typedef struct obj_camera {
@@ -72,11 +80,17 @@ typedef struct obj_light_quad {
   int material_index;
 } obj_light_quad;
 
+// Material libraries parsed by earlier loads. Passing the same cache to
+// parse_obj_scene_cached skips re-parsing .mtl files whose size and
+// modification time have not changed.
+typedef struct obj_mtl_cache {
+  list entries;
+  int hits;
+  int misses;
+} obj_mtl_cache;
+
 typedef struct obj_growable_scene_data {
   //	vector extreme_dimensions[2];
-  char scene_filename[OBJ_FILENAME_LENGTH];
-  char material_filename[OBJ_FILENAME_LENGTH];
-
   list vertex_list;
   list vertex_normal_list;
   list vertex_texture_list;
@@ -90,6 +104,9 @@ typedef struct obj_growable_scene_data {
   list light_disc_list;
 
   list material_list;
+  obj_mtl_cache *mtl_cache;
+  obj_string_pool strings;
+  int quiet; // no diagnostics on stdout or stderr
 
   obj_camera *camera;
 } obj_growable_scene_data;
@@ -124,9 +141,23 @@ typedef struct obj_scene_data {
   int material_count;
 
   obj_camera *camera;
+  // material names and paths, apart from the geometry the renderer walks
+  obj_string_pool strings;
 } obj_scene_data;
 
 int parse_obj_scene(obj_scene_data *data_out, char *filename);
+// Like parse_obj_scene, taking material libraries from `cache` when it is
+// not NULL. `quiet` drops the diagnostics about unreadable files and
+// unknown commands, for loads in the background while the terminal shows a
+// frame.
+int parse_obj_scene_cached(obj_scene_data *data_out, char *filename,
+                           obj_mtl_cache *cache, int quiet);
+void obj_mtl_cache_init(obj_mtl_cache *cache);
+void obj_mtl_cache_free(obj_mtl_cache *cache);
 void delete_obj_data(obj_scene_data *data_out);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,456 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "obj_writer.h"
+
+#define OBJ_WRITE_BUFFER_SIZE (1 << 20)
+// magnitudes written without printf: 10^-5 and 2^52, so every power of
+// ten used is exact and every value is f / 2^shift with shift > 0
+#define OBJ_FIXED_MIN 1e-5
+#define OBJ_FIXED_MAX 0x1p52
+#define OBJ_MAX_DECIMALS 22
+
+__extension__ typedef unsigned __int128 obj_uint128;
+
+static const double obj_powers_of_ten[OBJ_MAX_DECIMALS + 1] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const obj_uint128 obj_powers_of_ten_exact[OBJ_MAX_DECIMALS + 1] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+	10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+	100000000000ull, 1000000000000ull, 10000000000000ull,
+	100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+	100000000000000000ull, 1000000000000000000ull,
+	10000000000000000000ull,
+	(obj_uint128)10000000000000000000ull * 10,
+	(obj_uint128)10000000000000000000ull * 100,
+	(obj_uint128)10000000000000000000ull * 1000
+};
+
+typedef struct obj_writer
+{
+	FILE *file;
+	char *buffer;
+	size_t used;
+	int failed;
+} obj_writer;
+
+static int obj_writer_open(obj_writer *w, const char *filename)
+{
+	w->used = 0;
+	w->failed = 0;
+	w->buffer = (char*) malloc(OBJ_WRITE_BUFFER_SIZE);
+	w->file = w->buffer == NULL ? NULL : fopen(filename, "wb");
+	if(w->file == NULL)
+	{
+		fprintf(stderr, "Error writing file: %s\n", filename);
+		free(w->buffer);
+		return 0;
+	}
+	return 1;
+}
+
+static void obj_writer_flush(obj_writer *w)
+{
+	if(w->used > 0 && !w->failed && fwrite(w->buffer, 1, w->used, w->file) != w->used)
+		w->failed = 1;
+	w->used = 0;
+}
+
+// makes room for `bytes` more, which must be at most the buffer size
+static char* obj_writer_reserve(obj_writer *w, size_t bytes)
+{
+	if(w->used + bytes > OBJ_WRITE_BUFFER_SIZE)
+		obj_writer_flush(w);
+	return w->buffer + w->used;
+}
+
+static int obj_writer_close(obj_writer *w)
+{
+	obj_writer_flush(w);
+	if(fclose(w->file) != 0)
+		w->failed = 1;
+	free(w->buffer);
+	return !w->failed;
+}
+
+static void obj_write_text(obj_writer *w, const char *s)
+{
+	size_t length = strlen(s);
+	while(length > 0)
+	{
+		size_t chunk = length < OBJ_WRITE_BUFFER_SIZE ? length : OBJ_WRITE_BUFFER_SIZE;
+		memcpy(obj_writer_reserve(w, chunk), s, chunk);
+		w->used += chunk;
+		s += chunk;
+		length -= chunk;
+	}
+}
+
+static void obj_write_char(obj_writer *w, char c)
+{
+	*obj_writer_reserve(w, 1) = c;
+	w->used++;
+}
+
+static const char obj_digit_pairs[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+// digits of value, most significant first; counted first so they can be
+// written in place from the end, two at a time
+static int obj_format_unsigned(char *out, uint64_t value)
+{
+	int count = 1;
+	while(count < 20 && value >= (uint64_t)obj_powers_of_ten_exact[count])
+		count++;
+	char *end = out + count;
+	while(value >= 100)
+	{
+		end -= 2;
+		memcpy(end, obj_digit_pairs + 2 * (value % 100), 2);
+		value /= 100;
+	}
+	if(value >= 10)
+		memcpy(end - 2, obj_digit_pairs + 2 * value, 2);
+	else
+		end[-1] = (char)('0' + value);
+	return count;
+}
+
+static void obj_write_int(obj_writer *w, long long value)
+{
+	char *out = obj_writer_reserve(w, 21);
+	int length = 0;
+	if(value < 0)
+		out[length++] = '-';
+	length += obj_format_unsigned(out + length, value < 0 ? 0 - (uint64_t)value : (uint64_t)value);
+	w->used += length;
+}
+
+// m * 10^-k as plain decimals, without trailing zeros
+static int obj_format_fixed(char *out, uint64_t m, int k)
+{
+	char digits[20];
+	int count = obj_format_unsigned(digits, m);
+	while(k > 0 && count > 1 && digits[count - 1] == '0')
+	{
+		count--;
+		k--;
+	}
+	int length = 0;
+	if(count <= k)
+	{
+		// 0.00ddd
+		out[length++] = '0';
+		out[length++] = '.';
+		memset(out + length, '0', k - count);
+		length += k - count;
+		memcpy(out + length, digits, count);
+		length += count;
+	}
+	else
+	{
+		memcpy(out, digits, count - k);
+		length = count - k;
+		if(k > 0)
+		{
+			out[length++] = '.';
+			memcpy(out + length, digits + count - k, k);
+			length += k;
+		}
+	}
+	out[length] = '\0';
+	return length;
+}
+
+int obj_format_double(char *out, double value)
+{
+	int length = 0;
+	if(isnan(value))
+		return sprintf(out, "nan");
+	if(signbit(value))
+	{
+		out[length++] = '-';
+		value = -value;
+	}
+	if(isinf(value))
+		return length + sprintf(out + length, "inf");
+	if(value == 0)
+		return length + obj_format_fixed(out + length, 0, 0);
+
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	int biased_exponent = (int)(bits >> 52);
+	if(value >= OBJ_FIXED_MIN && value < OBJ_FIXED_MAX)
+	{
+		// 10^d <= value < 10^(d + 2); floor(e * log10(2)) for value >= 2^e
+		int d = ((biased_exponent - 1023) * 78913) >> 18;
+
+		// 8, then 15 significant digits, where the product below is within
+		// far less than 0.5 of an integer m when value was read from
+		// m * 10^-k. Division, correctly rounded like atof, tells whether it
+		// was: then m with k decimals reads back as value. Most models are
+		// written with float precision and pass the first try; shorter text
+		// ends in zeros that obj_format_fixed drops.
+		for(int digits=8; digits<=15; digits+=7)
+		{
+			int k = digits - 1 - d;
+			double product = k >= 0 ? value * obj_powers_of_ten[k] : 0x1p50;
+			if(product >= 0x1p50 && --k >= 0)
+				product = value * obj_powers_of_ten[k];
+			if(k < 0)
+				continue;
+			double m = (double)(int64_t)(product + 0.5);
+			if(m / obj_powers_of_ten[k] == value)
+				return length + obj_format_fixed(out + length, (uint64_t)m, k);
+		}
+
+		// Else value * 10^k rounded to 17 significant digits, exactly:
+		// value is f / 2^shift, and 17 digits always read back
+		uint64_t f = (bits & ((1ull << 52) - 1)) | 1ull << 52;
+		int shift = 1075 - biased_exponent;
+		for(int k=16 - d; ; )
+		{
+			obj_uint128 scaled = (obj_uint128)f * obj_powers_of_ten_exact[k];
+			uint64_t rounded = (uint64_t)((scaled + ((obj_uint128)1 << (shift - 1))) >> shift);
+			if(rounded < 10000000000000000ull && k < OBJ_MAX_DECIMALS)
+				k++;
+			else if(rounded >= 100000000000000000ull && k > 0)
+				k--;
+			else
+				return length + obj_format_fixed(out + length, rounded, k);
+		}
+	}
+
+	// very large or very small magnitudes, rare in models
+	for(int precision=15; ; precision++)
+	{
+		int written = sprintf(out + length, "%.*g", precision, value);
+		if(precision == 17 || strtod(out + length, NULL) == value)
+			return length + written;
+	}
+}
+
+static void obj_write_double(obj_writer *w, double value)
+{
+	w->used += obj_format_double(obj_writer_reserve(w, OBJ_DOUBLE_TEXT_SIZE + 1), value);
+}
+
+static void obj_write_vector(obj_writer *w, const char *tag, const obj_vector *v)
+{
+	obj_write_text(w, tag);
+	for(int i=0; i<3; i++)
+	{
+		obj_write_char(w, ' ');
+		obj_write_double(w, v->e[i]);
+	}
+	obj_write_char(w, '\n');
+}
+
+// The parser's reading of the index written here is `index`: counting from
+// 1, 0 for none (-1), and below that back from the end of the list, which
+// has all `count` items by the time elements refer to it
+static void obj_write_index(obj_writer *w, int index, int count)
+{
+	obj_write_int(w, index >= -1 ? (long long)index + 1 : (long long)index - count);
+}
+
+// v, v/vt, v//vn or v/vt/vn, whatever is needed
+static void obj_write_vertex_ref(obj_writer *w, const obj_scene_data *scene, int vertex, int texture, int normal)
+{
+	obj_write_char(w, ' ');
+	obj_write_index(w, vertex, scene->vertex_count);
+	if(texture == -1 && normal == -1)
+		return;
+	obj_write_char(w, '/');
+	if(texture != -1)
+		obj_write_index(w, texture, scene->vertex_texture_count);
+	if(normal != -1)
+	{
+		obj_write_char(w, '/');
+		obj_write_index(w, normal, scene->vertex_normal_count);
+	}
+}
+
+static void obj_write_values(obj_writer *w, const char *tag, const double *values, int count)
+{
+	obj_write_text(w, tag);
+	for(int i=0; i<count; i++)
+	{
+		obj_write_char(w, ' ');
+		obj_write_double(w, values[i]);
+	}
+	obj_write_char(w, '\n');
+}
+
+static int obj_write_mtl_file(const obj_scene_data *scene, const char *filename)
+{
+	obj_writer w;
+	if(!obj_writer_open(&w, filename))
+		return 0;
+	for(int i=0; i<scene->material_count; i++)
+	{
+		const obj_material *mtl = scene->material_list[i];
+		obj_write_text(&w, "newmtl ");
+		obj_write_text(&w, mtl->name);
+		obj_write_char(&w, '\n');
+		obj_write_values(&w, "Ka", mtl->amb, 3);
+		obj_write_values(&w, "Kd", mtl->diff, 3);
+		obj_write_values(&w, "Ks", mtl->spec, 3);
+		obj_write_values(&w, "Ns", &mtl->shiny, 1);
+		obj_write_values(&w, "d", &mtl->trans, 1);
+		obj_write_values(&w, "r", &mtl->reflect, 1);
+		obj_write_values(&w, "sharpness", &mtl->glossy, 1);
+		obj_write_values(&w, "Ni", &mtl->refract_index, 1);
+		if(mtl->texture_filename[0] != '\0')
+		{
+			obj_write_text(&w, "map_Ka ");
+			obj_write_text(&w, mtl->texture_filename);
+			obj_write_char(&w, '\n');
+		}
+	}
+	return obj_writer_close(&w);
+}
+
+// switches the current material with usemtl; a bare usemtl clears it
+static void obj_use_material(obj_writer *w, const obj_scene_data *scene, int with_materials, int *current, int material)
+{
+	if(!with_materials || material == *current)
+		return;
+	obj_write_text(w, "usemtl");
+	if(material >= 0 && material < scene->material_count)
+	{
+		obj_write_char(w, ' ');
+		obj_write_text(w, scene->material_list[material]->name);
+	}
+	obj_write_char(w, '\n');
+	*current = material;
+}
+
+int obj_write_scene(const obj_scene_data *scene, const char *obj_filename, const char *mtl_filename)
+{
+	int with_materials = mtl_filename != NULL;
+	if(with_materials && !obj_write_mtl_file(scene, mtl_filename))
+		return 0;
+
+	obj_writer w;
+	if(!obj_writer_open(&w, obj_filename))
+		return 0;
+	if(with_materials)
+	{
+		obj_write_text(&w, "mtllib ");
+		obj_write_text(&w, mtl_filename);
+		obj_write_char(&w, '\n');
+	}
+
+	for(int i=0; i<scene->vertex_count; i++)
+		obj_write_vector(&w, "v", scene->vertex_list[i]);
+	for(int i=0; i<scene->vertex_normal_count; i++)
+		obj_write_vector(&w, "vn", scene->vertex_normal_list[i]);
+	for(int i=0; i<scene->vertex_texture_count; i++)
+		obj_write_vector(&w, "vt", scene->vertex_texture_list[i]);
+
+	if(scene->camera != NULL)
+	{
+		obj_write_char(&w, 'c');
+		obj_write_vertex_ref(&w, scene, scene->camera->camera_pos_index, -1, -1);
+		obj_write_vertex_ref(&w, scene, scene->camera->camera_look_point_index, -1, -1);
+		// read from the position slot, but counted among the normals
+		obj_write_char(&w, ' ');
+		obj_write_index(&w, scene->camera->camera_up_norm_index, scene->vertex_normal_count);
+		obj_write_char(&w, '\n');
+	}
+
+	int material = -1;
+	for(int i=0; i<scene->face_count; i++)
+	{
+		const obj_face *face = scene->face_list[i];
+		obj_use_material(&w, scene, with_materials, &material, face->material_index);
+		obj_write_char(&w, 'f');
+		for(int j=0; j<face->vertex_count; j++)
+			obj_write_vertex_ref(&w, scene, face->vertex_index[j], face->texture_index[j], face->normal_index[j]);
+		obj_write_char(&w, '\n');
+	}
+
+	// spheres and planes are a position and two normals, each with a
+	// texture coordinate; a fourth one only holds a texture coordinate
+	for(int i=0; i<scene->sphere_count + scene->plane_count; i++)
+	{
+		int is_sphere = i < scene->sphere_count;
+		const obj_sphere *sphere = is_sphere ? scene->sphere_list[i] : NULL;
+		const obj_plane *plane = is_sphere ? NULL : scene->plane_list[i - scene->sphere_count];
+		int refs[MAX_VERTEX_COUNT] = {
+			is_sphere ? sphere->pos_index : plane->pos_index,
+			is_sphere ? sphere->up_normal_index : plane->normal_index,
+			is_sphere ? sphere->equator_normal_index : plane->rotation_normal_index,
+			-1
+		};
+		const int *texture_index = is_sphere ? sphere->texture_index : plane->texture_index;
+		obj_use_material(&w, scene, with_materials, &material, is_sphere ? sphere->material_index : plane->material_index);
+		obj_write_text(&w, is_sphere ? "sp" : "pl");
+		for(int j=0; j<MAX_VERTEX_COUNT; j++)
+		{
+			if(j == 3 && texture_index[3] == -1)
+				break;
+			obj_write_char(&w, ' ');
+			obj_write_index(&w, refs[j], j == 0 ? scene->vertex_count : scene->vertex_normal_count);
+			if(texture_index[j] != -1)
+			{
+				obj_write_char(&w, '/');
+				obj_write_index(&w, texture_index[j], scene->vertex_texture_count);
+			}
+		}
+		obj_write_char(&w, '\n');
+	}
+
+	for(int i=0; i<scene->light_point_count; i++)
+	{
+		obj_use_material(&w, scene, with_materials, &material, scene->light_point_list[i]->material_index);
+		obj_write_text(&w, "lp ");
+		obj_write_index(&w, scene->light_point_list[i]->pos_index, scene->vertex_count);
+		obj_write_char(&w, '\n');
+	}
+	for(int i=0; i<scene->light_disc_count; i++)
+	{
+		const obj_light_disc *disc = scene->light_disc_list[i];
+		obj_use_material(&w, scene, with_materials, &material, disc->material_index);
+		obj_write_text(&w, "ld ");
+		obj_write_index(&w, disc->pos_index, scene->vertex_count);
+		obj_write_char(&w, ' ');
+		obj_write_index(&w, disc->normal_index, scene->vertex_normal_count);
+		obj_write_char(&w, '\n');
+	}
+	for(int i=0; i<scene->light_quad_count; i++)
+	{
+		const obj_light_quad *quad = scene->light_quad_list[i];
+		obj_use_material(&w, scene, with_materials, &material, quad->material_index);
+		obj_write_text(&w, "lq");
+		// unused corners read back as -1 when left out
+		int corners = MAX_VERTEX_COUNT;
+		while(corners > 0 && quad->vertex_index[corners - 1] == -1)
+			corners--;
+		for(int j=0; j<corners; j++)
+		{
+			obj_write_char(&w, ' ');
+			obj_write_index(&w, quad->vertex_index[j], scene->vertex_count);
+		}
+		obj_write_char(&w, '\n');
+	}
+
+	return obj_writer_close(&w);
+}
+
+void obj_mtl_filename(char *out, size_t size, const char *obj_filename)
+{
+	snprintf(out, size, "%s", obj_filename);
+	char *dot = strrchr(out, '.');
+	if(dot != NULL && strchr(dot, '/') == NULL)
+		*dot = '\0';
+	strncat(out, ".mtl", size - strlen(out) - 1);
+}
@@ -0,0 +1,39 @@
+#ifndef OBJ_WRITER_H
+#define OBJ_WRITER_H
+
+#include "obj_parser.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// longest text obj_format_double produces, without the terminator
+#define OBJ_DOUBLE_TEXT_SIZE 32
+
+// Writes the scene as OBJ to obj_filename and its materials to mtl_filename,
+// which the OBJ refers to with mtllib exactly as given, since the parser
+// opens it as written. Parsing the result with parse_obj_scene gives back
+// the same vertices, bit for bit, and the same faces, spheres, planes,
+// lights, camera and materials. A NULL mtl_filename leaves the materials
+// and usemtl out. Output goes through one large buffer, so writing is
+// limited by the disk. Returns 0 when a file could not be written.
+int obj_write_scene(const obj_scene_data *scene, const char *obj_filename, const char *mtl_filename);
+
+// The material library for an OBJ written to obj_filename: the same path
+// with its extension replaced by .mtl. The parser opens mtllib paths
+// relative to the working directory, so the OBJ refers to the library by
+// this path. Writes at most `size` bytes, the terminator included.
+void obj_mtl_filename(char *out, size_t size, const char *obj_filename);
+
+// Text atof reads back as exactly `value`: the shortest plain decimals
+// when up to 15 significant digits are exact, else 17 digits, and %.*g at
+// the least precision that reads back outside [1e-5, 2^52). Writes at most
+// OBJ_DOUBLE_TEXT_SIZE characters plus a terminator, returns the length.
+int obj_format_double(char *out, double value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+#include "string_pool.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRING_BLOCK_SIZE 4096
+#define STRING_POOL_MIN_SLOTS 16
+
+typedef struct obj_string_block
+{
+	struct obj_string_block *next;
+	size_t used;
+	size_t capacity;
+	char data[];
+} obj_string_block;
+
+static uint32_t obj_string_hash(const char *s)
+{
+	uint32_t hash = 2166136261u;
+	for(; *s; s++)
+		hash = (hash ^ (unsigned char)*s) * 16777619u;
+	return hash;
+}
+
+void obj_string_pool_init(obj_string_pool *pool)
+{
+	pool->blocks = NULL;
+	pool->slots = NULL;
+	pool->slot_count = 0;
+	pool->string_count = 0;
+	pool->bytes = 0;
+}
+
+void obj_string_pool_free(obj_string_pool *pool)
+{
+	obj_string_block *block = pool->blocks;
+	while(block != NULL)
+	{
+		obj_string_block *next = block->next;
+		free(block);
+		block = next;
+	}
+	free(pool->slots);
+	obj_string_pool_init(pool);
+}
+
+// the slot holding s, or the empty slot where it belongs
+static const char** obj_string_slot(const char **slots, int slot_count, const char *s)
+{
+	int i = (int)(obj_string_hash(s) & (uint32_t)(slot_count - 1));
+	while(slots[i] != NULL && strcmp(slots[i], s) != 0)
+		i = (i + 1) & (slot_count - 1);
+	return &slots[i];
+}
+
+static int obj_string_pool_grow(obj_string_pool *pool)
+{
+	int slot_count = pool->slot_count ? pool->slot_count * 2 : STRING_POOL_MIN_SLOTS;
+	const char **slots = (const char**) calloc(slot_count, sizeof(char*));
+	if(slots == NULL)
+		return 0;
+	for(int i=0; i<pool->slot_count; i++)
+		if(pool->slots[i] != NULL)
+			*obj_string_slot(slots, slot_count, pool->slots[i]) = pool->slots[i];
+	free(pool->slots);
+	pool->bytes += sizeof(char*) * (slot_count - pool->slot_count);
+	pool->slots = slots;
+	pool->slot_count = slot_count;
+	return 1;
+}
+
+// copies s into the current block, starting a new one when it is full;
+// strings never move, so their addresses can be handed out
+static const char* obj_string_pool_store(obj_string_pool *pool, const char *s)
+{
+	size_t size = strlen(s) + 1;
+	obj_string_block *block = pool->blocks;
+	if(block == NULL || block->capacity - block->used < size)
+	{
+		size_t capacity = size > STRING_BLOCK_SIZE ? size : STRING_BLOCK_SIZE;
+		block = (obj_string_block*) malloc(sizeof(obj_string_block) + capacity);
+		if(block == NULL)
+			return NULL;
+		block->next = pool->blocks;
+		block->used = 0;
+		block->capacity = capacity;
+		pool->blocks = block;
+		pool->bytes += sizeof(obj_string_block) + capacity;
+	}
+	char *copy = block->data + block->used;
+	memcpy(copy, s, size);
+	block->used += size;
+	return copy;
+}
+
+const char* obj_string_pool_intern(obj_string_pool *pool, const char *s)
+{
+	// keep the table at most half full
+	if(2 * (pool->string_count + 1) > pool->slot_count && !obj_string_pool_grow(pool))
+		return NULL;
+	const char **slot = obj_string_slot(pool->slots, pool->slot_count, s);
+	if(*slot == NULL)
+	{
+		*slot = obj_string_pool_store(pool, s);
+		if(*slot == NULL)
+			return NULL;
+		pool->string_count++;
+	}
+	return *slot;
+}
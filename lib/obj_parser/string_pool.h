@@ -0,0 +1,31 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interned strings: every distinct string is stored once and its address
+// stays valid until the pool is freed, so names and paths can be compared
+// by pointer and cost nothing in the structures that refer to them.
+typedef struct obj_string_pool
+{
+	struct obj_string_block *blocks;
+	const char **slots;	// open addressing over the stored strings
+	int slot_count;
+	int string_count;
+	size_t bytes;		// allocated for blocks and slots
+} obj_string_pool;
+
+void obj_string_pool_init(obj_string_pool *pool);
+// returns the pool's copy of s, or NULL when out of memory
+const char* obj_string_pool_intern(obj_string_pool *pool, const char *s);
+void obj_string_pool_free(obj_string_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
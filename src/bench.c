@@ -0,0 +1,406 @@
+#include "bench.h"
+#include "framebuffer.h"
+#include "orientation.h"
+#include "render.h"
+#include "terminal.h"
+#include "timing.h"
+#include <curses.h>
+#include <inttypes.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The terminal backend frames would go through, writing to /dev/null
+typedef struct bench_output {
+  terminal_backend backend;
+  terminal_output raw;
+  SCREEN *screen;
+  FILE *out;
+  FILE *in;
+} bench_output;
+
+static int open_output(bench_output *o, const options *opts) {
+  memset(o, 0, sizeof(*o));
+  o->backend = opts->backend;
+  o->out = fopen("/dev/null", "w");
+  if (o->out == NULL)
+    return 0;
+  if (o->backend == TERMINAL_RAW) {
+    terminal_output_init(&o->raw, fileno(o->out));
+    return 1;
+  }
+  o->in = fopen("/dev/null", "r");
+  if (o->in == NULL) {
+    fclose(o->out);
+    return 0;
+  }
+  // as in the interactive mode, see main.c
+  setlocale(LC_CTYPE, "");
+  const char *term = getenv("TERM");
+  if (term != NULL && term[0] != '\0')
+    o->screen = newterm(term, o->out, o->in);
+  if (o->screen == NULL)
+    o->screen = newterm("xterm", o->out, o->in);
+  if (o->screen == NULL) {
+    fprintf(stderr, "Could not set up curses for %s\n", term ? term : "xterm");
+    fclose(o->in);
+    fclose(o->out);
+    return 0;
+  }
+  set_term(o->screen);
+  curs_set(0);
+  resizeterm(opts->height, opts->width);
+  return 1;
+}
+
+static void close_output(bench_output *o) {
+  if (o->backend == TERMINAL_RAW) {
+    terminal_output_free(&o->raw);
+  } else {
+    endwin();
+    delscreen(o->screen);
+    fclose(o->in);
+  }
+  fclose(o->out);
+}
+
+static void present_frame(bench_output *o, const framebuffer *fb,
+                          render_stats *stats) {
+  double t0 = now_seconds();
+  if (o->backend == TERMINAL_RAW)
+    terminal_output_frame(&o->raw, fb, fb->height, fb->width);
+  else
+    curses_output_frame(fb);
+  stats->encode_seconds += now_seconds() - t0;
+}
+
+// Bytes and write() calls of the whole process so far, from the kernel's
+// accounting. Returns 0 where it is not available.
+static int read_io_counters(long long *bytes, long long *writes) {
+  FILE *io = fopen("/proc/self/io", "r");
+  if (io == NULL)
+    return 0;
+  char line[128];
+  int found = 0;
+  while (fgets(line, sizeof(line), io)) {
+    if (sscanf(line, "wchar: %lld", bytes) == 1 ||
+        sscanf(line, "syscw: %lld", writes) == 1)
+      found++;
+  }
+  fclose(io);
+  return found == 2;
+}
+
+// Taken around the frame loop to attribute its writes to the output stage;
+// nothing else in the loop writes
+typedef struct io_mark {
+  long long bytes;
+  long long writes;
+  bool valid;
+} io_mark;
+
+static io_mark mark_io(void) {
+  fflush(stdout);
+  io_mark mark = {0, 0, false};
+  mark.valid = read_io_counters(&mark.bytes, &mark.writes);
+  return mark;
+}
+
+static void count_output(render_stats *stats, io_mark since) {
+  io_mark now = mark_io();
+  if (!since.valid || !now.valid) {
+    stats->output_writes = -1;
+    return;
+  }
+  stats->output_bytes = now.bytes - since.bytes;
+  stats->output_writes = now.writes - since.writes;
+}
+
+static int open_recorder(recording_writer *w, const options *opts,
+                         const framebuffer *fb) {
+  return opts->record_filename == NULL ||
+         recording_writer_open(w, opts->record_filename, fb);
+}
+
+static void record_frame(recording_writer *w, const options *opts,
+                         const framebuffer *fb, int frame) {
+  if (opts->record_filename != NULL)
+    recording_writer_add(w, fb, frame * RECORDING_FRAME_SECONDS);
+}
+
+static int close_recorder(recording_writer *w, const options *opts) {
+  if (opts->record_filename == NULL)
+    return 1;
+  printf("recording_bytes_per_frame: %.1f\n",
+         w->frames ? (double)w->bytes / (double)w->frames : 0.0);
+  if (!recording_writer_close(w)) {
+    fprintf(stderr, "Could not write recording %s\n", opts->record_filename);
+    return 0;
+  }
+  return 1;
+}
+
+static void print_report(const options *opts, const framebuffer *fb,
+                         long vertices, long faces, double total,
+                         const render_stats *stats) {
+  const double per_frame = 1e6 / opts->frames;
+  printf("frames: %d\n", opts->frames);
+  printf("frames_drawn: %d\n", stats->frames_drawn);
+  printf("size: %dx%d\n", fb->width, fb->height);
+  printf("vertices: %ld\n", vertices);
+  printf("faces: %ld\n", faces);
+  printf("total_s: %.6f\n", total);
+  printf("fps: %.2f\n", total > 0 ? opts->frames / total : 0.0);
+  printf("transform_us_per_frame: %.3f\n", stats->transform_seconds * per_frame);
+  printf("project_us_per_frame: %.3f\n", stats->project_seconds * per_frame);
+  printf("cull_us_per_frame: %.3f\n", stats->cull_seconds * per_frame);
+  printf("clear_us_per_frame: %.3f\n", stats->clear_seconds * per_frame);
+  printf("raster_us_per_frame: %.3f\n", stats->raster_seconds * per_frame);
+  printf("backend: %s\n", opts->backend == TERMINAL_RAW ? "raw" : "curses");
+  printf("encode_us_per_frame: %.3f\n", stats->encode_seconds * per_frame);
+  if (stats->output_writes >= 0) {
+    printf("bytes_per_frame: %.1f\n",
+           (double)stats->output_bytes / opts->frames);
+    printf("syscalls_per_frame: %.2f\n",
+           (double)stats->output_writes / opts->frames);
+  }
+  printf("checksum: %016" PRIx64 "\n", framebuffer_checksum(fb));
+}
+
+int run_benchmark(const options *opts, loaded_model *model) {
+  framebuffer fb;
+  if (!framebuffer_init(&fb, opts->width, opts->height) ||
+      !framebuffer_set_mode(&fb, opts->output) ||
+      !framebuffer_set_color(&fb, opts->color))
+    return 0;
+  bench_output output;
+  recording_writer recorder;
+  if (!open_output(&output, opts)) {
+    framebuffer_free(&fb);
+    return 0;
+  }
+  if (!open_recorder(&recorder, opts, &fb)) {
+    close_output(&output);
+    framebuffer_free(&fb);
+    return 0;
+  }
+
+  render_stats stats = {0};
+  model_view view = {{{0}}, MODEL_DISTANCE, opts->cull, opts->backfaces,
+                     opts->lod_pixels, opts->texture};
+  float rate[3];
+  spin_rate(opts, rate);
+  orientation spin;
+  orientation_init(&spin, rate);
+  io_mark before = mark_io();
+  double start = now_seconds();
+  for (int frame = 0; frame < opts->frames; ++frame) {
+    quat_to_matrix(spin.current, view.rotation);
+    loaded_model_draw(model, &fb, &view, &stats);
+    present_frame(&output, &fb, &stats);
+    record_frame(&recorder, opts, &fb, frame);
+    orientation_step(&spin);
+  }
+  double total = now_seconds() - start;
+  count_output(&stats, before);
+  close_output(&output);
+
+  if (opts->cull)
+    printf("visible_faces: %d\n", model->visible_count);
+  print_report(opts, &fb, model->source.vertex_count,
+               model->source.face_count, total, &stats);
+  framebuffer_free(&fb);
+  return close_recorder(&recorder, opts);
+}
+
+int run_chunked_benchmark(const options *opts, chunked_model *model) {
+  framebuffer fb;
+  if (!framebuffer_init(&fb, opts->width, opts->height) ||
+      !framebuffer_set_mode(&fb, opts->output) ||
+      !framebuffer_set_color(&fb, opts->color))
+    return 0;
+  bench_output output;
+  recording_writer recorder;
+  if (!open_output(&output, opts)) {
+    framebuffer_free(&fb);
+    return 0;
+  }
+  if (!open_recorder(&recorder, opts, &fb)) {
+    close_output(&output);
+    framebuffer_free(&fb);
+    return 0;
+  }
+
+  render_stats stats = {0};
+  model_view view = {{{0}}, MODEL_DISTANCE, true, false, opts->lod_pixels,
+                     false};
+  float rate[3];
+  spin_rate(opts, rate);
+  orientation spin;
+  orientation_init(&spin, rate);
+  io_mark before = mark_io();
+  double start = now_seconds();
+  for (int frame = 0; frame < opts->frames; ++frame) {
+    quat_to_matrix(spin.current, view.rotation);
+    chunked_model_draw(model, &fb, &view, &stats);
+    present_frame(&output, &fb, &stats);
+    record_frame(&recorder, opts, &fb, frame);
+    orientation_step(&spin);
+  }
+  double total = now_seconds() - start;
+  count_output(&stats, before);
+  close_output(&output);
+
+  const chunk_counters *c = &model->counters;
+  printf("chunks: %" PRIu32 "\n", model->header.chunk_count);
+  printf("chunks_drawn: %lld\n", c->drawn);
+  printf("chunks_skipped: %lld\n", c->skipped);
+  printf("chunk_maps: %lld\n", c->maps);
+  printf("chunk_evictions: %lld\n", c->evictions);
+  printf("faces_drawn_per_frame: %.1f\n",
+         stats.frames_drawn ? (double)c->faces_drawn / stats.frames_drawn
+                            : 0.0);
+  printf("memory_budget_bytes: %zu\n", model->budget);
+  printf("peak_mapped_bytes: %zu\n", c->peak_bytes);
+  print_report(opts, &fb, (long)model->header.vertex_count,
+               (long)model->header.face_count, total, &stats);
+  framebuffer_free(&fb);
+  return close_recorder(&recorder, opts);
+}
+
+int run_scene_benchmark(const options *opts, scene *s) {
+  framebuffer fb;
+  if (!framebuffer_init(&fb, opts->width, opts->height) ||
+      !framebuffer_set_mode(&fb, opts->output) ||
+      !framebuffer_set_color(&fb, opts->color))
+    return 0;
+  bench_output output;
+  recording_writer recorder;
+  if (!open_output(&output, opts)) {
+    framebuffer_free(&fb);
+    return 0;
+  }
+  if (!open_recorder(&recorder, opts, &fb)) {
+    close_output(&output);
+    framebuffer_free(&fb);
+    return 0;
+  }
+
+  // vertices and faces as drawn, i.e. counted once per instance
+  long vertices = 0, faces = 0;
+  for (int i = 0; i < s->instance_count; ++i) {
+    vertices += s->meshes[s->instances[i].mesh].vertex_count;
+    faces += s->meshes[s->instances[i].mesh].data.face_count;
+  }
+
+  render_stats stats = {0};
+  float angle = 0;
+  io_mark before = mark_io();
+  double start = now_seconds();
+  for (int frame = 0; frame < opts->frames; ++frame) {
+    double t0 = now_seconds();
+    scene_update(s, angle);
+    stats.transform_seconds += now_seconds() - t0;
+    scene_draw(s, &fb, &stats);
+    present_frame(&output, &fb, &stats);
+    record_frame(&recorder, opts, &fb, frame);
+    angle += opts->speed;
+  }
+  double total = now_seconds() - start;
+  count_output(&stats, before);
+  close_output(&output);
+
+  printf("meshes: %d\n", s->mesh_count);
+  printf("instances: %d\n", s->instance_count);
+  printf("instances_projected: %d\n", stats.objects_projected);
+  print_report(opts, &fb, vertices, faces, total, &stats);
+  framebuffer_free(&fb);
+  return close_recorder(&recorder, opts);
+}
+
+int run_raycast_benchmark(const options *opts, raycaster *rc) {
+  framebuffer fb;
+  if (!framebuffer_init(&fb, opts->width, opts->height) ||
+      !framebuffer_set_color(&fb, opts->color))
+    return 0;
+  bench_output output;
+  recording_writer recorder;
+  if (!open_output(&output, opts)) {
+    framebuffer_free(&fb);
+    return 0;
+  }
+  if (!open_recorder(&recorder, opts, &fb)) {
+    close_output(&output);
+    framebuffer_free(&fb);
+    return 0;
+  }
+
+  render_stats stats = {0};
+  float angle = 0;
+  io_mark before = mark_io();
+  double start = now_seconds();
+  for (int frame = 0; frame < opts->frames; ++frame) {
+    double t0 = now_seconds();
+    raycaster_render(rc, &fb, angle);
+    stats.raster_seconds += now_seconds() - t0;
+    stats.frames_drawn++;
+    present_frame(&output, &fb, &stats);
+    record_frame(&recorder, opts, &fb, frame);
+    angle += opts->speed;
+  }
+  double total = now_seconds() - start;
+  count_output(&stats, before);
+  close_output(&output);
+
+  printf("threads: %d\n", rc->threads);
+  printf("lights: %d\n", rc->light_count);
+  print_report(opts, &fb, rc->scene->vertex_count, rc->scene->face_count,
+               total, &stats);
+  framebuffer_free(&fb);
+  return close_recorder(&recorder, opts);
+}
+
+int run_playback_benchmark(const options *opts, recording *rec,
+                           framebuffer *fb) {
+  options played = *opts;
+  // colour recordings need the raw backend, as when playing them
+  if (fb->colors != NULL)
+    played.backend = TERMINAL_RAW;
+  bench_output output;
+  if (!open_output(&output, &played))
+    return 0;
+  render_stats stats = {0};
+  int frames = 0, status;
+  double seconds = 0;
+  io_mark before = mark_io();
+  double start = now_seconds();
+  for (;;) {
+    // decoding stands in for the whole render
+    double t0 = now_seconds();
+    status = recording_next(rec, fb, &seconds);
+    stats.raster_seconds += now_seconds() - t0;
+    if (status <= 0)
+      break;
+    stats.frames_drawn++;
+    present_frame(&output, fb, &stats);
+    frames++;
+  }
+  double total = now_seconds() - start;
+  count_output(&stats, before);
+  close_output(&output);
+  if (status < 0) {
+    fprintf(stderr, "Recording %s is corrupt\n", opts->play_filename);
+    return 0;
+  }
+  if (frames == 0) {
+    fprintf(stderr, "Recording %s has no frames\n", opts->play_filename);
+    return 0;
+  }
+
+  played.frames = frames;
+  printf("recording_seconds: %.3f\n", seconds);
+  printf("recording_bytes_per_frame: %.1f\n", (double)rec->size / frames);
+  print_report(&played, fb, 0, 0, total, &stats);
+  return 1;
+}
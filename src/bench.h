@@ -0,0 +1,27 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "chunks.h"
+#include "model.h"
+#include "options.h"
+#include "raycast.h"
+#include "recording.h"
+#include "scene.h"
+
+// Renders opts->frames frames of the spinning model into an in-memory
+// framebuffer and prints throughput, per-stage timings and a checksum of the
+// last frame to stdout. With opts->record_filename the frames are recorded
+// RECORDING_FRAME_SECONDS apart. Returns 0 on allocation failure.
+int run_benchmark(const options *opts, loaded_model *model);
+// Same report for an out-of-core model, with its paging counters
+int run_chunked_benchmark(const options *opts, chunked_model *model);
+// Same report for a scene of instanced meshes
+int run_scene_benchmark(const options *opts, scene *s);
+// Same report for the ray caster, with the whole trace counted as raster
+int run_raycast_benchmark(const options *opts, raycaster *rc);
+// Decodes and presents every frame of a recording as fast as it can, fb as
+// set up by recording_framebuffer
+int run_playback_benchmark(const options *opts, recording *rec,
+                           framebuffer *fb);
+
+#endif
@@ -0,0 +1,189 @@
+#include "bounds.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// below this many vertices a single thread is faster than starting more
+#define BOUNDS_PARALLEL_MIN_VERTICES 65536
+#define BOUNDS_MAX_THREADS 64
+
+typedef struct bounds_task {
+  const struct obj_scene_data *model;
+  const uint8_t *used; // vertices to measure, NULL for all
+  int first;
+  int end;
+  // results of measuring [first, end)
+  double min[3];
+  double max[3];
+  double sum[3];
+  int count;
+  // input of moving [first, end)
+  double center[3];
+  double scale;
+} bounds_task;
+
+static void *measure_vertices(void *arg) {
+  bounds_task *task = arg;
+  // in locals, and compared rather than fmin()ed, so they stay in
+  // registers; NaN coordinates are left out of the box
+  double min[3] = {INFINITY, INFINITY, INFINITY};
+  double max[3] = {-INFINITY, -INFINITY, -INFINITY};
+  double sum[3] = {0, 0, 0};
+  int count = 0;
+  obj_vector **vertices = task->model->vertex_list;
+  const uint8_t *used = task->used;
+  for (int i = task->first; i < task->end; ++i) {
+    if (used != NULL && !used[i])
+      continue;
+    count++;
+    const double *e = vertices[i]->e;
+    for (int k = 0; k < 3; ++k) {
+      min[k] = e[k] < min[k] ? e[k] : min[k];
+      max[k] = e[k] > max[k] ? e[k] : max[k];
+      sum[k] += e[k];
+    }
+  }
+  for (int k = 0; k < 3; ++k) {
+    task->min[k] = min[k];
+    task->max[k] = max[k];
+    task->sum[k] = sum[k];
+  }
+  task->count = count;
+  return NULL;
+}
+
+static void *move_vertices(void *arg) {
+  bounds_task *task = arg;
+  obj_vector **vertices = task->model->vertex_list;
+  for (int i = task->first; i < task->end; ++i) {
+    double *e = vertices[i]->e;
+    for (int k = 0; k < 3; ++k)
+      e[k] = (e[k] - task->center[k]) * task->scale;
+  }
+  return NULL;
+}
+
+// Runs fn on every task, the first one on the calling thread
+static void run_tasks(bounds_task *tasks, int count, void *(*fn)(void *)) {
+  pthread_t threads[BOUNDS_MAX_THREADS];
+  bool started[BOUNDS_MAX_THREADS] = {false};
+  for (int i = 1; i < count; ++i)
+    started[i] = pthread_create(&threads[i], NULL, fn, &tasks[i]) == 0;
+  fn(&tasks[0]);
+  for (int i = 1; i < count; ++i) {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    else
+      fn(&tasks[i]);
+  }
+}
+
+// Splits the vertices into one contiguous range per thread
+static int split_vertices(bounds_task *tasks,
+                          const struct obj_scene_data *model, int threads) {
+  if (threads <= 0)
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads > BOUNDS_MAX_THREADS)
+    threads = BOUNDS_MAX_THREADS;
+  if (model->vertex_count < BOUNDS_PARALLEL_MIN_VERTICES || threads < 1)
+    threads = 1;
+  for (int i = 0; i < threads; ++i) {
+    tasks[i].model = model;
+    tasks[i].first = (int)((long long)model->vertex_count * i / threads);
+    tasks[i].end = (int)((long long)model->vertex_count * (i + 1) / threads);
+  }
+  return threads;
+}
+
+// Flags the vertices some face refers to. NULL when no face refers to any,
+// or without memory, and then every vertex counts.
+static uint8_t *used_vertices(const struct obj_scene_data *model) {
+  if (model->face_count == 0 || model->vertex_count == 0)
+    return NULL;
+  uint8_t *used = calloc((size_t)model->vertex_count, 1);
+  if (used == NULL)
+    return NULL;
+  bool any = false;
+  for (int f = 0; f < model->face_count; ++f) {
+    const obj_face *face = model->face_list[f];
+    for (int j = 0; j < face->vertex_count; ++j) {
+      int v = face->vertex_index[j];
+      if (v >= 0 && v < model->vertex_count) {
+        used[v] = 1;
+        any = true;
+      }
+    }
+  }
+  if (!any) {
+    free(used);
+    return NULL;
+  }
+  return used;
+}
+
+void model_bounds_compute(model_bounds *b, const struct obj_scene_data *model,
+                          int threads) {
+  bounds_task tasks[BOUNDS_MAX_THREADS];
+  int count = split_vertices(tasks, model, threads);
+  uint8_t *used = used_vertices(model);
+  for (int i = 0; i < count; ++i)
+    tasks[i].used = used;
+  run_tasks(tasks, count, measure_vertices);
+  free(used);
+
+  double sum[3] = {0, 0, 0};
+  int measured = 0;
+  for (int k = 0; k < 3; ++k) {
+    b->min[k] = INFINITY;
+    b->max[k] = -INFINITY;
+  }
+  for (int i = 0; i < count; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      b->min[k] = fmin(b->min[k], tasks[i].min[k]);
+      b->max[k] = fmax(b->max[k], tasks[i].max[k]);
+      sum[k] += tasks[i].sum[k];
+    }
+    measured += tasks[i].count;
+  }
+  double radius_squared = 0;
+  for (int k = 0; k < 3; ++k) {
+    if (measured == 0) {
+      b->min[k] = b->max[k] = b->centroid[k] = 0;
+      continue;
+    }
+    b->centroid[k] = sum[k] / measured;
+    double reach =
+        fmax(b->centroid[k] - b->min[k], b->max[k] - b->centroid[k]);
+    radius_squared += reach * reach;
+  }
+  b->radius = sqrt(radius_squared);
+}
+
+float center_and_scale_model(struct obj_scene_data *model, float scale,
+                             bool quiet) {
+  model_bounds b;
+  model_bounds_compute(&b, model, 0);
+  if (scale == MODEL_SCALE_FIT)
+    scale = b.radius > 0 ? (float)(MODEL_FIT_RADIUS / b.radius) : 1.f;
+  if (!quiet) {
+    printf("Bounds: %f %f %f to %f %f %f\n", b.min[0], b.min[1], b.min[2],
+           b.max[0], b.max[1], b.max[2]);
+    printf("Middle coordinates: %f %f %f\n", b.centroid[0], b.centroid[1],
+           b.centroid[2]);
+    printf("scale: %f\n", scale);
+  }
+
+  bounds_task tasks[BOUNDS_MAX_THREADS];
+  int count = split_vertices(tasks, model, 0);
+  for (int i = 0; i < count; ++i) {
+    for (int k = 0; k < 3; ++k)
+      tasks[i].center[k] = b.centroid[k];
+    tasks[i].scale = scale;
+  }
+  run_tasks(tasks, count, move_vertices);
+  return scale;
+}
@@ -0,0 +1,34 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "obj_parser.h"
+#include <stdbool.h>
+
+// Radius a fitted model is scaled to: seen from MODEL_DISTANCE the sphere
+// stays inside the projection's |x/z|, |y/z| <= 0.5 however it is turned
+#define MODEL_FIT_RADIUS 0.6f
+// Fits the model instead of scaling it by a fixed factor
+#define MODEL_SCALE_FIT 0.f
+
+typedef struct model_bounds {
+  double min[3];
+  double max[3];
+  double centroid[3]; // mean of the vertices, 0 for an empty model
+  double radius;      // of the sphere around the centroid holding the box
+} model_bounds;
+
+// Bounding box and centroid in one pass over the vertices, split over
+// `threads` threads (0 for one per core) when the model is large. Only
+// vertices used by faces count, so stray points such as a scene's camera
+// position do not shrink the model; a model without faces counts all.
+void model_bounds_compute(model_bounds *b, const struct obj_scene_data *model,
+                          int threads);
+
+// Moves the centroid to the origin and multiplies by `scale`, or with
+// MODEL_SCALE_FIT by whatever makes the model's radius MODEL_FIT_RADIUS.
+// Prints the bounds and scale unless `quiet`, which background loads set
+// while the terminal shows frames. Returns the scale used.
+float center_and_scale_model(struct obj_scene_data *model, float scale,
+                             bool quiet);
+
+#endif
@@ -0,0 +1,479 @@
+#include "bvh.h"
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BVH_BINS 16
+#define BVH_LEAF_SIZE 4
+#define BVH_MAX_LEAF_SIZE 32
+// subtrees smaller than this are not worth a thread
+#define BVH_PARALLEL_MIN_FACES 8192
+// past this depth nodes are halved instead of SAH split, which bounds the
+// depth (and the traversal stacks) even for pathological inputs
+#define BVH_MAX_SAH_DEPTH 48
+#define BVH_STACK_SIZE 128
+
+typedef struct build_context {
+  bvh *b;
+  const float *face_bounds; // min xyz, max xyz per face
+  const float *centroids;   // xyz per face
+  atomic_int node_count;
+  int max_parallel_depth;
+} build_context;
+
+typedef struct build_task {
+  build_context *ctx;
+  int32_t node;
+  int32_t first;
+  int32_t count;
+  int depth;
+} build_task;
+
+typedef struct bin {
+  float min[3];
+  float max[3];
+  int32_t count;
+} bin;
+
+static void box_empty(float *min, float *max) {
+  for (int k = 0; k < 3; ++k) {
+    min[k] = FLT_MAX;
+    max[k] = -FLT_MAX;
+  }
+}
+
+// plain comparisons instead of fminf/fmaxf, which are libm calls without
+// -ffast-math and dominate the build time otherwise
+static inline float min_float(float a, float b) { return a < b ? a : b; }
+static inline float max_float(float a, float b) { return a > b ? a : b; }
+
+static inline void box_grow(float *min, float *max, const float *other_min,
+                            const float *other_max) {
+  for (int k = 0; k < 3; ++k) {
+    min[k] = min_float(min[k], other_min[k]);
+    max[k] = max_float(max[k], other_max[k]);
+  }
+}
+
+static float box_area(const float *min, const float *max) {
+  float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+  if (dx < 0 || dy < 0 || dz < 0)
+    return 0;
+  return dx * dy + dy * dz + dz * dx;
+}
+
+static void make_leaf(bvh_node *node, int32_t first, int32_t count) {
+  node->first = first;
+  node->count = count;
+}
+
+// Finds the cheapest SAH split among BVH_BINS bins on each axis. Returns 0
+// if keeping the leaf is cheaper.
+static int find_split(const build_context *ctx, const bvh_node *node,
+                      int32_t first, int32_t count, int *best_axis,
+                      float *best_position) {
+  const int32_t *indices = ctx->b->face_indices;
+  float cmin[3], cmax[3];
+  box_empty(cmin, cmax);
+  for (int32_t i = first; i < first + count; ++i) {
+    const float *c = &ctx->centroids[indices[i] * 3];
+    box_grow(cmin, cmax, c, c);
+  }
+
+  float best_cost = FLT_MAX;
+  for (int axis = 0; axis < 3; ++axis) {
+    float extent = cmax[axis] - cmin[axis];
+    if (extent <= 0)
+      continue;
+    bin bins[BVH_BINS];
+    for (int i = 0; i < BVH_BINS; ++i) {
+      box_empty(bins[i].min, bins[i].max);
+      bins[i].count = 0;
+    }
+    float scale = BVH_BINS / extent;
+    for (int32_t i = first; i < first + count; ++i) {
+      int32_t face = indices[i];
+      int b = (int)((ctx->centroids[face * 3 + axis] - cmin[axis]) * scale);
+      if (b >= BVH_BINS)
+        b = BVH_BINS - 1;
+      bins[b].count++;
+      box_grow(bins[b].min, bins[b].max, &ctx->face_bounds[face * 6],
+               &ctx->face_bounds[face * 6 + 3]);
+    }
+
+    // sweep from the left, then evaluate each plane while sweeping right
+    float left_area[BVH_BINS - 1];
+    int32_t left_count[BVH_BINS - 1];
+    float lmin[3], lmax[3];
+    box_empty(lmin, lmax);
+    int32_t running = 0;
+    for (int i = 0; i < BVH_BINS - 1; ++i) {
+      running += bins[i].count;
+      box_grow(lmin, lmax, bins[i].min, bins[i].max);
+      left_count[i] = running;
+      left_area[i] = box_area(lmin, lmax);
+    }
+    float rmin[3], rmax[3];
+    box_empty(rmin, rmax);
+    running = 0;
+    for (int i = BVH_BINS - 1; i > 0; --i) {
+      running += bins[i].count;
+      box_grow(rmin, rmax, bins[i].min, bins[i].max);
+      if (left_count[i - 1] == 0 || running == 0)
+        continue;
+      float cost = left_count[i - 1] * left_area[i - 1] +
+                   running * box_area(rmin, rmax);
+      if (cost < best_cost) {
+        best_cost = cost;
+        *best_axis = axis;
+        *best_position = cmin[axis] + i / scale;
+      }
+    }
+  }
+
+  float leaf_cost = count * box_area(node->min, node->max);
+  if (best_cost == FLT_MAX)
+    return 0;
+  return best_cost < leaf_cost || count > BVH_MAX_LEAF_SIZE;
+}
+
+static void *build_task_run(void *arg);
+
+static void build_node(build_context *ctx, int32_t node_index, int32_t first,
+                       int32_t count, int depth) {
+  bvh *b = ctx->b;
+  bvh_node *node = &b->nodes[node_index];
+  box_empty(node->min, node->max);
+  for (int32_t i = first; i < first + count; ++i) {
+    const float *fb = &ctx->face_bounds[b->face_indices[i] * 6];
+    box_grow(node->min, node->max, fb, fb + 3);
+  }
+
+  int axis = 0;
+  float position = 0;
+  if (count <= BVH_LEAF_SIZE || depth >= BVH_MAX_SAH_DEPTH ||
+      !find_split(ctx, node, first, count, &axis, &position)) {
+    // identical centroids or a deep tree leave a big node without a split,
+    // halve it
+    if (count <= BVH_MAX_LEAF_SIZE) {
+      make_leaf(node, first, count);
+      return;
+    }
+    axis = -1;
+  }
+
+  int32_t split = first;
+  if (axis >= 0) {
+    int32_t *indices = b->face_indices;
+    int32_t last = first + count - 1;
+    while (split <= last) {
+      if (ctx->centroids[indices[split] * 3 + axis] < position) {
+        split++;
+      } else {
+        int32_t tmp = indices[split];
+        indices[split] = indices[last];
+        indices[last--] = tmp;
+      }
+    }
+  }
+  if (split == first || split == first + count)
+    split = first + count / 2;
+
+  int32_t left = atomic_fetch_add(&ctx->node_count, 2);
+  node->first = left;
+  node->count = 0;
+
+  int32_t left_count = split - first;
+  if (depth < ctx->max_parallel_depth &&
+      count >= BVH_PARALLEL_MIN_FACES) {
+    build_task task = {ctx, left, first, left_count, depth + 1};
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, build_task_run, &task) == 0) {
+      build_node(ctx, left + 1, split, count - left_count, depth + 1);
+      pthread_join(thread, NULL);
+      return;
+    }
+  }
+  build_node(ctx, left, first, left_count, depth + 1);
+  build_node(ctx, left + 1, split, count - left_count, depth + 1);
+}
+
+static void *build_task_run(void *arg) {
+  build_task *task = arg;
+  build_node(task->ctx, task->node, task->first, task->count, task->depth);
+  return NULL;
+}
+
+static void face_bounds(const struct obj_scene_data *model,
+                        const obj_face *face, float *bounds,
+                        float *centroid) {
+  box_empty(bounds, bounds + 3);
+  for (int j = 0; j < face->vertex_count; ++j) {
+    int v = face->vertex_index[j];
+    if (v < 0 || v >= model->vertex_count)
+      continue;
+    float p[3] = {(float)model->vertex_list[v]->e[0],
+                  (float)model->vertex_list[v]->e[1],
+                  (float)model->vertex_list[v]->e[2]};
+    box_grow(bounds, bounds + 3, p, p);
+  }
+  if (bounds[0] > bounds[3]) {
+    // no usable vertex, park it at the origin
+    memset(bounds, 0, sizeof(float) * 6);
+  }
+  for (int k = 0; k < 3; ++k)
+    centroid[k] = (bounds[k] + bounds[k + 3]) * 0.5f;
+}
+
+int bvh_build(bvh *b, const struct obj_scene_data *model, int threads) {
+  int32_t n = model->face_count;
+  memset(b, 0, sizeof(*b));
+  b->face_count = n;
+  b->nodes = malloc(sizeof(bvh_node) * (n > 0 ? 2 * n - 1 : 1));
+  b->face_indices = malloc(sizeof(int32_t) * (n > 0 ? n : 1));
+  float *bounds = malloc(sizeof(float) * 6 * (n > 0 ? n : 1));
+  float *centroids = malloc(sizeof(float) * 3 * (n > 0 ? n : 1));
+  if (b->nodes == NULL || b->face_indices == NULL || bounds == NULL ||
+      centroids == NULL) {
+    free(bounds);
+    free(centroids);
+    bvh_free(b);
+    return 0;
+  }
+
+  for (int32_t i = 0; i < n; ++i) {
+    b->face_indices[i] = i;
+    face_bounds(model, model->face_list[i], &bounds[i * 6], &centroids[i * 3]);
+  }
+
+  if (threads <= 0)
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  build_context ctx;
+  ctx.b = b;
+  ctx.face_bounds = bounds;
+  ctx.centroids = centroids;
+  atomic_init(&ctx.node_count, 1);
+  // every level doubles the number of threads in flight
+  ctx.max_parallel_depth = 0;
+  while ((1 << ctx.max_parallel_depth) < threads)
+    ctx.max_parallel_depth++;
+
+  if (n > 0) {
+    build_node(&ctx, 0, 0, n, 0);
+  } else {
+    box_empty(b->nodes[0].min, b->nodes[0].max);
+    make_leaf(&b->nodes[0], 0, 0);
+  }
+  b->node_count = atomic_load(&ctx.node_count);
+
+  free(bounds);
+  free(centroids);
+  return 1;
+}
+
+void bvh_free(bvh *b) {
+  free(b->nodes);
+  free(b->face_indices);
+  memset(b, 0, sizeof(*b));
+}
+
+// 1 if the box is completely outside one of the planes
+static int box_outside(const bvh_node *node, const bvh_view *view) {
+  for (int p = 0; p < view->plane_count; ++p) {
+    const float *plane = view->planes[p];
+    // the corner furthest inside the plane decides
+    float x = plane[0] > 0 ? node->min[0] : node->max[0];
+    float y = plane[1] > 0 ? node->min[1] : node->max[1];
+    float z = plane[2] > 0 ? node->min[2] : node->max[2];
+    if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] > 0)
+      return 1;
+  }
+  return 0;
+}
+
+static float projected_size(const bvh_node *node, const bvh_view *view) {
+  float diagonal = 0, distance = 0;
+  for (int k = 0; k < 3; ++k) {
+    float extent = node->max[k] - node->min[k];
+    float offset = (node->max[k] + node->min[k]) * 0.5f - view->eye[k];
+    diagonal += extent * extent;
+    distance += offset * offset;
+  }
+  if (distance <= 0)
+    return FLT_MAX;
+  return sqrtf(diagonal / distance) * view->pixels_per_unit;
+}
+
+int bvh_collect_visible(const bvh *b, const bvh_view *view,
+                        int32_t *out_faces) {
+  if (b->face_count == 0)
+    return 0;
+  int count = 0;
+  int32_t stack[BVH_STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const bvh_node *node = &b->nodes[stack[--top]];
+    if (box_outside(node, view))
+      continue;
+    if (view->lod_pixels > 0 && projected_size(node, view) < view->lod_pixels) {
+      // too small to show detail, one face stands in for the whole subtree
+      while (node->count == 0)
+        node = &b->nodes[node->first];
+      out_faces[count++] = b->face_indices[node->first];
+      continue;
+    }
+    if (node->count > 0) {
+      for (int32_t i = 0; i < node->count; ++i)
+        out_faces[count++] = b->face_indices[node->first + i];
+    } else if (top + 2 <= BVH_STACK_SIZE) {
+      stack[top++] = node->first + 1;
+      stack[top++] = node->first;
+    }
+  }
+  return count;
+}
+
+// Slab test, returns the entry distance or FLT_MAX on a miss
+static float ray_box(const bvh_node *node, const float origin[3],
+                     const float inv_dir[3], float t_max) {
+  float t0 = 0, t1 = t_max;
+  for (int k = 0; k < 3; ++k) {
+    float a = (node->min[k] - origin[k]) * inv_dir[k];
+    float c = (node->max[k] - origin[k]) * inv_dir[k];
+    t0 = max_float(t0, min_float(a, c));
+    t1 = min_float(t1, max_float(a, c));
+  }
+  return t0 <= t1 ? t0 : FLT_MAX;
+}
+
+static void vertex_position(const struct obj_scene_data *model, int index,
+                            float *out) {
+  for (int k = 0; k < 3; ++k)
+    out[k] = (float)model->vertex_list[index]->e[k];
+}
+
+// Moller-Trumbore, returns the hit distance or FLT_MAX
+static float ray_triangle(const float *o, const float *d, const float *a,
+                          const float *b, const float *c) {
+  float e1[3], e2[3], p[3], s[3], q[3];
+  for (int k = 0; k < 3; ++k) {
+    e1[k] = b[k] - a[k];
+    e2[k] = c[k] - a[k];
+    s[k] = o[k] - a[k];
+  }
+  p[0] = d[1] * e2[2] - d[2] * e2[1];
+  p[1] = d[2] * e2[0] - d[0] * e2[2];
+  p[2] = d[0] * e2[1] - d[1] * e2[0];
+  float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+  if (fabsf(det) < 1e-12f)
+    return FLT_MAX;
+  float inv = 1.f / det;
+  float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+  if (u < 0 || u > 1)
+    return FLT_MAX;
+  q[0] = s[1] * e1[2] - s[2] * e1[1];
+  q[1] = s[2] * e1[0] - s[0] * e1[2];
+  q[2] = s[0] * e1[1] - s[1] * e1[0];
+  float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+  if (v < 0 || u + v > 1)
+    return FLT_MAX;
+  float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+  return t > 0 ? t : FLT_MAX;
+}
+
+static float ray_face(const struct obj_scene_data *model, const obj_face *face,
+                      const float *origin, const float *dir) {
+  float best = FLT_MAX;
+  if (face->vertex_count < 3)
+    return best;
+  for (int j = 0; j < face->vertex_count; ++j)
+    if (face->vertex_index[j] < 0 ||
+        face->vertex_index[j] >= model->vertex_count)
+      return best;
+  float a[3], b[3], c[3];
+  vertex_position(model, face->vertex_index[0], a);
+  // fan triangulation covers triangles and quads
+  for (int j = 1; j + 1 < face->vertex_count; ++j) {
+    vertex_position(model, face->vertex_index[j], b);
+    vertex_position(model, face->vertex_index[j + 1], c);
+    best = min_float(best, ray_triangle(origin, dir, a, b, c));
+  }
+  return best;
+}
+
+int bvh_pick(const bvh *b, const struct obj_scene_data *model,
+             const float origin[3], const float dir[3], float *t_out) {
+  if (b->face_count == 0)
+    return -1;
+  float inv_dir[3];
+  for (int k = 0; k < 3; ++k)
+    inv_dir[k] = 1.f / dir[k];
+
+  int best_face = -1;
+  float best_t = FLT_MAX;
+  int32_t stack[BVH_STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const bvh_node *node = &b->nodes[stack[--top]];
+    if (ray_box(node, origin, inv_dir, best_t) == FLT_MAX)
+      continue;
+    if (node->count > 0) {
+      for (int32_t i = 0; i < node->count; ++i) {
+        int32_t face = b->face_indices[node->first + i];
+        float t = ray_face(model, model->face_list[face], origin, dir);
+        if (t < best_t) {
+          best_t = t;
+          best_face = face;
+        }
+      }
+      continue;
+    }
+    if (top + 2 > BVH_STACK_SIZE)
+      continue;
+    // visit the nearer child first so best_t shrinks early
+    const bvh_node *left = &b->nodes[node->first];
+    const bvh_node *right = &b->nodes[node->first + 1];
+    float tl = ray_box(left, origin, inv_dir, best_t);
+    float tr = ray_box(right, origin, inv_dir, best_t);
+    if (tl <= tr) {
+      stack[top++] = node->first + 1;
+      stack[top++] = node->first;
+    } else {
+      stack[top++] = node->first;
+      stack[top++] = node->first + 1;
+    }
+  }
+  if (t_out != NULL)
+    *t_out = best_t;
+  return best_face;
+}
+
+void bvh_view_from_transform(bvh_view *view, float R[3][3],
+                             const float t[3], float pixels_per_unit,
+                             float lod_pixels) {
+  // camera space planes: +-x - z/2 <= 0, +-y - z/2 <= 0, near - z <= 0
+  static const float camera_planes[5][4] = {{1, 0, -0.5f, 0},
+                                            {-1, 0, -0.5f, 0},
+                                            {0, 1, -0.5f, 0},
+                                            {0, -1, -0.5f, 0},
+                                            {0, 0, -1, 0.01f}};
+  // p_camera = R p + t, so the plane becomes (R^T n) . p + (n . t + d)
+  for (int p = 0; p < 5; ++p) {
+    const float *n = camera_planes[p];
+    for (int k = 0; k < 3; ++k)
+      view->planes[p][k] = R[0][k] * n[0] + R[1][k] * n[1] + R[2][k] * n[2];
+    view->planes[p][3] = n[0] * t[0] + n[1] * t[1] + n[2] * t[2] + n[3];
+  }
+  view->plane_count = 5;
+  // the camera sits at the origin of camera space: eye = R^T (0 - t)
+  for (int k = 0; k < 3; ++k)
+    view->eye[k] = -(R[0][k] * t[0] + R[1][k] * t[1] + R[2][k] * t[2]);
+  view->pixels_per_unit = pixels_per_unit;
+  view->lod_pixels = lod_pixels;
+}
@@ -0,0 +1,57 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "obj_parser.h"
+#include <stdint.h>
+
+// Bounding volume hierarchy over the faces of a model, built once at load
+// time in object space. Nodes live in one flat array, children of a node are
+// always adjacent, so a node is 32 bytes and two children share a cache line.
+
+typedef struct bvh_node {
+  float min[3];
+  float max[3];
+  int32_t first; // leaf: first entry in face_indices, inner: left child
+  int32_t count; // leaf: number of faces, inner: 0 (right child is first + 1)
+} bvh_node;
+
+typedef struct bvh {
+  bvh_node *nodes;
+  int32_t node_count;
+  int32_t *face_indices; // faces reordered so every leaf is a contiguous run
+  int32_t face_count;
+} bvh;
+
+// What a traversal needs to know about the camera, all in object space
+typedef struct bvh_view {
+  float planes[6][4]; // inside when dot(n, p) + d <= 0
+  int plane_count;
+  float eye[3];
+  // screen pixels covered by one unit at distance one; LOD is disabled when
+  // lod_pixels is 0, otherwise nodes smaller than that on screen are drawn
+  // as a single representative face
+  float pixels_per_unit;
+  float lod_pixels;
+} bvh_view;
+
+// Builds the hierarchy using up to `threads` threads (0 picks the CPU count)
+int bvh_build(bvh *b, const struct obj_scene_data *model, int threads);
+void bvh_free(bvh *b);
+
+// Writes the faces that may be visible to out_faces (room for face_count
+// entries) and returns how many there are
+int bvh_collect_visible(const bvh *b, const bvh_view *view,
+                        int32_t *out_faces);
+
+// Casts a ray and returns the nearest hit face or -1, with the distance
+// along `dir` in *t_out
+int bvh_pick(const bvh *b, const struct obj_scene_data *model,
+             const float origin[3], const float dir[3], float *t_out);
+
+// Frustum of the renderer's projection (on screen when |x/z| and |y/z| are at
+// most 0.5) for an object rotated by R and moved by t, in object space
+void bvh_view_from_transform(bvh_view *view, float R[3][3],
+                             const float t[3], float pixels_per_unit,
+                             float lod_pixels);
+
+#endif
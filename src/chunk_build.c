@@ -0,0 +1,480 @@
+#include "chunks.h"
+#include "bounds.h"
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define WHITESPACE " \t\n\r"
+// faces are partitioned by the top bits of their key before sorting, so
+// one bucket at a time is sorted
+#define BUCKET_BITS 12
+#define BUCKETS (1 << BUCKET_BITS)
+#define MORTON_BITS 21
+#define NO_VERTEX UINT32_MAX
+// corners read from one f line, longer polygons lose the rest
+#define MAX_POLYGON 256
+// power of two above the most vertices a chunk can have
+#define VERTEX_TABLE_SIZE (8 * CHUNK_MAX_FACES)
+
+typedef struct face_record {
+  uint32_t corner[4]; // NO_VERTEX in the fourth for triangles
+} face_record;
+
+typedef struct keyed_face {
+  uint64_t key; // Morton code of the centroid
+  face_record face;
+} keyed_face;
+
+// One chunk being written, with its vertices numbered in order of first
+// use through an open addressing table keyed by global index
+typedef struct chunk_scratch {
+  uint32_t global[VERTEX_TABLE_SIZE];
+  uint16_t local[VERTEX_TABLE_SIZE];
+  uint32_t stamp[VERTEX_TABLE_SIZE]; // slot is in use when == generation
+  uint32_t generation;
+  uint32_t globals[4 * CHUNK_MAX_FACES]; // by local index
+  float positions[4 * CHUNK_MAX_FACES][3];
+  chunk_face faces[CHUNK_MAX_FACES]; // of one block
+} chunk_scratch;
+
+typedef struct builder {
+  const char *chunk_path;
+  FILE *vertex_file; // xyz doubles as parsed
+  FILE *face_file;   // face_record
+  uint64_t vertex_count;
+  uint64_t face_count;
+  uint64_t dropped;
+  // the box and fit center_and_scale_model would find, and the upright
+  // turn
+  double min[3];
+  double max[3];
+  double centroid[3];
+  float scale;
+  float upright[3][3];
+  const double (*vertices)[3]; // vertex_file, mapped
+  const face_record *faces;    // face_file, mapped
+  FILE *out;
+  uint64_t offset; // bytes written to out
+  chunk_info *directory;
+  uint32_t chunk_count;
+  uint32_t directory_capacity;
+  chunk_scratch *scratch;
+} builder;
+
+// An unlinked scratch file next to `near`, so it is on the same disk and
+// goes away with the process
+static FILE *scratch_file(const char *near) {
+  char path[PATH_MAX];
+  if (snprintf(path, sizeof(path), "%s.XXXXXX", near) >= (int)sizeof(path))
+    return NULL;
+  int fd = mkstemp(path);
+  if (fd < 0)
+    return NULL;
+  unlink(path);
+  FILE *f = fdopen(fd, "w+b");
+  if (f == NULL)
+    close(fd);
+  return f;
+}
+
+// Maps the first `size` bytes of f, growing the file when writable
+static void *map_file(FILE *f, size_t size, bool writable) {
+  if (fflush(f) != 0 || size == 0)
+    return NULL;
+  if (writable && ftruncate(fileno(f), (off_t)size) != 0)
+    return NULL;
+  void *map = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED, fileno(f), 0);
+  return map == MAP_FAILED ? NULL : map;
+}
+
+static bool add_face(builder *b, const uint32_t *corners, int count) {
+  face_record record;
+  for (int j = 0; j < 4; ++j)
+    record.corner[j] = j < count ? corners[j] : NO_VERTEX;
+  b->face_count++;
+  return fwrite(&record, sizeof(record), 1, b->face_file) == 1;
+}
+
+// One f line: up to four corners as they are, longer polygons as a fan of
+// triangles. Index rules are those of obj_convert_to_list_index.
+static bool read_face(builder *b, char **save) {
+  uint32_t corners[MAX_POLYGON];
+  int count = 0;
+  bool valid = true;
+  char *token;
+  while (count < MAX_POLYGON && (token = strtok_r(NULL, WHITESPACE, save))) {
+    long long index = atoll(token);
+    index = index < 0 ? (long long)b->vertex_count + index : index - 1;
+    valid = valid && index >= 0 && (uint64_t)index < b->vertex_count;
+    corners[count++] = (uint32_t)index;
+  }
+  if (!valid || count < 3) {
+    b->dropped++;
+    return true;
+  }
+  if (count <= 4)
+    return add_face(b, corners, count);
+  for (int j = 1; j + 1 < count; ++j) {
+    uint32_t fan[3] = {corners[0], corners[j], corners[j + 1]};
+    if (!add_face(b, fan, 3))
+      return false;
+  }
+  return true;
+}
+
+// First pass: vertices and faces into the scratch files
+static bool read_obj(builder *b, const char *obj_path) {
+  FILE *in = fopen(obj_path, "r");
+  if (in == NULL) {
+    fprintf(stderr, "Could not open %s\n", obj_path);
+    return false;
+  }
+  char *line = NULL;
+  size_t capacity = 0;
+  bool ok = true;
+  while (ok && getline(&line, &capacity, in) != -1) {
+    char *save;
+    char *token = strtok_r(line, WHITESPACE, &save);
+    if (token == NULL)
+      continue;
+    if (strcmp(token, "v") == 0) {
+      if (b->vertex_count == NO_VERTEX) {
+        fprintf(stderr, "%s has too many vertices\n", obj_path);
+        ok = false;
+        break;
+      }
+      double e[3];
+      for (int k = 0; k < 3; ++k) {
+        token = strtok_r(NULL, WHITESPACE, &save);
+        e[k] = token == NULL ? 0.0 : atof(token);
+      }
+      b->vertex_count++;
+      ok = fwrite(e, sizeof(e), 1, b->vertex_file) == 1;
+    } else if (strcmp(token, "f") == 0) {
+      ok = read_face(b, &save);
+    }
+  }
+  if (ferror(in))
+    ok = false;
+  free(line);
+  fclose(in);
+  if (!ok)
+    fprintf(stderr, "Could not convert %s\n", obj_path);
+  return ok;
+}
+
+// The scale and centroid center_and_scale_model would use, measured like
+// model_bounds_compute over the vertices the stored faces use; the flags
+// go to a mapped scratch file so they do not take memory either
+static bool fit(builder *b) {
+  FILE *used_file = scratch_file(b->chunk_path);
+  size_t used_bytes = b->vertex_count;
+  uint8_t *used = used_file ? map_file(used_file, used_bytes, true) : NULL;
+  if (used == NULL) {
+    if (used_file)
+      fclose(used_file);
+    return false;
+  }
+  for (uint64_t f = 0; f < b->face_count; ++f)
+    for (int j = 0; j < 4; ++j)
+      if (b->faces[f].corner[j] != NO_VERTEX)
+        used[b->faces[f].corner[j]] = 1;
+
+  double sum[3] = {0, 0, 0};
+  uint64_t measured = 0;
+  for (int k = 0; k < 3; ++k) {
+    b->min[k] = INFINITY;
+    b->max[k] = -INFINITY;
+  }
+  for (uint64_t v = 0; v < b->vertex_count; ++v) {
+    if (!used[v])
+      continue;
+    const double *e = b->vertices[v];
+    for (int k = 0; k < 3; ++k) {
+      b->min[k] = e[k] < b->min[k] ? e[k] : b->min[k];
+      b->max[k] = e[k] > b->max[k] ? e[k] : b->max[k];
+      sum[k] += e[k];
+    }
+    measured++;
+  }
+  munmap(used, used_bytes);
+  fclose(used_file);
+
+  double radius_squared = 0;
+  for (int k = 0; k < 3; ++k) {
+    b->centroid[k] = sum[k] / (double)measured;
+    double reach =
+        fmax(b->centroid[k] - b->min[k], b->max[k] - b->centroid[k]);
+    radius_squared += reach * reach;
+  }
+  double radius = sqrt(radius_squared);
+  b->scale = radius > 0 ? (float)(MODEL_FIT_RADIUS / radius) : 1.f;
+  upright_rotation(b->upright);
+  return true;
+}
+
+// A vertex as loaded_model_load leaves it: fitted, then turned upright by
+// transform_model
+static void fitted_vertex(const builder *b, uint32_t index, float out[3]) {
+  double moved[3];
+  for (int k = 0; k < 3; ++k)
+    moved[k] = (b->vertices[index][k] - b->centroid[k]) * b->scale;
+  float x = (float)moved[0], y = (float)moved[1], z = (float)moved[2];
+  const float(*R)[3] = b->upright;
+  out[0] = R[0][0] * x + R[0][1] * y + R[0][2] * z;
+  out[1] = R[1][0] * x + R[1][1] * y + R[1][2] * z;
+  out[2] = R[2][0] * x + R[2][1] * y + R[2][2] * z + 0.f;
+}
+
+// 21 bits spread out to every third bit
+static uint64_t spread_bits(uint32_t x) {
+  uint64_t v = x & ((1u << MORTON_BITS) - 1);
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+// Morton code of the face's centroid within the model's box
+static uint64_t face_key(const builder *b, const face_record *face) {
+  int count = face->corner[3] == NO_VERTEX ? 3 : 4;
+  uint64_t key = 0;
+  for (int k = 0; k < 3; ++k) {
+    double c = 0;
+    for (int j = 0; j < count; ++j)
+      c += b->vertices[face->corner[j]][k];
+    double extent = b->max[k] - b->min[k];
+    double t = extent > 0 ? (c / count - b->min[k]) / extent : 0;
+    t = t > 0 ? (t < 1 ? t : 1) : 0; // NaN to 0 as well
+    key |= spread_bits((uint32_t)(t * ((1u << MORTON_BITS) - 1))) << k;
+  }
+  return key;
+}
+
+static int compare_keyed(const void *a, const void *b) {
+  const keyed_face *x = a, *y = b;
+  if (x->key != y->key)
+    return x->key < y->key ? -1 : 1;
+  return memcmp(&x->face, &y->face, sizeof(x->face));
+}
+
+// Level of the i-th face of a chunk in curve order: every eighth face is
+// in level 0, the ones halfway between in level 1, and so on, so each
+// level is spread over the whole chunk
+static int face_level(int i) {
+  if (i % 8 == 0)
+    return 0;
+  if (i % 8 == 4)
+    return 1;
+  return i % 2 == 0 ? 2 : 3;
+}
+
+static uint16_t local_vertex(chunk_scratch *t, uint32_t global,
+                             uint32_t *count) {
+  uint32_t slot = (global * 2654435761u) & (VERTEX_TABLE_SIZE - 1);
+  while (t->stamp[slot] == t->generation) {
+    if (t->global[slot] == global)
+      return t->local[slot];
+    slot = (slot + 1) & (VERTEX_TABLE_SIZE - 1);
+  }
+  t->stamp[slot] = t->generation;
+  t->global[slot] = global;
+  t->local[slot] = (uint16_t)*count;
+  t->globals[*count] = global;
+  return (uint16_t)(*count)++;
+}
+
+static bool write_chunk(builder *b, const keyed_face *faces, int count) {
+  if (b->chunk_count == b->directory_capacity) {
+    uint32_t capacity = b->directory_capacity ? b->directory_capacity * 2 : 64;
+    chunk_info *directory =
+        realloc(b->directory, sizeof(chunk_info) * capacity);
+    if (directory == NULL)
+      return false;
+    b->directory = directory;
+    b->directory_capacity = capacity;
+  }
+  chunk_info *info = &b->directory[b->chunk_count++];
+  memset(info, 0, sizeof(*info));
+  info->offset = b->offset;
+
+  chunk_scratch *scratch = b->scratch;
+  float(*positions)[3] = scratch->positions;
+  scratch->generation++;
+  uint32_t vertex_count = 0, face_count = 0, bytes = 0;
+  float min[3] = {INFINITY, INFINITY, INFINITY};
+  float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+  for (int level = 0; level < CHUNK_LEVELS; ++level) {
+    uint32_t first_vertex = vertex_count;
+    int block_count = 0;
+    for (int i = 0; i < count; ++i) {
+      if (face_level(i) != level)
+        continue;
+      chunk_face *out = &scratch->faces[block_count++];
+      for (int j = 0; j < 4; ++j) {
+        uint32_t global = faces[i].face.corner[j];
+        out->corner[j] = global == NO_VERTEX
+                             ? CHUNK_NO_CORNER
+                             : local_vertex(scratch, global, &vertex_count);
+      }
+    }
+    for (uint32_t v = first_vertex; v < vertex_count; ++v) {
+      fitted_vertex(b, scratch->globals[v], positions[v]);
+      for (int k = 0; k < 3; ++k) {
+        min[k] = fminf(min[k], positions[v][k]);
+        max[k] = fmaxf(max[k], positions[v][k]);
+      }
+    }
+    size_t new_vertices = vertex_count - first_vertex;
+    if (fwrite(positions[first_vertex], sizeof(positions[0]), new_vertices,
+               b->out) != new_vertices ||
+        fwrite(scratch->faces, sizeof(chunk_face), block_count, b->out) !=
+            (size_t)block_count)
+      return false;
+    face_count += block_count;
+    bytes += (uint32_t)(new_vertices * sizeof(positions[0]) +
+                        block_count * sizeof(chunk_face));
+    info->vertices[level] = vertex_count;
+    info->faces[level] = face_count;
+    info->bytes[level] = bytes;
+  }
+  float radius = 0;
+  for (int k = 0; k < 3; ++k)
+    info->center[k] = (min[k] + max[k]) / 2;
+  for (uint32_t v = 0; v < vertex_count; ++v) {
+    float d[3];
+    for (int k = 0; k < 3; ++k)
+      d[k] = positions[v][k] - info->center[k];
+    radius = fmaxf(radius, sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+  }
+  info->radius = radius;
+  b->offset += bytes;
+  return true;
+}
+
+// Second pass: faces sorted along the curve through a scratch file, one
+// bucket at a time, and written out as chunks
+static bool write_chunks(builder *b) {
+  const face_record *faces = b->faces;
+  size_t sorted_bytes = sizeof(keyed_face) * b->face_count;
+  FILE *sorted_file = scratch_file(b->chunk_path);
+  keyed_face *sorted =
+      sorted_file ? map_file(sorted_file, sorted_bytes, true) : NULL;
+  // where each bucket starts, and where its next face goes
+  uint64_t *starts = calloc(BUCKETS + 1, sizeof(uint64_t));
+  uint64_t *fill = malloc(sizeof(uint64_t) * BUCKETS);
+  b->scratch = calloc(1, sizeof(chunk_scratch));
+  bool ok = sorted && starts && fill && b->scratch;
+  const int shift = 3 * MORTON_BITS - BUCKET_BITS;
+
+  if (ok) {
+    for (uint64_t f = 0; f < b->face_count; ++f)
+      starts[(face_key(b, &faces[f]) >> shift) + 1]++;
+    for (int i = 0; i < BUCKETS; ++i)
+      starts[i + 1] += starts[i];
+    memcpy(fill, starts, sizeof(uint64_t) * BUCKETS);
+    for (uint64_t f = 0; f < b->face_count; ++f) {
+      uint64_t key = face_key(b, &faces[f]);
+      keyed_face *slot = &sorted[fill[key >> shift]++];
+      slot->key = key;
+      slot->face = faces[f];
+    }
+  }
+  // the buckets follow the curve, so once each is sorted all faces are
+  for (int i = 0; i < BUCKETS && ok; ++i)
+    qsort(sorted + starts[i], starts[i + 1] - starts[i], sizeof(keyed_face),
+          compare_keyed);
+  for (uint64_t first = 0; first < b->face_count && ok;
+       first += CHUNK_MAX_FACES) {
+    uint64_t left = b->face_count - first;
+    ok = write_chunk(b, sorted + first,
+                     (int)(left < CHUNK_MAX_FACES ? left : CHUNK_MAX_FACES));
+  }
+
+  free(b->scratch);
+  free(fill);
+  free(starts);
+  if (sorted)
+    munmap(sorted, sorted_bytes);
+  if (sorted_file)
+    fclose(sorted_file);
+  return ok;
+}
+
+int chunks_build(const char *obj_path, const char *chunk_path,
+                 chunk_build_stats *stats) {
+  builder b;
+  memset(&b, 0, sizeof(b));
+  b.chunk_path = chunk_path;
+  b.vertex_file = scratch_file(chunk_path);
+  b.face_file = scratch_file(chunk_path);
+  b.out = fopen(chunk_path, "wb");
+  chunk_file_header header;
+  memset(&header, 0, sizeof(header));
+  bool ok = b.vertex_file && b.face_file && b.out;
+  if (!ok)
+    fprintf(stderr, "Could not create %s\n", chunk_path);
+  ok = ok && read_obj(&b, obj_path);
+  // the second pass reads both scratch files in place
+  size_t vertex_bytes = sizeof(double) * 3 * b.vertex_count;
+  size_t face_bytes = sizeof(face_record) * b.face_count;
+  if (ok && b.face_count > 0) {
+    b.vertices = map_file(b.vertex_file, vertex_bytes, false);
+    b.faces = map_file(b.face_file, face_bytes, false);
+  }
+  if (ok) {
+    // the header is rewritten at the end, when the directory is known
+    b.offset = sizeof(header);
+    ok = fwrite(&header, sizeof(header), 1, b.out) == 1 &&
+         (b.face_count == 0 ||
+          (b.vertices && b.faces && fit(&b) && write_chunks(&b)));
+    if (!ok)
+      fprintf(stderr, "Could not write %s\n", chunk_path);
+  }
+  if (b.vertices)
+    munmap((void *)b.vertices, vertex_bytes);
+  if (b.faces)
+    munmap((void *)b.faces, face_bytes);
+  if (ok) {
+    memcpy(header.magic, CHUNK_MAGIC, sizeof(header.magic));
+    header.version = CHUNK_VERSION;
+    header.chunk_count = b.chunk_count;
+    header.directory_offset = b.offset;
+    header.vertex_count = b.vertex_count;
+    header.face_count = b.face_count;
+    ok = fwrite(b.directory, sizeof(chunk_info), b.chunk_count, b.out) ==
+             b.chunk_count &&
+         fseek(b.out, 0, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, b.out) == 1;
+    if (!ok)
+      fprintf(stderr, "Could not write %s\n", chunk_path);
+  }
+  if (b.out && fclose(b.out) != 0 && ok) {
+    fprintf(stderr, "Could not write %s\n", chunk_path);
+    ok = false;
+  }
+  if (!ok && b.out)
+    remove(chunk_path);
+  if (b.vertex_file)
+    fclose(b.vertex_file);
+  if (b.face_file)
+    fclose(b.face_file);
+  if (ok && stats != NULL) {
+    stats->vertices = b.vertex_count;
+    stats->faces = b.face_count;
+    stats->dropped_faces = b.dropped;
+    stats->chunks = b.chunk_count;
+    stats->bytes = header.directory_offset +
+                   sizeof(chunk_info) * (uint64_t)b.chunk_count;
+  }
+  free(b.directory);
+  return ok;
+}
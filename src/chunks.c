@@ -0,0 +1,370 @@
+#include "chunks.h"
+#include "pipeline.h"
+#include "timing.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 1 / sqrt(1 + 0.5^2), turns distances from the view's side planes, which
+// are at x/z = +-0.5 and y/z = +-0.5, into lengths
+#define SIDE_PLANE_SCALE 0.894427191f
+
+// Where a level's block starts, and what it adds to the levels before it
+static uint32_t block_offset(const chunk_info *c, int level) {
+  return level > 0 ? c->bytes[level - 1] : 0;
+}
+static uint32_t first_vertex(const chunk_info *c, int level) {
+  return level > 0 ? c->vertices[level - 1] : 0;
+}
+static uint32_t first_face(const chunk_info *c, int level) {
+  return level > 0 ? c->faces[level - 1] : 0;
+}
+
+// The block is as long as its vertices and faces
+static int block_fits(const chunk_info *c, int level) {
+  if (c->bytes[level] < block_offset(c, level) ||
+      c->vertices[level] < first_vertex(c, level) ||
+      c->faces[level] < first_face(c, level))
+    return 0;
+  size_t vertices = c->vertices[level] - first_vertex(c, level);
+  size_t faces = c->faces[level] - first_face(c, level);
+  return c->bytes[level] - block_offset(c, level) ==
+         vertices * 3 * sizeof(float) + faces * sizeof(chunk_face);
+}
+
+// The directory entries agree with themselves and the file size
+static int valid_chunk(const chunk_info *c, uint64_t data_end) {
+  for (int level = 0; level < CHUNK_LEVELS; ++level)
+    if (!block_fits(c, level) || c->vertices[level] > CHUNK_NO_CORNER)
+      return 0;
+  // blocks hold floats, so they must stay 4-byte aligned
+  return c->offset % 4 == 0 && c->offset <= data_end &&
+         c->bytes[CHUNK_LEVELS - 1] <= data_end - c->offset &&
+         isfinite(c->radius);
+}
+
+int chunked_model_open(chunked_model *m, const char *path, size_t budget) {
+  memset(m, 0, sizeof(*m));
+  m->lru_first = m->lru_last = -1;
+  m->budget = budget;
+  long page = sysconf(_SC_PAGESIZE);
+  m->page_size = page > 0 ? (size_t)page : 4096;
+  m->fd = open(path, O_RDONLY);
+  if (m->fd < 0) {
+    fprintf(stderr, "Could not open %s\n", path);
+    return 0;
+  }
+  struct stat st;
+  chunk_file_header *h = &m->header;
+  if (fstat(m->fd, &st) != 0 ||
+      pread(m->fd, h, sizeof(*h), 0) != (ssize_t)sizeof(*h) ||
+      memcmp(h->magic, CHUNK_MAGIC, sizeof(h->magic)) != 0 ||
+      h->version != CHUNK_VERSION || h->directory_offset < sizeof(*h) ||
+      h->directory_offset > (uint64_t)st.st_size ||
+      ((uint64_t)st.st_size - h->directory_offset) / sizeof(chunk_info) <
+          h->chunk_count) {
+    fprintf(stderr, "%s is not a chunk file, see objchunk\n", path);
+    close(m->fd);
+    return 0;
+  }
+
+  size_t count = h->chunk_count > 0 ? h->chunk_count : 1;
+  m->chunks = malloc(sizeof(chunk_info) * count);
+  m->slots = calloc(count, sizeof(chunk_slot));
+  m->visits = malloc(sizeof(chunk_visit) * count);
+  m->projected = malloc(sizeof(struct obj_vector) * CHUNK_NO_CORNER);
+  size_t directory_bytes = sizeof(chunk_info) * h->chunk_count;
+  int ok = m->chunks && m->slots && m->visits && m->projected &&
+           pread(m->fd, m->chunks, directory_bytes,
+                 (off_t)h->directory_offset) == (ssize_t)directory_bytes;
+  if (!ok)
+    fprintf(stderr, "Could not read %s\n", path);
+  for (uint32_t i = 0; ok && i < h->chunk_count; ++i) {
+    ok = valid_chunk(&m->chunks[i], h->directory_offset);
+    if (!ok)
+      fprintf(stderr, "%s is corrupt\n", path);
+  }
+  if (!ok) {
+    chunked_model_close(m);
+    return 0;
+  }
+  for (uint32_t i = 0; i < h->chunk_count; ++i)
+    m->slots[i].prev = m->slots[i].next = -1;
+  return 1;
+}
+
+static void lru_remove(chunked_model *m, int c) {
+  chunk_slot *s = &m->slots[c];
+  if (s->prev >= 0)
+    m->slots[s->prev].next = s->next;
+  else
+    m->lru_first = s->next;
+  if (s->next >= 0)
+    m->slots[s->next].prev = s->prev;
+  else
+    m->lru_last = s->prev;
+  s->prev = s->next = -1;
+}
+
+static void lru_push_front(chunked_model *m, int c) {
+  chunk_slot *s = &m->slots[c];
+  s->prev = -1;
+  s->next = m->lru_first;
+  if (m->lru_first >= 0)
+    m->slots[m->lru_first].prev = c;
+  else
+    m->lru_last = c;
+  m->lru_first = c;
+}
+
+// Unmaps a chunk that is not in the list
+static void release_chunk(chunked_model *m, int c) {
+  chunk_slot *s = &m->slots[c];
+  munmap(s->map, s->map_size);
+  m->mapped_bytes -= s->map_size;
+  s->map = NULL;
+  s->data = NULL;
+  s->map_size = 0;
+  s->levels = 0;
+}
+
+static void unmap_chunk(chunked_model *m, int c) {
+  lru_remove(m, c);
+  release_chunk(m, c);
+}
+
+void chunked_model_close(chunked_model *m) {
+  while (m->slots != NULL && m->lru_first >= 0)
+    unmap_chunk(m, m->lru_first);
+  free(m->chunks);
+  free(m->slots);
+  free(m->visits);
+  free(m->projected);
+  m->chunks = NULL;
+  m->slots = NULL;
+  m->visits = NULL;
+  m->projected = NULL;
+  if (m->fd >= 0)
+    close(m->fd);
+  m->fd = -1;
+}
+
+// Unmaps the least recently drawn chunks, except those drawn this frame,
+// until `bytes` more fit in the budget
+static int make_room(chunked_model *m, size_t bytes) {
+  while (m->mapped_bytes + bytes > m->budget) {
+    int victim = m->lru_last;
+    if (victim < 0 || m->slots[victim].used == m->frame)
+      return 0;
+    unmap_chunk(m, victim);
+    m->counters.evictions++;
+  }
+  return 1;
+}
+
+// Bytes mapped to read chunk c up to `level`: whole pages, since
+// mappings start on a page and chunks need not
+static size_t map_size(const chunked_model *m, const chunk_info *c,
+                       int level) {
+  size_t size = c->offset % m->page_size + c->bytes[level];
+  return (size + m->page_size - 1) / m->page_size * m->page_size;
+}
+
+// Maps chunk c up to `level` unless it already is. When that does not fit
+// it keeps what is mapped, or maps the coarsest level. Returns the level
+// that can be drawn, or -1 when nothing fits.
+static int page_in(chunked_model *m, int c, int level) {
+  chunk_slot *s = &m->slots[c];
+  const chunk_info *info = &m->chunks[c];
+  // out of make_room's reach while it is being paged in
+  if (s->map != NULL)
+    lru_remove(m, c);
+  if (s->levels <= level) {
+    // the current mapping is replaced, so its bytes count as room
+    size_t size = map_size(m, info, level);
+    bool fits = make_room(m, size - s->map_size);
+    if (!fits && s->levels > 0) {
+      level = s->levels - 1;
+    } else if (!fits) {
+      level = 0;
+      size = map_size(m, info, level);
+      fits = make_room(m, size);
+    }
+    if (s->levels <= level) {
+      if (!fits)
+        return -1;
+      if (s->map != NULL)
+        release_chunk(m, c);
+      size_t skip = info->offset % m->page_size;
+      void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, m->fd,
+                       (off_t)(info->offset - skip));
+      if (map == MAP_FAILED)
+        return -1;
+      posix_madvise(map, size, POSIX_MADV_WILLNEED);
+      s->map = map;
+      s->map_size = size;
+      s->data = (const unsigned char *)map + skip;
+      s->levels = level + 1;
+      m->mapped_bytes += size;
+      if (m->mapped_bytes > m->counters.peak_bytes)
+        m->counters.peak_bytes = m->mapped_bytes;
+      m->counters.maps++;
+    }
+  }
+  lru_push_front(m, c);
+  s->used = m->frame;
+  return level;
+}
+
+// Projects and outlines the levels of chunk c up to `level`, transforming
+// and projecting exactly as transform_model and project_vertices do
+static void draw_chunk(chunked_model *m, framebuffer *fb, int c, int level,
+                       float R[3][3], float distance, edge_kernel edge,
+                       render_stats *stats) {
+  const chunk_info *info = &m->chunks[c];
+  const unsigned char *data = m->slots[c].data;
+  int width = framebuffer_raster_width(fb);
+  int height = framebuffer_raster_height(fb);
+  struct obj_vector *projected = m->projected;
+  double t0 = stats ? now_seconds() : 0;
+  for (int l = 0; l <= level; ++l) {
+    const float *p = (const float *)(data + block_offset(info, l));
+    for (uint32_t v = first_vertex(info, l); v < info->vertices[l];
+         ++v, p += 3) {
+      float x = p[0], y = p[1], z = p[2];
+      double *e = projected[v].e;
+      e[0] = R[0][0] * x + R[0][1] * y + R[0][2] * z;
+      e[1] = R[1][0] * x + R[1][1] * y + R[1][2] * z;
+      e[2] = R[2][0] * x + R[2][1] * y + R[2][2] * z + distance;
+      if (e[2] <= 0) {
+        e[2] = 0; // marks the vertex as behind the camera
+        continue;
+      }
+      double depth = e[2];
+      e[0] = e[0] / depth;
+      e[1] = e[1] / depth;
+      if (e[0] < -1 || e[0] > 1 || e[1] < -1 || e[1] > 1)
+        continue;
+      e[0] = e[0] * width + (float)width / 2;
+      e[1] = e[1] * height + (float)height / 2;
+    }
+  }
+  double t1 = stats ? now_seconds() : 0;
+  uint32_t vertex_count = info->vertices[level];
+  for (int l = 0; l <= level; ++l) {
+    uint32_t new_vertices = info->vertices[l] - first_vertex(info, l);
+    const chunk_face *face =
+        (const chunk_face *)(data + block_offset(info, l) +
+                             new_vertices * 3 * sizeof(float));
+    const chunk_face *end = face + (info->faces[l] - first_face(info, l));
+    for (; face < end; ++face) {
+      int corners = face->corner[3] == CHUNK_NO_CORNER ? 3 : 4;
+      int usable = 1;
+      for (int j = 0; j < corners; ++j)
+        usable = usable && face->corner[j] < vertex_count &&
+                 projected[face->corner[j]].e[2] > 0;
+      if (!usable)
+        continue;
+      for (int j = 0; j < corners; ++j)
+        edge(fb, &projected[face->corner[j]],
+             &projected[face->corner[j + 1 < corners ? j + 1 : 0]]);
+    }
+  }
+  m->counters.faces_drawn += info->faces[level];
+  if (stats) {
+    stats->project_seconds += t1 - t0;
+    stats->raster_seconds += now_seconds() - t1;
+  }
+}
+
+static int compare_visits(const void *a, const void *b) {
+  const chunk_visit *x = a, *y = b;
+  if (x->depth != y->depth)
+    return x->depth < y->depth ? -1 : 1;
+  return x->chunk - y->chunk;
+}
+
+// Coarsest level with no more than one face per `pixels` of the chunk's
+// disc on screen
+static int chunk_level(const chunk_info *c, float depth, int width,
+                       float pixels) {
+  float near = depth - c->radius;
+  if (pixels <= 0 || near <= 0)
+    return CHUNK_LEVELS - 1;
+  float radius = c->radius / depth * (float)width;
+  float wanted = 3.14159265f * radius * radius / pixels;
+  for (int level = 0; level < CHUNK_LEVELS; ++level)
+    if ((float)c->faces[level] >= wanted)
+      return level;
+  return CHUNK_LEVELS - 1;
+}
+
+int chunked_model_draw(chunked_model *m, framebuffer *fb,
+                       const model_view *view, render_stats *stats) {
+  int width = framebuffer_raster_width(fb);
+  int height = framebuffer_raster_height(fb);
+  const model_view *last = &m->drawn_view;
+  if (m->drawn_valid && width == m->drawn_width &&
+      height == m->drawn_height &&
+      memcmp(view->rotation, last->rotation, sizeof(view->rotation)) == 0 &&
+      view->distance == last->distance &&
+      view->lod_pixels == last->lod_pixels)
+    return 0;
+
+  float R[3][3];
+  memcpy(R, view->rotation, sizeof(R));
+  double t0 = now_seconds();
+  // the chunks whose spheres reach into the view, nearest first
+  int visible = 0;
+  for (uint32_t i = 0; i < m->header.chunk_count; ++i) {
+    const chunk_info *c = &m->chunks[i];
+    const float *p = c->center;
+    float x = R[0][0] * p[0] + R[0][1] * p[1] + R[0][2] * p[2];
+    float y = R[1][0] * p[0] + R[1][1] * p[1] + R[1][2] * p[2];
+    float z = R[2][0] * p[0] + R[2][1] * p[1] + R[2][2] * p[2] +
+              view->distance;
+    if (z + c->radius <= 0 ||
+        (fabsf(x) - 0.5f * z) * SIDE_PLANE_SCALE > c->radius ||
+        (fabsf(y) - 0.5f * z) * SIDE_PLANE_SCALE > c->radius)
+      continue;
+    chunk_visit *visit = &m->visits[visible++];
+    visit->chunk = (int)i;
+    visit->depth = z;
+    visit->level = chunk_level(c, z, width, view->lod_pixels);
+  }
+  qsort(m->visits, visible, sizeof(chunk_visit), compare_visits);
+  double t1 = now_seconds();
+  framebuffer_clear(fb, BACKGROUND_CHAR);
+  double t2 = now_seconds();
+
+  m->frame++;
+  edge_kernel edge = select_edge_kernel(fb);
+  for (int i = 0; i < visible; ++i) {
+    const chunk_visit *visit = &m->visits[i];
+    int level = page_in(m, visit->chunk, visit->level);
+    if (level < 0) {
+      m->counters.skipped++;
+      continue;
+    }
+    draw_chunk(m, fb, visit->chunk, level, R, view->distance, edge, stats);
+    m->counters.drawn++;
+  }
+
+  if (stats != NULL) {
+    stats->cull_seconds += t1 - t0;
+    stats->clear_seconds += t2 - t1;
+    stats->frames_drawn++;
+    stats->objects_projected += visible;
+  }
+  m->drawn_view = *view;
+  m->drawn_width = width;
+  m->drawn_height = height;
+  m->drawn_valid = true;
+  return 1;
+}
@@ -0,0 +1,139 @@
+#ifndef CHUNKS_H
+#define CHUNKS_H
+
+#include "framebuffer.h"
+#include "model.h"
+#include "obj_parser.h"
+#include "render.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Out-of-core models. chunks_build streams an OBJ file into a chunk file,
+// where faces are sorted along a Morton curve and cut into chunks of
+// spatially close faces, each with its own vertices as floats and 16-bit
+// corner indices. A chunked_model maps only the chunks in view, and only
+// as much of each as its level of detail needs, keeping the mapped bytes
+// under a budget by unmapping the least recently drawn chunks. Neither
+// side holds the whole model in memory.
+//
+// File layout, in the byte order of the machine that wrote it: a
+// chunk_file_header, the chunks' data, then the directory of chunk_info.
+// A chunk stores CHUNK_LEVELS blocks, coarsest first, each holding the
+// vertices new in that level (float xyz) followed by its faces. Every
+// level is a sample of the faces, twice as many as the level before, and
+// only refers to vertices of the blocks up to its own, so drawing a level
+// reads one contiguous prefix of the chunk.
+
+#define CHUNK_MAGIC "OBJCHNK1"
+#define CHUNK_VERSION 1
+#define CHUNK_LEVELS 4
+#define CHUNK_MAX_FACES 4096
+// the fourth corner of a triangle
+#define CHUNK_NO_CORNER 0xFFFF
+// mapped at most at once unless given otherwise
+#define CHUNK_DEFAULT_BUDGET ((size_t)256 << 20)
+
+typedef struct chunk_file_header {
+  char magic[8]; // CHUNK_MAGIC, not terminated
+  uint32_t version;
+  uint32_t chunk_count;
+  uint64_t directory_offset;
+  uint64_t vertex_count; // in the OBJ file
+  uint64_t face_count;   // stored, polygons split into triangles
+} chunk_file_header;
+
+typedef struct chunk_face {
+  uint16_t corner[4]; // into the chunk's vertices
+} chunk_face;
+
+typedef struct chunk_info {
+  uint64_t offset; // of the first block
+  float center[3]; // sphere around the chunk's vertices
+  float radius;
+  // totals up to and including each level
+  uint32_t vertices[CHUNK_LEVELS];
+  uint32_t faces[CHUNK_LEVELS];
+  uint32_t bytes[CHUNK_LEVELS]; // from offset
+} chunk_info;
+
+typedef struct chunk_build_stats {
+  uint64_t vertices;
+  uint64_t faces;
+  uint64_t dropped_faces; // with fewer than 3 corners or a bad index
+  uint32_t chunks;
+  uint64_t bytes;
+} chunk_build_stats;
+
+// Converts the OBJ file at obj_path, keeping v and f lines. Positions are
+// centered, scaled and turned upright exactly as loaded_model_load does,
+// so a chunked model drawn at full detail matches the loaded one. Scratch
+// data goes to unlinked files next to chunk_path and is memory-mapped, so
+// memory use does not grow with the model. stats may be NULL. Prints why
+// and returns 0 on failure.
+int chunks_build(const char *obj_path, const char *chunk_path,
+                 chunk_build_stats *stats);
+
+typedef struct chunk_counters {
+  long long maps;        // chunks paged in, i.e. mapped or remapped deeper
+  long long evictions;   // chunks unmapped to stay under the budget
+  long long drawn;       // chunks drawn, over all frames
+  long long skipped;     // chunks in view that did not fit in the budget
+  long long faces_drawn; // over all frames
+  size_t peak_bytes;     // most bytes mapped at once
+} chunk_counters;
+
+typedef struct chunk_slot {
+  const unsigned char *data; // the chunk's first block, NULL if unmapped
+  void *map;
+  size_t map_size; // counted against the budget
+  int levels;      // mapped levels
+  int prev;        // least recently used list, -1 at the ends
+  int next;
+  uint64_t used; // last frame drawn
+} chunk_slot;
+
+typedef struct chunk_visit {
+  int chunk;
+  int level;
+  float depth;
+} chunk_visit;
+
+typedef struct chunked_model {
+  int fd;
+  chunk_file_header header;
+  chunk_info *chunks; // the directory
+  chunk_slot *slots;
+  chunk_visit *visits; // scratch, chunks in view this frame
+  struct obj_vector *projected; // scratch, one chunk's vertices
+  size_t page_size;
+  size_t budget;       // bytes that may be mapped at once
+  size_t mapped_bytes; // mapped now
+  int lru_first;       // most recently drawn mapped chunk, or -1
+  int lru_last;
+  uint64_t frame;
+  chunk_counters counters;
+  // what the framebuffer last drew, as in loaded_model
+  model_view drawn_view;
+  int drawn_width;
+  int drawn_height;
+  bool drawn_valid;
+} chunked_model;
+
+// Opens a chunk file built by chunks_build. Only the header and directory
+// are read; `budget` bytes of chunk data may be mapped at once. Prints why
+// and returns 0 when the file is missing or malformed.
+int chunked_model_open(chunked_model *m, const char *path, size_t budget);
+void chunked_model_close(chunked_model *m);
+
+// Draws the model as seen from `view` into fb, the outlines of every chunk
+// in view, nearest first. view->lod_pixels > 0 draws each chunk at the
+// coarsest level with no more than one face per that many pixels of its
+// bounding sphere on screen, 0 draws everything. Chunks are paged in as
+// needed; when the budget is full the least recently drawn ones not in
+// view are unmapped first, and chunks that still do not fit are drawn at
+// their coarsest level or skipped. Returns 0 without touching fb when the
+// view and size are the ones last drawn. stats may be NULL.
+int chunked_model_draw(chunked_model *m, framebuffer *fb,
+                       const model_view *view, render_stats *stats);
+
+#endif
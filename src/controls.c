@@ -0,0 +1,72 @@
+#include "controls.h"
+#include <curses.h>
+
+#define CONTROLS_ANGLE_STEP 0.1f
+#define CONTROLS_DISTANCE_STEP 0.1f
+#define CONTROLS_MIN_DISTANCE 0.2f
+
+const char *const VIEW_CONTROLS_HELP =
+    "keys: arrows/wasd rotate, [ ] turn, + - zoom, space pause, r reset, "
+    "q quit";
+
+void view_controls_init(view_controls *c, float distance) {
+  c->home_distance = distance;
+  c->yaw = 0;
+  c->pitch = 0;
+  c->roll = 0;
+  c->distance = distance;
+  c->paused = false;
+  c->quit = false;
+}
+
+bool view_controls_key(view_controls *c, int key) {
+  switch (key) {
+  case KEY_LEFT:
+  case 'a':
+    c->pitch -= CONTROLS_ANGLE_STEP;
+    return true;
+  case KEY_RIGHT:
+  case 'd':
+    c->pitch += CONTROLS_ANGLE_STEP;
+    return true;
+  case KEY_UP:
+  case 'w':
+    c->roll -= CONTROLS_ANGLE_STEP;
+    return true;
+  case KEY_DOWN:
+  case 's':
+    c->roll += CONTROLS_ANGLE_STEP;
+    return true;
+  case '[':
+    c->yaw -= CONTROLS_ANGLE_STEP;
+    return true;
+  case ']':
+    c->yaw += CONTROLS_ANGLE_STEP;
+    return true;
+  case '+':
+  case '=':
+    c->distance -= CONTROLS_DISTANCE_STEP;
+    if (c->distance < CONTROLS_MIN_DISTANCE)
+      c->distance = CONTROLS_MIN_DISTANCE;
+    return true;
+  case '-':
+    c->distance += CONTROLS_DISTANCE_STEP;
+    return true;
+  case ' ':
+  case 'p':
+    c->paused = !c->paused;
+    return true;
+  case 'r':
+    // back to the starting view, keeping the pause state
+    c->yaw = 0;
+    c->pitch = 0;
+    c->roll = 0;
+    c->distance = c->home_distance;
+    return true;
+  case 'q':
+    c->quit = true;
+    return true;
+  default:
+    return false;
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef CONTROLS_H
+#define CONTROLS_H
+
+#include <stdbool.h>
+
+// Camera state driven by the keyboard. The angles are added on top of the
+// animation: pitch turns the model around the vertical axis, roll tilts it
+// towards the viewer and yaw turns it in the screen plane.
+typedef struct view_controls {
+  float yaw;
+  float pitch;
+  float roll;
+  float distance;
+  float home_distance; // restored by reset
+  bool paused;
+  bool quit;
+} view_controls;
+
+void view_controls_init(view_controls *c, float distance);
+// Applies one key press as returned by getch(). Returns true when the key
+// changed anything, i.e. the next frame has to be drawn.
+bool view_controls_key(view_controls *c, int key);
+
+// One line summary of the keys for the usage text
+extern const char *const VIEW_CONTROLS_HELP;
+
+#endif
@@ -0,0 +1,274 @@
+#include "framebuffer.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+const uint8_t
+    framebuffer_dot_bits[FRAMEBUFFER_DOTS_Y][FRAMEBUFFER_DOTS_X] = {
+    {0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+// dots in the upper and lower half of a cell, for half blocks
+#define UPPER_DOTS 0x1B
+#define LOWER_DOTS 0xE4
+// "\x1b[38;2;255;255;255m"
+#define MAX_COLOR_BYTES 19
+
+int framebuffer_init(framebuffer *fb, int width, int height) {
+  fb->width = width;
+  fb->height = height;
+  fb->capacity = (size_t)width * (size_t)height;
+  fb->mode = FRAMEBUFFER_ASCII;
+  fb->dots = NULL;
+  fb->color_mode = FRAMEBUFFER_MONOCHROME;
+  fb->colors = NULL;
+  fb->pen = FRAMEBUFFER_NO_COLOR;
+  fb->cells = malloc(fb->capacity);
+  return fb->cells != NULL;
+}
+
+int framebuffer_set_mode(framebuffer *fb, framebuffer_mode mode) {
+  if (mode != FRAMEBUFFER_ASCII && fb->dots == NULL) {
+    fb->dots = malloc(fb->capacity);
+    if (fb->dots == NULL)
+      return 0;
+  }
+  fb->mode = mode;
+  return 1;
+}
+
+int framebuffer_set_color(framebuffer *fb, framebuffer_color color_mode) {
+  if (color_mode != FRAMEBUFFER_MONOCHROME && fb->colors == NULL) {
+    fb->colors = malloc(fb->capacity * sizeof(uint32_t));
+    if (fb->colors == NULL)
+      return 0;
+  }
+  fb->color_mode = color_mode;
+  if (color_mode == FRAMEBUFFER_MONOCHROME) {
+    free(fb->colors);
+    fb->colors = NULL;
+  }
+  return 1;
+}
+
+int framebuffer_resize(framebuffer *fb, int width, int height) {
+  size_t size = (size_t)width * (size_t)height;
+  if (size > fb->capacity) {
+    char *cells = realloc(fb->cells, size);
+    if (cells == NULL)
+      return 0;
+    fb->cells = cells;
+    if (fb->dots != NULL) {
+      uint8_t *dots = realloc(fb->dots, size);
+      if (dots == NULL)
+        return 0;
+      fb->dots = dots;
+    }
+    if (fb->colors != NULL) {
+      uint32_t *colors = realloc(fb->colors, size * sizeof(uint32_t));
+      if (colors == NULL)
+        return 0;
+      fb->colors = colors;
+    }
+    fb->capacity = size;
+  }
+  fb->width = width;
+  fb->height = height;
+  return 1;
+}
+
+void framebuffer_free(framebuffer *fb) {
+  free(fb->cells);
+  free(fb->dots);
+  free(fb->colors);
+  fb->cells = NULL;
+  fb->dots = NULL;
+  fb->colors = NULL;
+  fb->capacity = 0;
+  fb->width = 0;
+  fb->height = 0;
+}
+
+void framebuffer_clear(framebuffer *fb, char c) {
+  size_t size = (size_t)fb->width * (size_t)fb->height;
+  if (fb->mode != FRAMEBUFFER_ASCII)
+    memset(fb->dots, 0, size);
+  else
+    memset(fb->cells, c, size);
+  if (fb->colors != NULL)
+    for (size_t i = 0; i < size; ++i)
+      fb->colors[i] = FRAMEBUFFER_NO_COLOR;
+  fb->pen = FRAMEBUFFER_NO_COLOR;
+}
+
+void framebuffer_put(framebuffer *fb, int row, int col, char c) {
+  if (row < 0 || row >= fb->height || col < 0 || col >= fb->width)
+    return;
+  fb->cells[row * fb->width + col] = c;
+  framebuffer_paint(fb, row * fb->width + col);
+}
+
+void framebuffer_put_dot(framebuffer *fb, int x, int y) {
+  if (x < 0 || y < 0 || x >= fb->width * FRAMEBUFFER_DOTS_X ||
+      y >= fb->height * FRAMEBUFFER_DOTS_Y)
+    return;
+  int cell = (y >> 2) * fb->width + (x >> 1);
+  fb->dots[cell] |= framebuffer_dot_bits[y & 3][x & 1];
+  framebuffer_paint(fb, cell);
+}
+
+uint64_t framebuffer_checksum(const framebuffer *fb) {
+  const unsigned char *bytes = fb->mode == FRAMEBUFFER_ASCII
+                                   ? (const unsigned char *)fb->cells
+                                   : fb->dots;
+  uint64_t hash = 14695981039346656037ULL;
+  size_t size = (size_t)fb->width * (size_t)fb->height;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  for (size_t i = 0; fb->colors != NULL && i < size; ++i) {
+    hash ^= fb->colors[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static char *encode_cell(framebuffer_mode mode, uint8_t dots, char *out) {
+  if (dots == 0) {
+    *out++ = ' ';
+    return out;
+  }
+  if (mode == FRAMEBUFFER_BRAILLE) {
+    // U+2800 + dots as UTF-8: 1110 0010, 10 1000 d7 d6, 10 d5..d0
+    *out++ = (char)0xE2;
+    *out++ = (char)(0xA0 | (dots >> 6));
+    *out++ = (char)(0x80 | (dots & 0x3F));
+    return out;
+  }
+  // U+2580 upper half, U+2584 lower half, U+2588 full block
+  static const char last_byte[4] = {0, (char)0x80, (char)0x84, (char)0x88};
+  int halves = ((dots & UPPER_DOTS) != 0) | ((dots & LOWER_DOTS) != 0) << 1;
+  *out++ = (char)0xE2;
+  *out++ = (char)0x96;
+  *out++ = last_byte[halves];
+  return out;
+}
+
+// What decides whether two cells need different colour sequences: the
+// palette index in 256-colour mode, the colour itself otherwise
+static uint32_t color_key(framebuffer_color mode, uint32_t color) {
+  if (mode != FRAMEBUFFER_COLOR_256 || color == FRAMEBUFFER_NO_COLOR)
+    return color;
+  // nearest entry of the 6x6x6 cube at 16..231
+  uint32_t r = ((color >> 16 & 0xFF) * 5 + 127) / 255;
+  uint32_t g = ((color >> 8 & 0xFF) * 5 + 127) / 255;
+  uint32_t b = ((color & 0xFF) * 5 + 127) / 255;
+  return 16 + 36 * r + 6 * g + b;
+}
+
+static char *append_uint(char *out, uint32_t value) {
+  if (value >= 100)
+    *out++ = (char)('0' + value / 100);
+  if (value >= 10)
+    *out++ = (char)('0' + value / 10 % 10);
+  *out++ = (char)('0' + value % 10);
+  return out;
+}
+
+static char *encode_color(framebuffer_color mode, uint32_t key, char *out) {
+  if (key == FRAMEBUFFER_NO_COLOR) {
+    memcpy(out, "\x1b[39m", 5);
+    return out + 5;
+  }
+  memcpy(out, "\x1b[38;", 5);
+  out += 5;
+  if (mode == FRAMEBUFFER_COLOR_256) {
+    *out++ = '5';
+    *out++ = ';';
+    out = append_uint(out, key);
+  } else {
+    *out++ = '2';
+    for (int shift = 16; shift >= 0; shift -= 8) {
+      *out++ = ';';
+      out = append_uint(out, key >> shift & 0xFF);
+    }
+  }
+  *out++ = 'm';
+  return out;
+}
+
+// Colour path: one sequence per run of visible cells sharing a colour, blank
+// cells look the same in any colour and do not break a run
+static size_t encode_color_span(const framebuffer *fb, size_t offset,
+                                int count, char *out) {
+  const uint32_t *colors = fb->colors + offset;
+  char *start = out;
+  uint32_t current = FRAMEBUFFER_NO_COLOR;
+  for (int col = 0; col < count; ++col) {
+    bool ascii = fb->mode == FRAMEBUFFER_ASCII;
+    bool visible = ascii ? fb->cells[offset + col] != ' '
+                         : fb->dots[offset + col] != 0;
+    if (visible) {
+      uint32_t key = color_key(fb->color_mode, colors[col]);
+      if (key != current) {
+        out = encode_color(fb->color_mode, key, out);
+        current = key;
+      }
+    }
+    if (ascii)
+      *out++ = fb->cells[offset + col];
+    else
+      out = encode_cell(fb->mode, fb->dots[offset + col], out);
+  }
+  if (current != FRAMEBUFFER_NO_COLOR)
+    out = encode_color(fb->color_mode, FRAMEBUFFER_NO_COLOR, out);
+  return (size_t)(out - start);
+}
+
+size_t framebuffer_max_row_bytes(const framebuffer *fb, int cols) {
+  size_t per_cell = FRAMEBUFFER_MAX_CELL_BYTES;
+  if (fb->colors != NULL)
+    per_cell += MAX_COLOR_BYTES;
+  return (size_t)cols * per_cell + MAX_COLOR_BYTES;
+}
+
+size_t framebuffer_encode_span(const framebuffer *fb, int row, int first,
+                               int cols, char *out) {
+  if (cols > fb->width - first)
+    cols = fb->width - first;
+  if (cols <= 0)
+    return 0;
+  size_t offset = (size_t)row * fb->width + (size_t)first;
+  if (fb->colors != NULL)
+    return encode_color_span(fb, offset, cols, out);
+  if (fb->mode == FRAMEBUFFER_ASCII) {
+    memcpy(out, fb->cells + offset, (size_t)cols);
+    return (size_t)cols;
+  }
+  const uint8_t *dots = fb->dots + offset;
+  char *start = out;
+  int col = 0;
+  while (col < cols) {
+    // wireframes are mostly empty, skip eight blank cells at a time
+    uint64_t block;
+    if (col + 8 <= cols) {
+      memcpy(&block, dots + col, sizeof(block));
+      if (block == 0) {
+        memset(out, ' ', 8);
+        out += 8;
+      } else {
+        for (int i = 0; i < 8; ++i)
+          out = encode_cell(fb->mode, dots[col + i], out);
+      }
+      col += 8;
+      continue;
+    }
+    out = encode_cell(fb->mode, dots[col], out);
+    ++col;
+  }
+  return (size_t)(out - start);
+}
+
+size_t framebuffer_encode_row(const framebuffer *fb, int row, int cols,
+                              char *out) {
+  return framebuffer_encode_span(fb, row, 0, cols, out);
+}
@@ -0,0 +1,111 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// How cells are rasterized and encoded for the terminal. The sub-cell modes
+// draw into a grid of 2x4 dots per cell and encode each cell from its dots,
+// as a braille glyph or as half blocks.
+typedef enum framebuffer_mode {
+  FRAMEBUFFER_ASCII,
+  FRAMEBUFFER_BRAILLE,
+  FRAMEBUFFER_BLOCKS
+} framebuffer_mode;
+
+// Colour output, independent of the mode. Cells carry a 0xRRGGBB colour
+// that is sent as 256-colour or 24-bit SGR sequences.
+typedef enum framebuffer_color {
+  FRAMEBUFFER_MONOCHROME,
+  FRAMEBUFFER_COLOR_256,
+  FRAMEBUFFER_TRUECOLOR
+} framebuffer_color;
+
+#define FRAMEBUFFER_DOTS_X 2
+#define FRAMEBUFFER_DOTS_Y 4
+// longest encoding of one cell, a UTF-8 braille or block character
+#define FRAMEBUFFER_MAX_CELL_BYTES 3
+// cells drawn without a colour use the terminal's default foreground
+#define FRAMEBUFFER_NO_COLOR 0xFF000000u
+
+// bit of dot (x, y) within a cell, in braille dot order
+extern const uint8_t
+    framebuffer_dot_bits[FRAMEBUFFER_DOTS_Y][FRAMEBUFFER_DOTS_X];
+
+// In-memory character grid the renderer draws into. The terminal backends
+// only ever read from it, so rendering works without a terminal attached.
+typedef struct framebuffer {
+  int width;
+  int height;
+  char *cells; // row-major, width * height bytes, no terminators
+  size_t capacity; // bytes allocated for cells, at least width * height
+  framebuffer_mode mode;
+  // sub-cell modes only: one byte per cell, one bit per dot in the braille
+  // dot order, so a cell's byte is its braille glyph's offset from U+2800
+  uint8_t *dots;
+  framebuffer_color color_mode;
+  uint32_t *colors; // colour modes only: 0xRRGGBB per cell
+  uint32_t pen;     // colour given to the cells drawn next
+} framebuffer;
+
+int framebuffer_init(framebuffer *fb, int width, int height);
+// Switches between ASCII and the sub-cell modes, allocating the dot grid
+// when needed. Returns 0 when out of memory.
+int framebuffer_set_mode(framebuffer *fb, framebuffer_mode mode);
+// Turns colour output on or off, allocating the colour plane when needed.
+// Returns 0 when out of memory.
+int framebuffer_set_color(framebuffer *fb, framebuffer_color color_mode);
+// Changes the size, keeping the allocation when it is big enough. The cells
+// are undefined afterwards. Returns 0 and leaves fb alone when out of
+// memory.
+int framebuffer_resize(framebuffer *fb, int width, int height);
+void framebuffer_free(framebuffer *fb);
+// Fills every cell with c, or clears every dot in the sub-cell modes, and
+// resets colours and the pen to FRAMEBUFFER_NO_COLOR
+void framebuffer_clear(framebuffer *fb, char c);
+void framebuffer_put(framebuffer *fb, int row, int col, char c);
+// Sets the dot at (x, y) of the dot grid, ignoring dots outside of it
+void framebuffer_put_dot(framebuffer *fb, int x, int y);
+// FNV-1a over all cells (or dots), used to check that optimizations keep
+// the output
+uint64_t framebuffer_checksum(const framebuffer *fb);
+
+// Resolution the rasterizer works at: cells, or dots in the sub-cell modes
+static inline int framebuffer_raster_width(const framebuffer *fb) {
+  return fb->mode == FRAMEBUFFER_ASCII ? fb->width
+                                       : fb->width * FRAMEBUFFER_DOTS_X;
+}
+static inline int framebuffer_raster_height(const framebuffer *fb) {
+  return fb->mode == FRAMEBUFFER_ASCII ? fb->height
+                                       : fb->height * FRAMEBUFFER_DOTS_Y;
+}
+
+// Sets the colour of the cell at index `cell` (row * width + col) to the pen
+static inline void framebuffer_paint(framebuffer *fb, int cell) {
+  if (fb->colors != NULL)
+    fb->colors[cell] = fb->pen;
+}
+
+// Room framebuffer_encode_row needs for `cols` cells
+size_t framebuffer_max_row_bytes(const framebuffer *fb, int cols);
+// Writes the terminal encoding of the first `cols` cells of `row` to out
+// and returns the number of bytes written. Nothing is NUL-terminated. In
+// the colour modes a colour sequence is only emitted where the colour
+// changes between visible cells, and the row ends in the default colour.
+size_t framebuffer_encode_row(const framebuffer *fb, int row, int cols,
+                              char *out);
+// Same for the `cols` cells of `row` starting at column `first`, for
+// backends that only send what changed. Each span ends in the default
+// colour, so spans can be written anywhere on the screen.
+size_t framebuffer_encode_span(const framebuffer *fb, int row, int first,
+                               int cols, char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,272 +1,446 @@
-#include "obj_parser.h"
+#include "bench.h"
+#include "chunks.h"
+#include "controls.h"
+#include "framebuffer.h"
+#include "model.h"
+#include "options.h"
+#include "orientation.h"
+#include "raycast.h"
+#include "recording.h"
+#include "render.h"
+#include "scene.h"
+#include "server.h"
+#include "terminal.h"
+#include "timing.h"
+#include "watcher.h"
 #include <curses.h>
-#include <math.h>
+#include <locale.h>
+#include <signal.h>
+#include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-
-// to compile, use the following
-/* gcc main.c -o main -lncurses -lm */
 
 static int MAX_X = 0, MAX_Y = 0;
-const char BACKGROUND_CHAR = '.';
-const char LINE_CHAR = 'x';
-const float MAX_DISTANCE_FROM_LINE = 0.5f;
-const float MODEL_DISTANCE = 1.5f;
+// one animation step per frame at this interval
+static const double FRAME_SECONDS = 0.05;
+// a terminal being dragged sends a stream of resizes, only the size it
+// settles on is applied
+static const double RESIZE_SETTLE_SECONDS = 0.1;
+
+// Terminal setup shared by rendering and playback
+static WINDOW *start_curses(void) {
+  // the sub-cell modes print UTF-8, which curses only does in such a locale
+  setlocale(LC_ALL, "");
+  WINDOW *mainwin;
+  if ((mainwin = initscr()) == NULL) {
+    fprintf(stderr, "Error initialising ncurses.\n");
+    exit(EXIT_FAILURE);
+  }
+  cbreak();
+  noecho();
+  keypad(stdscr, TRUE);
+  curs_set(0);
+  return mainwin;
+}
 
-/*    .+------+     */
-/* .'  |    .'|    */
-/* +---+--+'  |   */
-/* |   |  |   |   */
-/* |  ,+--+---+   */
-/* |.'    | .'    */
-/* +------+'      */
+// Shows a recording at the timing it was recorded with, q quits. Nothing is
+// rendered, each frame costs decoding its changed cells.
+static int play_recording(const options *opts) {
+  recording rec;
+  if (!recording_open(&rec, opts->play_filename))
+    return 0;
+  if (opts->cast_filename != NULL) {
+    int ok = recording_export_cast(&rec, opts->cast_filename);
+    recording_close(&rec);
+    return ok;
+  }
+  framebuffer fb;
+  if (!recording_framebuffer(&rec, &fb)) {
+    recording_close(&rec);
+    return 0;
+  }
+  if (opts->bench) {
+    int ok = run_playback_benchmark(opts, &rec, &fb);
+    framebuffer_free(&fb);
+    recording_close(&rec);
+    return ok;
+  }
 
-void fill_background(void) {
-  erase();
-  for (int row = 0; row < MAX_Y; ++row) {
-    for (int col = 0; col < MAX_X; ++col) {
-      addch(BACKGROUND_CHAR);
+  WINDOW *mainwin = start_curses();
+  // colour recordings need the raw backend, see terminal.h
+  bool raw_output = opts->backend == TERMINAL_RAW || fb.colors != NULL;
+  terminal_output raw;
+  terminal_output_init(&raw, STDOUT_FILENO);
+  double start = now_seconds();
+  double seconds;
+  int status = 0;
+  bool quit = false;
+  while (!quit && (status = recording_next(&rec, &fb, &seconds)) > 0) {
+    // wait for the frame's time, still answering keys
+    int key;
+    double wait;
+    while (!quit && (wait = start + seconds - now_seconds()) > 0) {
+      timeout((int)(wait * 1000) + 1);
+      key = getch();
+      if (key == 'q' || key == 'Q')
+        quit = true;
+      else if (key == KEY_RESIZE && raw_output)
+        raw.clear_next = true;
+      else if (key == KEY_RESIZE)
+        clearok(curscr, TRUE);
     }
+    int rows, cols;
+    getmaxyx(stdscr, rows, cols);
+    if (raw_output)
+      terminal_output_frame(&raw, &fb, rows, cols);
+    else
+      curses_output_frame(&fb);
   }
+  terminal_output_free(&raw);
+  framebuffer_free(&fb);
+  recording_close(&rec);
+  delwin(mainwin);
+  endwin();
+  if (status < 0)
+    fprintf(stderr, "Recording %s is corrupt\n", opts->play_filename);
+  return status >= 0;
 }
 
-typedef struct vec3 {
-  float x;
-  float y;
-  float z;
-} vec3;
-
-typedef struct line {
-  vec3 start;
-  vec3 end;
-} line;
-
-typedef struct triangle {
-  vec3 points[3];
-} triangle;
-
-typedef struct square {
-  vec3 points[4];
-} square;
-
-bool is_point_part_of_line(int starty, int startx, int endy, int endx,
-                           int pointy, int pointx) {
-  // early return if point is outside the rectangle defined by start and end
-  if (!(((pointy <= endy) && (pointy >= starty)) ||
-        ((pointy >= endy) && (pointy <= starty))))
-    return false;
-  if (!(((pointx <= endx) && (pointx >= startx)) ||
-        ((pointx >= endx) && (pointx <= startx))))
-    return false;
-
-  float length = sqrt((startx - endx) * (startx - endx) +
-                      (starty - endy) * (starty - endy));
+static volatile sig_atomic_t stop_serving = 0;
 
-  float twice_area =
-      fabsf((float)((endy - starty) * pointx - (endx - startx) * pointy +
-                    endx * starty - endy * startx));
-
-  float distance = twice_area / length;
-
-  return distance < MAX_DISTANCE_FROM_LINE ? true : false;
+static void handle_stop(int signal_number) {
+  (void)signal_number;
+  stop_serving = 1;
 }
 
-int clamp_to_screen(const int coord, const int min, const int max) {
-  int clamped_coord = coord;
-  if (coord < min)
-    clamped_coord = 0;
-  if (coord > max)
-    clamped_coord = max;
-  return clamped_coord;
-}
+// Renders at the interactive frame rate without a terminal of its own and
+// hands every frame to the viewers attached to opts->serve_path, until
+// interrupted. Exactly one of model, s and rc is set.
+static int serve_frames(const options *opts, loaded_model *model, scene *s,
+                        raycaster *rc) {
+  framebuffer fb;
+  if (!framebuffer_init(&fb, opts->width, opts->height) ||
+      !framebuffer_set_mode(&fb, opts->output) ||
+      !framebuffer_set_color(&fb, opts->color)) {
+    fprintf(stderr, "Error! Out of memory\n");
+    return 0;
+  }
+  frame_server server;
+  if (!frame_server_open(&server, opts->serve_path)) {
+    framebuffer_free(&fb);
+    return 0;
+  }
+  recording_writer recorder;
+  if (opts->record_filename != NULL &&
+      !recording_writer_open(&recorder, opts->record_filename, &fb)) {
+    frame_server_close(&server);
+    framebuffer_free(&fb);
+    return 0;
+  }
+  signal(SIGINT, handle_stop);
+  signal(SIGTERM, handle_stop);
+  fprintf(stderr, "Serving %dx%d frames on %s\n", fb.width, fb.height,
+          opts->serve_path);
 
-void draw_line(int starty, int startx, int endy, int endx) {
-  starty = clamp_to_screen(starty, 0, MAX_Y);
-  startx = clamp_to_screen(startx, 0, MAX_X);
-  endy = clamp_to_screen(endy, 0, MAX_Y);
-  endx = clamp_to_screen(endx, 0, MAX_X);
-  for (int row = 0; row < MAX_Y; ++row) {
-    for (int col = 0; col < MAX_X; ++col) {
-      if (is_point_part_of_line(starty, startx, endy, endx, row, col)) {
-        mvaddch(row, col, LINE_CHAR);
-      }
+  double start = now_seconds();
+  double next_frame = start;
+  float angle = 0;
+  float rate[3];
+  spin_rate(opts, rate);
+  orientation spin;
+  orientation_init(&spin, rate);
+  while (!stop_serving) {
+    if (rc != NULL) {
+      raycaster_render(rc, &fb, angle);
+    } else if (model != NULL) {
+      model_view view = {{{0}}, MODEL_DISTANCE, opts->cull, opts->backfaces,
+                         opts->lod_pixels, opts->texture};
+      quat_to_matrix(spin.current, view.rotation);
+      loaded_model_draw(model, &fb, &view, NULL);
+    } else {
+      scene_update(s, angle);
+      scene_draw(s, &fb, NULL);
     }
+    // unchanged frames are published too, they cost nothing but let
+    // clients that fell behind catch up
+    frame_server_publish(&server, &fb);
+    if (opts->record_filename != NULL)
+      recording_writer_add(&recorder, &fb, now_seconds() - start);
+    angle += opts->speed;
+    orientation_step(&spin);
+    next_frame += FRAME_SECONDS;
+    if (next_frame < now_seconds())
+      next_frame = now_seconds();
+    frame_server_poll(&server, next_frame - now_seconds());
   }
-}
 
-void draw_line_by_vec3(vec3 start, vec3 end) {
-  draw_line(start.y, start.x, end.y, end.x);
+  fprintf(stderr, "Served %lld frames, %lld full frames, %lld bytes\n",
+          server.frames, server.keyframes_sent, server.bytes_sent);
+  bool recorded = opts->record_filename == NULL ||
+                  recording_writer_close(&recorder);
+  frame_server_close(&server);
+  framebuffer_free(&fb);
+  return recorded;
 }
 
-void draw_line_by_obj_vector(struct obj_vector start, struct obj_vector end) {
-  draw_line(start.e[1], start.e[0], end.e[1], end.e[0]);
-}
-
-void draw_faces(const struct obj_scene_data *model,
-                struct obj_vector *projected_vertices) {
-  for (int32_t i = 0; i < model->face_count; ++i) {
-    struct obj_face current_face = *model->face_list[i];
-    for (int32_t j = 0; j < current_face.vertex_count; ++j) {
-      struct obj_vector start =
-          projected_vertices[current_face.vertex_index[j]];
-      struct obj_vector end = projected_vertices
-          [current_face.vertex_index[(j + 1) % current_face.vertex_count]];
-      draw_line_by_obj_vector(start, end);
+int main(int argc, char **argv) {
+  options opts;
+  if (!parse_options(&opts, argc, argv))
+    exit(EXIT_FAILURE);
+  if (opts.play_filename != NULL)
+    return play_recording(&opts) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  scene instanced_scene;
+  loaded_model *model = NULL;
+  if (opts.scene_filename != NULL) {
+    if (!scene_load(&instanced_scene, opts.scene_filename)) {
+      fprintf(stderr, "Error! Could not load scene %s\n",
+              opts.scene_filename);
+      exit(EXIT_FAILURE);
+    }
+    if (opts.bench) {
+      int ok = run_scene_benchmark(&opts, &instanced_scene);
+      scene_free(&instanced_scene);
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
     }
   }
-}
-
-// Applies yaw (Z), pitch (Y), roll (X) rotation to a point
-void rotate(vec3 *point, float yaw, float pitch, float roll) {
-  // Convert degrees to radians
-  float cy = cosf(yaw);
-  float sy = sinf(yaw);
-  float cp = cosf(pitch);
-  float sp = sinf(pitch);
-  float cr = cosf(roll);
-  float sr = sinf(roll);
 
-  // Rotation matrix (combined yaw-pitch-roll, ZYX order)
-  float R[3][3] = {{cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr},
-                   {sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr},
-                   {-sp, cp * sr, cp * cr}};
-
-  // Original point
-  float x = point->x;
-  float y = point->y;
-  float z = point->z;
+  chunked_model chunked;
+  if (opts.chunks_filename != NULL) {
+    if (!chunked_model_open(&chunked, opts.chunks_filename,
+                            opts.memory_budget))
+      exit(EXIT_FAILURE);
+    if (opts.bench) {
+      int ok = run_chunked_benchmark(&opts, &chunked);
+      chunked_model_close(&chunked);
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
 
-  // Apply rotation
-  point->x = R[0][0] * x + R[0][1] * y + R[0][2] * z;
-  point->y = R[1][0] * x + R[1][1] * y + R[1][2] * z;
-  point->z = R[2][0] * x + R[2][1] * y + R[2][2] * z;
-}
+  obj_scene_data raw_scene;
+  raycaster rc;
+  if (opts.raycast) {
+    // ray casting uses the scene in its own coordinates and camera
+    if (!parse_obj_scene(&raw_scene, (char *)opts.model_filename) ||
+        !raycaster_init(&rc, &raw_scene, 0)) {
+      fprintf(stderr, "Error! Could not parse provided obj file %s\n",
+              opts.model_filename);
+      exit(EXIT_FAILURE);
+    }
+    if (opts.bench) {
+      int ok = run_raycast_benchmark(&opts, &rc);
+      raycaster_free(&rc);
+      delete_obj_data(&raw_scene);
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
 
-void center_and_scale_model(struct obj_scene_data *model, float scale) {
-  printf("scale: %f\n", scale);
-  float cx = 0.f, cy = 0.f, cz = 0.f;
-  float maxx = 0.f, maxy = 0.f, maxz = 0.f;
-  for (int32_t i = 0; i < model->vertex_count; ++i) {
-    cx += model->vertex_list[i]->e[0];
-    cy += model->vertex_list[i]->e[1];
-    cz += model->vertex_list[i]->e[2];
-    if (fabs(model->vertex_list[i]->e[0]) > fabs(maxx))
-      maxx = model->vertex_list[i]->e[0];
-    if (fabs(model->vertex_list[i]->e[1]) > fabs(maxy))
-      maxy = model->vertex_list[i]->e[1];
-    if (fabs(model->vertex_list[i]->e[2]) > fabs(maxz))
-      maxz = model->vertex_list[i]->e[2];
+  model_watcher watcher;
+  obj_mtl_cache *mtl_cache = NULL;
+  if (opts.watch) {
+    model_watcher_init(&watcher, opts.model_filename);
+    mtl_cache = &watcher.mtl_cache;
+    watcher.textured = opts.texture;
   }
-  printf("Max coordinates: %f %f %f\n", maxx, maxy, maxz);
-  cx /= model->vertex_count;
-  cy /= model->vertex_count;
-  cz /= model->vertex_count;
-  printf("Middle coordinates: %f %f %f\n", cx, cy, cz);
-  for (int32_t i = 0; i < model->vertex_count; ++i) {
-    model->vertex_list[i]->e[0] -= cx;
-    model->vertex_list[i]->e[1] -= cy;
-    model->vertex_list[i]->e[2] -= cz;
-    model->vertex_list[i]->e[0] *= scale;
-    model->vertex_list[i]->e[1] *= scale;
-    model->vertex_list[i]->e[2] *= scale;
+
+  // load obj file
+  if (opts.scene_filename == NULL && opts.chunks_filename == NULL &&
+      !opts.raycast) {
+    model = malloc(sizeof(loaded_model));
+    if (model == NULL ||
+        !loaded_model_load(model, opts.model_filename, mtl_cache, false) ||
+        (opts.texture &&
+         !loaded_model_load_textures(model, opts.model_filename, false))) {
+      fprintf(stderr, "Error! Could not parse provided obj file %s\n",
+              opts.model_filename);
+      exit(EXIT_FAILURE);
+    }
   }
-  printf("Scaled down max coordinates: %f %f %f\n", maxx * scale, maxy * scale,
-         maxz * scale);
-}
 
-int main(int argc, char **argv) {
+  if (opts.bench) {
+    int ok = run_benchmark(&opts, model);
+    loaded_model_free(model);
+    free(model);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-  WINDOW *mainwin;
-  if ((mainwin = initscr()) == NULL) {
-    fprintf(stderr, "Error initialising ncurses.\n");
-    exit(EXIT_FAILURE);
+  if (opts.serve_path != NULL) {
+    int ok = serve_frames(&opts, model, model ? NULL : &instanced_scene,
+                          opts.raycast ? &rc : NULL);
+    if (opts.raycast) {
+      raycaster_free(&rc);
+      delete_obj_data(&raw_scene);
+    } else if (model != NULL) {
+      loaded_model_free(model);
+      free(model);
+    } else {
+      scene_free(&instanced_scene);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
   }
-  if (argc < 2) {
-    fprintf(stderr, "Missing obj file.\nUsage: %s <model.obj>\n", argv[0]);
+
+  if (opts.watch && !model_watcher_start(&watcher)) {
+    fprintf(stderr, "Error! Could not watch %s\n", opts.model_filename);
     exit(EXIT_FAILURE);
   }
+
+  WINDOW *mainwin = start_curses();
   getmaxyx(mainwin, MAX_Y, MAX_X);
-  // load obj file
-  struct obj_scene_data model;
-  int ok_code = parse_obj_scene(&model, argv[1]);
-  if (!ok_code) {
-    fprintf(stderr, "Error! Could not parse provided obj file %s\n", argv[1]);
+
+  framebuffer fb;
+  if (!framebuffer_init(&fb, MAX_X, MAX_Y) ||
+      !framebuffer_set_mode(&fb, opts.output) ||
+      !framebuffer_set_color(&fb, opts.color)) {
+    endwin();
+    fprintf(stderr, "Error! Out of memory\n");
     exit(EXIT_FAILURE);
   }
-  struct obj_scene_data const_model;
-  ok_code = parse_obj_scene(&const_model, argv[1]);
-  if (!ok_code) {
-    fprintf(stderr, "Error! Could not parse provided obj file %s\n", argv[1]);
+  bool raw_output = opts.backend == TERMINAL_RAW;
+  terminal_output raw;
+  terminal_output_init(&raw, STDOUT_FILENO);
+  recording_writer recorder;
+  if (opts.record_filename != NULL &&
+      !recording_writer_open(&recorder, opts.record_filename, &fb)) {
+    endwin();
     exit(EXIT_FAILURE);
   }
-
-  center_and_scale_model(&model, 1.f / 137.f);
-  center_and_scale_model(&const_model, 1.f / 137.f);
-
-  int vertex_count = model.vertex_count;
-
-  struct obj_vector *projectedVert =
-      malloc(sizeof(struct obj_vector) * vertex_count);
+  double record_start = now_seconds();
   float angle = 0;
-
-  for (int32_t k = 0; k < vertex_count; ++k) {
-    vec3 current_cube_vertex;
-    current_cube_vertex.x = const_model.vertex_list[k]->e[0];
-    current_cube_vertex.y = const_model.vertex_list[k]->e[1];
-    current_cube_vertex.z = const_model.vertex_list[k]->e[2];
-    rotate(&current_cube_vertex, 0, 0, 3.14f / 2.f);
-    const_model.vertex_list[k]->e[0] = current_cube_vertex.x;
-    const_model.vertex_list[k]->e[1] = current_cube_vertex.y;
-    const_model.vertex_list[k]->e[2] = current_cube_vertex.z;
-  }
-
-  while (1) {
-    fill_background();
-    for (int32_t i = 0; i < vertex_count; ++i) {
-      /* https://computergraphics.stackexchange.com/questions/8255/finding-the-projection-matrix-for-one-point-perspective
-       */
-      projectedVert[i].e[0] =
-          model.vertex_list[i]->e[0] / model.vertex_list[i]->e[2];
-      projectedVert[i].e[1] =
-          model.vertex_list[i]->e[1] / model.vertex_list[i]->e[2];
-      // potential error handling
-      if (projectedVert[i].e[0] < -1 || projectedVert[i].e[0] > 1 ||
-          projectedVert[i].e[1] < -1 || projectedVert[i].e[1] > 1) {
-        continue;
+  bool raycast_drawn = false;
+  float raycast_angle = 0;
+  view_controls controls;
+  view_controls_init(&controls, MODEL_DISTANCE);
+  // the animation turns the model between the keys' yaw and their pitch
+  // and roll, which for the default spin is the same as adding it to pitch
+  float rate[3];
+  spin_rate(&opts, rate);
+  orientation spin;
+  orientation_init(&spin, rate);
+  quat turned = quat_identity(), tilted = quat_identity();
+  double next_frame = now_seconds() + FRAME_SECONDS;
+  bool resize_pending = false;
+  double resize_at = 0;
+
+  while (!controls.quit) {
+    if (opts.watch) {
+      loaded_model *reloaded = model_watcher_take(&watcher);
+      if (reloaded != NULL) {
+        model_watcher_retire(&watcher, model);
+        model = reloaded;
       }
-      projectedVert[i].e[0] = projectedVert[i].e[0] * MAX_X + (float)MAX_X / 2;
-      projectedVert[i].e[1] = projectedVert[i].e[1] * MAX_Y + (float)MAX_Y / 2;
     }
-    // draw faces
-
-    draw_faces(&model, projectedVert);
 
-    // perform rotation on cube located at origo and offset it by MODEL_DISTANCE
-    for (int32_t k = 0; k < vertex_count; ++k) {
-      vec3 current_cube_vertex;
-      current_cube_vertex.x = const_model.vertex_list[k]->e[0];
-      current_cube_vertex.y = const_model.vertex_list[k]->e[1];
-      current_cube_vertex.z = const_model.vertex_list[k]->e[2];
-      /* rotate(&current_cube_vertex, angle / 5, angle, angle / 3); */
-      rotate(&current_cube_vertex, 0, angle, 0);
-      model.vertex_list[k]->e[0] = current_cube_vertex.x;
-      model.vertex_list[k]->e[1] = current_cube_vertex.y;
-      model.vertex_list[k]->e[2] = current_cube_vertex.z + MODEL_DISTANCE;
+    // only redraw and present when something changed, an unchanged view
+    // costs a few comparisons per tick
+    int changed;
+    if (opts.raycast) {
+      // the camera orbits, turning left and right moves it along the orbit
+      float orbit = angle + controls.pitch;
+      changed = !raycast_drawn || orbit != raycast_angle;
+      if (changed)
+        raycaster_render(&rc, &fb, orbit);
+      raycast_drawn = true;
+      raycast_angle = orbit;
+    } else if (model != NULL) {
+      // perform rotation on cube located at origo and offset it by
+      // the camera distance
+      model_view view = {{{0}}, controls.distance, opts.cull, opts.backfaces,
+                         opts.lod_pixels, opts.texture};
+      quat q = quat_multiply(turned, quat_multiply(spin.current, tilted));
+      quat_to_matrix(q, view.rotation);
+      changed = loaded_model_draw(model, &fb, &view, NULL);
+    } else if (opts.chunks_filename != NULL) {
+      model_view view = {{{0}}, controls.distance, true, false,
+                         opts.lod_pixels, false};
+      quat q = quat_multiply(turned, quat_multiply(spin.current, tilted));
+      quat_to_matrix(q, view.rotation);
+      changed = chunked_model_draw(&chunked, &fb, &view, NULL);
+    } else {
+      scene_update(&instanced_scene, angle);
+      changed = scene_draw(&instanced_scene, &fb, NULL);
+    }
+    if (changed && raw_output) {
+      int rows, cols;
+      getmaxyx(stdscr, rows, cols);
+      terminal_output_frame(&raw, &fb, rows, cols);
+    } else if (changed) {
+      curses_output_frame(&fb);
+    }
+    if (changed && opts.record_filename != NULL)
+      recording_writer_add(&recorder, &fb, now_seconds() - record_start);
+
+    // Wait for keys until the next frame is due. getch() never waits
+    // longer than that, so the loop keeps its frame rate and reloads are
+    // still picked up while paused; a key wakes it up straight away.
+    double wake = resize_pending && resize_at < next_frame ? resize_at
+                                                           : next_frame;
+    double wait = wake - now_seconds();
+    timeout(wait > 0 ? (int)(wait * 1000) : 0);
+    int key;
+    while ((key = getch()) != ERR) {
+      // curses turns SIGWINCH into KEY_RESIZE after updating its own size
+      if (key == KEY_RESIZE) {
+        resize_pending = true;
+        resize_at = now_seconds() + RESIZE_SETTLE_SECONDS;
+      } else if (view_controls_key(&controls, key)) {
+        turned = quat_from_euler(controls.yaw, 0, 0);
+        tilted = quat_from_euler(0, controls.pitch, controls.roll);
+      }
+      // drain whatever else is queued without waiting
+      timeout(0);
+    }
+    if (resize_pending && now_seconds() >= resize_at) {
+      resize_pending = false;
+      getmaxyx(mainwin, MAX_Y, MAX_X);
+      // the stages notice the new size and re-project, re-cull and redraw;
+      // when out of memory keep drawing at the old size
+      if (MAX_X > 0 && MAX_Y > 0 && framebuffer_resize(&fb, MAX_X, MAX_Y)) {
+        raycast_drawn = false;
+        if (raw_output)
+          raw.clear_next = true;
+        else
+          clearok(curscr, TRUE);
+      }
+    }
+    if (now_seconds() >= next_frame) {
+      if (!controls.paused) {
+        angle += opts.speed;
+        orientation_step(&spin);
+      }
+      next_frame += FRAME_SECONDS;
+      // after a stall, do not try to catch up on the missed frames
+      if (next_frame < now_seconds())
+        next_frame = now_seconds() + FRAME_SECONDS;
     }
-    angle += 0.1f;
-    refresh();
-    usleep(1000 * 50);
   }
 
   /*  Clean up after ourselves  */
-  free(projectedVert);
-  delete_obj_data(&model);
+  if (opts.watch)
+    model_watcher_stop(&watcher);
+  framebuffer_free(&fb);
+  terminal_output_free(&raw);
+  bool recorded = opts.record_filename == NULL ||
+                  recording_writer_close(&recorder);
+  if (opts.raycast) {
+    raycaster_free(&rc);
+    delete_obj_data(&raw_scene);
+  } else if (model != NULL) {
+    loaded_model_free(model);
+    free(model);
+  } else if (opts.chunks_filename != NULL) {
+    chunked_model_close(&chunked);
+  } else {
+    scene_free(&instanced_scene);
+  }
 
   delwin(mainwin);
   endwin();
   refresh();
 
+  if (!recorded) {
+    fprintf(stderr, "Error! Could not write recording %s\n",
+            opts.record_filename);
+    return EXIT_FAILURE;
+  }
   return EXIT_SUCCESS;
 }
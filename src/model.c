@@ -0,0 +1,202 @@
+#include "model.h"
+#include "bounds.h"
+#include "pipeline.h"
+#include "render.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Points `transformed` at source's lists, apart from a copy of its vertices
+static int share_source(loaded_model *m) {
+  int count = m->source.vertex_count;
+  m->transformed = m->source;
+  m->transformed.vertex_list =
+      malloc(sizeof(struct obj_vector *) * (count > 0 ? count : 1));
+  m->transformed_vertices =
+      malloc(sizeof(struct obj_vector) * (count > 0 ? count : 1));
+  if (m->transformed.vertex_list == NULL || m->transformed_vertices == NULL) {
+    free(m->transformed.vertex_list);
+    free(m->transformed_vertices);
+    return 0;
+  }
+  for (int i = 0; i < count; ++i) {
+    m->transformed_vertices[i] = *m->source.vertex_list[i];
+    m->transformed.vertex_list[i] = &m->transformed_vertices[i];
+  }
+  return 1;
+}
+
+int loaded_model_load(loaded_model *m, const char *filename,
+                      obj_mtl_cache *cache, bool quiet) {
+  if (!parse_obj_scene_cached(&m->source, (char *)filename, cache, quiet))
+    return 0;
+  if (!share_source(m)) {
+    delete_obj_data(&m->source);
+    return 0;
+  }
+  int vertex_slots = m->source.vertex_count > 0 ? m->source.vertex_count : 1;
+  m->projected = calloc(vertex_slots, sizeof(struct obj_vector));
+  int face_slots = m->source.face_count > 0 ? m->source.face_count : 1;
+  m->visible_faces = malloc(sizeof(int32_t) * face_slots);
+  if (m->projected == NULL || m->visible_faces == NULL) {
+    free(m->projected);
+    free(m->visible_faces);
+    free(m->transformed.vertex_list);
+    free(m->transformed_vertices);
+    delete_obj_data(&m->source);
+    return 0;
+  }
+  m->visible_count = 0;
+  drop_bad_corners(&m->source);
+  m->face_arity = face_arity(&m->source);
+  m->drawn_valid = false;
+  memset(&m->textures, 0, sizeof(m->textures));
+  m->depth = NULL;
+  m->depth_capacity = 0;
+
+  // `transformed` is rewritten from source before it is first drawn
+  center_and_scale_model(&m->source, MODEL_SCALE_FIT, quiet);
+
+  float upright[3][3];
+  upright_rotation(upright);
+  transform_model(&m->source, &m->source, upright, 0);
+
+  m->normals.face = NULL;
+  m->normals.vertex = NULL;
+  if (!bvh_build(&m->faces_bvh, &m->source, 0) ||
+      !mesh_normals_compute(&m->normals, &m->source, 0)) {
+    loaded_model_free(m);
+    return 0;
+  }
+  return 1;
+}
+
+void upright_rotation(float R[3][3]) { rotation_matrix(R, 0, 0, 3.14f / 2.f); }
+
+void loaded_model_free(loaded_model *m) {
+  free(m->projected);
+  m->projected = NULL;
+  free(m->visible_faces);
+  m->visible_faces = NULL;
+  texture_set_free(&m->textures);
+  free(m->depth);
+  m->depth = NULL;
+  bvh_free(&m->faces_bvh);
+  mesh_normals_free(&m->normals);
+  // everything but the vertices belongs to source
+  free(m->transformed.vertex_list);
+  free(m->transformed_vertices);
+  m->transformed_vertices = NULL;
+  memset(&m->transformed, 0, sizeof(m->transformed));
+  delete_obj_data(&m->source);
+}
+
+int loaded_model_load_textures(loaded_model *m, const char *filename,
+                               bool quiet) {
+  texture_set_free(&m->textures);
+  m->drawn_valid = false;
+  return texture_set_load(&m->textures, &m->source, filename, quiet);
+}
+
+void loaded_model_cull(loaded_model *m, float R[3][3], float distance,
+                       int width, float lod_pixels, bool backfaces) {
+  const float t[3] = {0, 0, distance};
+  bvh_view view;
+  // the projection maps x/z = 1 to `width` columns
+  bvh_view_from_transform(&view, R, t, (float)width, lod_pixels);
+  m->visible_count =
+      bvh_collect_visible(&m->faces_bvh, &view, m->visible_faces);
+  if (!backfaces)
+    return;
+
+  // the camera sits at the origin, a face looks away from it when its
+  // rotated normal points the same way as any of its vertices
+  const struct obj_scene_data *view_space = &m->transformed;
+  int kept = 0;
+  for (int i = 0; i < m->visible_count; ++i) {
+    int32_t f = m->visible_faces[i];
+    // the BVH keeps faces with bad indices, those are left out here
+    int v = view_space->face_list[f]->vertex_index[0];
+    if (v < 0 || v >= view_space->vertex_count)
+      continue;
+    const float *n = &m->normals.face[3 * f];
+    const double *p = view_space->vertex_list[v]->e;
+    float facing = 0;
+    for (int k = 0; k < 3; ++k)
+      facing += (R[k][0] * n[0] + R[k][1] * n[1] + R[k][2] * n[2]) *
+                (float)p[k];
+    if (facing <= 0)
+      m->visible_faces[kept++] = f;
+  }
+  m->visible_count = kept;
+}
+
+int loaded_model_draw(loaded_model *m, framebuffer *fb, const model_view *view,
+                      render_stats *stats) {
+  const model_view *last = &m->drawn_view;
+  bool transform =
+      !m->drawn_valid ||
+      memcmp(view->rotation, last->rotation, sizeof(view->rotation)) != 0 ||
+      view->distance != last->distance;
+  int width = framebuffer_raster_width(fb);
+  int height = framebuffer_raster_height(fb);
+  bool project =
+      transform || width != m->drawn_width || height != m->drawn_height;
+  bool raster = project || view->cull != last->cull ||
+                view->backfaces != last->backfaces ||
+                view->lod_pixels != last->lod_pixels ||
+                view->textured != last->textured;
+  bool textured = view->textured && fb->mode == FRAMEBUFFER_ASCII;
+  size_t cells = (size_t)fb->width * fb->height;
+  if (textured && m->depth_capacity < cells) {
+    float *depth = realloc(m->depth, sizeof(float) * cells);
+    if (depth == NULL)
+      textured = false;
+    else {
+      m->depth = depth;
+      m->depth_capacity = cells;
+    }
+  }
+  if (!raster)
+    return 0;
+
+  float R[3][3];
+  memcpy(R, view->rotation, sizeof(R));
+  double t0 = now_seconds();
+  if (transform)
+    transform_model(&m->source, &m->transformed, R, view->distance);
+  double t1 = now_seconds();
+  if (project)
+    project_vertices(&m->transformed, m->projected, width, height);
+  double t2 = now_seconds();
+  if (view->cull)
+    loaded_model_cull(m, R, view->distance, width, view->lod_pixels,
+                      view->backfaces);
+  double t3 = now_seconds();
+  framebuffer_clear(fb, BACKGROUND_CHAR);
+  double t4 = now_seconds();
+  if (textured)
+    draw_textured_faces(fb, &m->transformed, &m->textures,
+                        view->cull ? m->visible_faces : NULL,
+                        m->visible_count, m->depth);
+  else
+    select_face_kernel(fb, m->face_arity, view->cull)(
+        fb, &m->transformed, m->projected, m->visible_faces,
+        m->visible_count);
+  double t5 = now_seconds();
+
+  if (stats != NULL) {
+    stats->transform_seconds += t1 - t0;
+    stats->project_seconds += t2 - t1;
+    stats->cull_seconds += t3 - t2;
+    stats->clear_seconds += t4 - t3;
+    stats->raster_seconds += t5 - t4;
+    stats->frames_drawn++;
+    stats->objects_projected += project;
+  }
+  m->drawn_view = *view;
+  m->drawn_width = width;
+  m->drawn_height = height;
+  m->drawn_valid = true;
+  return 1;
+}
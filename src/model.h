@@ -0,0 +1,79 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include "bvh.h"
+#include "framebuffer.h"
+#include "normals.h"
+#include "obj_parser.h"
+#include "render.h"
+
+// Everything that decides what a frame of a single model looks like
+typedef struct model_view {
+  float rotation[3][3]; // see rotation_matrix and quat_to_matrix
+  float distance;
+  bool cull;
+  bool backfaces;
+  float lod_pixels;
+  bool textured; // filled with textures in the ASCII mode, else outlines
+} model_view;
+
+// Everything the render loop needs for one model file. The render loop
+// swaps whole loaded_models when the file is reloaded, so nothing in here
+// may be shared with another instance.
+typedef struct loaded_model {
+  struct obj_scene_data source;      // centered and scaled, never animated
+  // source's faces, materials and the rest, with its own vertices that
+  // are rewritten from source every frame
+  struct obj_scene_data transformed;
+  struct obj_vector *transformed_vertices; // backs transformed.vertex_list
+  struct obj_vector *projected;      // screen positions, one per vertex
+  bvh faces_bvh;                     // over source, i.e. in object space
+  mesh_normals normals;              // of source, i.e. in object space
+  int face_arity;                    // see face_arity, picks the kernel
+  texture_set textures;              // empty until loaded_model_load_textures
+  float *depth;                      // textured mode: 1/z per cell
+  size_t depth_capacity;
+  int32_t *visible_faces;            // output of the last culling pass
+  int visible_count;
+  // what `transformed`, `projected` and the framebuffer last drew, so
+  // frames with the same inputs can skip those stages
+  model_view drawn_view;
+  int drawn_width; // raster size, i.e. dots in the sub-cell modes
+  int drawn_height;
+  bool drawn_valid;
+} loaded_model;
+
+// Parses `filename` into m, reusing material libraries from `cache` when it
+// is not NULL. `quiet` keeps the parser and the fit from printing, for
+// reloads while the terminal shows frames. Returns 0 if the file could not
+// be parsed.
+int loaded_model_load(loaded_model *m, const char *filename,
+                      obj_mtl_cache *cache, bool quiet);
+void loaded_model_free(loaded_model *m);
+// The turn loaded_model_load gives every model after fitting it, which
+// stands the usual y-up OBJ models upright on screen
+void upright_rotation(float R[3][3]);
+// Decodes the textures of the model's materials for the textured view,
+// reporting missing images unless `quiet`. Returns 0 when out of memory;
+// missing images only leave faces flat.
+int loaded_model_load_textures(loaded_model *m, const char *filename,
+                               bool quiet);
+
+// Culls faces against the view of a model rotated by R and pushed
+// `distance` away, filling visible_faces. lod_pixels > 0 also collapses
+// subtrees smaller than that many pixels on a `width` wide screen, and
+// `backfaces` drops faces turned away from the camera. The back-face test
+// reads `transformed`, so it must already hold this frame's vertices.
+void loaded_model_cull(loaded_model *m, float R[3][3], float distance,
+                       int width, float lod_pixels, bool backfaces);
+
+// Draws the model as seen from `view` into a cleared fb, rerunning only the
+// stages whose inputs changed since the last call: the transform when the
+// rotation or distance moved, the projection when it or the framebuffer
+// size did, culling and raster when anything did. Returns 0 without
+// touching fb when the frame would be identical to the last one, which
+// assumes fb still holds it. stats may be NULL.
+int loaded_model_draw(loaded_model *m, framebuffer *fb, const model_view *view,
+                      render_stats *stats);
+
+#endif
@@ -0,0 +1,173 @@
+#include "normals.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// below this many faces a single thread is faster than starting more
+#define NORMALS_PARALLEL_MIN_FACES 8192
+#define NORMALS_MAX_THREADS 64
+
+typedef struct normals_task {
+  const struct obj_scene_data *model;
+  mesh_normals *n;
+  int first;
+  int end;
+  float *accumulator; // 3 floats per vertex, private to the task
+  float **accumulators;
+  int accumulator_count;
+  bool used_file_normals;
+} normals_task;
+
+static void normalize(float *v) {
+  float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (len > 0) {
+    v[0] /= len;
+    v[1] /= len;
+    v[2] /= len;
+  }
+}
+
+// Face normals for [first, end), scattered into the task's vertex sums
+static void *accumulate_faces(void *arg) {
+  normals_task *task = arg;
+  const struct obj_scene_data *model = task->model;
+  for (int f = task->first; f < task->end; ++f) {
+    const obj_face *face = model->face_list[f];
+    // Newell's method: the length is twice the polygon's area
+    float area_normal[3] = {0, 0, 0};
+    for (int j = 0; j < face->vertex_count; ++j) {
+      int a = face->vertex_index[j];
+      int b = face->vertex_index[(j + 1) % face->vertex_count];
+      if (a < 0 || a >= model->vertex_count || b < 0 ||
+          b >= model->vertex_count)
+        continue;
+      const double *p = model->vertex_list[a]->e;
+      const double *q = model->vertex_list[b]->e;
+      area_normal[0] += (float)((p[1] - q[1]) * (p[2] + q[2]));
+      area_normal[1] += (float)((p[2] - q[2]) * (p[0] + q[0]));
+      area_normal[2] += (float)((p[0] - q[0]) * (p[1] + q[1]));
+    }
+    float *unit = &task->n->face[3 * f];
+    memcpy(unit, area_normal, sizeof(area_normal));
+    normalize(unit);
+    float weight = sqrtf(area_normal[0] * area_normal[0] +
+                         area_normal[1] * area_normal[1] +
+                         area_normal[2] * area_normal[2]);
+
+    for (int j = 0; j < face->vertex_count; ++j) {
+      int v = face->vertex_index[j];
+      if (v < 0 || v >= model->vertex_count)
+        continue;
+      float *sum = &task->accumulator[3 * v];
+      int vn = face->normal_index[j];
+      if (vn >= 0 && vn < model->vertex_normal_count) {
+        float file_normal[3];
+        for (int k = 0; k < 3; ++k)
+          file_normal[k] = (float)model->vertex_normal_list[vn]->e[k];
+        normalize(file_normal);
+        for (int k = 0; k < 3; ++k)
+          sum[k] += file_normal[k] * weight;
+        task->used_file_normals = true;
+      } else {
+        for (int k = 0; k < 3; ++k)
+          sum[k] += area_normal[k];
+      }
+    }
+  }
+  return NULL;
+}
+
+// Adds up the per-task sums for vertices [first, end) and normalizes them
+static void *reduce_vertices(void *arg) {
+  normals_task *task = arg;
+  float *out = task->n->vertex;
+  for (int v = task->first; v < task->end; ++v) {
+    float *sum = &out[3 * v];
+    for (int i = 1; i < task->accumulator_count; ++i)
+      for (int k = 0; k < 3; ++k)
+        sum[k] += task->accumulators[i][3 * v + k];
+    normalize(sum);
+  }
+  return NULL;
+}
+
+// Runs fn on every task, the first one on the calling thread
+static void run_tasks(normals_task *tasks, int count, void *(*fn)(void *)) {
+  pthread_t threads[NORMALS_MAX_THREADS];
+  bool started[NORMALS_MAX_THREADS] = {false};
+  for (int i = 1; i < count; ++i)
+    started[i] = pthread_create(&threads[i], NULL, fn, &tasks[i]) == 0;
+  fn(&tasks[0]);
+  for (int i = 1; i < count; ++i) {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    else
+      fn(&tasks[i]);
+  }
+}
+
+int mesh_normals_compute(mesh_normals *n, const struct obj_scene_data *model,
+                         int threads) {
+  memset(n, 0, sizeof(*n));
+  n->face_count = model->face_count;
+  n->vertex_count = model->vertex_count;
+  n->face = malloc(sizeof(float) * 3 * (model->face_count + 1));
+  n->vertex = calloc((size_t)3 * (model->vertex_count + 1), sizeof(float));
+  if (n->face == NULL || n->vertex == NULL) {
+    mesh_normals_free(n);
+    return 0;
+  }
+
+  if (threads <= 0)
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads > NORMALS_MAX_THREADS)
+    threads = NORMALS_MAX_THREADS;
+  if (model->face_count < NORMALS_PARALLEL_MIN_FACES || threads < 1)
+    threads = 1;
+
+  // the first task sums straight into the output, the others into their
+  // own arrays so no two threads write the same vertex
+  float *accumulators[NORMALS_MAX_THREADS];
+  accumulators[0] = n->vertex;
+  for (int i = 1; i < threads; ++i) {
+    accumulators[i] =
+        calloc((size_t)3 * (model->vertex_count + 1), sizeof(float));
+    if (accumulators[i] == NULL) {
+      // fall back to fewer threads rather than failing the load
+      threads = i;
+      break;
+    }
+  }
+
+  normals_task tasks[NORMALS_MAX_THREADS];
+  for (int i = 0; i < threads; ++i) {
+    tasks[i].model = model;
+    tasks[i].n = n;
+    tasks[i].first = (int)((long long)model->face_count * i / threads);
+    tasks[i].end = (int)((long long)model->face_count * (i + 1) / threads);
+    tasks[i].accumulator = accumulators[i];
+    tasks[i].accumulators = accumulators;
+    tasks[i].accumulator_count = threads;
+    tasks[i].used_file_normals = false;
+  }
+  run_tasks(tasks, threads, accumulate_faces);
+  for (int i = 0; i < threads; ++i) {
+    n->uses_file_normals |= tasks[i].used_file_normals;
+    tasks[i].first = (int)((long long)model->vertex_count * i / threads);
+    tasks[i].end = (int)((long long)model->vertex_count * (i + 1) / threads);
+  }
+  run_tasks(tasks, threads, reduce_vertices);
+
+  for (int i = 1; i < threads; ++i)
+    free(accumulators[i]);
+  return 1;
+}
+
+void mesh_normals_free(mesh_normals *n) {
+  free(n->face);
+  free(n->vertex);
+  n->face = NULL;
+  n->vertex = NULL;
+}
@@ -0,0 +1,26 @@
+#ifndef NORMALS_H
+#define NORMALS_H
+
+#include "obj_parser.h"
+#include <stdbool.h>
+
+// Unit normals computed once at load time, in flat arrays of x, y, z
+// triples indexed like the model's faces and vertices. Face normals use
+// Newell's method, so polygons of any arity work. Vertex normals are the
+// area-weighted sum over the faces around the vertex, with a face corner's
+// `vn` taking the place of the face normal when the file provides one.
+typedef struct mesh_normals {
+  float *face;
+  float *vertex;
+  int face_count;
+  int vertex_count;
+  bool uses_file_normals; // at least one corner referenced a vn
+} mesh_normals;
+
+// Computes the normals of `model` with up to `threads` threads (0 picks the
+// CPU count). Returns 0 on allocation failure.
+int mesh_normals_compute(mesh_normals *n, const struct obj_scene_data *model,
+                         int threads);
+void mesh_normals_free(mesh_normals *n);
+
+#endif
@@ -0,0 +1,365 @@
+#include "options.h"
+#include "chunks.h"
+#include "controls.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  OPT_BENCH = 256,
+  OPT_FRAMES,
+  OPT_SIZE,
+  OPT_WATCH,
+  OPT_SCENE,
+  OPT_CULL,
+  OPT_LOD,
+  OPT_RAYCAST,
+  OPT_BACKFACE,
+  OPT_SPEED,
+  OPT_OUTPUT,
+  OPT_COLOR,
+  OPT_BACKEND,
+  OPT_RECORD,
+  OPT_PLAY,
+  OPT_CAST,
+  OPT_SERVE,
+  OPT_SPIN,
+  OPT_TEXTURE,
+  OPT_CHUNKS,
+  OPT_MEMORY
+};
+
+void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] <model.obj>\n"
+          "       %s [options] --scene <file.scene>\n"
+          "       %s [options] --chunks <file.chunks>\n"
+          "       %s [options] --play <file.rec>\n"
+          "  --bench          render without a terminal and print timings\n"
+          "  --frames N       number of frames to render in bench mode\n"
+          "  --size WxH       framebuffer size in bench mode\n"
+          "  --watch          reload the model when the file changes\n"
+          "  --scene FILE     render several instanced meshes from a scene\n"
+          "  --chunks FILE    render a model larger than memory from a\n"
+          "                   chunk file built by objchunk; --lod PIXELS\n"
+          "                   then draws about one face per PIXELS\n"
+          "  --memory MB      chunk data mapped at most at once (256)\n"
+          "  --cull           skip faces outside the view using the BVH\n"
+          "  --lod PIXELS     draw subtrees smaller than PIXELS as one face\n"
+          "  --backface       skip faces turned away from the camera\n"
+          "  --texture        fill faces with their materials' map_Ka\n"
+          "                   images (PGM/PPM) shaded as ASCII glyphs\n"
+          "  --speed RADIANS  rotation per frame, 0 for a still image\n"
+          "  --spin Y,P,R     turn about several axes at once: yaw, pitch\n"
+          "                   and roll in multiples of --speed (0,1,0)\n"
+          "  --output MODE    ascii (default), braille or blocks; the last\n"
+          "                   two draw 2x4 dots per cell\n"
+          "  --color MODE     colour faces by material: 256 or truecolor\n"
+          "  --backend NAME   terminal output through curses, or raw: one\n"
+          "                   write() of the changed cells per frame\n"
+          "  --record FILE    also write the frames shown to a recording\n"
+          "  --play FILE      show a recording at its original timing\n"
+          "  --cast FILE      with --play, convert it to asciicast instead\n"
+          "  --serve SOCKET   render --size frames once for any number of\n"
+          "                   viewers on a Unix socket, e.g.\n"
+          "                   socat -,raw UNIX-CONNECT:SOCKET\n"
+          "  --raycast        shade the model by ray casting its spheres,\n"
+          "                   planes, lights, camera and materials\n",
+          program, program, program, program);
+  fprintf(stderr, "%s\n", VIEW_CONTROLS_HELP);
+}
+
+static int parse_size(const char *arg, int *width, int *height) {
+  char *end;
+  long w = strtol(arg, &end, 10);
+  if (*end != 'x' && *end != 'X')
+    return 0;
+  long h = strtol(end + 1, &end, 10);
+  if (*end != '\0' || w <= 0 || h <= 0)
+    return 0;
+  *width = (int)w;
+  *height = (int)h;
+  return 1;
+}
+
+void spin_rate(const options *opts, float rate[3]) {
+  for (int i = 0; i < 3; ++i)
+    rate[i] = opts->speed * opts->spin[i];
+}
+
+static int parse_spin(const char *arg, float spin[3]) {
+  char *end;
+  for (int i = 0; i < 3; ++i) {
+    spin[i] = strtof(arg, &end);
+    if (end == arg || *end != (i < 2 ? ',' : '\0'))
+      return 0;
+    arg = end + 1;
+  }
+  return 1;
+}
+
+static int parse_output(const char *arg, framebuffer_mode *mode) {
+  static const char *const names[] = {"ascii", "braille", "blocks"};
+  static const framebuffer_mode modes[] = {
+      FRAMEBUFFER_ASCII, FRAMEBUFFER_BRAILLE, FRAMEBUFFER_BLOCKS};
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    if (strcmp(arg, names[i]) == 0) {
+      *mode = modes[i];
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int parse_options(options *opts, int argc, char **argv) {
+  static const struct option long_options[] = {
+      {"bench", no_argument, NULL, OPT_BENCH},
+      {"frames", required_argument, NULL, OPT_FRAMES},
+      {"size", required_argument, NULL, OPT_SIZE},
+      {"watch", no_argument, NULL, OPT_WATCH},
+      {"scene", required_argument, NULL, OPT_SCENE},
+      {"cull", no_argument, NULL, OPT_CULL},
+      {"lod", required_argument, NULL, OPT_LOD},
+      {"raycast", no_argument, NULL, OPT_RAYCAST},
+      {"backface", no_argument, NULL, OPT_BACKFACE},
+      {"texture", no_argument, NULL, OPT_TEXTURE},
+      {"speed", required_argument, NULL, OPT_SPEED},
+      {"spin", required_argument, NULL, OPT_SPIN},
+      {"output", required_argument, NULL, OPT_OUTPUT},
+      {"color", required_argument, NULL, OPT_COLOR},
+      {"backend", required_argument, NULL, OPT_BACKEND},
+      {"record", required_argument, NULL, OPT_RECORD},
+      {"play", required_argument, NULL, OPT_PLAY},
+      {"cast", required_argument, NULL, OPT_CAST},
+      {"serve", required_argument, NULL, OPT_SERVE},
+      {"chunks", required_argument, NULL, OPT_CHUNKS},
+      {"memory", required_argument, NULL, OPT_MEMORY},
+      {NULL, 0, NULL, 0}};
+
+  opts->model_filename = NULL;
+  opts->scene_filename = NULL;
+  opts->chunks_filename = NULL;
+  opts->memory_budget = CHUNK_DEFAULT_BUDGET;
+  opts->record_filename = NULL;
+  opts->play_filename = NULL;
+  opts->cast_filename = NULL;
+  opts->serve_path = NULL;
+  opts->bench = false;
+  opts->watch = false;
+  opts->cull = false;
+  opts->backfaces = false;
+  opts->raycast = false;
+  opts->texture = false;
+  opts->lod_pixels = 0;
+  opts->speed = 0.1f;
+  opts->spin[0] = 0;
+  opts->spin[1] = 1;
+  opts->spin[2] = 0;
+  opts->output = FRAMEBUFFER_ASCII;
+  opts->color = FRAMEBUFFER_MONOCHROME;
+  bool backend_given = false;
+  opts->frames = 100;
+  opts->width = 80;
+  opts->height = 24;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+    switch (opt) {
+    case OPT_BENCH:
+      opts->bench = true;
+      break;
+    case OPT_SCENE:
+      opts->scene_filename = optarg;
+      break;
+    case OPT_CHUNKS:
+      opts->chunks_filename = optarg;
+      break;
+    case OPT_MEMORY: {
+      char *end;
+      double megabytes = strtod(optarg, &end);
+      if (*end != '\0' || !(megabytes > 0)) {
+        fprintf(stderr, "Invalid memory budget '%s'\n", optarg);
+        return 0;
+      }
+      opts->memory_budget = (size_t)(megabytes * (1 << 20));
+      break;
+    }
+    case OPT_CULL:
+      opts->cull = true;
+      break;
+    case OPT_LOD:
+      opts->lod_pixels = (float)atof(optarg);
+      if (opts->lod_pixels <= 0) {
+        fprintf(stderr, "Invalid LOD size '%s'\n", optarg);
+        return 0;
+      }
+      // LOD selection is part of the culling traversal
+      opts->cull = true;
+      break;
+    case OPT_BACKFACE:
+      // back faces are dropped from the culling pass's output
+      opts->backfaces = true;
+      opts->cull = true;
+      break;
+    case OPT_TEXTURE:
+      opts->texture = true;
+      break;
+    case OPT_RAYCAST:
+      opts->raycast = true;
+      break;
+    case OPT_SPEED: {
+      char *end;
+      opts->speed = strtof(optarg, &end);
+      if (*end != '\0') {
+        fprintf(stderr, "Invalid speed '%s'\n", optarg);
+        return 0;
+      }
+      break;
+    }
+    case OPT_SPIN:
+      if (!parse_spin(optarg, opts->spin)) {
+        fprintf(stderr, "Invalid spin '%s'\n", optarg);
+        return 0;
+      }
+      break;
+    case OPT_OUTPUT:
+      if (!parse_output(optarg, &opts->output)) {
+        fprintf(stderr, "Invalid output mode '%s'\n", optarg);
+        return 0;
+      }
+      break;
+    case OPT_COLOR:
+      if (strcmp(optarg, "256") == 0) {
+        opts->color = FRAMEBUFFER_COLOR_256;
+      } else if (strcmp(optarg, "truecolor") == 0) {
+        opts->color = FRAMEBUFFER_TRUECOLOR;
+      } else {
+        fprintf(stderr, "Invalid color mode '%s'\n", optarg);
+        return 0;
+      }
+      break;
+    case OPT_BACKEND:
+      if (strcmp(optarg, "curses") == 0) {
+        opts->backend = TERMINAL_CURSES;
+      } else if (strcmp(optarg, "raw") == 0) {
+        opts->backend = TERMINAL_RAW;
+      } else {
+        fprintf(stderr, "Invalid backend '%s'\n", optarg);
+        return 0;
+      }
+      backend_given = true;
+      break;
+    case OPT_RECORD:
+      opts->record_filename = optarg;
+      break;
+    case OPT_PLAY:
+      opts->play_filename = optarg;
+      break;
+    case OPT_CAST:
+      opts->cast_filename = optarg;
+      break;
+    case OPT_SERVE:
+      opts->serve_path = optarg;
+      break;
+    case OPT_WATCH:
+      opts->watch = true;
+      break;
+    case OPT_FRAMES:
+      opts->frames = atoi(optarg);
+      if (opts->frames <= 0) {
+        fprintf(stderr, "Invalid frame count '%s'\n", optarg);
+        return 0;
+      }
+      break;
+    case OPT_SIZE:
+      if (!parse_size(optarg, &opts->width, &opts->height)) {
+        fprintf(stderr, "Invalid size '%s', expected WxH\n", optarg);
+        return 0;
+      }
+      break;
+    default:
+      print_usage(argv[0]);
+      return 0;
+    }
+  }
+
+  if (!backend_given)
+    opts->backend =
+        opts->color != FRAMEBUFFER_MONOCHROME ? TERMINAL_RAW : TERMINAL_CURSES;
+  else if (opts->backend == TERMINAL_CURSES &&
+           opts->color != FRAMEBUFFER_MONOCHROME) {
+    fprintf(stderr, "--color needs the raw backend\n");
+    return 0;
+  }
+
+  if (opts->cast_filename != NULL && opts->play_filename == NULL) {
+    fprintf(stderr, "--cast converts a recording given with --play\n");
+    return 0;
+  }
+  if (opts->serve_path != NULL &&
+      (opts->bench || opts->watch || opts->play_filename != NULL)) {
+    fprintf(stderr, "--serve cannot be combined with --%s\n",
+            opts->bench ? "bench" : opts->watch ? "watch" : "play");
+    return 0;
+  }
+  if (opts->play_filename != NULL) {
+    // mode, colours and size come from the recording
+    if (opts->scene_filename != NULL || opts->chunks_filename != NULL ||
+        opts->raycast || opts->texture || opts->watch ||
+        opts->record_filename != NULL || optind < argc) {
+      fprintf(stderr, "--play only takes a recording\n");
+      return 0;
+    }
+    return 1;
+  }
+
+  if (opts->chunks_filename != NULL) {
+    // chunks are always culled against the view, and drawn without
+    // materials or normals
+    if (optind < argc) {
+      fprintf(stderr, "--chunks replaces the obj file\n");
+      return 0;
+    }
+    if (opts->scene_filename != NULL || opts->watch || opts->raycast ||
+        opts->texture || opts->backfaces || opts->serve_path != NULL) {
+      fprintf(stderr, "--%s is not supported together with --chunks\n",
+              opts->scene_filename != NULL ? "scene"
+              : opts->watch                ? "watch"
+              : opts->raycast              ? "raycast"
+              : opts->texture              ? "texture"
+              : opts->backfaces            ? "backface"
+                                           : "serve");
+      return 0;
+    }
+    return 1;
+  }
+  if (opts->scene_filename != NULL) {
+    if (opts->watch || opts->raycast || opts->texture) {
+      fprintf(stderr, "--%s is not supported together with --scene\n",
+              opts->watch ? "watch" : opts->raycast ? "raycast" : "texture");
+      return 0;
+    }
+    return 1;
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "Missing obj file.\n");
+    print_usage(argv[0]);
+    return 0;
+  }
+  opts->model_filename = argv[optind];
+  if (opts->raycast && (opts->watch || opts->cull)) {
+    fprintf(stderr, "--raycast cannot be combined with --watch or --cull\n");
+    return 0;
+  }
+  if (opts->raycast && opts->texture) {
+    fprintf(stderr, "--raycast cannot be combined with --texture\n");
+    return 0;
+  }
+  if ((opts->raycast || opts->texture) && opts->output != FRAMEBUFFER_ASCII) {
+    fprintf(stderr, "--%s only supports ascii output\n",
+            opts->raycast ? "raycast" : "texture");
+    return 0;
+  }
+  return 1;
+}
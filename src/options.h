@@ -0,0 +1,43 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "framebuffer.h"
+#include "terminal.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct options {
+  const char *model_filename;
+  const char *scene_filename;
+  const char *chunks_filename; // out-of-core model, see chunks.h
+  const char *record_filename; // frames shown are also written here
+  const char *play_filename;   // a recording to show instead of rendering
+  const char *cast_filename;   // with play: convert to asciicast instead
+  const char *serve_path;      // render for viewers on this Unix socket
+  bool bench;
+  bool watch;
+  bool cull;
+  bool backfaces;
+  bool raycast;
+  bool texture; // fill faces with their map_Ka textures
+  float lod_pixels;
+  size_t memory_budget; // bytes of chunks mapped at once
+  float speed; // radians the model turns per frame
+  // how fast it turns about each axis, in multiples of speed: yaw, pitch
+  // and roll, e.g. 0.2,1,0.33 tumbles it
+  float spin[3];
+  framebuffer_mode output;
+  framebuffer_color color;
+  terminal_backend backend; // raw by default for colour, curses otherwise
+  int frames;
+  int width;
+  int height;
+} options;
+
+// Fills opts from the command line, prints usage and returns 0 on bad input
+int parse_options(options *opts, int argc, char **argv);
+void print_usage(const char *program);
+// Radians of yaw, pitch and roll the model turns per frame
+void spin_rate(const options *opts, float rate[3]);
+
+#endif
@@ -0,0 +1,65 @@
+#include "orientation.h"
+#include <math.h>
+
+quat quat_identity(void) { return (quat){1, 0, 0, 0}; }
+
+quat quat_from_axis_angle(float x, float y, float z, float angle) {
+  float s = sinf(angle / 2);
+  return (quat){cosf(angle / 2), x * s, y * s, z * s};
+}
+
+quat quat_from_euler(float yaw, float pitch, float roll) {
+  quat z = quat_from_axis_angle(0, 0, 1, yaw);
+  quat y = quat_from_axis_angle(0, 1, 0, pitch);
+  quat x = quat_from_axis_angle(1, 0, 0, roll);
+  return quat_multiply(z, quat_multiply(y, x));
+}
+
+quat quat_multiply(quat a, quat b) {
+  return (quat){a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+                a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+}
+
+quat quat_normalize(quat q) {
+  float length = sqrtf(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+  if (length == 0)
+    return quat_identity();
+  return (quat){q.w / length, q.x / length, q.y / length, q.z / length};
+}
+
+void quat_to_matrix(quat q, float R[3][3]) {
+  float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+  float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+  float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+  R[0][0] = 1 - 2 * (yy + zz);
+  R[0][1] = 2 * (xy - wz);
+  R[0][2] = 2 * (xz + wy);
+  R[1][0] = 2 * (xy + wz);
+  R[1][1] = 1 - 2 * (xx + zz);
+  R[1][2] = 2 * (yz - wx);
+  R[2][0] = 2 * (xz - wy);
+  R[2][1] = 2 * (yz + wx);
+  R[2][2] = 1 - 2 * (xx + yy);
+}
+
+void orientation_init(orientation *o, const float rate[3]) {
+  o->current = quat_identity();
+  o->steps = 0;
+  // the axis in x, y, z order: roll, pitch, yaw
+  float x = rate[2], y = rate[1], z = rate[0];
+  float angle = sqrtf(x * x + y * y + z * z);
+  if (angle == 0)
+    o->step = quat_identity();
+  else
+    o->step = quat_from_axis_angle(x / angle, y / angle, z / angle, angle);
+}
+
+void orientation_step(orientation *o) {
+  o->current = quat_multiply(o->step, o->current);
+  if (++o->steps == ORIENTATION_NORMALIZE_INTERVAL) {
+    o->current = quat_normalize(o->current);
+    o->steps = 0;
+  }
+}
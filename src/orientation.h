@@ -0,0 +1,40 @@
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+// Rotations as unit quaternions. Turning a model about several axes at
+// once by integrating a constant angular velocity avoids the gimbal lock of
+// adding to Euler angles, and costs a few multiplications per frame instead
+// of the sines and cosines of rebuilding the rotation.
+typedef struct quat {
+  float w, x, y, z;
+} quat;
+
+quat quat_identity(void);
+// Turns `angle` radians about the unit axis (x, y, z)
+quat quat_from_axis_angle(float x, float y, float z, float angle);
+// The same rotation as rotation_matrix(yaw, pitch, roll)
+quat quat_from_euler(float yaw, float pitch, float roll);
+// a * b rotates by b first, then by a
+quat quat_multiply(quat a, quat b);
+quat quat_normalize(quat q);
+// Rotation matrix of a unit quaternion, laid out like rotation_matrix
+void quat_to_matrix(quat q, float R[3][3]);
+
+// Steps between renormalizations of an integrated orientation; the rounding
+// error of one step is around 1e-7, so drift never becomes visible
+#define ORIENTATION_NORMALIZE_INTERVAL 64
+
+// A model turning at a constant angular velocity
+typedef struct orientation {
+  quat current;
+  quat step; // the rotation of one frame
+  int steps; // since `current` was last renormalized
+} orientation;
+
+// Starts at the identity, turning per frame by `rate` radians of yaw (about
+// Z), pitch (Y) and roll (X) together, i.e. about their combined axis.
+// The only trigonometry of the whole animation happens here.
+void orientation_init(orientation *o, const float rate[3]);
+void orientation_step(orientation *o);
+
+#endif
@@ -0,0 +1,205 @@
+#include "pipeline.h"
+#include "render.h"
+#include <cmath>
+
+namespace {
+
+// Raster policies: how one edge lands in the framebuffer. Both set up what
+// stays fixed for a frame when constructed and plot with the pen only when
+// Colored.
+
+// Cells of the ASCII mode, chosen exactly as draw_line does: those inside
+// the edge's bounding box and closer than MAX_DISTANCE_FROM_LINE to it.
+// draw_line tests every cell of the screen, this only visits the box.
+struct cell_raster {
+  framebuffer *fb;
+  int width;
+  int height;
+
+  explicit cell_raster(framebuffer *target)
+      : fb(target), width(target->width), height(target->height) {}
+
+  template <bool Colored>
+  void edge(const obj_vector &start, const obj_vector &end) const {
+    int starty = clamp_to_screen((int)start.e[1], 0, height);
+    int startx = clamp_to_screen((int)start.e[0], 0, width);
+    int endy = clamp_to_screen((int)end.e[1], 0, height);
+    int endx = clamp_to_screen((int)end.e[0], 0, width);
+    int row0 = starty < endy ? starty : endy;
+    int row1 = starty < endy ? endy : starty;
+    int col0 = startx < endx ? startx : endx;
+    int col1 = startx < endx ? endx : startx;
+    row1 = row1 < height ? row1 : height - 1;
+    col1 = col1 < width ? col1 : width - 1;
+
+    int dy = endy - starty, dx = endx - startx;
+    int offset = endx * starty - endy * startx;
+    // 0 for a single point, which then draws nothing, as in draw_line
+    float length = std::sqrt((double)(dx * dx + dy * dy));
+    for (int row = row0; row <= row1; ++row) {
+      char *cells = fb->cells + row * width;
+      for (int col = col0; col <= col1; ++col) {
+        float twice_area = std::fabs((float)(dy * col - dx * row + offset));
+        if (twice_area / length < RENDER_MAX_DISTANCE_FROM_LINE) {
+          cells[col] = RENDER_LINE_CHAR;
+          if constexpr (Colored)
+            fb->colors[row * width + col] = fb->pen;
+        }
+      }
+    }
+  }
+};
+
+// The dot grid of the braille and half-block modes, as draw_dot_line and
+// framebuffer_put_dot draw it
+struct dot_raster {
+  framebuffer *fb;
+  int width; // in dots
+  int height;
+
+  explicit dot_raster(framebuffer *target)
+      : fb(target), width(target->width * FRAMEBUFFER_DOTS_X),
+        height(target->height * FRAMEBUFFER_DOTS_Y) {}
+
+  template <bool Colored> void dot(int x, int y) const {
+    if (x < 0 || y < 0 || x >= width || y >= height)
+      return;
+    int cell = (y >> 2) * fb->width + (x >> 1);
+    fb->dots[cell] |= framebuffer_dot_bits[y & 3][x & 1];
+    if constexpr (Colored)
+      fb->colors[cell] = fb->pen;
+  }
+
+  template <bool Colored>
+  void edge(const obj_vector &start, const obj_vector &end) const {
+    dot_span span;
+    if (!clip_dot_line((float)start.e[0], (float)start.e[1], (float)end.e[0],
+                       (float)end.e[1], width, height, &span))
+      return;
+    for (int i = 0; i <= span.steps; ++i)
+      dot<Colored>((int)(span.sx + span.stepx * i + 0.5f),
+                   (int)(span.sy + span.stepy * i + 0.5f));
+  }
+};
+
+// Arity is the corner count of every face, or 0 to read it from each face.
+// Culled draws faces[0..face_count) instead of all of the model's faces.
+template <int Arity, typename Raster, bool Colored, bool Culled>
+void draw_outlines(framebuffer *fb, const obj_scene_data *model,
+                   const obj_vector *projected, const int32_t *faces,
+                   int face_count) {
+  const Raster raster(fb);
+  int count = Culled ? face_count : model->face_count;
+  for (int i = 0; i < count; ++i) {
+    const obj_face *face = model->face_list[Culled ? faces[i] : i];
+    if constexpr (Colored)
+      fb->pen = material_color(model, face->material_index);
+    int corners = Arity != 0 ? Arity : face->vertex_count;
+    for (int j = 0; j < corners; ++j) {
+      int next = j + 1 < corners ? j + 1 : 0;
+      raster.template edge<Colored>(projected[face->vertex_index[j]],
+                                    projected[face->vertex_index[next]]);
+    }
+  }
+}
+
+// The variants for one arity, indexed by raster * 4 + colour * 2 + culling
+template <int Arity>
+constexpr face_kernel arity_variants[8] = {
+    draw_outlines<Arity, cell_raster, false, false>,
+    draw_outlines<Arity, cell_raster, false, true>,
+    draw_outlines<Arity, cell_raster, true, false>,
+    draw_outlines<Arity, cell_raster, true, true>,
+    draw_outlines<Arity, dot_raster, false, false>,
+    draw_outlines<Arity, dot_raster, false, true>,
+    draw_outlines<Arity, dot_raster, true, false>,
+    draw_outlines<Arity, dot_raster, true, true>};
+
+// indexed by arity: any, triangles, quads
+constexpr const face_kernel *kernels[3] = {
+    arity_variants<0>, arity_variants<3>, arity_variants<4>};
+
+template <typename Raster, bool Colored>
+void draw_edge(framebuffer *fb, const obj_vector *start,
+               const obj_vector *end) {
+  Raster(fb).template edge<Colored>(*start, *end);
+}
+
+// indexed by raster * 2 + colour
+constexpr edge_kernel edge_variants[4] = {
+    draw_edge<cell_raster, false>, draw_edge<cell_raster, true>,
+    draw_edge<dot_raster, false>, draw_edge<dot_raster, true>};
+
+} // namespace
+
+int face_arity(const struct obj_scene_data *model) {
+  if (model->face_count == 0)
+    return 0;
+  int arity = model->face_list[0]->vertex_count;
+  for (int i = 1; i < model->face_count; ++i)
+    if (model->face_list[i]->vertex_count != arity)
+      return 0;
+  return arity == 3 || arity == 4 ? arity : 0;
+}
+
+int drop_bad_corners(struct obj_scene_data *model) {
+  int dropped = 0;
+  for (int i = 0; i < model->face_count; ++i) {
+    obj_face *face = model->face_list[i];
+    int kept = 0;
+    for (int j = 0; j < face->vertex_count; ++j) {
+      int v = face->vertex_index[j];
+      if (v < 0 || v >= model->vertex_count) {
+        dropped++;
+        continue;
+      }
+      face->vertex_index[kept] = v;
+      face->normal_index[kept] = face->normal_index[j];
+      face->texture_index[kept] = face->texture_index[j];
+      kept++;
+    }
+    face->vertex_count = kept;
+  }
+  return dropped;
+}
+
+void draw_outlines_generic(framebuffer *fb, const struct obj_scene_data *model,
+                           const struct obj_vector *projected,
+                           const int32_t *faces, int face_count) {
+  const cell_raster cells(fb);
+  const dot_raster dots(fb);
+  int count = faces != NULL ? face_count : model->face_count;
+  for (int i = 0; i < count; ++i) {
+    const obj_face *face = model->face_list[faces != NULL ? faces[i] : i];
+    if (fb->colors != NULL)
+      fb->pen = material_color(model, face->material_index);
+    for (int j = 0; j < face->vertex_count; ++j) {
+      int next = j + 1 < face->vertex_count ? j + 1 : 0;
+      const obj_vector &start = projected[face->vertex_index[j]];
+      const obj_vector &end = projected[face->vertex_index[next]];
+      if (fb->mode == FRAMEBUFFER_ASCII) {
+        if (fb->colors != NULL)
+          cells.edge<true>(start, end);
+        else
+          cells.edge<false>(start, end);
+      } else if (fb->colors != NULL) {
+        dots.edge<true>(start, end);
+      } else {
+        dots.edge<false>(start, end);
+      }
+    }
+  }
+}
+
+face_kernel select_face_kernel(const framebuffer *fb, int arity, bool culled) {
+  int by_arity = arity == 3 ? 1 : arity == 4 ? 2 : 0;
+  int variant = (fb->mode == FRAMEBUFFER_ASCII ? 0 : 4) +
+                (fb->colors != NULL ? 2 : 0) + (culled ? 1 : 0);
+  return kernels[by_arity][variant];
+}
+
+edge_kernel select_edge_kernel(const framebuffer *fb) {
+  int variant =
+      (fb->mode == FRAMEBUFFER_ASCII ? 0 : 2) + (fb->colors != NULL ? 1 : 0);
+  return edge_variants[variant];
+}
@@ -0,0 +1,56 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "framebuffer.h"
+#include "obj_parser.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Draws face outlines exactly like draw_faces (or draw_face_list with
+// `faces`), from vertices already projected into fb's raster
+typedef void (*face_kernel)(framebuffer *fb,
+                            const struct obj_scene_data *model,
+                            const struct obj_vector *projected,
+                            const int32_t *faces, int face_count);
+
+// Corners shared by every face of the model: 3, 4, or 0 when they differ
+int face_arity(const struct obj_scene_data *model);
+
+// Removes the corners whose vertex index is outside the model's vertices,
+// keeping the rest of their faces, and returns how many were removed. The
+// kernels index the projected vertices unchecked, so models they draw go
+// through this once after loading, before face_arity.
+int drop_bad_corners(struct obj_scene_data *model);
+
+// Outline kernel compiled for one combination of face arity (see
+// face_arity), raster (cells or the dot grid of the sub-cell modes), colour
+// on or off, and culling (drawing the listed faces rather than all). Each
+// one has those decisions, the line glyph and the distance threshold
+// folded in, so its loops only test the pixels. The choice follows fb's
+// current mode and colour, so pick again after changing those.
+face_kernel select_face_kernel(const framebuffer *fb, int arity, bool culled);
+
+// The kernels' rasters with arity, raster, colour and culling (`faces` not
+// NULL) decided per face and edge at run time: the generic baseline the
+// specialised kernels are measured against
+void draw_outlines_generic(framebuffer *fb, const struct obj_scene_data *model,
+                           const struct obj_vector *projected,
+                           const int32_t *faces, int face_count);
+
+// Draws one edge between projected vertices with fb's pen, for callers that
+// keep their own faces
+typedef void (*edge_kernel)(framebuffer *fb, const struct obj_vector *start,
+                            const struct obj_vector *end);
+
+// The edge the face kernels draw for fb's current mode and colour
+edge_kernel select_edge_kernel(const framebuffer *fb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,715 @@
+#include "raycast.h"
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RC_EPSILON 1e-4f
+#define RC_MAX_DEPTH 3
+#define RC_STACK_SIZE 128
+// terminal cells are about twice as tall as they are wide
+#define RC_CELL_ASPECT 0.5f
+#define RC_VERTICAL_FOV 0.7f
+
+static const char shade_ramp[] = " .:-=+*#%@";
+
+enum { HIT_NONE, HIT_TRIANGLE, HIT_SPHERE, HIT_PLANE };
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef int32_t v4i __attribute__((vector_size(16)));
+
+static inline v4f v4f_set1(float x) { return (v4f){x, x, x, x}; }
+static inline v4i v4i_set1(int32_t x) { return (v4i){x, x, x, x}; }
+static inline v4f v4f_select(v4i mask, v4f a, v4f b) {
+  return (v4f)(((v4i)a & mask) | ((v4i)b & ~mask));
+}
+static inline v4i v4i_select(v4i mask, v4i a, v4i b) {
+  return (a & mask) | (b & ~mask);
+}
+static inline v4f v4f_min(v4f a, v4f b) { return v4f_select(a < b, a, b); }
+static inline v4f v4f_max(v4f a, v4f b) { return v4f_select(a > b, a, b); }
+static inline int v4i_any(v4i m) { return (m[0] | m[1] | m[2] | m[3]) != 0; }
+
+typedef struct ray_packet {
+  v4f o[3];
+  v4f d[3];
+  v4f inv_d[3];
+  v4f t; // nearest hit so far, and the search limit
+  v4i kind;
+  v4i index;
+  v4i active;
+} ray_packet;
+
+static void packet_prepare(ray_packet *p, float t_max) {
+  for (int k = 0; k < 3; ++k)
+    for (int l = 0; l < 4; ++l) {
+      float d = p->d[k][l];
+      p->inv_d[k][l] = 1.f / (fabsf(d) > 1e-20f ? d : 1e-20f);
+    }
+  p->t = v4f_set1(t_max);
+  p->kind = v4i_set1(HIT_NONE);
+  p->index = v4i_set1(-1);
+}
+
+static v4i packet_box(const ray_packet *p, const bvh_node *node) {
+  v4f t0 = v4f_set1(0), t1 = p->t;
+  for (int k = 0; k < 3; ++k) {
+    v4f a = (v4f_set1(node->min[k]) - p->o[k]) * p->inv_d[k];
+    v4f c = (v4f_set1(node->max[k]) - p->o[k]) * p->inv_d[k];
+    t0 = v4f_max(t0, v4f_min(a, c));
+    t1 = v4f_min(t1, v4f_max(a, c));
+  }
+  return (t0 <= t1) & p->active;
+}
+
+// Moller-Trumbore on four rays at once
+static void packet_triangle(ray_packet *p, const rc_triangle *tri, int id) {
+  v4f e1[3], e2[3], s[3];
+  for (int k = 0; k < 3; ++k) {
+    e1[k] = v4f_set1(tri->e1[k]);
+    e2[k] = v4f_set1(tri->e2[k]);
+    s[k] = p->o[k] - v4f_set1(tri->a[k]);
+  }
+  v4f px = p->d[1] * e2[2] - p->d[2] * e2[1];
+  v4f py = p->d[2] * e2[0] - p->d[0] * e2[2];
+  v4f pz = p->d[0] * e2[1] - p->d[1] * e2[0];
+  v4f det = e1[0] * px + e1[1] * py + e1[2] * pz;
+  v4f inv = v4f_set1(1.f) / det;
+  v4f u = (s[0] * px + s[1] * py + s[2] * pz) * inv;
+  v4f qx = s[1] * e1[2] - s[2] * e1[1];
+  v4f qy = s[2] * e1[0] - s[0] * e1[2];
+  v4f qz = s[0] * e1[1] - s[1] * e1[0];
+  v4f v = (p->d[0] * qx + p->d[1] * qy + p->d[2] * qz) * inv;
+  v4f t = (e2[0] * qx + e2[1] * qy + e2[2] * qz) * inv;
+  v4i hit = (det * det > v4f_set1(1e-24f)) & (u >= v4f_set1(0)) &
+            (v >= v4f_set1(0)) & (u + v <= v4f_set1(1)) &
+            (t > v4f_set1(RC_EPSILON)) & (t < p->t) & p->active;
+  p->t = v4f_select(hit, t, p->t);
+  p->kind = v4i_select(hit, v4i_set1(HIT_TRIANGLE), p->kind);
+  p->index = v4i_select(hit, v4i_set1(id), p->index);
+}
+
+static void packet_sphere(ray_packet *p, const float center[3], float radius,
+                          int id) {
+  v4f oc[3];
+  for (int k = 0; k < 3; ++k)
+    oc[k] = p->o[k] - v4f_set1(center[k]);
+  v4f b = oc[0] * p->d[0] + oc[1] * p->d[1] + oc[2] * p->d[2];
+  v4f c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] -
+          v4f_set1(radius * radius);
+  v4f disc = b * b - c;
+  v4f root;
+  for (int l = 0; l < 4; ++l)
+    root[l] = sqrtf(disc[l] > 0 ? disc[l] : 0);
+  v4f t_near = -b - root, t_far = -b + root;
+  v4f t = v4f_select(t_near > v4f_set1(RC_EPSILON), t_near, t_far);
+  v4i hit = (disc > v4f_set1(0)) & (t > v4f_set1(RC_EPSILON)) & (t < p->t) &
+            p->active;
+  p->t = v4f_select(hit, t, p->t);
+  p->kind = v4i_select(hit, v4i_set1(HIT_SPHERE), p->kind);
+  p->index = v4i_select(hit, v4i_set1(id), p->index);
+}
+
+static void packet_plane(ray_packet *p, const float point[3],
+                         const float normal[3], int id) {
+  v4f denom = p->d[0] * v4f_set1(normal[0]) + p->d[1] * v4f_set1(normal[1]) +
+              p->d[2] * v4f_set1(normal[2]);
+  v4f num = (v4f_set1(point[0]) - p->o[0]) * v4f_set1(normal[0]) +
+            (v4f_set1(point[1]) - p->o[1]) * v4f_set1(normal[1]) +
+            (v4f_set1(point[2]) - p->o[2]) * v4f_set1(normal[2]);
+  v4f t = num / denom;
+  v4i hit = (denom * denom > v4f_set1(1e-12f)) & (t > v4f_set1(RC_EPSILON)) &
+            (t < p->t) & p->active;
+  p->t = v4f_select(hit, t, p->t);
+  p->kind = v4i_select(hit, v4i_set1(HIT_PLANE), p->kind);
+  p->index = v4i_select(hit, v4i_set1(id), p->index);
+}
+
+static void vertex(const struct obj_scene_data *scene, int index, float *out) {
+  for (int k = 0; k < 3; ++k)
+    out[k] = (index >= 0 && index < scene->vertex_count)
+                 ? (float)scene->vertex_list[index]->e[k]
+                 : 0.f;
+}
+
+static void normal(const struct obj_scene_data *scene, int index, float *out,
+                   float fallback_y) {
+  if (index >= 0 && index < scene->vertex_normal_count) {
+    for (int k = 0; k < 3; ++k)
+      out[k] = (float)scene->vertex_normal_list[index]->e[k];
+    return;
+  }
+  out[0] = 0;
+  out[1] = fallback_y;
+  out[2] = 0;
+}
+
+static void normalize(float *v) {
+  float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (len > 0)
+    for (int k = 0; k < 3; ++k)
+      v[k] /= len;
+}
+
+static float dot(const float *a, const float *b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross(const float *a, const float *b, float *out) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static const obj_material *material(const raycaster *rc, int index) {
+  if (index < 0 || index >= rc->scene->material_count)
+    return NULL;
+  return rc->scene->material_list[index];
+}
+
+static float luminance(const double *rgb) {
+  return (float)(0.2126 * rgb[0] + 0.7152 * rgb[1] + 0.0722 * rgb[2]);
+}
+
+static int is_emitter(const obj_material *m) {
+  return m != NULL && (m->diff[0] > 1 || m->diff[1] > 1 || m->diff[2] > 1);
+}
+
+static void traverse(const raycaster *rc, ray_packet *p) {
+  const struct obj_scene_data *scene = rc->scene;
+  for (int i = 0; i < scene->sphere_count; ++i) {
+    const obj_sphere *s = scene->sphere_list[i];
+    float center[3], up[3];
+    vertex(scene, s->pos_index, center);
+    normal(scene, s->up_normal_index, up, 1.f);
+    packet_sphere(p, center, sqrtf(dot(up, up)), i);
+  }
+  for (int i = 0; i < scene->plane_count; ++i) {
+    const obj_plane *pl = scene->plane_list[i];
+    float point[3], n[3];
+    vertex(scene, pl->pos_index, point);
+    normal(scene, pl->normal_index, n, 1.f);
+    packet_plane(p, point, n, i);
+  }
+
+  const bvh *b = &rc->faces_bvh;
+  if (b->face_count == 0)
+    return;
+  int32_t stack[RC_STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const bvh_node *node = &b->nodes[stack[--top]];
+    if (!v4i_any(packet_box(p, node)))
+      continue;
+    if (node->count > 0) {
+      for (int32_t i = 0; i < node->count; ++i) {
+        int face = b->face_indices[node->first + i];
+        for (int t = rc->face_first_triangle[face];
+             t < rc->face_first_triangle[face + 1]; ++t)
+          packet_triangle(p, &rc->triangles[t], t);
+      }
+    } else if (top + 2 <= RC_STACK_SIZE) {
+      stack[top++] = node->first + 1;
+      stack[top++] = node->first;
+    }
+  }
+}
+
+typedef struct surface {
+  float point[3];
+  float normal[3];
+  const obj_material *material;
+} surface;
+
+static void hit_surface(const raycaster *rc, const ray_packet *p, int lane,
+                        surface *s) {
+  const struct obj_scene_data *scene = rc->scene;
+  float d[3] = {p->d[0][lane], p->d[1][lane], p->d[2][lane]};
+  for (int k = 0; k < 3; ++k)
+    s->point[k] = p->o[k][lane] + p->t[lane] * d[k];
+  int index = p->index[lane];
+  int material_index = -1;
+  switch (p->kind[lane]) {
+  case HIT_TRIANGLE: {
+    const rc_triangle *tri = &rc->triangles[index];
+    memcpy(s->normal, &rc->normals.face[3 * tri->face], sizeof(s->normal));
+    material_index = scene->face_list[tri->face]->material_index;
+    break;
+  }
+  case HIT_SPHERE: {
+    const obj_sphere *sp = scene->sphere_list[index];
+    float center[3];
+    vertex(scene, sp->pos_index, center);
+    for (int k = 0; k < 3; ++k)
+      s->normal[k] = s->point[k] - center[k];
+    material_index = sp->material_index;
+    break;
+  }
+  default: {
+    const obj_plane *pl = scene->plane_list[index];
+    normal(scene, pl->normal_index, s->normal, 1.f);
+    material_index = pl->material_index;
+    break;
+  }
+  }
+  normalize(s->normal);
+  // surfaces are two-sided, face the normal towards the viewer
+  if (dot(s->normal, d) > 0)
+    for (int k = 0; k < 3; ++k)
+      s->normal[k] = -s->normal[k];
+  s->material = material(rc, material_index);
+}
+
+static v4f trace(const raycaster *rc, ray_packet *p, int depth);
+
+// Direct light with shadows for the lanes in `lit`
+static void shade_lights(const raycaster *rc, const surface *surfaces,
+                         const ray_packet *view, v4i lit, float *out) {
+  for (int i = 0; i < rc->light_count; ++i) {
+    const rc_light *light = &rc->lights[i];
+    ray_packet shadow;
+    float distance[4] = {0};
+    for (int l = 0; l < 4; ++l) {
+      if (!lit[l]) {
+        // a harmless ray for the lanes with no surface
+        for (int k = 0; k < 3; ++k) {
+          shadow.o[k][l] = 0;
+          shadow.d[k][l] = k == 1 ? 1.f : 0.f;
+        }
+        continue;
+      }
+      float to_light[3];
+      for (int k = 0; k < 3; ++k) {
+        to_light[k] = light->position[k] - surfaces[l].point[k];
+        shadow.o[k][l] = surfaces[l].point[k] + surfaces[l].normal[k] * 1e-3f;
+      }
+      distance[l] = sqrtf(dot(to_light, to_light));
+      normalize(to_light);
+      for (int k = 0; k < 3; ++k)
+        shadow.d[k][l] = to_light[k];
+    }
+    packet_prepare(&shadow, FLT_MAX);
+    for (int l = 0; l < 4; ++l)
+      shadow.t[l] = distance[l] * (1.f - 1e-3f);
+    shadow.active = lit;
+    traverse(rc, &shadow);
+
+    for (int l = 0; l < 4; ++l) {
+      if (!lit[l] || shadow.kind[l] != HIT_NONE)
+        continue;
+      const obj_material *m = surfaces[l].material;
+      float to_light[3] = {shadow.d[0][l], shadow.d[1][l], shadow.d[2][l]};
+      float diffuse = dot(surfaces[l].normal, to_light);
+      if (diffuse <= 0)
+        continue;
+      float kd = m ? luminance(m->diff) : 0.8f;
+      float value = kd * diffuse;
+      if (m != NULL && m->shiny > 0) {
+        // Blinn-Phong against the direction back to the viewer
+        float half[3];
+        for (int k = 0; k < 3; ++k)
+          half[k] = to_light[k] - view->d[k][l];
+        normalize(half);
+        float nh = dot(surfaces[l].normal, half);
+        if (nh > 0)
+          value += luminance(m->spec) * powf(nh, (float)m->shiny);
+      }
+      out[l] += value * light->intensity;
+    }
+  }
+}
+
+static v4f trace(const raycaster *rc, ray_packet *p, int depth) {
+  traverse(rc, p);
+  float result[4] = {0, 0, 0, 0};
+  surface surfaces[4] = {0};
+  v4i lit = v4i_set1(0);
+  float reflect[4] = {0, 0, 0, 0};
+
+  for (int l = 0; l < 4; ++l) {
+    if (!p->active[l] || p->kind[l] == HIT_NONE)
+      continue;
+    hit_surface(rc, p, l, &surfaces[l]);
+    const obj_material *m = surfaces[l].material;
+    if (is_emitter(m)) {
+      result[l] = 1.f;
+      continue;
+    }
+    result[l] = m ? luminance(m->amb) * 0.2f : 0.05f;
+    lit[l] = -1;
+    reflect[l] = m ? (float)m->reflect : 0.f;
+  }
+  if (!v4i_any(lit))
+    return (v4f){result[0], result[1], result[2], result[3]};
+
+  shade_lights(rc, surfaces, p, lit, result);
+
+  if (depth < RC_MAX_DEPTH) {
+    ray_packet bounce;
+    v4i mirror = v4i_set1(0);
+    for (int l = 0; l < 4; ++l) {
+      const float *n = surfaces[l].normal;
+      float d[3] = {p->d[0][l], p->d[1][l], p->d[2][l]};
+      float dn = lit[l] ? dot(d, n) : 0;
+      for (int k = 0; k < 3; ++k) {
+        bounce.o[k][l] = lit[l] ? surfaces[l].point[k] + n[k] * 1e-3f : 0;
+        bounce.d[k][l] = d[k] - 2 * dn * (lit[l] ? n[k] : 0);
+      }
+      mirror[l] = lit[l] && reflect[l] > 0 ? -1 : 0;
+    }
+    if (v4i_any(mirror)) {
+      packet_prepare(&bounce, FLT_MAX);
+      bounce.active = mirror;
+      v4f reflected = trace(rc, &bounce, depth + 1);
+      for (int l = 0; l < 4; ++l)
+        if (mirror[l])
+          result[l] = result[l] * (1 - reflect[l]) + reflected[l] * reflect[l];
+    }
+  }
+  return (v4f){result[0], result[1], result[2], result[3]};
+}
+
+// Hue of the surfaces the primary rays hit, at the cell's brightness. The
+// packet still holds the primary hits after trace() returns.
+static uint32_t cell_color(const raycaster *rc, const ray_packet *p,
+                           float level) {
+  float rgb[3] = {0, 0, 0};
+  int hits = 0;
+  for (int l = 0; l < 4; ++l) {
+    if (p->kind[l] == HIT_NONE)
+      continue;
+    surface s;
+    hit_surface(rc, p, l, &s);
+    for (int k = 0; k < 3; ++k)
+      rgb[k] += s.material && !is_emitter(s.material)
+                    ? (float)s.material->diff[k]
+                    : 1.f;
+    hits++;
+  }
+  float brightest = fmaxf(rgb[0], fmaxf(rgb[1], rgb[2]));
+  if (hits == 0 || brightest <= 0)
+    return FRAMEBUFFER_NO_COLOR;
+  uint32_t color = 0;
+  for (int k = 0; k < 3; ++k)
+    color = color << 8 | (uint32_t)(rgb[k] / brightest * level * 255 + 0.5f);
+  return color;
+}
+
+typedef struct frame_job {
+  raycaster *rc;
+  framebuffer *fb;
+  float eye[3];
+  float forward[3];
+  float right[3];
+  float up[3];
+  atomic_int next_row;
+} frame_job;
+
+static void render_row(frame_job *job, int row) {
+  framebuffer *fb = job->fb;
+  float half_height = tanf(RC_VERTICAL_FOV * 0.5f);
+  float half_width = half_height * fb->width * RC_CELL_ASPECT / fb->height;
+  static const float offsets[4][2] = {
+      {0.25f, 0.25f}, {0.75f, 0.25f}, {0.25f, 0.75f}, {0.75f, 0.75f}};
+
+  for (int col = 0; col < fb->width; ++col) {
+    ray_packet p;
+    for (int l = 0; l < 4; ++l) {
+      float sx = ((col + offsets[l][0]) / fb->width * 2 - 1) * half_width;
+      float sy = (1 - (row + offsets[l][1]) / fb->height * 2) * half_height;
+      float d[3];
+      for (int k = 0; k < 3; ++k) {
+        d[k] = job->forward[k] + job->right[k] * sx + job->up[k] * sy;
+        p.o[k][l] = job->eye[k];
+      }
+      normalize(d);
+      for (int k = 0; k < 3; ++k)
+        p.d[k][l] = d[k];
+    }
+    packet_prepare(&p, FLT_MAX);
+    p.active = v4i_set1(-1);
+    v4f value = trace(job->rc, &p, 0);
+    float average = (value[0] + value[1] + value[2] + value[3]) * 0.25f;
+    // a little gamma so dim surfaces still get distinct glyphs
+    float level = sqrtf(average < 0 ? 0 : (average > 1 ? 1 : average));
+    int index = (int)(level * (sizeof(shade_ramp) - 2) + 0.5f);
+    fb->cells[row * fb->width + col] = shade_ramp[index];
+    if (fb->colors != NULL)
+      fb->colors[row * fb->width + col] = cell_color(job->rc, &p, level);
+  }
+}
+
+static void render_rows(frame_job *job) {
+  int row;
+  while ((row = atomic_fetch_add(&job->next_row, 1)) < job->fb->height)
+    render_row(job, row);
+}
+
+// A pool thread: takes its share of rows from every frame raycaster_render
+// publishes, until raycaster_free stops it
+static void *worker_main(void *arg) {
+  raycaster *rc = arg;
+  unsigned seen = 0;
+  pthread_mutex_lock(&rc->lock);
+  for (;;) {
+    while (!rc->stopping && rc->frame == seen)
+      pthread_cond_wait(&rc->wake, &rc->lock);
+    if (rc->stopping)
+      break;
+    seen = rc->frame;
+    frame_job *job = rc->job;
+    pthread_mutex_unlock(&rc->lock);
+    render_rows(job);
+    pthread_mutex_lock(&rc->lock);
+    if (--rc->busy == 0)
+      pthread_cond_signal(&rc->done);
+  }
+  pthread_mutex_unlock(&rc->lock);
+  return NULL;
+}
+
+// Starts threads - 1 workers, the rendering thread being the last one.
+// Fewer start when creating them fails, which only costs speed.
+static void start_workers(raycaster *rc) {
+  pthread_mutex_init(&rc->lock, NULL);
+  pthread_cond_init(&rc->wake, NULL);
+  pthread_cond_init(&rc->done, NULL);
+  rc->pool_started = true;
+  for (int i = 1; i < rc->threads; ++i)
+    if (pthread_create(&rc->workers[rc->worker_count], NULL, worker_main,
+                       rc) == 0)
+      rc->worker_count++;
+}
+
+static void stop_workers(raycaster *rc) {
+  if (!rc->pool_started)
+    return;
+  pthread_mutex_lock(&rc->lock);
+  rc->stopping = true;
+  pthread_cond_broadcast(&rc->wake);
+  pthread_mutex_unlock(&rc->lock);
+  for (int i = 0; i < rc->worker_count; ++i)
+    pthread_join(rc->workers[i], NULL);
+  pthread_cond_destroy(&rc->done);
+  pthread_cond_destroy(&rc->wake);
+  pthread_mutex_destroy(&rc->lock);
+  rc->worker_count = 0;
+  rc->pool_started = false;
+}
+
+static void scene_bounds(const struct obj_scene_data *scene, float *min,
+                         float *max) {
+  for (int k = 0; k < 3; ++k) {
+    min[k] = FLT_MAX;
+    max[k] = -FLT_MAX;
+  }
+  for (int i = 0; i < scene->vertex_count; ++i)
+    for (int k = 0; k < 3; ++k) {
+      float v = (float)scene->vertex_list[i]->e[k];
+      min[k] = v < min[k] ? v : min[k];
+      max[k] = v > max[k] ? v : max[k];
+    }
+  if (scene->vertex_count == 0)
+    for (int k = 0; k < 3; ++k)
+      min[k] = max[k] = 0;
+}
+
+static int add_light(raycaster *rc, const float *position, float intensity) {
+  rc_light *lights =
+      realloc(rc->lights, sizeof(rc_light) * (rc->light_count + 1));
+  if (lights == NULL)
+    return 0;
+  rc->lights = lights;
+  memcpy(lights[rc->light_count].position, position, sizeof(float) * 3);
+  lights[rc->light_count].intensity = intensity;
+  rc->light_count++;
+  return 1;
+}
+
+static float light_intensity(const raycaster *rc, int material_index) {
+  const obj_material *m = material(rc, material_index);
+  if (m == NULL)
+    return 1.f;
+  float value = luminance(m->diff);
+  return value > 1 ? 1 : value;
+}
+
+static int collect_lights(raycaster *rc) {
+  const struct obj_scene_data *scene = rc->scene;
+  float position[3];
+  for (int i = 0; i < scene->light_point_count; ++i) {
+    vertex(scene, scene->light_point_list[i]->pos_index, position);
+    if (!add_light(rc, position,
+                   light_intensity(rc, scene->light_point_list[i]->material_index)))
+      return 0;
+  }
+  for (int i = 0; i < scene->light_disc_count; ++i) {
+    vertex(scene, scene->light_disc_list[i]->pos_index, position);
+    if (!add_light(rc, position,
+                   light_intensity(rc, scene->light_disc_list[i]->material_index)))
+      return 0;
+  }
+  for (int i = 0; i < scene->light_quad_count; ++i) {
+    const obj_light_quad *q = scene->light_quad_list[i];
+    float corner[3] = {0};
+    memset(position, 0, sizeof(position));
+    for (int j = 0; j < MAX_VERTEX_COUNT; ++j) {
+      vertex(scene, q->vertex_index[j], corner);
+      for (int k = 0; k < 3; ++k)
+        position[k] += corner[k] / MAX_VERTEX_COUNT;
+    }
+    if (!add_light(rc, position, light_intensity(rc, q->material_index)))
+      return 0;
+  }
+  for (int f = 0; f < scene->face_count; ++f) {
+    const obj_face *face = scene->face_list[f];
+    if (!is_emitter(material(rc, face->material_index)) ||
+        face->vertex_count == 0)
+      continue;
+    memset(position, 0, sizeof(position));
+    for (int j = 0; j < face->vertex_count; ++j) {
+      float corner[3];
+      vertex(scene, face->vertex_index[j], corner);
+      for (int k = 0; k < 3; ++k)
+        position[k] += corner[k] / face->vertex_count;
+    }
+    if (!add_light(rc, position, 1.f))
+      return 0;
+  }
+  return 1;
+}
+
+static void setup_camera(raycaster *rc) {
+  const struct obj_scene_data *scene = rc->scene;
+  if (scene->camera != NULL) {
+    vertex(scene, scene->camera->camera_pos_index, rc->camera_position);
+    vertex(scene, scene->camera->camera_look_point_index, rc->camera_look);
+    normal(scene, scene->camera->camera_up_norm_index, rc->camera_up, 1.f);
+    return;
+  }
+  float min[3], max[3], extent = 0;
+  scene_bounds(scene, min, max);
+  for (int k = 0; k < 3; ++k) {
+    rc->camera_look[k] = (min[k] + max[k]) * 0.5f;
+    extent = fmaxf(extent, max[k] - min[k]);
+  }
+  rc->camera_position[0] = rc->camera_look[0];
+  rc->camera_position[1] = rc->camera_look[1];
+  rc->camera_position[2] = rc->camera_look[2] - (extent > 0 ? extent : 1) * 2;
+  rc->camera_up[0] = 0;
+  rc->camera_up[1] = 1;
+  rc->camera_up[2] = 0;
+}
+
+int raycaster_init(raycaster *rc, const struct obj_scene_data *scene,
+                   int threads) {
+  memset(rc, 0, sizeof(*rc));
+  rc->scene = scene;
+  rc->threads = threads > 0 ? threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (rc->threads > RC_MAX_THREADS)
+    rc->threads = RC_MAX_THREADS;
+
+  rc->face_first_triangle = malloc(sizeof(int) * (scene->face_count + 1));
+  if (rc->face_first_triangle == NULL)
+    return 0;
+  int triangle_count = 0;
+  for (int f = 0; f < scene->face_count; ++f) {
+    rc->face_first_triangle[f] = triangle_count;
+    int n = scene->face_list[f]->vertex_count;
+    triangle_count += n >= 3 ? n - 2 : 0;
+  }
+  rc->face_first_triangle[scene->face_count] = triangle_count;
+
+  // fan triangulation of every face, precomputed edges for Moller-Trumbore
+  rc->triangles = malloc(sizeof(rc_triangle) * (triangle_count + 1));
+  if (rc->triangles == NULL) {
+    raycaster_free(rc);
+    return 0;
+  }
+  for (int f = 0; f < scene->face_count; ++f) {
+    const obj_face *face = scene->face_list[f];
+    rc_triangle *tri = &rc->triangles[rc->face_first_triangle[f]];
+    for (int j = 1; j + 1 < face->vertex_count; ++j, ++tri) {
+      float b[3], c[3];
+      vertex(scene, face->vertex_index[0], tri->a);
+      vertex(scene, face->vertex_index[j], b);
+      vertex(scene, face->vertex_index[j + 1], c);
+      for (int k = 0; k < 3; ++k) {
+        tri->e1[k] = b[k] - tri->a[k];
+        tri->e2[k] = c[k] - tri->a[k];
+      }
+      tri->face = f;
+    }
+  }
+
+  if (!bvh_build(&rc->faces_bvh, scene, rc->threads) ||
+      !mesh_normals_compute(&rc->normals, scene, rc->threads) ||
+      !collect_lights(rc)) {
+    raycaster_free(rc);
+    return 0;
+  }
+  setup_camera(rc);
+  if (rc->light_count == 0) {
+    // nothing to light the scene with, use a lamp at the camera
+    add_light(rc, rc->camera_position, 1.f);
+  }
+  start_workers(rc);
+  return 1;
+}
+
+void raycaster_free(raycaster *rc) {
+  stop_workers(rc);
+  bvh_free(&rc->faces_bvh);
+  mesh_normals_free(&rc->normals);
+  free(rc->triangles);
+  free(rc->face_first_triangle);
+  free(rc->lights);
+  rc->triangles = NULL;
+  rc->face_first_triangle = NULL;
+  rc->lights = NULL;
+  rc->light_count = 0;
+}
+
+void raycaster_render(raycaster *rc, framebuffer *fb, float angle) {
+  frame_job job;
+  job.rc = rc;
+  job.fb = fb;
+  atomic_init(&job.next_row, 0);
+
+  // orbit the eye around the target, about the camera's up axis
+  float up[3], offset[3];
+  memcpy(up, rc->camera_up, sizeof(up));
+  normalize(up);
+  for (int k = 0; k < 3; ++k)
+    offset[k] = rc->camera_position[k] - rc->camera_look[k];
+  float c = cosf(angle), s = sinf(angle), cross_up[3];
+  cross(up, offset, cross_up);
+  float along = dot(up, offset);
+  for (int k = 0; k < 3; ++k) {
+    // Rodrigues' rotation formula
+    float rotated = offset[k] * c + cross_up[k] * s + up[k] * along * (1 - c);
+    job.eye[k] = rc->camera_look[k] + rotated;
+    job.forward[k] = -rotated;
+  }
+  normalize(job.forward);
+  cross(job.forward, up, job.right);
+  normalize(job.right);
+  cross(job.right, job.forward, job.up);
+
+  // wake the pool, render alongside it, and wait for its last rows
+  pthread_mutex_lock(&rc->lock);
+  rc->job = &job;
+  rc->busy = rc->worker_count;
+  rc->frame++;
+  pthread_cond_broadcast(&rc->wake);
+  pthread_mutex_unlock(&rc->lock);
+  render_rows(&job);
+  pthread_mutex_lock(&rc->lock);
+  while (rc->busy > 0)
+    pthread_cond_wait(&rc->done, &rc->lock);
+  pthread_mutex_unlock(&rc->lock);
+}
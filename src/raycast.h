@@ -0,0 +1,69 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include "bvh.h"
+#include "framebuffer.h"
+#include "normals.h"
+#include "obj_parser.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+// Ray-cast renderer for the parser's raytracing extensions: faces, spheres
+// (sp), planes (pl), point/disc/quad lights (lp, ld, lq) and the camera (c),
+// shaded with the materials' diffuse, specular and reflection terms. Faces
+// whose diffuse colour exceeds 1 (e.g. the Cornell box lamp) are treated as
+// emitters and also light the scene from their centre.
+//
+// Each terminal cell is sampled with a 2x2 packet of rays that is traced
+// together with 4-wide vector operations; rows are handed out to a pool of
+// threads started once by raycaster_init.
+
+#define RC_MAX_THREADS 64
+
+typedef struct rc_triangle {
+  float a[3];
+  float e1[3];
+  float e2[3];
+  int face;
+} rc_triangle;
+
+typedef struct rc_light {
+  float position[3];
+  float intensity;
+} rc_light;
+
+typedef struct raycaster {
+  const struct obj_scene_data *scene;
+  bvh faces_bvh;
+  mesh_normals normals;
+  rc_triangle *triangles;
+  int *face_first_triangle; // triangles of face f are [first[f], first[f+1])
+  rc_light *lights;
+  int light_count;
+  float camera_position[3];
+  float camera_look[3];
+  float camera_up[3];
+  int threads;
+  // the worker pool, woken once per frame
+  pthread_t workers[RC_MAX_THREADS];
+  int worker_count;
+  bool pool_started;
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // a new frame, or stopping
+  pthread_cond_t done; // the last busy worker finished
+  struct frame_job *job;
+  unsigned frame;
+  int busy; // workers still rendering the current frame
+  bool stopping;
+} raycaster;
+
+// Prepares triangles, the BVH and the light list, and starts the worker
+// threads. The scene must outlive the raycaster, which must not be moved or
+// copied until raycaster_free. threads = 0 uses every CPU.
+int raycaster_init(raycaster *rc, const struct obj_scene_data *scene,
+                   int threads);
+void raycaster_free(raycaster *rc);
+// Renders one frame with the camera orbited by `angle` around its target
+void raycaster_render(raycaster *rc, framebuffer *fb, float angle);
+
+#endif
@@ -0,0 +1,436 @@
+#include "recording.h"
+#include "terminal.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char RECORDING_MAGIC[6] = {'O', 'B', 'J', 'R', 'E', 'C'};
+#define RECORDING_VERSION 1
+// magic, version, mode, colour mode, 16-bit width and height
+#define RECORDING_HEADER_BYTES 13
+#define RECORD_KEYFRAME 0x01
+// a varint of up to 64 bits
+#define MAX_VARINT_BYTES 10
+// repeats shorter than this are cheaper to store literally
+#define MIN_REPEAT 3
+// unchanged stretches shorter than this are cheaper to store again
+#define MIN_SKIP 2
+
+static uint8_t *put_varint(uint8_t *out, uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = (uint8_t)value;
+  return out;
+}
+
+// Reads a varint from [*in, end), returns 0 when it runs past the end
+static int get_varint(const uint8_t **in, const uint8_t *end,
+                      uint64_t *value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *in < end; shift += 7) {
+    uint8_t byte = *(*in)++;
+    *value |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return 1;
+  }
+  return 0;
+}
+
+// One plane of a frame: glyphs (one byte per cell) or colours (four bytes
+// per cell, stored little-endian)
+typedef struct plane {
+  const uint8_t *glyphs;
+  const uint32_t *colors;
+} plane;
+
+static bool unit_equal(plane a, size_t i, plane b, size_t j) {
+  return a.glyphs ? a.glyphs[i] == b.glyphs[j] : a.colors[i] == b.colors[j];
+}
+
+static uint8_t *put_unit(uint8_t *out, plane p, size_t i) {
+  if (p.glyphs) {
+    *out++ = p.glyphs[i];
+    return out;
+  }
+  for (int shift = 0; shift < 32; shift += 8)
+    *out++ = (uint8_t)(p.colors[i] >> shift);
+  return out;
+}
+
+// Most bytes encode_plane writes for `count` units of `unit` bytes: in the
+// worst case every changed unit starts a block of its own
+static size_t max_plane_bytes(size_t count, size_t unit) {
+  return count * (unit + 2 * MAX_VARINT_BYTES) + MAX_VARINT_BYTES;
+}
+
+// Writes cur as a list of blocks, each a skip over units equal to prev,
+// then a header of (length << 1 | repeated) and the units' values, one
+// value for a repeat
+static uint8_t *encode_plane(plane cur, plane prev, size_t count,
+                             uint8_t *out) {
+  size_t pos = 0;
+  while (pos < count) {
+    size_t skip = 0;
+    while (pos + skip < count && unit_equal(cur, pos + skip, prev, pos + skip))
+      ++skip;
+    out = put_varint(out, skip);
+    pos += skip;
+    if (pos == count)
+      break;
+
+    size_t repeat = 1;
+    while (pos + repeat < count && unit_equal(cur, pos + repeat, cur, pos))
+      ++repeat;
+    if (repeat >= MIN_REPEAT) {
+      out = put_varint(out, (uint64_t)repeat << 1 | 1);
+      out = put_unit(out, cur, pos);
+      pos += repeat;
+      continue;
+    }
+    // a literal block runs until a stretch worth skipping or repeating
+    size_t end = pos + 1;
+    while (end < count) {
+      size_t same = 0;
+      while (end + same < count && same < MIN_SKIP &&
+             unit_equal(cur, end + same, prev, end + same))
+        ++same;
+      if (same >= MIN_SKIP || end + same == count)
+        break;
+      size_t run = 1;
+      while (end + run < count && run < MIN_REPEAT &&
+             unit_equal(cur, end + run, cur, end))
+        ++run;
+      if (run >= MIN_REPEAT)
+        break;
+      ++end;
+    }
+    out = put_varint(out, (uint64_t)(end - pos) << 1);
+    for (; pos < end; ++pos)
+      out = put_unit(out, cur, pos);
+  }
+  return out;
+}
+
+// Applies a plane written by encode_plane to `glyphs` or `colors`. Returns
+// 0 for data that does not fit the plane.
+static int decode_plane(const uint8_t **in, const uint8_t *end,
+                        uint8_t *glyphs, uint32_t *colors, size_t count) {
+  size_t unit = glyphs ? 1 : 4;
+  size_t pos = 0;
+  while (pos < count) {
+    uint64_t skip, header;
+    if (!get_varint(in, end, &skip) || skip > count - pos)
+      return 0;
+    pos += skip;
+    if (pos == count)
+      break;
+    if (!get_varint(in, end, &header))
+      return 0;
+    uint64_t length = header >> 1;
+    bool repeated = header & 1;
+    size_t stored = repeated ? 1 : length;
+    if (length == 0 || length > count - pos ||
+        (size_t)(end - *in) < stored * unit)
+      return 0;
+    for (uint64_t i = 0; i < length; ++i, ++pos) {
+      const uint8_t *value = *in + (repeated ? 0 : i * unit);
+      if (glyphs)
+        glyphs[pos] = value[0];
+      else
+        colors[pos] = (uint32_t)value[0] | (uint32_t)value[1] << 8 |
+                      (uint32_t)value[2] << 16 | (uint32_t)value[3] << 24;
+    }
+    *in += stored * unit;
+  }
+  return 1;
+}
+
+static uint8_t *frame_glyphs(const framebuffer *fb) {
+  return fb->mode == FRAMEBUFFER_ASCII ? (uint8_t *)fb->cells : fb->dots;
+}
+
+int recording_writer_open(recording_writer *w, const char *path,
+                          const framebuffer *fb) {
+  memset(w, 0, sizeof(*w));
+  w->file = fopen(path, "wb");
+  if (w->file == NULL) {
+    fprintf(stderr, "Could not create recording %s\n", path);
+    return 0;
+  }
+  w->mode = fb->mode;
+  w->color_mode = fb->color_mode;
+  uint8_t header[RECORDING_HEADER_BYTES];
+  memcpy(header, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+  header[6] = RECORDING_VERSION;
+  header[7] = (uint8_t)fb->mode;
+  header[8] = (uint8_t)fb->color_mode;
+  header[9] = (uint8_t)fb->width;
+  header[10] = (uint8_t)(fb->width >> 8);
+  header[11] = (uint8_t)fb->height;
+  header[12] = (uint8_t)(fb->height >> 8);
+  if (fwrite(header, sizeof(header), 1, w->file) != 1) {
+    fclose(w->file);
+    return 0;
+  }
+  w->bytes = sizeof(header);
+  return 1;
+}
+
+static int add_frame(recording_writer *w, const framebuffer *fb,
+                     double seconds) {
+  size_t count = (size_t)fb->width * (size_t)fb->height;
+  bool keyframe = fb->width != w->width || fb->height != w->height ||
+                  w->frames_since_keyframe >= RECORDING_KEYFRAME_INTERVAL;
+  if (count > w->cell_capacity) {
+    uint8_t *glyphs = realloc(w->glyphs, count);
+    if (glyphs == NULL)
+      return 0;
+    w->glyphs = glyphs;
+    if (fb->colors != NULL) {
+      uint32_t *colors = realloc(w->colors, count * sizeof(uint32_t));
+      if (colors == NULL)
+        return 0;
+      w->colors = colors;
+    }
+    w->cell_capacity = count;
+  }
+  size_t needed = max_plane_bytes(count, 1) +
+                  (fb->colors ? max_plane_bytes(count, 4) : 0);
+  if (needed > w->payload_capacity) {
+    uint8_t *payload = realloc(w->payload, needed);
+    if (payload == NULL)
+      return 0;
+    w->payload = payload;
+    w->payload_capacity = needed;
+  }
+  // keyframes are stored against an empty frame
+  if (keyframe) {
+    memset(w->glyphs, 0, count);
+    if (fb->colors != NULL)
+      memset(w->colors, 0, count * sizeof(uint32_t));
+    w->frames_since_keyframe = 0;
+  }
+
+  const uint8_t *glyphs = frame_glyphs(fb);
+  uint8_t *end = encode_plane((plane){glyphs, NULL},
+                              (plane){w->glyphs, NULL}, count, w->payload);
+  if (fb->colors != NULL)
+    end = encode_plane((plane){NULL, fb->colors}, (plane){NULL, w->colors},
+                       count, end);
+  size_t payload_size = (size_t)(end - w->payload);
+
+  long long micros = llround(seconds * 1e6);
+  uint64_t delta = micros > w->last_micros ? (uint64_t)(micros - w->last_micros)
+                                           : 0;
+  uint8_t header[1 + 4 * MAX_VARINT_BYTES];
+  uint8_t *h = header;
+  *h++ = keyframe ? RECORD_KEYFRAME : 0;
+  h = put_varint(h, delta);
+  h = put_varint(h, (uint64_t)fb->width);
+  h = put_varint(h, (uint64_t)fb->height);
+  h = put_varint(h, payload_size);
+  if (fwrite(header, (size_t)(h - header), 1, w->file) != 1 ||
+      (payload_size > 0 &&
+       fwrite(w->payload, payload_size, 1, w->file) != 1))
+    return 0;
+
+  memcpy(w->glyphs, glyphs, count);
+  if (fb->colors != NULL)
+    memcpy(w->colors, fb->colors, count * sizeof(uint32_t));
+  w->width = fb->width;
+  w->height = fb->height;
+  w->last_micros = micros > w->last_micros ? micros : w->last_micros;
+  w->frames_since_keyframe++;
+  w->frames++;
+  w->bytes += (long long)(h - header) + (long long)payload_size;
+  return 1;
+}
+
+int recording_writer_add(recording_writer *w, const framebuffer *fb,
+                         double seconds) {
+  if (w->failed || !add_frame(w, fb, seconds))
+    w->failed = true;
+  return !w->failed;
+}
+
+int recording_writer_close(recording_writer *w) {
+  int ok = w->file != NULL && fclose(w->file) == 0 && !w->failed;
+  free(w->glyphs);
+  free(w->colors);
+  free(w->payload);
+  w->file = NULL;
+  w->glyphs = NULL;
+  w->colors = NULL;
+  w->payload = NULL;
+  return ok;
+}
+
+int recording_open(recording *r, const char *path) {
+  memset(r, 0, sizeof(*r));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Could not open recording %s\n", path);
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < RECORDING_HEADER_BYTES) {
+    fprintf(stderr, "%s is not a recording\n", path);
+    close(fd);
+    return 0;
+  }
+  void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Could not map recording %s\n", path);
+    return 0;
+  }
+  // playback reads each record once, front to back
+  madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+  r->data = data;
+  r->size = (size_t)st.st_size;
+
+  const uint8_t *h = r->data;
+  if (memcmp(h, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 ||
+      h[6] != RECORDING_VERSION || h[7] > FRAMEBUFFER_BLOCKS ||
+      h[8] > FRAMEBUFFER_TRUECOLOR) {
+    fprintf(stderr, "%s is not a recording of this version\n", path);
+    recording_close(r);
+    return 0;
+  }
+  r->mode = (framebuffer_mode)h[7];
+  r->color_mode = (framebuffer_color)h[8];
+  r->width = h[9] | h[10] << 8;
+  r->height = h[11] | h[12] << 8;
+  r->offset = RECORDING_HEADER_BYTES;
+  return 1;
+}
+
+void recording_close(recording *r) {
+  if (r->data != NULL)
+    munmap((void *)r->data, r->size);
+  r->data = NULL;
+  r->size = 0;
+}
+
+int recording_framebuffer(const recording *r, framebuffer *fb) {
+  if (!framebuffer_init(fb, r->width > 0 ? r->width : 1,
+                        r->height > 0 ? r->height : 1))
+    return 0;
+  if (!framebuffer_set_mode(fb, r->mode) ||
+      !framebuffer_set_color(fb, r->color_mode)) {
+    framebuffer_free(fb);
+    return 0;
+  }
+  framebuffer_clear(fb, ' ');
+  return 1;
+}
+
+void recording_rewind(recording *r) {
+  r->offset = RECORDING_HEADER_BYTES;
+  r->elapsed_micros = 0;
+}
+
+int recording_next(recording *r, framebuffer *fb, double *seconds) {
+  if (r->offset >= r->size)
+    return 0;
+  const uint8_t *in = r->data + r->offset;
+  const uint8_t *end = r->data + r->size;
+  uint8_t flags = *in++;
+  uint64_t delta, width, height, payload_size;
+  if (!get_varint(&in, end, &delta) || !get_varint(&in, end, &width) ||
+      !get_varint(&in, end, &height) || !get_varint(&in, end, &payload_size) ||
+      width == 0 || height == 0 || width > 0xFFFF || height > 0xFFFF ||
+      payload_size > (uint64_t)(end - in))
+    return -1;
+
+  bool keyframe = flags & RECORD_KEYFRAME;
+  if ((int)width != fb->width || (int)height != fb->height) {
+    // only a keyframe can change the size
+    if (!keyframe || !framebuffer_resize(fb, (int)width, (int)height))
+      return -1;
+  }
+  size_t count = (size_t)width * (size_t)height;
+  uint8_t *glyphs = frame_glyphs(fb);
+  if (keyframe) {
+    memset(glyphs, 0, count);
+    if (fb->colors != NULL)
+      memset(fb->colors, 0, count * sizeof(uint32_t));
+  }
+  const uint8_t *payload_end = in + payload_size;
+  if (!decode_plane(&in, payload_end, glyphs, NULL, count) ||
+      (fb->colors != NULL &&
+       !decode_plane(&in, payload_end, NULL, fb->colors, count)))
+    return -1;
+
+  r->offset = (size_t)(payload_end - r->data);
+  r->elapsed_micros += delta;
+  *seconds = (double)r->elapsed_micros * 1e-6;
+  return 1;
+}
+
+// JSON string contents: escapes quotes, backslashes and control characters,
+// the UTF-8 of the sub-cell glyphs passes through
+static void write_json_string(FILE *out, const char *data, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = (unsigned char)data[i];
+    if (c == '"' || c == '\\')
+      fprintf(out, "\\%c", c);
+    else if (c < 0x20 || c == 0x7F)
+      fprintf(out, "\\u%04x", c);
+    else
+      fputc(c, out);
+  }
+}
+
+int recording_export_cast(recording *r, const char *path) {
+  FILE *out = fopen(path, "w");
+  if (out == NULL) {
+    fprintf(stderr, "Could not create %s\n", path);
+    return 0;
+  }
+  framebuffer fb;
+  if (!recording_framebuffer(r, &fb)) {
+    fclose(out);
+    return 0;
+  }
+  terminal_output encoder;
+  terminal_output_init(&encoder, -1);
+  fprintf(out, "{\"version\": 2, \"width\": %d, \"height\": %d}\n", r->width,
+          r->height);
+
+  recording_rewind(r);
+  int width = r->width, height = r->height;
+  int status;
+  double seconds;
+  while ((status = recording_next(r, &fb, &seconds)) > 0) {
+    if (fb.width != width || fb.height != height) {
+      width = fb.width;
+      height = fb.height;
+      fprintf(out, "[%.6f, \"r\", \"%dx%d\"]\n", seconds, width, height);
+      encoder.clear_next = true;
+    }
+    size_t length;
+    if (!terminal_output_encode(&encoder, &fb, fb.height, fb.width,
+                                &length)) {
+      status = -1;
+      break;
+    }
+    if (length == 0)
+      continue;
+    fprintf(out, "[%.6f, \"o\", \"", seconds);
+    write_json_string(out, encoder.buffer, length);
+    fputs("\"]\n", out);
+  }
+  terminal_output_free(&encoder);
+  framebuffer_free(&fb);
+  if (status < 0)
+    fprintf(stderr, "Recording is corrupt\n");
+  return fclose(out) == 0 && status == 0;
+}
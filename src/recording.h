@@ -0,0 +1,74 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include "framebuffer.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A recording is a header followed by one record per frame. Each record
+// holds the time since the previous frame, the frame size, and the cells
+// that differ from the previous frame: runs of unchanged cells are skipped,
+// changed cells are stored literally or as a repeated value. Every
+// RECORDING_KEYFRAME_INTERVAL frames, and whenever the size changes, a
+// keyframe is stored against an empty frame so playback can start there.
+#define RECORDING_KEYFRAME_INTERVAL 100
+// time between frames rendered off-line, the interactive frame interval
+#define RECORDING_FRAME_SECONDS 0.05
+
+typedef struct recording_writer {
+  FILE *file;
+  framebuffer_mode mode;
+  framebuffer_color color_mode;
+  // the previous frame: one glyph per cell (character or dots) and, in
+  // the colour modes, one colour per cell
+  uint8_t *glyphs;
+  uint32_t *colors;
+  size_t cell_capacity;
+  int width;
+  int height;
+  uint8_t *payload; // one encoded frame
+  size_t payload_capacity;
+  int frames_since_keyframe;
+  long long last_micros; // when the previous frame was shown
+  long long frames;
+  long long bytes;
+  bool failed; // a frame could not be written
+} recording_writer;
+
+// Creates `path` for frames in fb's mode and colour mode. Returns 0 and
+// prints why on failure.
+int recording_writer_open(recording_writer *w, const char *path,
+                          const framebuffer *fb);
+// Appends fb as shown `seconds` after the recording started
+int recording_writer_add(recording_writer *w, const framebuffer *fb,
+                         double seconds);
+// Flushes and closes the file, returns 0 if any frame failed to write
+int recording_writer_close(recording_writer *w);
+
+// A recording mapped into memory for playback
+typedef struct recording {
+  const uint8_t *data;
+  size_t size;
+  size_t offset; // of the next record
+  uint64_t elapsed_micros; // when the last frame read was shown
+  framebuffer_mode mode;
+  framebuffer_color color_mode;
+  int width; // of the first frame
+  int height;
+} recording;
+
+// Maps `path` and checks its header. Returns 0 and prints why on failure.
+int recording_open(recording *r, const char *path);
+void recording_close(recording *r);
+// Sets up fb for the recording's frames
+int recording_framebuffer(const recording *r, framebuffer *fb);
+// Applies the next frame to fb, resizing it as recorded, and stores when it
+// was shown. Returns 1, 0 after the last frame, or -1 for corrupt data.
+int recording_next(recording *r, framebuffer *fb, double *seconds);
+void recording_rewind(recording *r);
+// Writes the whole recording as an asciicast v2 file. Returns 0 on failure.
+int recording_export_cast(recording *r, const char *path);
+
+#endif
@@ -0,0 +1,337 @@
+#include "render.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+const char BACKGROUND_CHAR = '.';
+const char LINE_CHAR = RENDER_LINE_CHAR;
+const float MAX_DISTANCE_FROM_LINE = RENDER_MAX_DISTANCE_FROM_LINE;
+const float MODEL_DISTANCE = 1.5f;
+
+/*    .+------+     */
+/* .'  |    .'|    */
+/* +---+--+'  |   */
+/* |   |  |   |   */
+/* |  ,+--+---+   */
+/* |.'    | .'    */
+/* +------+'      */
+
+bool is_point_part_of_line(int starty, int startx, int endy, int endx,
+                           int pointy, int pointx) {
+  // early return if point is outside the rectangle defined by start and end
+  if (!(((pointy <= endy) && (pointy >= starty)) ||
+        ((pointy >= endy) && (pointy <= starty))))
+    return false;
+  if (!(((pointx <= endx) && (pointx >= startx)) ||
+        ((pointx >= endx) && (pointx <= startx))))
+    return false;
+
+  float length = sqrt((startx - endx) * (startx - endx) +
+                      (starty - endy) * (starty - endy));
+
+  float twice_area =
+      fabsf((float)((endy - starty) * pointx - (endx - startx) * pointy +
+                    endx * starty - endy * startx));
+
+  float distance = twice_area / length;
+
+  return distance < MAX_DISTANCE_FROM_LINE ? true : false;
+}
+
+int clamp_to_screen(const int coord, const int min, const int max) {
+  int clamped_coord = coord;
+  if (coord < min)
+    clamped_coord = 0;
+  if (coord > max)
+    clamped_coord = max;
+  return clamped_coord;
+}
+
+void draw_line(framebuffer *fb, int starty, int startx, int endy, int endx) {
+  starty = clamp_to_screen(starty, 0, fb->height);
+  startx = clamp_to_screen(startx, 0, fb->width);
+  endy = clamp_to_screen(endy, 0, fb->height);
+  endx = clamp_to_screen(endx, 0, fb->width);
+  for (int row = 0; row < fb->height; ++row) {
+    for (int col = 0; col < fb->width; ++col) {
+      if (is_point_part_of_line(starty, startx, endy, endx, row, col)) {
+        fb->cells[row * fb->width + col] = LINE_CHAR;
+        framebuffer_paint(fb, row * fb->width + col);
+      }
+    }
+  }
+}
+
+void draw_line_by_vec3(framebuffer *fb, vec3 start, vec3 end) {
+  draw_line(fb, start.y, start.x, end.y, end.x);
+}
+
+void draw_line_by_obj_vector(framebuffer *fb, struct obj_vector start,
+                             struct obj_vector end) {
+  draw_line(fb, start.e[1], start.e[0], end.e[1], end.e[0]);
+}
+
+void draw_dot_line(framebuffer *fb, float x0, float y0, float x1, float y1) {
+  dot_span span;
+  if (!clip_dot_line(x0, y0, x1, y1, framebuffer_raster_width(fb),
+                     framebuffer_raster_height(fb), &span))
+    return;
+  for (int i = 0; i <= span.steps; ++i)
+    framebuffer_put_dot(fb, (int)(span.sx + span.stepx * i + 0.5f),
+                        (int)(span.sy + span.stepy * i + 0.5f));
+}
+
+uint32_t material_color(const struct obj_scene_data *model,
+                        int material_index) {
+  if (material_index < 0 || material_index >= model->material_count)
+    return FRAMEBUFFER_NO_COLOR;
+  const double *diff = model->material_list[material_index]->diff;
+  double brightest = fmax(diff[0], fmax(diff[1], diff[2]));
+  if (brightest <= 0)
+    return FRAMEBUFFER_NO_COLOR;
+  uint32_t color = 0;
+  for (int k = 0; k < 3; ++k)
+    color = color << 8 | (uint32_t)(diff[k] / brightest * 255 + 0.5);
+  return color;
+}
+
+static void draw_face(framebuffer *fb, const struct obj_scene_data *model,
+                      const struct obj_face *face,
+                      struct obj_vector *projected_vertices) {
+  if (fb->colors != NULL)
+    fb->pen = material_color(model, face->material_index);
+  for (int32_t j = 0; j < face->vertex_count; ++j) {
+    struct obj_vector start = projected_vertices[face->vertex_index[j]];
+    struct obj_vector end =
+        projected_vertices[face->vertex_index[(j + 1) % face->vertex_count]];
+    if (fb->mode == FRAMEBUFFER_ASCII)
+      draw_line_by_obj_vector(fb, start, end);
+    else
+      draw_dot_line(fb, (float)start.e[0], (float)start.e[1],
+                    (float)end.e[0], (float)end.e[1]);
+  }
+}
+
+void draw_face_list(framebuffer *fb, const struct obj_scene_data *model,
+                    struct obj_vector *projected_vertices,
+                    const int32_t *faces, int face_count) {
+  for (int i = 0; i < face_count; ++i)
+    draw_face(fb, model, model->face_list[faces[i]], projected_vertices);
+}
+
+void draw_faces(framebuffer *fb, const struct obj_scene_data *model,
+                struct obj_vector *projected_vertices) {
+  for (int32_t i = 0; i < model->face_count; ++i)
+    draw_face(fb, model, model->face_list[i], projected_vertices);
+}
+
+// glyphs from dark to bright, as in the ray caster
+static const char texture_ramp[] = " .:-=+*#%@";
+// triangles closer than this to the camera are not filled
+#define TEXTURE_NEAR_Z 0.01f
+
+typedef struct raster_vertex {
+  float x, y; // cells
+  float w;    // 1 / z, which interpolates linearly across the screen
+  float u, v; // texture coordinates divided by z
+} raster_vertex;
+
+static float edge(const raster_vertex *a, const raster_vertex *b, float x,
+                  float y) {
+  return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+// Mip level whose texels best match the triangle's cells
+static int triangle_level(const texture *t, float uv[3][2], float cells) {
+  float du1 = uv[1][0] - uv[0][0], dv1 = uv[1][1] - uv[0][1];
+  float du2 = uv[2][0] - uv[0][0], dv2 = uv[2][1] - uv[0][1];
+  float texels = fabsf(du1 * dv2 - du2 * dv1) * 0.5f * t->width * t->height;
+  if (cells <= 0 || texels <= cells)
+    return 0;
+  int level = (int)(0.5f * log2f(texels / cells));
+  return level < t->levels ? level : t->levels - 1;
+}
+
+static void fill_triangle(framebuffer *fb, float *depth, raster_vertex v[3],
+                          const texture *t, float uv[3][2], uint8_t flat) {
+  float area = edge(&v[0], &v[1], v[2].x, v[2].y);
+  if (fabsf(area) < 1e-6f)
+    return;
+  int level = t != NULL ? triangle_level(t, uv, fabsf(area) * 0.5f) : 0;
+  float min_x = fminf(v[0].x, fminf(v[1].x, v[2].x));
+  float max_x = fmaxf(v[0].x, fmaxf(v[1].x, v[2].x));
+  float min_y = fminf(v[0].y, fminf(v[1].y, v[2].y));
+  float max_y = fmaxf(v[0].y, fmaxf(v[1].y, v[2].y));
+  int col0 = min_x < 0 ? 0 : (int)min_x;
+  int row0 = min_y < 0 ? 0 : (int)min_y;
+  int col1 = max_x > fb->width - 1 ? fb->width - 1 : (int)max_x;
+  int row1 = max_y > fb->height - 1 ? fb->height - 1 : (int)max_y;
+  for (int row = row0; row <= row1; ++row) {
+    float y = row + 0.5f;
+    for (int col = col0; col <= col1; ++col) {
+      float x = col + 0.5f;
+      // barycentric weights, positive inside for either winding
+      float b0 = edge(&v[1], &v[2], x, y) / area;
+      float b1 = edge(&v[2], &v[0], x, y) / area;
+      float b2 = 1 - b0 - b1;
+      if (b0 < 0 || b1 < 0 || b2 < 0)
+        continue;
+      float w = b0 * v[0].w + b1 * v[1].w + b2 * v[2].w;
+      int cell = row * fb->width + col;
+      if (w <= depth[cell])
+        continue;
+      depth[cell] = w;
+      uint8_t luma = flat;
+      if (t != NULL) {
+        float u = (b0 * v[0].u + b1 * v[1].u + b2 * v[2].u) / w;
+        float tv = (b0 * v[0].v + b1 * v[1].v + b2 * v[2].v) / w;
+        if (isfinite(u) && isfinite(tv) && fabsf(u) < 1e6f &&
+            fabsf(tv) < 1e6f)
+          luma = texture_sample(t, level, u, tv);
+      }
+      fb->cells[cell] =
+          texture_ramp[(luma * (sizeof(texture_ramp) - 2) + 127) / 255];
+      framebuffer_paint(fb, cell);
+    }
+  }
+}
+
+static void fill_face(framebuffer *fb, const struct obj_scene_data *model,
+                      const texture_set *textures, const obj_face *face,
+                      float *depth) {
+  int n = face->vertex_count;
+  if (n < 3)
+    return;
+  float width = (float)fb->width, height = (float)fb->height;
+  raster_vertex v[MAX_VERTEX_COUNT];
+  float uv[MAX_VERTEX_COUNT][2];
+  const texture *t =
+      textures != NULL ? texture_set_get(textures, face->material_index) : NULL;
+  for (int j = 0; j < n; ++j) {
+    int vi = face->vertex_index[j];
+    if (vi < 0 || vi >= model->vertex_count)
+      return;
+    const double *p = model->vertex_list[vi]->e;
+    if (p[2] < TEXTURE_NEAR_Z)
+      return;
+    v[j].w = 1.f / (float)p[2];
+    v[j].x = (float)p[0] * v[j].w * width + width / 2;
+    v[j].y = (float)p[1] * v[j].w * height + height / 2;
+    int ti = face->texture_index[j];
+    if (ti < 0 || ti >= model->vertex_texture_count) {
+      t = NULL;
+    } else {
+      uv[j][0] = (float)model->vertex_texture_list[ti]->e[0];
+      uv[j][1] = (float)model->vertex_texture_list[ti]->e[1];
+    }
+  }
+  uint8_t flat = 204;
+  if (face->material_index >= 0 &&
+      face->material_index < model->material_count) {
+    const double *diff = model->material_list[face->material_index]->diff;
+    double luma = 0.299 * diff[0] + 0.587 * diff[1] + 0.114 * diff[2];
+    flat = (uint8_t)(luma < 0 ? 0 : luma > 1 ? 255 : luma * 255 + 0.5);
+  }
+  for (int j = 0; j < n && t != NULL; ++j) {
+    v[j].u = uv[j][0] * v[j].w;
+    v[j].v = uv[j][1] * v[j].w;
+  }
+  if (fb->colors != NULL)
+    fb->pen = material_color(model, face->material_index);
+  // a fan of triangles, which covers the triangles and quads OBJ files hold
+  for (int j = 1; j + 1 < n; ++j) {
+    raster_vertex tri[3] = {v[0], v[j], v[j + 1]};
+    float tri_uv[3][2] = {{0, 0}, {0, 0}, {0, 0}};
+    if (t != NULL) {
+      memcpy(tri_uv[0], uv[0], sizeof(uv[0]));
+      memcpy(tri_uv[1], uv[j], sizeof(uv[0]));
+      memcpy(tri_uv[2], uv[j + 1], sizeof(uv[0]));
+    }
+    fill_triangle(fb, depth, tri, t, tri_uv, flat);
+  }
+}
+
+void draw_textured_faces(framebuffer *fb, const struct obj_scene_data *model,
+                         const texture_set *textures, const int32_t *faces,
+                         int face_count, float *depth) {
+  for (int i = 0; i < fb->width * fb->height; ++i)
+    depth[i] = 0;
+  if (faces == NULL) {
+    for (int32_t i = 0; i < model->face_count; ++i)
+      fill_face(fb, model, textures, model->face_list[i], depth);
+  } else {
+    for (int i = 0; i < face_count; ++i)
+      fill_face(fb, model, textures, model->face_list[faces[i]], depth);
+  }
+}
+
+// Rotation matrix (combined yaw-pitch-roll, ZYX order)
+void rotation_matrix(float R[3][3], float yaw, float pitch, float roll) {
+  float cy = cosf(yaw);
+  float sy = sinf(yaw);
+  float cp = cosf(pitch);
+  float sp = sinf(pitch);
+  float cr = cosf(roll);
+  float sr = sinf(roll);
+
+  R[0][0] = cy * cp;
+  R[0][1] = cy * sp * sr - sy * cr;
+  R[0][2] = cy * sp * cr + sy * sr;
+  R[1][0] = sy * cp;
+  R[1][1] = sy * sp * sr + cy * cr;
+  R[1][2] = sy * sp * cr - cy * sr;
+  R[2][0] = -sp;
+  R[2][1] = cp * sr;
+  R[2][2] = cp * cr;
+}
+
+// Applies yaw (Z), pitch (Y), roll (X) rotation to a point
+void rotate(vec3 *point, float yaw, float pitch, float roll) {
+  float R[3][3];
+  rotation_matrix(R, yaw, pitch, roll);
+
+  // Original point
+  float x = point->x;
+  float y = point->y;
+  float z = point->z;
+
+  // Apply rotation
+  point->x = R[0][0] * x + R[0][1] * y + R[0][2] * z;
+  point->y = R[1][0] * x + R[1][1] * y + R[1][2] * z;
+  point->z = R[2][0] * x + R[2][1] * y + R[2][2] * z;
+}
+
+void transform_model(const struct obj_scene_data *src,
+                     struct obj_scene_data *dst, float R[3][3],
+                     float distance) {
+  for (int32_t k = 0; k < src->vertex_count; ++k) {
+    const double *p = src->vertex_list[k]->e;
+    float x = (float)p[0], y = (float)p[1], z = (float)p[2];
+    double *out = dst->vertex_list[k]->e;
+    out[0] = R[0][0] * x + R[0][1] * y + R[0][2] * z;
+    out[1] = R[1][0] * x + R[1][1] * y + R[1][2] * z;
+    out[2] = R[2][0] * x + R[2][1] * y + R[2][2] * z + distance;
+  }
+}
+
+void project_vertices(const struct obj_scene_data *model,
+                      struct obj_vector *projected_vertices, int width,
+                      int height) {
+  for (int32_t i = 0; i < model->vertex_count; ++i) {
+    /* https://computergraphics.stackexchange.com/questions/8255/finding-the-projection-matrix-for-one-point-perspective
+     */
+    projected_vertices[i].e[0] =
+        model->vertex_list[i]->e[0] / model->vertex_list[i]->e[2];
+    projected_vertices[i].e[1] =
+        model->vertex_list[i]->e[1] / model->vertex_list[i]->e[2];
+    // potential error handling
+    if (projected_vertices[i].e[0] < -1 || projected_vertices[i].e[0] > 1 ||
+        projected_vertices[i].e[1] < -1 || projected_vertices[i].e[1] > 1) {
+      continue;
+    }
+    projected_vertices[i].e[0] =
+        projected_vertices[i].e[0] * width + (float)width / 2;
+    projected_vertices[i].e[1] =
+        projected_vertices[i].e[1] * height + (float)height / 2;
+  }
+}
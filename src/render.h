@@ -0,0 +1,152 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "framebuffer.h"
+#include "obj_parser.h"
+#include "texture.h"
+#include <math.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// LINE_CHAR and MAX_DISTANCE_FROM_LINE as constant expressions, for the
+// kernels in pipeline.h
+#define RENDER_LINE_CHAR 'x'
+#define RENDER_MAX_DISTANCE_FROM_LINE 0.5f
+
+extern const char BACKGROUND_CHAR;
+extern const char LINE_CHAR;
+extern const float MAX_DISTANCE_FROM_LINE;
+extern const float MODEL_DISTANCE;
+
+typedef struct vec3 {
+  float x;
+  float y;
+  float z;
+} vec3;
+
+typedef struct line {
+  vec3 start;
+  vec3 end;
+} line;
+
+typedef struct triangle {
+  vec3 points[3];
+} triangle;
+
+typedef struct square {
+  vec3 points[4];
+} square;
+
+// Time spent in each pipeline stage, accumulated over frames. Stages that
+// were skipped because their inputs did not change add nothing.
+typedef struct render_stats {
+  double transform_seconds;
+  double project_seconds;
+  double cull_seconds;
+  double clear_seconds;
+  double raster_seconds;
+  double encode_seconds; // turning cells into terminal output and sending it
+  long long output_bytes;  // as written to the terminal
+  long long output_writes; // write() calls, -1 when they could not be counted
+  int frames_drawn;      // frames whose framebuffer had to be redrawn
+  int objects_projected; // models or instances whose vertices were projected
+} render_stats;
+
+bool is_point_part_of_line(int starty, int startx, int endy, int endx,
+                           int pointy, int pointx);
+int clamp_to_screen(const int coord, const int min, const int max);
+
+void draw_line(framebuffer *fb, int starty, int startx, int endy, int endx);
+void draw_line_by_vec3(framebuffer *fb, vec3 start, vec3 end);
+void draw_line_by_obj_vector(framebuffer *fb, struct obj_vector start,
+                             struct obj_vector end);
+// A line clipped to a width x height dot grid: dots sx + stepx * i,
+// sy + stepy * i for i in 0..steps, before rounding
+typedef struct dot_span {
+  float sx, sy;
+  float stepx, stepy;
+  int steps;
+} dot_span;
+
+// Liang-Barsky clip of (x0, y0)-(x1, y1) to the grid, false when nothing of
+// the line is on it. Shared by draw_dot_line and the pipeline's dot raster,
+// which only differ in how they plot a dot.
+static inline bool clip_dot_line(float x0, float y0, float x1, float y1,
+                                 int width, int height, dot_span *span) {
+  float dx = x1 - x0, dy = y1 - y0;
+  float t0 = 0, t1 = 1;
+  const float p[4] = {-dx, dx, -dy, dy};
+  const float q[4] = {x0, width - 1 - x0, y0, height - 1 - y0};
+  for (int i = 0; i < 4; ++i) {
+    if (p[i] == 0) {
+      if (q[i] < 0)
+        return false;
+      continue;
+    }
+    float t = q[i] / p[i];
+    if (p[i] < 0)
+      t0 = t > t0 ? t : t0;
+    else
+      t1 = t < t1 ? t : t1;
+  }
+  if (t0 > t1)
+    return false;
+
+  span->sx = x0 + dx * t0;
+  span->sy = y0 + dy * t0;
+  span->steps = (int)ceilf(fmaxf(fabsf(dx), fabsf(dy)) * (t1 - t0));
+  span->stepx = span->steps ? dx * (t1 - t0) / span->steps : 0;
+  span->stepy = span->steps ? dy * (t1 - t0) / span->steps : 0;
+  return true;
+}
+
+// Line on the dot grid of the sub-cell modes, in dot coordinates
+void draw_dot_line(framebuffer *fb, float x0, float y0, float x1, float y1);
+// Draws face outlines with draw_line, or draw_dot_line in sub-cell modes
+void draw_faces(framebuffer *fb, const struct obj_scene_data *model,
+                struct obj_vector *projected_vertices);
+// Like draw_faces, but only for the listed faces (e.g. after culling)
+void draw_face_list(framebuffer *fb, const struct obj_scene_data *model,
+                    struct obj_vector *projected_vertices,
+                    const int32_t *faces, int face_count);
+
+// Fills faces in the ASCII mode, a glyph from the luminance ramp per cell:
+// sampled from the face's texture where its material has one and the face
+// has texture coordinates, the material's diffuse brightness otherwise.
+// `model` holds view space positions (after transform_model), the screen
+// mapping is the one of project_vertices. Texture coordinates are
+// interpolated perspective-correct, and each triangle samples the mip level
+// whose texels are about the size of its cells. `depth` holds one float per
+// cell and is reset here. `faces` NULL draws every face.
+void draw_textured_faces(framebuffer *fb, const struct obj_scene_data *model,
+                         const texture_set *textures, const int32_t *faces,
+                         int face_count, float *depth);
+
+// Pen colour of a material: its diffuse colour scaled so the strongest
+// channel is at full intensity, which keeps dark materials readable on a
+// terminal. FRAMEBUFFER_NO_COLOR for faces without a usable material.
+uint32_t material_color(const struct obj_scene_data *model,
+                        int material_index);
+
+void rotation_matrix(float R[3][3], float yaw, float pitch, float roll);
+void rotate(vec3 *point, float yaw, float pitch, float roll);
+
+// Rotates every vertex of src by R and pushes it `distance` away from the
+// camera, writing the result into dst (both scenes must have the same vertex
+// count)
+void transform_model(const struct obj_scene_data *src,
+                     struct obj_scene_data *dst, float R[3][3],
+                     float distance);
+// Perspective divide and viewport mapping into the framebuffer's size
+void project_vertices(const struct obj_scene_data *model,
+                      struct obj_vector *projected_vertices, int width,
+                      int height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
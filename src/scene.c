@@ -0,0 +1,340 @@
+#include "scene.h"
+#include "bounds.h"
+#include "pipeline.h"
+#include "render.h"
+#include "timing.h"
+#include <libgen.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCENE_LINE_SIZE 1024
+#define SCENE_WHITESPACE " \t\r\n"
+
+// Frees what the kernels do not read: the per-vertex lists and their counts
+static void free_vertex_lists(struct obj_scene_data *data) {
+  for (int i = 0; i < data->vertex_count; ++i)
+    free(data->vertex_list[i]);
+  for (int i = 0; i < data->vertex_normal_count; ++i)
+    free(data->vertex_normal_list[i]);
+  for (int i = 0; i < data->vertex_texture_count; ++i)
+    free(data->vertex_texture_list[i]);
+  free(data->vertex_list);
+  free(data->vertex_normal_list);
+  free(data->vertex_texture_list);
+  data->vertex_list = data->vertex_normal_list = data->vertex_texture_list =
+      NULL;
+  data->vertex_count = data->vertex_normal_count =
+      data->vertex_texture_count = 0;
+}
+
+static int add_mesh(scene *s, const char *name, const char *path,
+                    float scale) {
+  scene_mesh *meshes =
+      realloc(s->meshes, sizeof(scene_mesh) * (s->mesh_count + 1));
+  if (meshes == NULL)
+    return 0;
+  s->meshes = meshes;
+  scene_mesh *mesh = &s->meshes[s->mesh_count];
+  snprintf(mesh->name, sizeof(mesh->name), "%s", name);
+  if (!parse_obj_scene(&mesh->data, (char *)path))
+    return 0;
+  center_and_scale_model(&mesh->data, scale, false);
+  drop_bad_corners(&mesh->data);
+  mesh->face_arity = face_arity(&mesh->data);
+
+  int count = mesh->data.vertex_count;
+  mesh->positions = malloc(sizeof(float) * 3 * (count > 0 ? count : 1));
+  mesh->screen = malloc(sizeof(float) * 2 * (count > 0 ? count : 1));
+  mesh->projected = calloc(count > 0 ? count : 1, sizeof(struct obj_vector));
+  if (mesh->positions == NULL || mesh->screen == NULL ||
+      mesh->projected == NULL) {
+    free(mesh->positions);
+    free(mesh->screen);
+    free(mesh->projected);
+    delete_obj_data(&mesh->data);
+    return 0;
+  }
+  for (int i = 0; i < count; ++i)
+    for (int k = 0; k < 3; ++k)
+      mesh->positions[i * 3 + k] = (float)mesh->data.vertex_list[i]->e[k];
+  mesh->vertex_count = count;
+  free_vertex_lists(&mesh->data);
+  s->mesh_count++;
+  return 1;
+}
+
+static int find_mesh(const scene *s, const char *name) {
+  for (int i = 0; i < s->mesh_count; ++i)
+    if (strcmp(s->meshes[i].name, name) == 0)
+      return i;
+  return -1;
+}
+
+static scene_instance *add_instance(scene *s, int mesh) {
+  scene_instance *instances =
+      realloc(s->instances, sizeof(scene_instance) * (s->instance_count + 1));
+  if (instances == NULL)
+    return NULL;
+  s->instances = instances;
+  scene_instance *instance = &s->instances[s->instance_count++];
+  memset(instance, 0, sizeof(*instance));
+  instance->mesh = mesh;
+  instance->scale = 1.f;
+  instance->spin = 1.f;
+  instance->dirty = true;
+  return instance;
+}
+
+// Reads up to `max` numbers from the rest of the line, returns how many
+static int read_floats(float *values, int max) {
+  int count = 0;
+  char *token;
+  while (count < max && (token = strtok(NULL, SCENE_WHITESPACE)) != NULL)
+    values[count++] = (float)atof(token);
+  return count;
+}
+
+static int parse_instance(scene *s, int mesh) {
+  float v[8];
+  int n = read_floats(v, 8);
+  if (n < 3)
+    return 0;
+  scene_instance *instance = add_instance(s, mesh);
+  if (instance == NULL)
+    return 0;
+  memcpy(instance->position, v, sizeof(float) * 3);
+  if (n >= 6)
+    memcpy(instance->rotation, v + 3, sizeof(float) * 3);
+  if (n >= 7)
+    instance->scale = v[6];
+  if (n >= 8)
+    instance->spin = v[7];
+  return 1;
+}
+
+static int parse_grid(scene *s, int mesh) {
+  float v[9];
+  int n = read_floats(v, 9);
+  if (n < 7)
+    return 0;
+  int counts[3] = {(int)v[0], (int)v[1], (int)v[2]};
+  float spacing = v[3];
+  for (int z = 0; z < counts[2]; ++z) {
+    for (int y = 0; y < counts[1]; ++y) {
+      for (int x = 0; x < counts[0]; ++x) {
+        scene_instance *instance = add_instance(s, mesh);
+        if (instance == NULL)
+          return 0;
+        int index[3] = {x, y, z};
+        for (int k = 0; k < 3; ++k)
+          instance->position[k] =
+              v[4 + k] + (index[k] - (counts[k] - 1) / 2.f) * spacing;
+        if (n >= 8)
+          instance->scale = v[7];
+        if (n >= 9)
+          instance->spin = v[8];
+        // vary the phase so the grid does not move in lockstep
+        instance->rotation[1] = (float)(x + y + z) * 0.3f;
+      }
+    }
+  }
+  return 1;
+}
+
+static int compare_instances(const void *a, const void *b) {
+  const scene_instance *ia = a, *ib = b;
+  return ia->mesh - ib->mesh;
+}
+
+int scene_load(scene *s, const char *filename) {
+  memset(s, 0, sizeof(*s));
+  FILE *in = fopen(filename, "r");
+  if (in == NULL) {
+    fprintf(stderr, "Error reading file: %s\n", filename);
+    return 0;
+  }
+  char *dir_copy = strdup(filename);
+  const char *directory = dirname(dir_copy);
+
+  char line[SCENE_LINE_SIZE];
+  int line_number = 0;
+  int ok = 1;
+  while (ok && fgets(line, sizeof(line), in)) {
+    line_number++;
+    char *command = strtok(line, SCENE_WHITESPACE);
+    if (command == NULL || command[0] == '#')
+      continue;
+
+    if (strcmp(command, "mesh") == 0) {
+      char *name = strtok(NULL, SCENE_WHITESPACE);
+      char *path = strtok(NULL, SCENE_WHITESPACE);
+      float scale = 1.f;
+      read_floats(&scale, 1);
+      if (name == NULL || path == NULL) {
+        ok = 0;
+        break;
+      }
+      char full_path[SCENE_LINE_SIZE + 256];
+      if (path[0] == '/')
+        snprintf(full_path, sizeof(full_path), "%s", path);
+      else
+        snprintf(full_path, sizeof(full_path), "%s/%s", directory, path);
+      ok = add_mesh(s, name, full_path, scale);
+    } else if (strcmp(command, "instance") == 0 ||
+               strcmp(command, "grid") == 0) {
+      char *name = strtok(NULL, SCENE_WHITESPACE);
+      int mesh = name ? find_mesh(s, name) : -1;
+      if (mesh < 0) {
+        fprintf(stderr, "Unknown mesh '%s' in %s at line %d\n",
+                name ? name : "", filename, line_number);
+        ok = 0;
+        break;
+      }
+      ok = command[0] == 'i' ? parse_instance(s, mesh) : parse_grid(s, mesh);
+    } else {
+      fprintf(stderr, "Unknown command '%s' in %s at line %d\n", command,
+              filename, line_number);
+    }
+    if (!ok)
+      fprintf(stderr, "Error in %s at line %d\n", filename, line_number);
+  }
+
+  free(dir_copy);
+  fclose(in);
+  if (!ok) {
+    scene_free(s);
+    return 0;
+  }
+  qsort(s->instances, s->instance_count, sizeof(scene_instance),
+        compare_instances);
+  // caches in instance order while the budget lasts, one block for all;
+  // the rest are re-projected into their mesh's scratch
+  size_t cached = 0;
+  for (int i = 0; i < s->instance_count; ++i) {
+    size_t count = (size_t)s->meshes[s->instances[i].mesh].vertex_count;
+    if (cached + count <= SCENE_CACHED_VERTICES)
+      cached += count;
+  }
+  s->screen_cache = malloc(sizeof(float) * 2 * (cached > 0 ? cached : 1));
+  if (s->screen_cache == NULL)
+    return 1;
+  cached = 0;
+  for (int i = 0; i < s->instance_count; ++i) {
+    size_t count = (size_t)s->meshes[s->instances[i].mesh].vertex_count;
+    if (cached + count <= SCENE_CACHED_VERTICES) {
+      s->instances[i].screen = s->screen_cache + cached * 2;
+      cached += count;
+    }
+  }
+  return 1;
+}
+
+void scene_free(scene *s) {
+  for (int i = 0; i < s->mesh_count; ++i) {
+    delete_obj_data(&s->meshes[i].data);
+    free(s->meshes[i].positions);
+    free(s->meshes[i].screen);
+    free(s->meshes[i].projected);
+  }
+  free(s->meshes);
+  free(s->instances);
+  free(s->screen_cache);
+  memset(s, 0, sizeof(*s));
+}
+
+void scene_update(scene *s, float angle) {
+  for (int i = 0; i < s->instance_count; ++i) {
+    scene_instance *instance = &s->instances[i];
+    float yaw = instance->rotation[0];
+    float pitch = instance->rotation[1] + angle * instance->spin;
+    float roll = instance->rotation[2];
+    float R[3][3];
+    rotation_matrix(R, yaw, pitch, roll);
+    float matrix[3][4];
+    for (int r = 0; r < 3; ++r)
+      for (int c = 0; c < 3; ++c)
+        matrix[r][c] = R[r][c] * instance->scale;
+    for (int r = 0; r < 3; ++r)
+      matrix[r][3] = instance->position[r];
+    if (memcmp(matrix, instance->matrix, sizeof(matrix)) != 0) {
+      memcpy(instance->matrix, matrix, sizeof(matrix));
+      instance->dirty = true;
+    }
+  }
+}
+
+// Transform and projection fused into one pass over the packed positions,
+// writing x y pairs; the projection matches project_vertices
+static void transform_and_project(const scene_mesh *mesh, float m[3][4],
+                                  float *out, int width, int height) {
+  const float *p = mesh->positions;
+  for (int i = 0; i < mesh->vertex_count; ++i, p += 3, out += 2) {
+    float x = m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3];
+    float y = m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3];
+    float z = m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3];
+    out[0] = x / z;
+    out[1] = y / z;
+    if (out[0] < -1 || out[0] > 1 || out[1] < -1 || out[1] > 1)
+      continue;
+    out[0] = out[0] * width + (float)width / 2;
+    out[1] = out[1] * height + (float)height / 2;
+  }
+}
+
+// Widens x y pairs into the vertices the face kernels read
+static void expand_screen(const scene_mesh *mesh, const float *screen) {
+  for (int i = 0; i < mesh->vertex_count; ++i, screen += 2) {
+    mesh->projected[i].e[0] = screen[0];
+    mesh->projected[i].e[1] = screen[1];
+  }
+}
+
+int scene_draw(scene *s, framebuffer *fb, render_stats *stats) {
+  int width = framebuffer_raster_width(fb);
+  int height = framebuffer_raster_height(fb);
+  bool resized = width != s->drawn_width || height != s->drawn_height;
+  bool changed = resized;
+  for (int i = 0; i < s->instance_count && !changed; ++i)
+    changed = s->instances[i].dirty;
+  if (!changed)
+    return 0;
+
+  double t0 = stats ? now_seconds() : 0;
+  framebuffer_clear(fb, BACKGROUND_CHAR);
+  if (stats) {
+    stats->clear_seconds += now_seconds() - t0;
+    stats->frames_drawn++;
+  }
+
+  for (int i = 0; i < s->instance_count; ++i) {
+    scene_instance *instance = &s->instances[i];
+    scene_mesh *mesh = &s->meshes[instance->mesh];
+    bool moved = instance->dirty || resized;
+    instance->dirty = false;
+    // skip instances that sit behind the camera
+    if (instance->position[2] <= 0)
+      continue;
+
+    double t1 = stats ? now_seconds() : 0;
+    float *screen = instance->screen;
+    if (screen == NULL || moved) {
+      screen = screen ? screen : mesh->screen;
+      transform_and_project(mesh, instance->matrix, screen, width, height);
+      if (stats)
+        stats->objects_projected++;
+    }
+    expand_screen(mesh, screen);
+    double t2 = stats ? now_seconds() : 0;
+    select_face_kernel(fb, mesh->face_arity, false)(fb, &mesh->data,
+                                                    mesh->projected, NULL, 0);
+    if (stats) {
+      stats->project_seconds += t2 - t1;
+      stats->raster_seconds += now_seconds() - t2;
+    }
+  }
+  s->drawn_width = width;
+  s->drawn_height = height;
+  return 1;
+}
@@ -0,0 +1,80 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "framebuffer.h"
+#include "obj_parser.h"
+#include "render.h"
+
+#define SCENE_NAME_SIZE 64
+
+// A scene is a set of meshes, each parsed once, and any number of instances
+// that reference them. Instances only carry a transform, so 1000 cubes cost
+// one cube's geometry plus 1000 small matrices, and at most
+// SCENE_CACHED_VERTICES cached screen positions shared between them.
+//
+// Scene files are line based, paths are relative to the scene file:
+//   mesh <name> <file.obj> [scale]
+//   instance <mesh> <x> <y> <z> [yaw pitch roll] [scale] [spin]
+//   grid <mesh> <nx> <ny> <nz> <spacing> <x> <y> <z> [scale] [spin]
+// `spin` multiplies the animation angle that turns the instance around its
+// own Y axis, `grid` places nx*ny*nz instances centred on (x, y, z).
+// Instances are kept sorted by mesh so each mesh's data stays hot in cache
+// while all of its instances are transformed.
+//
+// Instances keep their own projected vertices, an x and y float each, while
+// they fit in SCENE_CACHED_VERTICES for the whole scene, so a frame where
+// only some instances moved re-projects just those and redraws the rest from
+// their cached positions. Instances past that budget are re-projected every
+// frame. A frame where nothing moved leaves the framebuffer as it was.
+
+// Screen positions cached over all instances, 8 MB
+#define SCENE_CACHED_VERTICES (1 << 20)
+
+typedef struct scene_mesh {
+  char name[SCENE_NAME_SIZE];
+  // faces and materials, shared by instances. Its vertex, normal and
+  // texture coordinate lists are freed once the centered and scaled
+  // vertices are in `positions`, nothing reads them after that.
+  struct obj_scene_data data;
+  float *positions; // xyz per vertex, packed for batch transforms
+  int vertex_count;
+  float *screen;                // x y per vertex, scratch for instances
+                                // without a cache
+  struct obj_vector *projected; // screen positions as the kernels read them
+  int face_arity;               // see face_arity, picks the kernel
+} scene_mesh;
+
+typedef struct scene_instance {
+  int mesh;
+  float position[3];
+  float rotation[3]; // yaw, pitch, roll
+  float scale;
+  float spin;
+  float matrix[3][4]; // rotation * scale | translation, set per frame
+  float *screen; // cached x y per vertex, or NULL
+  bool dirty;                   // matrix changed since the last draw
+} scene_instance;
+
+typedef struct scene {
+  scene_mesh *meshes;
+  int mesh_count;
+  scene_instance *instances;
+  int instance_count;
+  float *screen_cache; // backs the instances' screen positions
+  int drawn_width; // raster size of the last draw, 0 before the first
+  int drawn_height;
+} scene;
+
+int scene_load(scene *s, const char *filename);
+void scene_free(scene *s);
+// Rebuilds the instance matrices for the current animation angle and marks
+// the instances whose matrix changed
+void scene_update(scene *s, float angle);
+// Transforms, projects and draws the instances, mesh by mesh, into a
+// cleared fb. Returns 0 without touching fb when nothing changed since the
+// last draw into a framebuffer of the same size. stats may be NULL,
+// otherwise the time spent in each stage is added to it; transform and
+// projection are fused and counted as projection.
+int scene_draw(scene *s, framebuffer *fb, render_stats *stats);
+
+#endif
@@ -0,0 +1,283 @@
+#define _GNU_SOURCE
+#include "server.h"
+#include "timing.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_MAX_EVENTS 64
+
+int frame_server_open(frame_server *s, const char *path) {
+  memset(s, 0, sizeof(*s));
+  s->listen_fd = -1;
+  s->epoll_fd = -1;
+  s->path = path;
+  terminal_output_init(&s->delta, -1);
+  terminal_output_init(&s->keyframe, -1);
+
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Socket path %s is too long\n", path);
+    return 0;
+  }
+  strcpy(address.sun_path, path);
+  // a socket left behind by a server that did not shut down is replaced,
+  // anything else at the path is not
+  struct stat st;
+  if (lstat(path, &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      fprintf(stderr, "%s exists and is not a socket\n", path);
+      return 0;
+    }
+    unlink(path);
+  }
+
+  s->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  s->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+  if (s->listen_fd < 0 || s->epoll_fd < 0 ||
+      bind(s->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(s->listen_fd, 16) != 0 ||
+      epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, s->listen_fd, &event) != 0) {
+    fprintf(stderr, "Could not listen on %s: %s\n", path, strerror(errno));
+    frame_server_close(s);
+    return 0;
+  }
+  return 1;
+}
+
+static void free_client(frame_client *c) {
+  close(c->fd);
+  free(c->queue);
+  free(c);
+}
+
+void frame_server_close(frame_server *s) {
+  for (int i = 0; i < s->client_count; ++i)
+    free_client(s->clients[i]);
+  free(s->clients);
+  s->clients = NULL;
+  s->client_count = 0;
+  if (s->listen_fd >= 0) {
+    close(s->listen_fd);
+    unlink(s->path);
+  }
+  if (s->epoll_fd >= 0)
+    close(s->epoll_fd);
+  s->listen_fd = -1;
+  s->epoll_fd = -1;
+  terminal_output_free(&s->delta);
+  terminal_output_free(&s->keyframe);
+}
+
+static void accept_clients(frame_server *s) {
+  for (;;) {
+    int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+    frame_client **clients =
+        realloc(s->clients, sizeof(frame_client *) * (s->client_count + 1));
+    frame_client *c = calloc(1, sizeof(frame_client));
+    if (clients != NULL)
+      s->clients = clients;
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = c};
+    if (clients == NULL || c == NULL ||
+        epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      close(fd);
+      free(c);
+      continue;
+    }
+    c->fd = fd;
+    c->reading = true;
+    // a new viewer starts from a full frame
+    c->needs_keyframe = true;
+    s->clients[s->client_count++] = c;
+  }
+}
+
+// Asks for EPOLLOUT only while there is something left to write
+static void watch_client(frame_server *s, frame_client *c, bool pending) {
+  c->writing = pending;
+  struct epoll_event event = {
+      .events = (c->reading ? EPOLLIN : 0) | (pending ? EPOLLOUT : 0),
+      .data.ptr = c};
+  epoll_ctl(s->epoll_fd, EPOLL_CTL_MOD, c->fd, &event);
+}
+
+static void flush_client(frame_server *s, frame_client *c) {
+  while (c->sent < c->length) {
+    ssize_t n = send(c->fd, c->queue + c->sent, c->length - c->sent,
+                     MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        c->closed = true;
+      break;
+    }
+    c->sent += (size_t)n;
+    s->bytes_sent += n;
+  }
+  // forget the frames that are out
+  int done = 0;
+  while (done < c->frames_queued && c->frame_ends[done] <= c->sent)
+    ++done;
+  memmove(c->frame_ends, c->frame_ends + done,
+          sizeof(size_t) * (size_t)(c->frames_queued - done));
+  c->frames_queued -= done;
+  if (c->sent == c->length) {
+    c->sent = 0;
+    c->length = 0;
+  }
+  bool pending = c->length > 0;
+  if (!c->closed && pending != c->writing)
+    watch_client(s, c, pending);
+}
+
+static int enqueue(frame_client *c, const char *data, size_t size) {
+  if (c->sent > 0) {
+    // move the unsent bytes to the front before growing
+    memmove(c->queue, c->queue + c->sent, c->length - c->sent);
+    for (int i = 0; i < c->frames_queued; ++i)
+      c->frame_ends[i] -= c->sent;
+    c->length -= c->sent;
+    c->sent = 0;
+  }
+  if (c->length + size > c->capacity) {
+    size_t capacity = c->capacity ? c->capacity : 4096;
+    while (capacity < c->length + size)
+      capacity *= 2;
+    char *queue = realloc(c->queue, capacity);
+    if (queue == NULL)
+      return 0;
+    c->queue = queue;
+    c->capacity = capacity;
+  }
+  memcpy(c->queue + c->length, data, size);
+  c->length += size;
+  c->frame_ends[c->frames_queued++] = c->length;
+  return 1;
+}
+
+// Drops every queued frame but the one being written, which has to be
+// completed for the terminal to make sense of what follows
+static void skip_to_keyframe(frame_client *c) {
+  if (c->frames_queued > 0) {
+    c->length = c->frame_ends[0];
+    c->frames_queued = 1;
+  }
+  c->needs_keyframe = true;
+  c->frames_skipped++;
+}
+
+static void reap_clients(frame_server *s) {
+  int kept = 0;
+  for (int i = 0; i < s->client_count; ++i) {
+    if (s->clients[i]->closed)
+      free_client(s->clients[i]);
+    else
+      s->clients[kept++] = s->clients[i];
+  }
+  s->client_count = kept;
+}
+
+int frame_server_publish(frame_server *s, const framebuffer *fb) {
+  size_t delta_length, key_length = 0;
+  if (!terminal_output_encode(&s->delta, fb, fb->height, fb->width,
+                              &delta_length))
+    return 0;
+  for (int i = 0; i < s->client_count; ++i) {
+    frame_client *c = s->clients[i];
+    if (c->closed)
+      continue;
+    if (c->needs_keyframe) {
+      // still busy with older frames, skip this one too
+      if (c->length > 0) {
+        c->frames_skipped++;
+        continue;
+      }
+      // encoded once per frame, for however many clients need it
+      if (key_length == 0) {
+        s->keyframe.clear_next = true;
+        if (!terminal_output_encode(&s->keyframe, fb, fb->height, fb->width,
+                                    &key_length))
+          return 0;
+      }
+      if (!enqueue(c, s->keyframe.buffer, key_length)) {
+        c->closed = true;
+        continue;
+      }
+      c->needs_keyframe = false;
+      s->keyframes_sent++;
+    } else if (delta_length > 0) {
+      if (c->length - c->sent + delta_length > SERVER_CLIENT_BACKLOG ||
+          c->frames_queued == SERVER_MAX_QUEUED_FRAMES) {
+        skip_to_keyframe(c);
+        continue;
+      }
+      if (!enqueue(c, s->delta.buffer, delta_length)) {
+        c->closed = true;
+        continue;
+      }
+    }
+    flush_client(s, c);
+  }
+  reap_clients(s);
+  s->frames++;
+  return 1;
+}
+
+static void read_client(frame_server *s, frame_client *c) {
+  char discard[256];
+  for (;;) {
+    ssize_t n = read(c->fd, discard, sizeof(discard));
+    if (n > 0)
+      continue;
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n == 0) {
+      // a viewer whose input ended, e.g. `nc -U path < /dev/null`, may
+      // still be watching
+      c->reading = false;
+      watch_client(s, c, c->length > 0);
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      c->closed = true;
+    }
+    return;
+  }
+}
+
+void frame_server_poll(frame_server *s, double seconds) {
+  double deadline = now_seconds() + seconds;
+  struct epoll_event events[SERVER_MAX_EVENTS];
+  double wait;
+  while ((wait = deadline - now_seconds()) > 0) {
+    int count = epoll_wait(s->epoll_fd, events, SERVER_MAX_EVENTS,
+                           (int)(wait * 1000) + 1);
+    // a signal, let the caller decide whether to go on
+    if (count < 0)
+      return;
+    for (int i = 0; i < count; ++i) {
+      frame_client *c = events[i].data.ptr;
+      if (c == NULL) {
+        accept_clients(s);
+        continue;
+      }
+      if (c->closed)
+        continue;
+      if (events[i].events & (EPOLLERR | EPOLLHUP))
+        c->closed = true;
+      else if (events[i].events & EPOLLIN)
+        read_client(s, c);
+      if (!c->closed && (events[i].events & EPOLLOUT))
+        flush_client(s, c);
+    }
+    reap_clients(s);
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "framebuffer.h"
+#include "terminal.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bytes a client may have queued before it is considered too slow
+#define SERVER_CLIENT_BACKLOG (256 * 1024)
+// Frames a client may have queued, whatever their size
+#define SERVER_MAX_QUEUED_FRAMES 32
+
+// A viewer attached to the server, e.g. `socat -,raw UNIX-CONNECT:path`
+typedef struct frame_client {
+  int fd;
+  char *queue; // encoded frames not yet taken by the socket
+  size_t length;
+  size_t sent; // bytes of the queue already written
+  size_t capacity;
+  // where each queued frame ends, so dropping frames never cuts one short
+  size_t frame_ends[SERVER_MAX_QUEUED_FRAMES];
+  int frames_queued;
+  // the client lost frames, or just connected, and is sent the next full
+  // frame once its queue has drained
+  bool needs_keyframe;
+  bool reading; // until the client shuts down its side, input is discarded
+  bool writing; // waiting for the socket to take more of the queue
+  bool closed;
+  long long frames_skipped;
+} frame_client;
+
+// Renders once, fans out to every client: each frame is encoded once as
+// the changes since the previous frame, and as a full frame for clients
+// that need to start over. A slow client is never buffered for without
+// limit, it skips ahead to the next full frame instead.
+typedef struct frame_server {
+  int listen_fd;
+  int epoll_fd;
+  const char *path;
+  frame_client **clients;
+  int client_count;
+  terminal_output delta;    // changes since the previous frame
+  terminal_output keyframe; // the whole frame after a screen clear
+  long long frames;
+  long long keyframes_sent;
+  long long bytes_sent;
+} frame_server;
+
+// Listens on the Unix socket `path`, replacing a stale socket there.
+// Returns 0 and prints why on failure.
+int frame_server_open(frame_server *s, const char *path);
+// Disconnects every client and removes the socket
+void frame_server_close(frame_server *s);
+// Queues fb for every client and writes as much as the sockets take
+int frame_server_publish(frame_server *s, const framebuffer *fb);
+// Accepts clients and keeps writing queued frames for `seconds`, or until
+// a signal arrives
+void frame_server_poll(frame_server *s, double seconds);
+
+#endif
@@ -0,0 +1,159 @@
+#include "terminal.h"
+#include <curses.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// "\x1b[" row ";" col "H", both up to five digits
+#define CURSOR_MOVE_BYTES 14
+
+void terminal_output_init(terminal_output *t, int fd) {
+  t->fd = fd;
+  t->buffer = NULL;
+  t->capacity = 0;
+  t->shown = NULL;
+  t->shown_capacity = 0;
+  t->shown_rows = 0;
+  t->shown_cols = 0;
+  t->clear_next = true;
+  t->writes = 0;
+}
+
+void terminal_output_free(terminal_output *t) {
+  free(t->buffer);
+  free(t->shown);
+  t->buffer = NULL;
+  t->shown = NULL;
+  t->capacity = 0;
+  t->shown_capacity = 0;
+}
+
+static int write_all(terminal_output *t, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(t->fd, data, size);
+    t->writes++;
+    if (written < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      return 0;
+    }
+    data += written;
+    size -= (size_t)written;
+  }
+  return 1;
+}
+
+// Returns a buffer of at least `needed` bytes, or NULL with the old one
+// still allocated
+static void *reserve(void *buffer, size_t *capacity, size_t needed) {
+  if (needed <= *capacity)
+    return buffer;
+  void *grown = realloc(buffer, needed);
+  if (grown != NULL)
+    *capacity = needed;
+  return grown;
+}
+
+// Everything that decides what a cell looks like
+static uint64_t cell_key(const framebuffer *fb, size_t cell) {
+  uint8_t glyph = fb->mode == FRAMEBUFFER_ASCII ? (uint8_t)fb->cells[cell]
+                                                : fb->dots[cell];
+  uint32_t color = fb->colors != NULL ? fb->colors[cell] : 0;
+  return (uint64_t)color << 8 | glyph;
+}
+
+int terminal_output_encode(terminal_output *t, const framebuffer *fb,
+                           int rows, int cols, size_t *length) {
+  *length = 0;
+  rows = rows < fb->height ? rows : fb->height;
+  cols = cols < fb->width ? cols : fb->width;
+  if (rows <= 0 || cols <= 0)
+    return 1;
+  // Unchanged cells shorter than a cursor move are cheaper to send again
+  // than to jump over
+  int merge_gap = fb->mode == FRAMEBUFFER_ASCII && fb->colors == NULL ? 6 : 2;
+  int max_spans = cols / (merge_gap + 1) + 1;
+  size_t needed =
+      (size_t)rows * (framebuffer_max_row_bytes(fb, cols) +
+                      (size_t)max_spans * (CURSOR_MOVE_BYTES +
+                                           framebuffer_max_row_bytes(fb, 0))) +
+      8;
+  size_t cells = (size_t)rows * (size_t)cols;
+  char *buffer = reserve(t->buffer, &t->capacity, needed);
+  if (buffer == NULL)
+    return 0;
+  t->buffer = buffer;
+  uint64_t *shown_cells =
+      reserve(t->shown, &t->shown_capacity, cells * sizeof(uint64_t));
+  if (shown_cells == NULL)
+    return 0;
+  t->shown = shown_cells;
+
+  // a cleared or resized screen has nothing worth keeping
+  bool full = t->clear_next || rows != t->shown_rows || cols != t->shown_cols;
+  char *out = t->buffer;
+  if (t->clear_next) {
+    memcpy(out, "\x1b[2J", 4);
+    out += 4;
+    t->clear_next = false;
+  }
+  for (int row = 0; row < rows; ++row) {
+    uint64_t *shown = t->shown + (size_t)row * cols;
+    size_t offset = (size_t)row * fb->width;
+    int col = 0;
+    while (col < cols) {
+      if (!full && shown[col] == cell_key(fb, offset + col)) {
+        ++col;
+        continue;
+      }
+      int last = col;
+      for (int next = col + 1; next < cols && next - last <= merge_gap + 1;
+           ++next)
+        if (full || shown[next] != cell_key(fb, offset + next))
+          last = next;
+      for (int i = col; i <= last; ++i)
+        shown[i] = cell_key(fb, offset + i);
+      out += snprintf(out, CURSOR_MOVE_BYTES + 1, "\x1b[%d;%dH", row + 1,
+                      col + 1);
+      out += framebuffer_encode_span(fb, row, col, last - col + 1, out);
+      col = last + 1;
+    }
+  }
+  t->shown_rows = rows;
+  t->shown_cols = cols;
+  *length = (size_t)(out - t->buffer);
+  return 1;
+}
+
+int terminal_output_frame(terminal_output *t, const framebuffer *fb, int rows,
+                          int cols) {
+  size_t length;
+  if (!terminal_output_encode(t, fb, rows, cols, &length))
+    return 0;
+  return length == 0 || write_all(t, t->buffer, length);
+}
+
+// Until a resize has settled the screen may be smaller than the frame, clip
+// instead of letting curses wrap long rows
+void curses_output_frame(const framebuffer *fb) {
+  static char *line = NULL;
+  static size_t line_size = 0;
+  int rows, cols;
+  getmaxyx(stdscr, rows, cols);
+  rows = rows < fb->height ? rows : fb->height;
+  cols = cols < fb->width ? cols : fb->width;
+  char *grown =
+      reserve(line, &line_size, framebuffer_max_row_bytes(fb, cols) + 1);
+  if (grown == NULL)
+    return;
+  line = grown;
+  erase();
+  for (int row = 0; row < rows; ++row) {
+    size_t length = framebuffer_encode_row(fb, row, cols, line);
+    line[length] = '\0';
+    mvaddstr(row, 0, line);
+  }
+  refresh();
+}
@@ -0,0 +1,49 @@
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+#include "framebuffer.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// How frames reach the terminal. curses diffs its own copy of the screen
+// and writes through its output buffer; the raw backend diffs against the
+// last frame it sent and writes each frame with a single write(). Colour
+// frames always take the raw path, curses cannot pass colour sequences of
+// its own through its output, and 24-bit colour is beyond it.
+typedef enum terminal_backend {
+  TERMINAL_CURSES,
+  TERMINAL_RAW
+} terminal_backend;
+
+// Raw backend: writes frames straight to the terminal as escape sequences.
+// curses keeps handling input and the screen size.
+typedef struct terminal_output {
+  int fd;
+  char *buffer; // one encoded frame, grown as needed
+  size_t capacity;
+  // what the terminal shows, one key per cell of the last frame's area
+  uint64_t *shown;
+  size_t shown_capacity;
+  int shown_rows;
+  int shown_cols;
+  bool clear_next; // erase the screen before the next frame, e.g. a resize
+  long long writes; // write() calls so far
+} terminal_output;
+
+void terminal_output_init(terminal_output *t, int fd);
+void terminal_output_free(terminal_output *t);
+// Sends the cells of the top left `rows` x `cols` of fb that differ from
+// the previous frame, as runs behind cursor moves, in a single write()
+// unless the terminal takes it in pieces. Writes nothing when no cell
+// changed. Returns 0 on failure.
+int terminal_output_frame(terminal_output *t, const framebuffer *fb, int rows,
+                          int cols);
+// The encoding step of terminal_output_frame on its own: leaves the bytes
+// in t->buffer and their count in *length instead of writing them
+int terminal_output_encode(terminal_output *t, const framebuffer *fb,
+                           int rows, int cols, size_t *length);
+
+// curses backend: copies the frame into the curses screen and refreshes
+void curses_output_frame(const framebuffer *fb);
+
+#endif
@@ -0,0 +1,231 @@
+#include "texture.h"
+#include <libgen.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reads a decimal header field or plain sample, skipping whitespace and
+// comments. Returns -1 when there is none.
+static long read_number(const unsigned char *data, size_t size, size_t *pos) {
+  while (*pos < size) {
+    unsigned char c = data[*pos];
+    if (c == '#') {
+      while (*pos < size && data[*pos] != '\n')
+        ++*pos;
+    } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      ++*pos;
+    } else {
+      break;
+    }
+  }
+  if (*pos >= size || data[*pos] < '0' || data[*pos] > '9')
+    return -1;
+  long value = 0;
+  while (*pos < size && data[*pos] >= '0' && data[*pos] <= '9') {
+    value = value * 10 + (data[*pos] - '0');
+    if (value > 1 << 24)
+      return -1;
+    ++*pos;
+  }
+  return value;
+}
+
+// Halves the previous level with a 2x2 box filter; odd edges repeat their
+// last row or column
+static void build_mipmaps(texture *t) {
+  for (int level = 1; level < t->levels; ++level) {
+    const uint8_t *src = t->texels + t->offsets[level - 1];
+    uint8_t *dst = t->texels + t->offsets[level];
+    int sw = texture_level_width(t, level - 1);
+    int sh = texture_level_height(t, level - 1);
+    int w = texture_level_width(t, level), h = texture_level_height(t, level);
+    for (int y = 0; y < h; ++y) {
+      int y0 = 2 * y < sh ? 2 * y : sh - 1;
+      int y1 = 2 * y + 1 < sh ? 2 * y + 1 : y0;
+      for (int x = 0; x < w; ++x) {
+        int x0 = 2 * x < sw ? 2 * x : sw - 1;
+        int x1 = 2 * x + 1 < sw ? 2 * x + 1 : x0;
+        int sum = src[y0 * sw + x0] + src[y0 * sw + x1] + src[y1 * sw + x0] +
+                  src[y1 * sw + x1];
+        dst[y * w + x] = (uint8_t)((sum + 2) / 4);
+      }
+    }
+  }
+}
+
+int texture_decode_pnm(texture *t, const unsigned char *data, size_t size) {
+  memset(t, 0, sizeof(*t));
+  if (size < 2 || data[0] != 'P')
+    return 0;
+  char kind = (char)data[1];
+  bool plain = kind == '2' || kind == '3';
+  bool rgb = kind == '3' || kind == '6';
+  if (kind != '2' && kind != '3' && kind != '5' && kind != '6')
+    return 0;
+  size_t pos = 2;
+  long width = read_number(data, size, &pos);
+  long height = read_number(data, size, &pos);
+  long maxval = read_number(data, size, &pos);
+  if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535 ||
+      width > 32768 || height > 32768)
+    return 0;
+  // a single whitespace byte separates the header from binary samples
+  ++pos;
+
+  int channels = rgb ? 3 : 1;
+  int sample_bytes = maxval > 255 ? 2 : 1;
+  size_t texel_count = (size_t)width * (size_t)height;
+  if (!plain && (pos > size || (size - pos) / channels / sample_bytes <
+                                   texel_count))
+    return 0;
+
+  t->width = (int)width;
+  t->height = (int)height;
+  size_t total = 0;
+  while (t->levels < TEXTURE_MAX_LEVELS) {
+    t->offsets[t->levels] = total;
+    total += (size_t)texture_level_width(t, t->levels) *
+             texture_level_height(t, t->levels);
+    if (texture_level_width(t, t->levels) == 1 &&
+        texture_level_height(t, t->levels) == 1) {
+      t->levels++;
+      break;
+    }
+    t->levels++;
+  }
+  t->texels = malloc(total);
+  if (t->texels == NULL)
+    return 0;
+
+  for (size_t i = 0; i < texel_count; ++i) {
+    long c[3];
+    for (int k = 0; k < channels; ++k) {
+      if (plain) {
+        c[k] = read_number(data, size, &pos);
+        if (c[k] < 0) {
+          texture_free(t);
+          return 0;
+        }
+      } else if (sample_bytes == 2) {
+        c[k] = data[pos] << 8 | data[pos + 1];
+        pos += 2;
+      } else {
+        c[k] = data[pos++];
+      }
+      if (c[k] > maxval)
+        c[k] = maxval;
+    }
+    // Rec. 601 luma, scaled to 0-255
+    long luma = rgb ? (299 * c[0] + 587 * c[1] + 114 * c[2]) / 1000 : c[0];
+    t->texels[i] = (uint8_t)((luma * 255 + maxval / 2) / maxval);
+  }
+  build_mipmaps(t);
+  return 1;
+}
+
+int texture_load(texture *t, const char *path, bool quiet) {
+  memset(t, 0, sizeof(*t));
+  FILE *in = fopen(path, "rb");
+  if (in == NULL)
+    return 0;
+  unsigned char *data = NULL;
+  long size = -1;
+  if (fseek(in, 0, SEEK_END) == 0 && (size = ftell(in)) > 0 &&
+      fseek(in, 0, SEEK_SET) == 0 && (data = malloc((size_t)size)) != NULL &&
+      fread(data, 1, (size_t)size, in) != (size_t)size)
+    size = -1;
+  fclose(in);
+  int ok = data != NULL && size > 0 &&
+           texture_decode_pnm(t, data, (size_t)size);
+  if (!ok && !quiet)
+    fprintf(stderr, "Could not decode texture %s, only PGM/PPM are read\n",
+            path);
+  free(data);
+  return ok;
+}
+
+void texture_free(texture *t) {
+  free(t->texels);
+  memset(t, 0, sizeof(*t));
+}
+
+// Opens the texture as given, or next to the model
+static int load_texture_file(texture *t, const char *name,
+                             const char *model_filename, bool quiet) {
+  FILE *probe = fopen(name, "rb");
+  if (probe != NULL) {
+    fclose(probe);
+    return texture_load(t, name, quiet);
+  }
+  char *dir_copy = strdup(model_filename);
+  if (dir_copy == NULL)
+    return 0;
+  size_t length = strlen(dir_copy) + strlen(name) + 2;
+  char *path = malloc(length);
+  int ok = 0;
+  if (path != NULL) {
+    snprintf(path, length, "%s/%s", dirname(dir_copy), name);
+    probe = fopen(path, "rb");
+    if (probe != NULL) {
+      fclose(probe);
+      ok = texture_load(t, path, quiet);
+    } else if (!quiet) {
+      fprintf(stderr, "Texture %s not found\n", name);
+    }
+  }
+  free(path);
+  free(dir_copy);
+  return ok;
+}
+
+int texture_set_load(texture_set *s, const struct obj_scene_data *model,
+                     const char *model_filename, bool quiet) {
+  memset(s, 0, sizeof(*s));
+  int count = model->material_count;
+  s->material_count = count;
+  s->material_texture = malloc(sizeof(int) * (count + 1));
+  s->textures = malloc(sizeof(texture) * (count + 1));
+  // every distinct name tried so far and the texture it gave, -1 when it
+  // failed; names are interned, so materials sharing an image share the
+  // pointer
+  const char **tried = malloc(sizeof(char *) * (count + 1));
+  int *result = malloc(sizeof(int) * (count + 1));
+  if (s->material_texture == NULL || s->textures == NULL || tried == NULL ||
+      result == NULL) {
+    free(tried);
+    free(result);
+    texture_set_free(s);
+    return 0;
+  }
+  int tried_count = 0;
+  for (int m = 0; m < count; ++m) {
+    const char *name = model->material_list[m]->texture_filename;
+    s->material_texture[m] = -1;
+    if (name == NULL || name[0] == '\0')
+      continue;
+    int i = 0;
+    while (i < tried_count && tried[i] != name)
+      ++i;
+    if (i == tried_count) {
+      tried[tried_count] = name;
+      result[tried_count++] =
+          load_texture_file(&s->textures[s->texture_count], name,
+                            model_filename, quiet)
+              ? s->texture_count++
+              : -1;
+    }
+    s->material_texture[m] = result[i];
+  }
+  free(tried);
+  free(result);
+  return 1;
+}
+
+void texture_set_free(texture_set *s) {
+  for (int i = 0; i < s->texture_count; ++i)
+    texture_free(&s->textures[i]);
+  free(s->textures);
+  free(s->material_texture);
+  memset(s, 0, sizeof(*s));
+}
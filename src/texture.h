@@ -0,0 +1,86 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include "obj_parser.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// enough levels for a 32768 texel wide image
+#define TEXTURE_MAX_LEVELS 16
+
+// A decoded image as 8-bit luminance with its mipmaps. All levels share one
+// allocation, largest first, each level row-major; sampling a minified
+// texture reads a level about as dense as the cells it lands on, so
+// neighbouring cells touch neighbouring texels.
+typedef struct texture {
+  int width; // of level 0
+  int height;
+  int levels;
+  uint8_t *texels;
+  size_t offsets[TEXTURE_MAX_LEVELS]; // where each level starts in texels
+} texture;
+
+// Decodes a binary or plain PGM (P5, P2) or PPM (P6, P3) image and builds
+// its mipmaps. Returns 0 on malformed data or when out of memory.
+int texture_decode_pnm(texture *t, const unsigned char *data, size_t size);
+// Reads and decodes a PGM/PPM file, printing why it could not unless `quiet`
+int texture_load(texture *t, const char *path, bool quiet);
+void texture_free(texture *t);
+
+static inline int texture_level_width(const texture *t, int level) {
+  int w = t->width >> level;
+  return w > 0 ? w : 1;
+}
+static inline int texture_level_height(const texture *t, int level) {
+  int h = t->height >> level;
+  return h > 0 ? h : 1;
+}
+
+// Nearest texel of `level` at (u, v), repeating outside [0, 1). v grows
+// upwards as in OBJ files, images are stored top row first.
+static inline uint8_t texture_sample(const texture *t, int level, float u,
+                                     float v) {
+  int w = texture_level_width(t, level), h = texture_level_height(t, level);
+  int x = (int)((u - floorf(u)) * w), y = (int)((v - floorf(v)) * h);
+  // rounding can land exactly on 1
+  x = x < w ? x : w - 1;
+  y = h - 1 - (y < h ? y : h - 1);
+  return t->texels[t->offsets[level] + (size_t)y * w + x];
+}
+
+// The textures of a model's materials. Each image is decoded once however
+// many materials refer to it.
+typedef struct texture_set {
+  texture *textures;
+  int texture_count;
+  int *material_texture; // per material: index into textures, or -1
+  int material_count;
+} texture_set;
+
+// Loads every map_Ka of `model`. Paths are tried as given, like mtllib,
+// then next to `model_filename`. Materials whose image is missing or not a
+// PGM/PPM are left untextured, and reported unless `quiet`. Returns 0 only
+// when out of memory.
+int texture_set_load(texture_set *s, const struct obj_scene_data *model,
+                     const char *model_filename, bool quiet);
+void texture_set_free(texture_set *s);
+// The texture of a material, or NULL
+static inline const texture *texture_set_get(const texture_set *s,
+                                             int material_index) {
+  if (material_index < 0 || material_index >= s->material_count ||
+      s->material_texture[material_index] < 0)
+    return NULL;
+  return &s->textures[s->material_texture[material_index]];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
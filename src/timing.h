@@ -0,0 +1,13 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <time.h>
+
+// Monotonic wall clock in seconds, for frame pacing and stage timings
+static inline double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+#endif
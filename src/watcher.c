@@ -0,0 +1,144 @@
+#include "watcher.h"
+#include <libgen.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Editors and exporters often touch a file several times in a row, wait for
+// this long without events before re-parsing
+#define RELOAD_SETTLE_MS 50
+#define POLL_INTERVAL_MS 100
+
+static void free_model(loaded_model *m) {
+  if (m == NULL)
+    return;
+  loaded_model_free(m);
+  free(m);
+}
+
+static int is_relevant(const model_watcher *w,
+                       const struct inotify_event *event) {
+  if (event->len == 0)
+    return 0;
+  if (strcmp(event->name, w->file_basename) == 0)
+    return 1;
+  size_t len = strlen(event->name);
+  return len > 4 && strcmp(event->name + len - 4, ".mtl") == 0;
+}
+
+// Drains the inotify queue, returns 1 if anything we care about changed
+static int read_events(model_watcher *w) {
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  int changed = 0;
+  ssize_t len;
+  while ((len = read(w->inotify_fd, buffer, sizeof(buffer))) > 0) {
+    for (char *p = buffer; p < buffer + len;) {
+      const struct inotify_event *event = (const struct inotify_event *)p;
+      changed |= is_relevant(w, event);
+      p += sizeof(struct inotify_event) + event->len;
+    }
+  }
+  return changed;
+}
+
+static void reload(model_watcher *w) {
+  loaded_model *m = malloc(sizeof(loaded_model));
+  if (m == NULL)
+    return;
+  // the render loop owns the terminal, nothing may be printed from here
+  if (!loaded_model_load(m, w->filename, &w->mtl_cache, true)) {
+    // keep rendering the old model, a half-written file is retried on the
+    // next change event
+    free(m);
+    return;
+  }
+  if (w->textured && !loaded_model_load_textures(m, w->filename, true)) {
+    free_model(m);
+    return;
+  }
+  // a model that was never picked up is simply replaced
+  free_model(atomic_exchange(&w->pending, m));
+}
+
+static void *watch_thread(void *arg) {
+  model_watcher *w = arg;
+  struct pollfd pfd = {.fd = w->inotify_fd, .events = POLLIN};
+  int dirty = 0;
+
+  while (!atomic_load(&w->stop)) {
+    free_model(atomic_exchange(&w->retired, NULL));
+
+    int timeout = dirty ? RELOAD_SETTLE_MS : POLL_INTERVAL_MS;
+    int ready = poll(&pfd, 1, timeout);
+    if (ready > 0) {
+      dirty |= read_events(w);
+    } else if (ready == 0 && dirty) {
+      dirty = 0;
+      reload(w);
+    }
+  }
+  return NULL;
+}
+
+void model_watcher_init(model_watcher *w, const char *filename) {
+  w->filename = strdup(filename);
+  char *dir_copy = strdup(filename);
+  w->directory = strdup(dirname(dir_copy));
+  free(dir_copy);
+  const char *slash = strrchr(w->filename, '/');
+  w->file_basename = slash ? slash + 1 : w->filename;
+  w->inotify_fd = -1;
+  atomic_init(&w->stop, false);
+  atomic_init(&w->pending, NULL);
+  atomic_init(&w->retired, NULL);
+  obj_mtl_cache_init(&w->mtl_cache);
+  w->textured = false;
+}
+
+int model_watcher_start(model_watcher *w) {
+  // watch the directory, not the file: saving via rename replaces the inode
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0 || inotify_add_watch(fd, w->directory,
+                                  IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    perror("inotify");
+    if (fd >= 0)
+      close(fd);
+    return 0;
+  }
+  w->inotify_fd = fd;
+  if (pthread_create(&w->thread, NULL, watch_thread, w) != 0) {
+    close(fd);
+    w->inotify_fd = -1;
+    return 0;
+  }
+  return 1;
+}
+
+void model_watcher_stop(model_watcher *w) {
+  if (w->inotify_fd >= 0) {
+    atomic_store(&w->stop, true);
+    pthread_join(w->thread, NULL);
+    close(w->inotify_fd);
+    w->inotify_fd = -1;
+  }
+  free_model(atomic_exchange(&w->pending, NULL));
+  free_model(atomic_exchange(&w->retired, NULL));
+  obj_mtl_cache_free(&w->mtl_cache);
+  free(w->filename);
+  free(w->directory);
+  w->filename = NULL;
+  w->directory = NULL;
+}
+
+loaded_model *model_watcher_take(model_watcher *w) {
+  return atomic_exchange(&w->pending, NULL);
+}
+
+void model_watcher_retire(model_watcher *w, loaded_model *m) {
+  // if the watcher has not freed the previous one yet, do it here
+  free_model(atomic_exchange(&w->retired, m));
+}
@@ -0,0 +1,39 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include "model.h"
+#include "obj_parser.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Watches a model file with inotify and re-parses it on a background thread
+// whenever it (or a material library next to it) is rewritten. The render
+// loop picks finished models up with model_watcher_take, so a reload never
+// stalls a frame.
+typedef struct model_watcher {
+  char *filename;
+  char *directory;
+  const char *file_basename;
+  int inotify_fd;
+  pthread_t thread;
+  atomic_bool stop;
+  _Atomic(loaded_model *) pending; // parsed, not yet picked up
+  _Atomic(loaded_model *) retired; // swapped out, freed by the watcher
+  obj_mtl_cache mtl_cache;         // only touched by the watcher thread
+  bool textured;                   // reloads also decode the textures
+} model_watcher;
+
+// The material cache is usable right after init, so the first load can
+// fill it before the background thread is started
+void model_watcher_init(model_watcher *w, const char *filename);
+int model_watcher_start(model_watcher *w);
+// Joins the thread (if started) and frees everything the watcher owns
+void model_watcher_stop(model_watcher *w);
+// Returns a newly loaded model or NULL. The caller owns the result.
+loaded_model *model_watcher_take(model_watcher *w);
+// Hands a model that is no longer rendered back so it is freed off the
+// render thread.
+void model_watcher_retire(model_watcher *w, loaded_model *m);
+
+#endif
@@ -0,0 +1,111 @@
+#include "bounds.h"
+#include "test_util.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A model with only vertices, which is all the bounds look at
+static void make_points(struct obj_scene_data *model, int count) {
+  memset(model, 0, sizeof(*model));
+  model->vertex_count = count;
+  model->vertex_list = malloc(sizeof(obj_vector *) * (size_t)count);
+  for (int i = 0; i < count; ++i) {
+    model->vertex_list[i] = malloc(sizeof(obj_vector));
+    // spread over [-300, 500] x [0, 200] x [-1000, -999]
+    double t = (double)i / (count - 1);
+    model->vertex_list[i]->e[0] = -300 + 800 * t;
+    model->vertex_list[i]->e[1] = 200 * fmod(t * 7, 1.0);
+    model->vertex_list[i]->e[2] = -1000 + t * t;
+  }
+}
+
+static void free_points(struct obj_scene_data *model) {
+  for (int i = 0; i < model->vertex_count; ++i)
+    free(model->vertex_list[i]);
+  free(model->vertex_list);
+}
+
+static void test_box_and_centroid(void) {
+  struct obj_scene_data model;
+  make_points(&model, 101);
+  model_bounds b;
+  model_bounds_compute(&b, &model, 1);
+  CHECK(b.min[0] == -300 && b.max[0] == 500);
+  CHECK(b.min[1] == 0 && b.max[1] < 200);
+  CHECK(b.min[2] == -1000 && b.max[2] == -999);
+  CHECK(fabs(b.centroid[0] - 100) < 1e-9);
+  free_points(&model);
+}
+
+// Every split of the vertices gives the same box and, up to rounding, the
+// same centroid
+static void test_threads_agree(void) {
+  struct obj_scene_data model;
+  make_points(&model, 200000);
+  model_bounds one, many;
+  model_bounds_compute(&one, &model, 1);
+  model_bounds_compute(&many, &model, 7);
+  for (int k = 0; k < 3; ++k) {
+    CHECK(one.min[k] == many.min[k]);
+    CHECK(one.max[k] == many.max[k]);
+    CHECK(fabs(one.centroid[k] - many.centroid[k]) < 1e-9);
+  }
+  free_points(&model);
+}
+
+// Whatever its size and position, a fitted model ends up around the origin
+// with MODEL_FIT_RADIUS
+static void test_fit(void) {
+  struct obj_scene_data model;
+  make_points(&model, 100000);
+  float scale = center_and_scale_model(&model, MODEL_SCALE_FIT, false);
+  CHECK(scale > 0);
+  model_bounds b;
+  model_bounds_compute(&b, &model, 0);
+  for (int k = 0; k < 3; ++k)
+    CHECK(fabs(b.centroid[k]) < 1e-6);
+  CHECK(fabs(b.radius - MODEL_FIT_RADIUS) < 1e-5);
+  free_points(&model);
+
+  // a fixed scale is applied as given
+  make_points(&model, 11);
+  CHECK(center_and_scale_model(&model, 0.5f, false) == 0.5f);
+  model_bounds_compute(&b, &model, 1);
+  CHECK(fabs(b.max[0] - b.min[0] - 400) < 1e-9);
+  free_points(&model);
+}
+
+static void test_empty(void) {
+  struct obj_scene_data model;
+  memset(&model, 0, sizeof(model));
+  model_bounds b;
+  model_bounds_compute(&b, &model, 0);
+  CHECK(b.radius == 0 && b.centroid[0] == 0 && b.min[0] == 0);
+  CHECK(center_and_scale_model(&model, MODEL_SCALE_FIT, false) == 1.f);
+}
+
+// A point no face uses, like the camera position of cornell_box.obj, is
+// left out of the fit
+static void test_unused_vertices(void) {
+  struct obj_scene_data model;
+  CHECK(parse_obj_scene(&model, (char *)write_temp_file(
+                                    "v 0 0 0\nv 2 0 0\nv 2 2 0\n"
+                                    "v 278 273 -800\nv 0 2 0\n"
+                                    "f 1 2 3 5\n")));
+  model_bounds b;
+  model_bounds_compute(&b, &model, 1);
+  CHECK(b.min[2] == 0 && b.max[0] == 2 && b.max[1] == 2);
+  CHECK(fabs(b.centroid[0] - 1) < 1e-9 && fabs(b.centroid[1] - 1) < 1e-9);
+  CHECK(fabs(b.radius - sqrt(2)) < 1e-9);
+  delete_obj_data(&model);
+}
+
+int main(void) {
+  RUN_TEST(test_box_and_centroid);
+  RUN_TEST(test_threads_agree);
+  RUN_TEST(test_fit);
+  RUN_TEST(test_empty);
+  RUN_TEST(test_unused_vertices);
+  remove_temp_files();
+  return test_failures();
+}
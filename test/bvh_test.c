@@ -0,0 +1,158 @@
+#include "bvh.h"
+#include "obj_parser.h"
+#include "render.h"
+#include "test_util.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A bumpy (n x n) grid of triangles, so splits happen on every axis
+static const char *bumpy_grid(int n) {
+  size_t size = (size_t)(n + 1) * (n + 1) * 64 + (size_t)n * n * 96;
+  char *text = malloc(size);
+  size_t used = 0;
+  for (int y = 0; y <= n; ++y)
+    for (int x = 0; x <= n; ++x)
+      used += sprintf(text + used, "v %f %f %f\n", (double)x / n - 0.5,
+                      (double)y / n - 0.5, 0.1 * sin(x * 0.7) * cos(y * 0.3));
+  for (int y = 0; y < n; ++y) {
+    for (int x = 0; x < n; ++x) {
+      int a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 1, d = c + 1;
+      used += sprintf(text + used, "f %d %d %d\nf %d %d %d\n", a, b, d, a, d,
+                      c);
+    }
+  }
+  const char *path = write_temp_file(text);
+  free(text);
+  return path;
+}
+
+static void face_box(const obj_scene_data *scene, int face, float *min,
+                     float *max) {
+  for (int k = 0; k < 3; ++k) {
+    min[k] = FLT_MAX;
+    max[k] = -FLT_MAX;
+  }
+  const obj_face *f = scene->face_list[face];
+  for (int j = 0; j < f->vertex_count; ++j)
+    for (int k = 0; k < 3; ++k) {
+      float v = (float)scene->vertex_list[f->vertex_index[j]]->e[k];
+      min[k] = fminf(min[k], v);
+      max[k] = fmaxf(max[k], v);
+    }
+}
+
+static void test_structure(void) {
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, (char *)bumpy_grid(60)));
+  bvh b;
+  CHECK(bvh_build(&b, &scene, 4));
+  CHECK_EQ_INT(b.face_count, scene.face_count);
+  CHECK(b.node_count <= 2 * scene.face_count - 1);
+
+  // every face is referenced by exactly one leaf that contains its bounds
+  int *seen = calloc(scene.face_count, sizeof(int));
+  for (int i = 0; i < b.node_count; ++i) {
+    const bvh_node *node = &b.nodes[i];
+    for (int32_t j = 0; j < node->count; ++j) {
+      int face = b.face_indices[node->first + j];
+      seen[face]++;
+      float min[3], max[3];
+      face_box(&scene, face, min, max);
+      for (int k = 0; k < 3; ++k)
+        CHECK(min[k] >= node->min[k] && max[k] <= node->max[k]);
+    }
+  }
+  for (int i = 0; i < scene.face_count; ++i)
+    CHECK_EQ_INT(seen[i], 1);
+  free(seen);
+  bvh_free(&b);
+  delete_obj_data(&scene);
+}
+
+static int vertex_in_view(const bvh_view *view, const double *e) {
+  for (int p = 0; p < view->plane_count; ++p) {
+    const float *n = view->planes[p];
+    if (n[0] * e[0] + n[1] * e[1] + n[2] * e[2] + n[3] > 0)
+      return 0;
+  }
+  return 1;
+}
+
+static void test_culling_is_conservative(void) {
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, (char *)bumpy_grid(40)));
+  bvh b;
+  CHECK(bvh_build(&b, &scene, 1));
+  int32_t *visible = malloc(sizeof(int32_t) * scene.face_count);
+  int *listed = malloc(sizeof(int) * scene.face_count);
+
+  for (int step = 0; step < 8; ++step) {
+    float R[3][3];
+    rotation_matrix(R, 0.2f * step, 0.5f * step, 0.1f);
+    // close enough that part of the grid falls outside the view
+    const float t[3] = {0.3f, 0, 0.6f};
+    bvh_view view;
+    bvh_view_from_transform(&view, R, t, 80, 0);
+    int count = bvh_collect_visible(&b, &view, visible);
+    memset(listed, 0, sizeof(int) * scene.face_count);
+    for (int i = 0; i < count; ++i)
+      listed[visible[i]] = 1;
+    CHECK(count < scene.face_count);
+    for (int f = 0; f < scene.face_count; ++f) {
+      const obj_face *face = scene.face_list[f];
+      for (int j = 0; j < face->vertex_count; ++j)
+        if (vertex_in_view(&view, scene.vertex_list[face->vertex_index[j]]->e))
+          CHECK(listed[f]);
+    }
+  }
+  free(listed);
+  free(visible);
+  bvh_free(&b);
+  delete_obj_data(&scene);
+}
+
+static void test_pick_matches_brute_force(void) {
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, (char *)bumpy_grid(30)));
+  bvh b;
+  CHECK(bvh_build(&b, &scene, 2));
+
+  for (int i = 0; i < 50; ++i) {
+    float origin[3] = {-0.45f + 0.018f * i, 0.4f - 0.015f * i, 2.f};
+    float dir[3] = {0.01f, -0.02f, -1.f};
+    float t;
+    int hit = bvh_pick(&b, &scene, origin, dir, &t);
+    CHECK(hit >= 0);
+
+    // brute force: a one-leaf hierarchy per face
+    int best = -1;
+    float best_t = FLT_MAX;
+    for (int f = 0; f < scene.face_count; ++f) {
+      bvh one;
+      one.nodes = &(bvh_node){{-1e9f, -1e9f, -1e9f}, {1e9f, 1e9f, 1e9f}, 0, 1};
+      one.node_count = 1;
+      one.face_indices = &(int32_t){f};
+      one.face_count = 1;
+      float ft;
+      if (bvh_pick(&one, &scene, origin, dir, &ft) == f && ft < best_t) {
+        best_t = ft;
+        best = f;
+      }
+    }
+    CHECK_EQ_INT(hit, best);
+    CHECK(fabsf(t - best_t) < 1e-5f);
+  }
+  bvh_free(&b);
+  delete_obj_data(&scene);
+}
+
+int main(void) {
+  RUN_TEST(test_structure);
+  RUN_TEST(test_culling_is_conservative);
+  RUN_TEST(test_pick_matches_brute_force);
+  remove_temp_files();
+  return test_failures();
+}
@@ -0,0 +1,179 @@
+#include "chunks.h"
+#include "framebuffer.h"
+#include "model.h"
+#include "orientation.h"
+#include "test_util.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// A wavy grid of side x side quads, enough for several chunks while the
+// chunks stay within 16-bit corners, and a far point no face uses, which
+// the fit leaves out
+static const char *write_grid(int side) {
+  size_t size = (size_t)(side + 1) * (side + 1) * 48 + (size_t)side * side * 40;
+  char *obj = malloc(size);
+  size_t n = snprintf(obj, size, "v 1000 -500 300\n");
+  for (int y = 0; y <= side; ++y)
+    for (int x = 0; x <= side; ++x)
+      n += snprintf(obj + n, size - n, "v %d %d %f\n", x, y,
+                    (double)((x * 7 + y * 3) % 11) / 4);
+  for (int y = 0; y < side; ++y) {
+    for (int x = 0; x < side; ++x) {
+      int v = y * (side + 1) + x + 2;
+      n += snprintf(obj + n, size - n, "f %d %d %d %d\n", v, v + 1,
+                    v + side + 2, v + side + 1);
+    }
+  }
+  const char *path = write_temp_file(obj);
+  free(obj);
+  return path;
+}
+
+// Builds the chunk file for obj_path into a fresh temporary file
+static const char *build(const char *obj_path, chunk_build_stats *stats) {
+  const char *path = write_temp_file("");
+  CHECK(chunks_build(obj_path, path, stats));
+  return path;
+}
+
+static void view_at(model_view *view, int step) {
+  memset(view, 0, sizeof(*view));
+  quat q = quat_from_euler(0.7f * step, 0.4f * step, 0.1f * step);
+  quat_to_matrix(q, view->rotation);
+  view->distance = MODEL_DISTANCE;
+}
+
+static void test_build_stats(void) {
+  const char *obj = write_temp_file("v 0 0 0\nv 1 0 0\nv 1 1 0\n"
+                                    "v 0 1 0\nv 0.5 1.5 0\n"
+                                    "f 1 2 3\n"
+                                    "f 1 2 3 4\n"
+                                    "f 1 2 3 5 4\n"  // fan of three
+                                    "f -3 -2 -1\n"   // relative
+                                    "f 1 2 9\n"      // no such vertex
+                                    "f 1 2\n");      // not a face
+  chunk_build_stats stats;
+  build(obj, &stats);
+  CHECK_EQ_INT(stats.vertices, 5);
+  CHECK_EQ_INT(stats.faces, 6);
+  CHECK_EQ_INT(stats.dropped_faces, 2);
+  CHECK_EQ_INT(stats.chunks, 1);
+}
+
+// At full detail every face is drawn where the loaded model draws it
+static void test_matches_loaded_model(void) {
+  const char *obj = write_grid(80);
+  chunk_build_stats stats;
+  const char *path = build(obj, &stats);
+  CHECK_EQ_INT(stats.faces, 80 * 80);
+  CHECK(stats.chunks > 1);
+
+  loaded_model loaded;
+  CHECK(loaded_model_load(&loaded, obj, NULL, false));
+  chunked_model chunked;
+  CHECK(chunked_model_open(&chunked, path, CHUNK_DEFAULT_BUDGET));
+  const framebuffer_mode modes[] = {FRAMEBUFFER_ASCII, FRAMEBUFFER_BRAILLE};
+  for (int m = 0; m < 2; ++m) {
+    framebuffer a, b;
+    CHECK(framebuffer_init(&a, 80, 24) && framebuffer_init(&b, 80, 24));
+    CHECK(framebuffer_set_mode(&a, modes[m]));
+    CHECK(framebuffer_set_mode(&b, modes[m]));
+    for (int step = 0; step < 4; ++step) {
+      model_view view;
+      view_at(&view, step);
+      CHECK(loaded_model_draw(&loaded, &a, &view, NULL));
+      CHECK(chunked_model_draw(&chunked, &b, &view, NULL));
+      CHECK(framebuffer_checksum(&a) == framebuffer_checksum(&b));
+      // unchanged views are not redrawn
+      CHECK_EQ_INT(chunked_model_draw(&chunked, &b, &view, NULL), 0);
+    }
+    framebuffer_free(&a);
+    framebuffer_free(&b);
+  }
+  CHECK_EQ_INT(chunked.counters.skipped, 0);
+  chunked_model_close(&chunked);
+  loaded_model_free(&loaded);
+}
+
+static void test_budget(void) {
+  const char *path = build(write_grid(120), NULL);
+  chunked_model chunked;
+  CHECK(chunked_model_open(&chunked, path, CHUNK_DEFAULT_BUDGET));
+  // room for about one chunk in full
+  size_t budget = chunked.chunks[0].bytes[CHUNK_LEVELS - 1] +
+                  2 * chunked.page_size;
+  chunked_model_close(&chunked);
+  CHECK(chunked_model_open(&chunked, path, budget));
+  CHECK(chunked.header.chunk_count >= 4);
+
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 80, 24));
+  for (int step = 0; step < 8; ++step) {
+    model_view view;
+    view_at(&view, step);
+    chunked_model_draw(&chunked, &fb, &view, NULL);
+    CHECK(chunked.mapped_bytes <= budget);
+  }
+  CHECK(chunked.counters.peak_bytes <= budget);
+  CHECK(chunked.counters.evictions > 0);
+  CHECK(chunked.counters.drawn > 0);
+  framebuffer_free(&fb);
+  chunked_model_close(&chunked);
+}
+
+static void test_level_of_detail(void) {
+  const char *path = build(write_grid(120), NULL);
+  long long faces[2];
+  for (int coarse = 0; coarse < 2; ++coarse) {
+    chunked_model chunked;
+    CHECK(chunked_model_open(&chunked, path, CHUNK_DEFAULT_BUDGET));
+    framebuffer fb;
+    CHECK(framebuffer_init(&fb, 80, 24));
+    model_view view;
+    view_at(&view, 1);
+    view.lod_pixels = coarse ? 50 : 0;
+    CHECK(chunked_model_draw(&chunked, &fb, &view, NULL));
+    faces[coarse] = chunked.counters.faces_drawn;
+    framebuffer_free(&fb);
+    chunked_model_close(&chunked);
+  }
+  CHECK_EQ_INT(faces[0], 120 * 120);
+  CHECK(faces[1] < faces[0]);
+  CHECK(faces[1] > 0);
+}
+
+static void test_bad_files(void) {
+  chunked_model chunked;
+  CHECK(!chunked_model_open(&chunked, "/nonexistent/model.chunks",
+                            CHUNK_DEFAULT_BUDGET));
+  CHECK(!chunked_model_open(&chunked, write_temp_file("v 0 0 0\n"),
+                            CHUNK_DEFAULT_BUDGET));
+  // a chunk reaching past its data
+  const char *path = build(write_grid(20), NULL);
+  CHECK(chunked_model_open(&chunked, path, CHUNK_DEFAULT_BUDGET));
+  uint64_t directory = chunked.header.directory_offset;
+  chunked_model_close(&chunked);
+  FILE *f = fopen(path, "r+b");
+  CHECK(f != NULL);
+  uint32_t bytes = UINT32_MAX;
+  fseek(f, (long)(directory + offsetof(chunk_info, bytes)), SEEK_SET);
+  fwrite(&bytes, sizeof(bytes), 1, f);
+  fclose(f);
+  CHECK(!chunked_model_open(&chunked, path, CHUNK_DEFAULT_BUDGET));
+  // the directory is at the end, cut off here
+  CHECK(truncate(path, (off_t)directory + 8) == 0);
+  CHECK(!chunked_model_open(&chunked, path, CHUNK_DEFAULT_BUDGET));
+}
+
+int main(void) {
+  RUN_TEST(test_build_stats);
+  RUN_TEST(test_matches_loaded_model);
+  RUN_TEST(test_budget);
+  RUN_TEST(test_level_of_detail);
+  RUN_TEST(test_bad_files);
+  remove_temp_files();
+  return test_failures();
+}
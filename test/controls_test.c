@@ -0,0 +1,34 @@
+#include "controls.h"
+#include "test_util.h"
+#include <curses.h>
+
+static void test_keys_move_the_camera(void) {
+  view_controls c;
+  view_controls_init(&c, 1.5f);
+  CHECK(view_controls_key(&c, KEY_RIGHT));
+  CHECK(view_controls_key(&c, 'w'));
+  CHECK(view_controls_key(&c, ']'));
+  CHECK(c.pitch > 0 && c.roll < 0 && c.yaw > 0);
+
+  // zooming in stops before the camera reaches the model
+  for (int i = 0; i < 100; ++i)
+    view_controls_key(&c, '+');
+  CHECK(c.distance > 0);
+  CHECK(view_controls_key(&c, '-'));
+
+  CHECK(view_controls_key(&c, ' '));
+  CHECK(c.paused);
+  CHECK(view_controls_key(&c, 'r'));
+  CHECK(c.pitch == 0 && c.roll == 0 && c.yaw == 0 && c.distance == 1.5f);
+  CHECK(c.paused);
+
+  CHECK(!view_controls_key(&c, 'z'));
+  CHECK(!c.quit);
+  CHECK(view_controls_key(&c, 'q'));
+  CHECK(c.quit);
+}
+
+int main(void) {
+  RUN_TEST(test_keys_move_the_camera);
+  return test_failures();
+}
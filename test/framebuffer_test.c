@@ -0,0 +1,95 @@
+#include "framebuffer.h"
+#include "test_util.h"
+#include <string.h>
+
+static void test_resize_reuses_capacity(void) {
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 80, 24));
+  char *cells = fb.cells;
+
+  // shrinking, and growing back within the old size, keeps the buffer
+  CHECK(framebuffer_resize(&fb, 60, 20));
+  CHECK(fb.cells == cells);
+  CHECK(framebuffer_resize(&fb, 80, 24));
+  CHECK(fb.cells == cells);
+  CHECK_EQ_INT(fb.width, 80);
+  CHECK_EQ_INT(fb.height, 24);
+
+  CHECK(framebuffer_resize(&fb, 200, 60));
+  CHECK(fb.capacity >= 200 * 60);
+  framebuffer_clear(&fb, '.');
+  framebuffer_put(&fb, 59, 199, 'x');
+  CHECK(fb.cells[59 * 200 + 199] == 'x');
+  // writes outside the new size are dropped
+  framebuffer_put(&fb, 60, 0, 'x');
+  framebuffer_free(&fb);
+}
+
+static void test_subcell_encoding(void) {
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 12, 2));
+  CHECK(framebuffer_set_mode(&fb, FRAMEBUFFER_BRAILLE));
+  framebuffer_clear(&fb, ' ');
+  // top left dot of cell 0, the bottom right dot of cell 10, past the
+  // first run of eight cells, and a full cell 11
+  framebuffer_put_dot(&fb, 0, 0);
+  framebuffer_put_dot(&fb, 21, 3);
+  for (int y = 0; y < 4; ++y)
+    for (int x = 22; x < 24; ++x)
+      framebuffer_put_dot(&fb, x, y);
+  framebuffer_put_dot(&fb, 24, 0); // outside, dropped
+
+  char out[12 * FRAMEBUFFER_MAX_CELL_BYTES];
+  size_t n = framebuffer_encode_row(&fb, 0, 12, out);
+  const char braille[] = "\u2801         \u2880\u28ff";
+  CHECK_EQ_INT(n, strlen(braille));
+  CHECK(memcmp(out, braille, n) == 0);
+  CHECK_EQ_INT(framebuffer_encode_row(&fb, 1, 12, out), 12);
+
+  CHECK(framebuffer_set_mode(&fb, FRAMEBUFFER_BLOCKS));
+  n = framebuffer_encode_row(&fb, 0, 12, out);
+  const char blocks[] = "\u2580         \u2584\u2588";
+  CHECK_EQ_INT(n, strlen(blocks));
+  CHECK(memcmp(out, blocks, n) == 0);
+
+  // clipped to the requested number of columns
+  CHECK_EQ_INT(framebuffer_encode_row(&fb, 0, 3, out), 5);
+  framebuffer_free(&fb);
+}
+
+static void test_color_runs(void) {
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 8, 1));
+  CHECK(framebuffer_set_color(&fb, FRAMEBUFFER_TRUECOLOR));
+  framebuffer_clear(&fb, ' ');
+  fb.pen = 0xFF0000;
+  framebuffer_put(&fb, 0, 0, 'x');
+  framebuffer_put(&fb, 0, 1, 'x');
+  // a blank cell does not end the red run
+  framebuffer_put(&fb, 0, 3, 'x');
+  fb.pen = 0x00FF80;
+  framebuffer_put(&fb, 0, 4, 'x');
+
+  char out[256];
+  size_t n = framebuffer_encode_row(&fb, 0, 8, out);
+  CHECK(n <= framebuffer_max_row_bytes(&fb, 8));
+  const char truecolor[] = "\x1b[38;2;255;0;0mxx x\x1b[38;2;0;255;128mx   "
+                           "\x1b[39m";
+  CHECK_EQ_INT(n, strlen(truecolor));
+  CHECK(memcmp(out, truecolor, n) == 0);
+
+  // both colours map to their nearest cube entries
+  CHECK(framebuffer_set_color(&fb, FRAMEBUFFER_COLOR_256));
+  n = framebuffer_encode_row(&fb, 0, 8, out);
+  const char indexed[] = "\x1b[38;5;196mxx x\x1b[38;5;49mx   \x1b[39m";
+  CHECK_EQ_INT(n, strlen(indexed));
+  CHECK(memcmp(out, indexed, n) == 0);
+  framebuffer_free(&fb);
+}
+
+int main(void) {
+  RUN_TEST(test_resize_reuses_capacity);
+  RUN_TEST(test_subcell_encoding);
+  RUN_TEST(test_color_runs);
+  return test_failures();
+}
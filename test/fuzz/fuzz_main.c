@@ -0,0 +1,32 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Standalone driver for compilers without libFuzzer: runs every file given on
+// the command line through the harness once, which is also what AFL expects
+// (afl-fuzz ... -- fuzz_obj_parser @@).
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    FILE *in = fopen(argv[i], "rb");
+    if (in == NULL) {
+      perror(argv[i]);
+      return EXIT_FAILURE;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? (size_t)size : 1);
+    if (fread(data, 1, (size_t)size, in) != (size_t)size) {
+      perror(argv[i]);
+      return EXIT_FAILURE;
+    }
+    fclose(in);
+    LLVMFuzzerTestOneInput(data, (size_t)size);
+    free(data);
+  }
+  return EXIT_SUCCESS;
+}
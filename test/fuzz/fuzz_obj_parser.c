@@ -0,0 +1,27 @@
+#define _GNU_SOURCE
+#include "obj_parser.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// libFuzzer entry point. The parser only reads from paths, so the input is
+// placed in an anonymous in-memory file and parsed through /proc/self/fd.
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  int fd = memfd_create("fuzz_obj", 0);
+  if (fd < 0)
+    return 0;
+  if (write(fd, data, size) != (ssize_t)size) {
+    close(fd);
+    return 0;
+  }
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+
+  obj_scene_data scene;
+  if (parse_obj_scene(&scene, path))
+    delete_obj_data(&scene);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,157 @@
+#include "objLoader.h"
+#include "objMesh.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ranges>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+extern "C" {
+#include "test_util.h"
+}
+
+static_assert(std::is_nothrow_move_constructible_v<objMesh>);
+static_assert(std::is_nothrow_move_assignable_v<objMesh>);
+static_assert(!std::is_copy_constructible_v<objMesh>);
+static_assert(!std::is_copy_assignable_v<objMesh>);
+static_assert(!std::is_copy_constructible_v<objLoader>);
+static_assert(std::ranges::random_access_range<decltype(std::declval<const objMesh &>().triangles())>);
+static_assert(std::ranges::sized_range<decltype(std::declval<const objMesh &>().triangles())>);
+
+// A quad, a triangle, and a face with a corner past the last vertex
+static std::string writeModel()
+{
+	const char *mtl = write_temp_file("newmtl red\nKd 1 0 0\nmap_Ka red.ppm\nnewmtl blue\nKd 0 0 1\n");
+	char obj[512];
+	std::snprintf(obj, sizeof(obj),
+		"mtllib %s\n"
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0.5 0.5 1\n"
+		"vn 0 0 1\nvt 0 0\nvt 1 1\n"
+		"usemtl red\nf 1/1/1 2/2/1 3/2/1 4/1/1\n"
+		"usemtl blue\nf 1 2 5\n"
+		"f 1 2 9\n",
+		mtl);
+	return write_temp_file(obj);
+}
+
+static void testBuffers()
+{
+	std::string path = writeModel();
+	std::optional<objMesh> loaded = objMesh::load(path.c_str());
+	CHECK(loaded.has_value());
+	if(!loaded)
+		return;
+	const objMesh &mesh = *loaded;
+	CHECK_EQ_INT(mesh.positions().size(), 5);
+	CHECK_EQ_INT(mesh.normals().size(), 1);
+	CHECK_EQ_INT(mesh.textureCoordinates().size(), 2);
+	CHECK_EQ_INT(mesh.faces().size(), 3);
+	CHECK(mesh.positions()[4].e[2] == 1.0);
+	CHECK(mesh.positions().data() + 1 == &mesh.positions()[1]);
+
+	// the quad is a fan of two triangles, the broken face is left out
+	const std::uint32_t expected[] = {0, 1, 2, 0, 2, 3, 0, 1, 4};
+	CHECK_EQ_INT(mesh.indices().size(), 9);
+	CHECK(std::ranges::equal(mesh.indices(), expected));
+	CHECK_EQ_INT(mesh.triangleCount(), 3);
+	CHECK_EQ_INT(mesh.triangleFaces()[1], 0);
+	CHECK_EQ_INT(mesh.triangleFaces()[2], 1);
+
+	CHECK_EQ_INT(mesh.materials().size(), 2);
+	CHECK(std::strcmp(mesh.materials()[0].name, "red") == 0);
+	CHECK(std::strcmp(mesh.materials()[0].texture_filename, "red.ppm") == 0);
+	CHECK(std::strcmp(mesh.materials()[1].texture_filename, "") == 0);
+}
+
+static void testTriangles()
+{
+	std::optional<objMesh> mesh = objMesh::load(writeModel().c_str());
+	CHECK(mesh.has_value());
+	if(!mesh)
+		return;
+	int count = 0;
+	double height = 0;
+	for(auto [a, b, c, face, material] : mesh->triangles())
+	{
+		CHECK(&a == &mesh->positions()[mesh->indices()[3 * count]]);
+		CHECK_EQ_INT(face, count < 2 ? 0 : 1);
+		CHECK_EQ_INT(material, count < 2 ? 0 : 1);
+		height += a.e[2] + b.e[2] + c.e[2];
+		count++;
+	}
+	CHECK_EQ_INT(count, 3);
+	CHECK(height == 1.0);
+	CHECK(&mesh->triangles()[2].c == &mesh->positions()[4]);
+}
+
+// Moving hands the buffers and strings over without copying them
+static void testMove()
+{
+	std::optional<objMesh> loaded = objMesh::load(writeModel().c_str());
+	CHECK(loaded.has_value());
+	if(!loaded)
+		return;
+	const obj_vector *positions = loaded->positions().data();
+	const char *name = loaded->materials()[0].name;
+	objMesh moved = std::move(*loaded);
+	loaded.reset();
+	CHECK(moved.positions().data() == positions);
+	CHECK(moved.materials()[0].name == name);
+	CHECK(std::strcmp(name, "red") == 0);
+
+	// assigning over a mesh releases what it held
+	std::optional<objMesh> other = objMesh::load(writeModel().c_str());
+	CHECK(other.has_value());
+	if(other)
+		moved = std::move(*other);
+	CHECK_EQ_INT(moved.triangleCount(), 3);
+}
+
+static void testFromScene()
+{
+	obj_scene_data scene;
+	std::string path = writeModel();
+	CHECK(parse_obj_scene(&scene, path.data()));
+	objMesh mesh = objMesh::fromScene(scene);
+	CHECK(scene.vertex_list == nullptr && scene.vertex_count == 0);
+	CHECK_EQ_INT(mesh.positions().size(), 5);
+}
+
+static void testMissingFile()
+{
+	CHECK(!objMesh::load("/nonexistent/model.obj").has_value());
+}
+
+// The old loader may be loaded twice and destroyed without loading, and a
+// failed reload leaves it empty
+static void testLoader()
+{
+	objLoader unused;
+	objLoader loader;
+	std::string path = writeModel();
+	CHECK(loader.load(path.data()));
+	CHECK(loader.load(path.data()));
+	CHECK_EQ_INT(loader.vertexCount, 5);
+	CHECK_EQ_INT(loader.faceCount, 3);
+	char missing[] = "/nonexistent/model.obj";
+	CHECK(!loader.load(missing));
+	CHECK_EQ_INT(loader.vertexCount, 0);
+	CHECK_EQ_INT(loader.faceCount, 0);
+	CHECK(loader.vertexList == nullptr);
+	CHECK(loader.faceList == nullptr);
+}
+
+int main()
+{
+	RUN_TEST(testBuffers);
+	RUN_TEST(testTriangles);
+	RUN_TEST(testMove);
+	RUN_TEST(testFromScene);
+	RUN_TEST(testMissingFile);
+	RUN_TEST(testLoader);
+	remove_temp_files();
+	return test_failures();
+}
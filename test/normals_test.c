@@ -0,0 +1,122 @@
+#include "model.h"
+#include "normals.h"
+#include "obj_parser.h"
+#include "test_util.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char unit_cube[] = "v -1 -1 -1\nv 1 -1 -1\nv 1 1 -1\nv -1 1 -1\n"
+                                "v -1 -1 1\nv 1 -1 1\nv 1 1 1\nv -1 1 1\n"
+                                "f 1 4 3 2\nf 5 6 7 8\nf 1 2 6 5\n"
+                                "f 4 8 7 3\nf 1 5 8 4\nf 2 3 7 6\n";
+
+static int near(float a, float b) { return fabsf(a - b) < 1e-4f; }
+
+static void test_cube_normals_point_outwards(void) {
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, (char *)write_temp_file(unit_cube)));
+  mesh_normals n;
+  CHECK(mesh_normals_compute(&n, &scene, 1));
+  CHECK(!n.uses_file_normals);
+
+  for (int f = 0; f < scene.face_count; ++f) {
+    // the cube is centered, so the face centre is the outward direction
+    float centre[3] = {0, 0, 0};
+    const obj_face *face = scene.face_list[f];
+    for (int j = 0; j < face->vertex_count; ++j)
+      for (int k = 0; k < 3; ++k)
+        centre[k] += (float)scene.vertex_list[face->vertex_index[j]]->e[k] /
+                     face->vertex_count;
+    for (int k = 0; k < 3; ++k)
+      CHECK(near(n.face[3 * f + k], centre[k]));
+  }
+  // corners average three equal faces
+  float diagonal = 1 / sqrtf(3);
+  for (int v = 0; v < scene.vertex_count; ++v)
+    for (int k = 0; k < 3; ++k)
+      CHECK(near(n.vertex[3 * v + k],
+                 (float)scene.vertex_list[v]->e[k] * diagonal));
+  mesh_normals_free(&n);
+  delete_obj_data(&scene);
+}
+
+static void test_file_normals_are_reused(void) {
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, (char *)write_temp_file(
+                                    "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+                                    "vn 0 3 4\n"
+                                    "f 1//1 2//1 3//1\n")));
+  mesh_normals n;
+  CHECK(mesh_normals_compute(&n, &scene, 1));
+  CHECK(n.uses_file_normals);
+  // the face normal is geometric, the vertex normals come from vn
+  CHECK(near(n.face[2], 1));
+  for (int v = 0; v < 3; ++v) {
+    CHECK(near(n.vertex[3 * v + 1], 0.6f));
+    CHECK(near(n.vertex[3 * v + 2], 0.8f));
+  }
+  mesh_normals_free(&n);
+  delete_obj_data(&scene);
+}
+
+// enough faces to take the multi-threaded path
+static void test_threads_match_single_thread(void) {
+  int size = 80;
+  char *text = malloc((size_t)(size + 1) * (size + 1) * 64 +
+                      (size_t)size * size * 64);
+  size_t used = 0;
+  for (int y = 0; y <= size; ++y)
+    for (int x = 0; x <= size; ++x)
+      used += sprintf(text + used, "v %d %d %f\n", x, y,
+                      sin(x * 0.3) * cos(y * 0.2));
+  for (int y = 0; y < size; ++y)
+    for (int x = 0; x < size; ++x) {
+      int a = y * (size + 1) + x + 1, b = a + 1, c = a + size + 1, d = c + 1;
+      used += sprintf(text + used, "f %d %d %d\nf %d %d %d\n", a, b, d, a, d,
+                      c);
+    }
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, (char *)write_temp_file(text)));
+  free(text);
+
+  mesh_normals single, many;
+  CHECK(mesh_normals_compute(&single, &scene, 1));
+  CHECK(mesh_normals_compute(&many, &scene, 4));
+  int mismatches = 0;
+  for (int i = 0; i < 3 * scene.face_count; ++i)
+    mismatches += single.face[i] != many.face[i];
+  for (int i = 0; i < 3 * scene.vertex_count; ++i)
+    mismatches += !near(single.vertex[i], many.vertex[i]);
+  CHECK_EQ_INT(mismatches, 0);
+  mesh_normals_free(&single);
+  mesh_normals_free(&many);
+  delete_obj_data(&scene);
+}
+
+// Back-face culling leaves out faces without a corner that exists, which
+// keep no corners once the bad ones are dropped at load
+static void test_backfaces_skip_bad_faces(void) {
+  char obj[512];
+  snprintf(obj, sizeof(obj), "%sf 99 98 97\n", unit_cube);
+  loaded_model m;
+  CHECK(loaded_model_load(&m, write_temp_file(obj), NULL, false));
+  CHECK_EQ_INT(m.source.face_count, 7);
+  CHECK_EQ_INT(m.source.face_list[6]->vertex_count, 0);
+  float R[3][3];
+  rotation_matrix(R, 0, 0, 0);
+  loaded_model_cull(&m, R, MODEL_DISTANCE, 80, 0, true);
+  CHECK(m.visible_count > 0);
+  for (int i = 0; i < m.visible_count; ++i)
+    CHECK(m.visible_faces[i] != 6);
+  loaded_model_free(&m);
+}
+
+int main(void) {
+  RUN_TEST(test_cube_normals_point_outwards);
+  RUN_TEST(test_file_normals_are_reused);
+  RUN_TEST(test_threads_match_single_thread);
+  RUN_TEST(test_backfaces_skip_bad_faces);
+  remove_temp_files();
+  return test_failures();
+}
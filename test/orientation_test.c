@@ -0,0 +1,90 @@
+#include "orientation.h"
+#include "render.h"
+#include "test_util.h"
+#include <math.h>
+
+static float max_difference(float a[3][3], float b[3][3]) {
+  float worst = 0;
+  for (int r = 0; r < 3; ++r)
+    for (int c = 0; c < 3; ++c)
+      worst = fmaxf(worst, fabsf(a[r][c] - b[r][c]));
+  return worst;
+}
+
+static void test_matches_euler(void) {
+  static const float angles[][3] = {
+      {0, 0, 0}, {0.3f, 0, 0}, {0, -1.2f, 0}, {0, 0, 2.5f},
+      {0.4f, 1.1f, -0.7f}, {3.0f, 1.5707964f, 0.2f}};
+  for (size_t i = 0; i < sizeof(angles) / sizeof(angles[0]); ++i) {
+    float expected[3][3], got[3][3];
+    rotation_matrix(expected, angles[i][0], angles[i][1], angles[i][2]);
+    quat_to_matrix(quat_from_euler(angles[i][0], angles[i][1], angles[i][2]),
+                   got);
+    CHECK(max_difference(expected, got) < 1e-6f);
+  }
+}
+
+// The default spin is the old animation, pitch growing by speed per frame
+static void test_single_axis_spin(void) {
+  orientation o;
+  orientation_init(&o, (const float[3]){0, 0.1f, 0});
+  for (int frame = 1; frame <= 500; ++frame) {
+    orientation_step(&o);
+    if (frame % 50 != 0)
+      continue;
+    float expected[3][3], got[3][3];
+    rotation_matrix(expected, 0, 0.1f * frame, 0);
+    quat_to_matrix(o.current, got);
+    CHECK(max_difference(expected, got) < 1e-4f);
+  }
+}
+
+// Turning about yaw, pitch and roll at once stays a rotation: no drift in
+// length, no shear, however long it runs
+static void test_tumble_stays_orthonormal(void) {
+  orientation o;
+  orientation_init(&o, (const float[3]){0.1f / 5, 0.1f, 0.1f / 3});
+  for (int frame = 0; frame < 100000; ++frame)
+    orientation_step(&o);
+  quat q = o.current;
+  float norm = sqrtf(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+  CHECK(fabsf(norm - 1) < 1e-5f);
+  float R[3][3];
+  quat_to_matrix(q, R);
+  for (int a = 0; a < 3; ++a) {
+    for (int b = 0; b < 3; ++b) {
+      float dot = R[0][a] * R[0][b] + R[1][a] * R[1][b] + R[2][a] * R[2][b];
+      CHECK(fabsf(dot - (a == b)) < 1e-4f);
+    }
+  }
+}
+
+// A constant angular velocity turns about a fixed axis: after a full turn
+// the model is back where it started
+static void test_full_turn(void) {
+  const float speed = 2 * 3.14159265f / 360;
+  orientation o;
+  orientation_init(&o, (const float[3]){speed * 0.6f, speed * 0.8f, 0});
+  for (int frame = 0; frame < 360; ++frame)
+    orientation_step(&o);
+  float identity[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}, R[3][3];
+  quat_to_matrix(o.current, R);
+  CHECK(max_difference(identity, R) < 1e-4f);
+}
+
+static void test_still(void) {
+  orientation o;
+  orientation_init(&o, (const float[3]){0, 0, 0});
+  orientation_step(&o);
+  CHECK(o.current.w == 1 && o.current.x == 0 && o.current.y == 0 &&
+        o.current.z == 0);
+}
+
+int main(void) {
+  RUN_TEST(test_matches_euler);
+  RUN_TEST(test_single_axis_spin);
+  RUN_TEST(test_tumble_stays_orthonormal);
+  RUN_TEST(test_full_turn);
+  RUN_TEST(test_still);
+  return test_failures();
+}
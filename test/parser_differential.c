@@ -0,0 +1,153 @@
+#include "obj_parser.h"
+#include "scene_compare.h"
+#include "test_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Differential tests for OBJ parsers. Every implementation listed in
+// `parsers` must produce exactly what the reference parse_obj_scene produces
+// on the corpus given on the command line, and every input must parse the
+// same regardless of index style, line endings or whitespace. The cached
+// parser runs twice per file, once missing and once hitting its material
+// library cache.
+
+typedef int (*parse_fn)(obj_scene_data *data_out, char *filename);
+
+typedef struct parser_impl {
+  const char *name;
+  parse_fn parse;
+} parser_impl;
+
+static obj_mtl_cache mtl_cache;
+
+// Starts from an empty cache, so every library is parsed
+static int parse_cold_cache(obj_scene_data *data_out, char *filename) {
+  obj_mtl_cache_free(&mtl_cache);
+  obj_mtl_cache_init(&mtl_cache);
+  return parse_obj_scene_cached(data_out, filename, &mtl_cache, 0);
+}
+
+// Runs right after parse_cold_cache, so libraries come from the cache
+static int parse_warm_cache(obj_scene_data *data_out, char *filename) {
+  return parse_obj_scene_cached(data_out, filename, &mtl_cache, 0);
+}
+
+// New parsers are added here and are then checked against the reference
+static const parser_impl parsers[] = {
+    {"parse_obj_scene", parse_obj_scene},
+    {"parse_obj_scene_cached, cold cache", parse_cold_cache},
+    {"parse_obj_scene_cached, warm cache", parse_warm_cache},
+};
+
+static void compare_parsers_on(const char *path) {
+  obj_scene_data expected;
+  if (!parse_obj_scene(&expected, (char *)path)) {
+    fprintf(stderr, "reference parser failed on %s\n", path);
+    ++test_failure_count;
+    return;
+  }
+  for (size_t i = 0; i < sizeof(parsers) / sizeof(parsers[0]); ++i) {
+    obj_scene_data actual;
+    char context[512];
+    snprintf(context, sizeof(context), "%s on %s", parsers[i].name, path);
+    if (!parsers[i].parse(&actual, (char *)path)) {
+      fprintf(stderr, "%s: parse failed\n", context);
+      ++test_failure_count;
+      continue;
+    }
+    CHECK(scenes_equal(&expected, &actual, context));
+    delete_obj_data(&actual);
+  }
+  delete_obj_data(&expected);
+}
+
+// Builds the same small mesh in different spellings of the format
+static char *mesh_variant(int negative, const char *eol, const char *sep) {
+  char *text = malloc(8192);
+  size_t used = 0;
+  const int n = 4;
+  for (int y = 0; y <= n; ++y) {
+    for (int x = 0; x <= n; ++x) {
+      int index = y * (n + 1) + x + 1;
+      used += sprintf(text + used, "v%s%d.25%s%d.5%s-0.125%s", sep, x, sep,
+                      y, sep, eol);
+      used += sprintf(text + used, "vt%s0.%d%s0.%d%s0%s", sep, x, sep, y, sep,
+                      eol);
+      used += sprintf(text + used, "vn%s0%s0%s1%s", sep, sep, sep, eol);
+      // faces reference the previous row, emitted once it is complete
+      if (y > 0 && x > 0) {
+        int a = index - n - 2, b = index - n - 1, c = index, d = index - 1;
+        int refs[4] = {a, b, c, d};
+        used += sprintf(text + used, "f");
+        for (int k = 0; k < 4; ++k) {
+          int r = negative ? refs[k] - index - 1 : refs[k];
+          used += sprintf(text + used, "%s%d/%d/%d", sep, r, r, r);
+        }
+        used += sprintf(text + used, "%s", eol);
+      }
+    }
+  }
+  return text;
+}
+
+static void test_spelling_variants(void) {
+  char *reference_text = mesh_variant(0, "\n", " ");
+  const char *reference_path = write_temp_file(reference_text);
+  obj_scene_data expected;
+  CHECK(parse_obj_scene(&expected, (char *)reference_path));
+  CHECK_EQ_INT(expected.face_count, 16);
+
+  struct {
+    const char *name;
+    int negative;
+    const char *eol;
+    const char *sep;
+  } variants[] = {
+      {"negative indices", 1, "\n", " "},
+      {"CRLF line endings", 0, "\r\n", " "},
+      {"tabs and runs of spaces", 0, "\n", " \t  "},
+      {"everything at once", 1, "\r\n", "\t"},
+  };
+  for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); ++i) {
+    char *text =
+        mesh_variant(variants[i].negative, variants[i].eol, variants[i].sep);
+    const char *path = write_temp_file(text);
+    obj_scene_data actual;
+    CHECK(parse_obj_scene(&actual, (char *)path));
+    CHECK(scenes_equal(&expected, &actual, variants[i].name));
+    delete_obj_data(&actual);
+    compare_parsers_on(path);
+    free(text);
+  }
+  compare_parsers_on(reference_path);
+  delete_obj_data(&expected);
+  free(reference_text);
+}
+
+// The warm run really takes the cached path
+static void test_cached_materials(void) {
+  const char *mtl = write_temp_file("newmtl red\nKd 1 0 0\n"
+                                    "newmtl blue\nKd 0 0 1\nNs 10\n");
+  char obj[256];
+  snprintf(obj, sizeof(obj),
+           "mtllib %s\nv 0 0 0\nv 1 0 0\nv 0 1 0\nusemtl blue\nf 1 2 3\n"
+           "usemtl red\nf 3 2 1\n",
+           mtl);
+  int hits = mtl_cache.hits;
+  compare_parsers_on(write_temp_file(obj));
+  CHECK_EQ_INT(mtl_cache.hits, hits + 1);
+}
+
+int main(int argc, char **argv) {
+  obj_mtl_cache_init(&mtl_cache);
+  RUN_TEST(test_spelling_variants);
+  RUN_TEST(test_cached_materials);
+  for (int i = 1; i < argc; ++i) {
+    compare_parsers_on(argv[i]);
+    printf("%s corpus %s\n", test_failure_count ? "[FAIL]" : "[ OK ]", argv[i]);
+  }
+  obj_mtl_cache_free(&mtl_cache);
+  remove_temp_files();
+  return test_failures();
+}
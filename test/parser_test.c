@@ -0,0 +1,196 @@
+#include "list.h"
+#include "obj_parser.h"
+#include "test_util.h"
+#include <stdio.h>
+#include <string.h>
+
+// Runs from lib/obj_parser so the sample files find their .mtl libraries
+
+static void test_sample_scene(void) {
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, "test.obj"));
+  CHECK_EQ_INT(scene.vertex_count, 17);
+  CHECK_EQ_INT(scene.vertex_normal_count, 7);
+  CHECK_EQ_INT(scene.vertex_texture_count, 3);
+  CHECK_EQ_INT(scene.face_count, 12);
+  CHECK_EQ_INT(scene.sphere_count, 1);
+  CHECK_EQ_INT(scene.plane_count, 1);
+  CHECK_EQ_INT(scene.light_point_count, 1);
+  CHECK_EQ_INT(scene.light_disc_count, 1);
+  CHECK_EQ_INT(scene.light_quad_count, 1);
+  CHECK_EQ_INT(scene.material_count, 4);
+  CHECK(scene.camera != NULL);
+
+  // f 1/1/1 3/2/2 4/3/3
+  const obj_face *face = scene.face_list[0];
+  CHECK_EQ_INT(face->vertex_count, 3);
+  CHECK_EQ_INT(face->vertex_index[2], 3);
+  CHECK_EQ_INT(face->texture_index[1], 1);
+  CHECK_EQ_INT(face->normal_index[2], 2);
+  CHECK_EQ_INT(face->material_index, 0);
+  // f 4//1 2//2 1//3
+  face = scene.face_list[1];
+  CHECK_EQ_INT(face->texture_index[0], -1);
+  CHECK_EQ_INT(face->normal_index[1], 1);
+
+  CHECK(strcmp(scene.material_list[0]->name, "red_material") == 0);
+  CHECK(strcmp(scene.material_list[0]->texture_filename,
+               "not_a_real_file.png") == 0);
+  CHECK(scene.material_list[1]->reflect == 0.5);
+  CHECK(scene.material_list[2]->refract_index == 1.33);
+  delete_obj_data(&scene);
+}
+
+static void test_negative_indices(void) {
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, "cornell_box.obj"));
+  // the light is "f -1 -2 -3 -4", written right after vertices 61-64
+  const obj_face *light = scene.face_list[scene.face_count - 1];
+  CHECK_EQ_INT(light->vertex_count, 4);
+  CHECK_EQ_INT(light->vertex_index[0], 63);
+  CHECK_EQ_INT(light->vertex_index[3], 60);
+  delete_obj_data(&scene);
+}
+
+static void test_malformed_lines(void) {
+  const char *path = write_temp_file("v 1\n"
+                                     "v\n"
+                                     "v 1 2 3\n"
+                                     "f 1 2 3 1 2 3\n"
+                                     "f\n"
+                                     "usemtl\n"
+                                     "mtllib\n"
+                                     "lp\n"
+                                     "sp 1//1\n"
+                                     "lq 1/1 2/2\n"
+                                     "c 1 2 3\n"
+                                     "c 1 2 3 4 5\n");
+  obj_scene_data scene;
+  CHECK(path != NULL && parse_obj_scene(&scene, (char *)path));
+  CHECK_EQ_INT(scene.vertex_count, 3);
+  // missing coordinates read as zero
+  CHECK(scene.vertex_list[0]->e[0] == 1.0);
+  CHECK(scene.vertex_list[0]->e[1] == 0.0);
+  CHECK(scene.vertex_list[1]->e[2] == 0.0);
+  // faces longer than MAX_VERTEX_COUNT are truncated, not overflowed
+  CHECK_EQ_INT(scene.face_count, 2);
+  CHECK_EQ_INT(scene.face_list[0]->vertex_count, MAX_VERTEX_COUNT);
+  CHECK_EQ_INT(scene.face_list[1]->vertex_count, 0);
+  CHECK_EQ_INT(scene.face_list[1]->material_index, -1);
+  CHECK(scene.camera != NULL);
+  delete_obj_data(&scene);
+}
+
+static void test_long_material_name(void) {
+  char mtl[1024] = "newmtl ";
+  size_t len = strlen(mtl);
+  memset(mtl + len, 'a', 600);
+  strcpy(mtl + len + 600, "\nKd 0.5\nmap_Ka\n");
+  const char *mtl_path = write_temp_file(mtl);
+
+  char obj[128];
+  snprintf(obj, sizeof(obj), "mtllib %s\nmtllib %s\n", mtl_path, mtl_path);
+  const char *obj_path = write_temp_file(obj);
+
+  obj_scene_data scene;
+  CHECK(obj_path != NULL && parse_obj_scene(&scene, (char *)obj_path));
+  // a second mtllib appends instead of dropping the first library
+  CHECK_EQ_INT(scene.material_count, 2);
+  if (scene.material_count > 0) {
+    const obj_material *m = scene.material_list[0];
+    CHECK_EQ_INT(strlen(m->name), MATERIAL_NAME_SIZE - 1);
+    CHECK(m->diff[0] == 0.5 && m->diff[1] == 0.0);
+    CHECK(m->texture_filename[0] == '\0');
+  }
+  delete_obj_data(&scene);
+}
+
+// Names and paths live once in the scene's string pool, and materials
+// copied from the cache do not point into it
+static void test_material_strings_are_pooled(void) {
+  const char *mtl_path = write_temp_file("newmtl a\nmap_Ka shared.ppm\n"
+                                         "newmtl b\nmap_Ka shared.ppm\n");
+  char obj[128];
+  snprintf(obj, sizeof(obj), "mtllib %s\n", mtl_path);
+  const char *obj_path = write_temp_file(obj);
+
+  obj_mtl_cache cache;
+  obj_mtl_cache_init(&cache);
+  obj_scene_data first, second;
+  CHECK(parse_obj_scene_cached(&first, (char *)obj_path, &cache, 0));
+  CHECK(parse_obj_scene_cached(&second, (char *)obj_path, &cache, 0));
+  CHECK_EQ_INT(cache.hits, 1);
+  obj_mtl_cache_free(&cache);
+
+  obj_scene_data *scenes[] = {&first, &second};
+  for (int i = 0; i < 2; ++i) {
+    CHECK_EQ_INT(scenes[i]->material_count, 2);
+    if (scenes[i]->material_count != 2)
+      continue;
+    const obj_material *a = scenes[i]->material_list[0];
+    const obj_material *b = scenes[i]->material_list[1];
+    CHECK(strcmp(a->name, "a") == 0 && strcmp(b->name, "b") == 0);
+    CHECK(strcmp(a->texture_filename, "shared.ppm") == 0);
+    CHECK(a->texture_filename == b->texture_filename);
+    CHECK_EQ_INT(scenes[i]->strings.string_count, 3);
+  }
+  CHECK(first.material_list[0]->name != second.material_list[0]->name);
+  delete_obj_data(&first);
+  delete_obj_data(&second);
+}
+
+static void test_string_pool(void) {
+  obj_string_pool pool;
+  obj_string_pool_init(&pool);
+  char name[16];
+  const char *first[100];
+  for (int i = 0; i < 100; ++i) {
+    snprintf(name, sizeof(name), "material_%d", i);
+    first[i] = obj_string_pool_intern(&pool, name);
+  }
+  CHECK_EQ_INT(pool.string_count, 100);
+  // growing the table keeps every string where it was
+  for (int i = 0; i < 100; ++i) {
+    snprintf(name, sizeof(name), "material_%d", i);
+    CHECK(obj_string_pool_intern(&pool, name) == first[i]);
+    CHECK(strcmp(first[i], name) == 0);
+  }
+  CHECK_EQ_INT(pool.string_count, 100);
+  // longer than a block
+  char long_name[5000];
+  memset(long_name, 'x', sizeof(long_name) - 1);
+  long_name[sizeof(long_name) - 1] = '\0';
+  CHECK(strcmp(obj_string_pool_intern(&pool, long_name), long_name) == 0);
+  obj_string_pool_free(&pool);
+}
+
+static void test_missing_file(void) {
+  obj_scene_data scene;
+  CHECK(!parse_obj_scene(&scene, "does/not/exist.obj"));
+}
+
+static void test_list_names_are_terminated(void) {
+  list listo;
+  int item;
+  list_make(&listo, 1, 1);
+  for (int i = 0; i < 5; ++i)
+    list_add_item(&listo, &item, "name");
+  CHECK_EQ_INT(listo.item_count, 5);
+  for (int i = 0; i < listo.item_count; ++i)
+    CHECK(strcmp(listo.names[i], "name") == 0);
+  CHECK_EQ_INT(list_find(&listo, "name"), 0);
+  list_free(&listo);
+}
+
+int main(void) {
+  RUN_TEST(test_sample_scene);
+  RUN_TEST(test_negative_indices);
+  RUN_TEST(test_malformed_lines);
+  RUN_TEST(test_long_material_name);
+  RUN_TEST(test_material_strings_are_pooled);
+  RUN_TEST(test_string_pool);
+  RUN_TEST(test_missing_file);
+  RUN_TEST(test_list_names_are_terminated);
+  remove_temp_files();
+  return test_failures();
+}
@@ -0,0 +1,143 @@
+#include "framebuffer.h"
+#include "pipeline.h"
+#include "render.h"
+#include "test_util.h"
+#include <stdio.h>
+#include <string.h>
+
+// A ring of `count` faces with `corners` corners each (0 mixes 2 to 4
+// corners), alternating between two materials, some of it off screen
+static const char *write_ring(int count, int corners) {
+  static char obj[16384];
+  const char *mtl = write_temp_file("newmtl red\nKd 1 0 0\n"
+                                    "newmtl teal\nKd 0 0.5 0.5\n");
+  int n = snprintf(obj, sizeof(obj), "mtllib %s\n", mtl);
+  int vertices = count * 5;
+  for (int i = 0; i < vertices; ++i) {
+    // a spiral that leaves the view on its outer turns
+    float r = 0.05f + 2.5f * (float)i / vertices;
+    n += snprintf(obj + n, sizeof(obj) - n, "v %f %f %f\n",
+                  r * (float)((i * 37) % 101 - 50) / 50,
+                  r * (float)((i * 61) % 103 - 51) / 51,
+                  (float)(i % 7) / 10);
+  }
+  for (int f = 0; f < count; ++f) {
+    int k = corners ? corners : 2 + f % 3;
+    n += snprintf(obj + n, sizeof(obj) - n, "usemtl %s\nf",
+                  f % 2 ? "red" : "teal");
+    for (int j = 0; j < k; ++j)
+      n += snprintf(obj + n, sizeof(obj) - n, " %d", f * 5 + j + 1);
+    n += snprintf(obj + n, sizeof(obj) - n, "\n");
+  }
+  return write_temp_file(obj);
+}
+
+// Same cells, dots and colours
+static int same_frame(const framebuffer *a, const framebuffer *b) {
+  size_t cells = (size_t)a->width * a->height;
+  if (a->mode == FRAMEBUFFER_ASCII ? memcmp(a->cells, b->cells, cells) != 0
+                                   : memcmp(a->dots, b->dots, cells) != 0)
+    return 0;
+  return a->colors == NULL ||
+         memcmp(a->colors, b->colors, cells * sizeof(uint32_t)) == 0;
+}
+
+// Every kernel, and the generic version of them, draws what draw_faces and
+// draw_face_list draw
+static void check_kernels(const char *path, int expected_arity) {
+  obj_scene_data model;
+  CHECK(parse_obj_scene(&model, (char *)path));
+  CHECK_EQ_INT(face_arity(&model), expected_arity);
+  float R[3][3];
+  rotation_matrix(R, 0.4f, 0.3f, 0.2f);
+  transform_model(&model, &model, R, MODEL_DISTANCE);
+  struct obj_vector projected[1024];
+  int32_t every_third[256];
+  int listed = 0;
+  for (int f = 0; f < model.face_count; f += 3)
+    every_third[listed++] = f;
+
+  const framebuffer_mode modes[] = {FRAMEBUFFER_ASCII, FRAMEBUFFER_BRAILLE,
+                                    FRAMEBUFFER_BLOCKS};
+  for (int m = 0; m < 3; ++m) {
+    for (int color = 0; color < 2; ++color) {
+      for (int culled = 0; culled < 2; ++culled) {
+        framebuffer generic, specialized, dispatched;
+        framebuffer *fbs[3] = {&generic, &specialized, &dispatched};
+        for (int k = 0; k < 3; ++k) {
+          CHECK(framebuffer_init(fbs[k], 61, 23));
+          CHECK(framebuffer_set_mode(fbs[k], modes[m]));
+          CHECK(framebuffer_set_color(fbs[k], color ? FRAMEBUFFER_COLOR_256
+                                                    : FRAMEBUFFER_MONOCHROME));
+          framebuffer_clear(fbs[k], BACKGROUND_CHAR);
+        }
+        project_vertices(&model, projected, framebuffer_raster_width(&generic),
+                         framebuffer_raster_height(&generic));
+        if (culled)
+          draw_face_list(&generic, &model, projected, every_third, listed);
+        else
+          draw_faces(&generic, &model, projected);
+        select_face_kernel(&specialized, face_arity(&model), culled)(
+            &specialized, &model, projected, every_third, listed);
+        draw_outlines_generic(&dispatched, &model, projected,
+                              culled ? every_third : NULL, listed);
+        if (!same_frame(&generic, &specialized))
+          fprintf(stderr, "%s: mode %d, colour %d, culled %d differ\n", path,
+                  m, color, culled);
+        CHECK(same_frame(&generic, &specialized));
+        CHECK(same_frame(&generic, &dispatched));
+        framebuffer_free(&generic);
+        framebuffer_free(&specialized);
+        framebuffer_free(&dispatched);
+      }
+    }
+  }
+  delete_obj_data(&model);
+}
+
+static void test_triangles(void) { check_kernels(write_ring(60, 3), 3); }
+
+static void test_quads(void) { check_kernels(write_ring(60, 4), 4); }
+
+static void test_mixed_faces(void) { check_kernels(write_ring(60, 0), 0); }
+
+static void test_empty(void) {
+  obj_scene_data model;
+  memset(&model, 0, sizeof(model));
+  CHECK_EQ_INT(face_arity(&model), 0);
+}
+
+// Corners past the vertices are dropped, and the kernels draw the rest
+static void test_bad_corners(void) {
+  obj_scene_data model;
+  CHECK(parse_obj_scene(&model, (char *)write_temp_file(
+                                    "v 0 0 1\nv 1 0 1\nv 1 1 1\nv 0 1 1\n"
+                                    "f 1 2 99\nf 1 2 3 4\nf 4 -9 3\n")));
+  CHECK_EQ_INT(drop_bad_corners(&model), 2);
+  CHECK_EQ_INT(model.face_list[0]->vertex_count, 2);
+  CHECK_EQ_INT(model.face_list[1]->vertex_count, 4);
+  CHECK_EQ_INT(model.face_list[2]->vertex_count, 2);
+  CHECK_EQ_INT(model.face_list[2]->vertex_index[1], 2);
+  CHECK_EQ_INT(face_arity(&model), 0);
+  CHECK_EQ_INT(drop_bad_corners(&model), 0);
+
+  struct obj_vector projected[4];
+  project_vertices(&model, projected, 2 * 40, 4 * 12);
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 40, 12));
+  CHECK(framebuffer_set_mode(&fb, FRAMEBUFFER_BRAILLE));
+  select_face_kernel(&fb, face_arity(&model), false)(&fb, &model, projected,
+                                                     NULL, 0);
+  framebuffer_free(&fb);
+  delete_obj_data(&model);
+}
+
+int main(void) {
+  RUN_TEST(test_triangles);
+  RUN_TEST(test_quads);
+  RUN_TEST(test_mixed_faces);
+  RUN_TEST(test_empty);
+  RUN_TEST(test_bad_corners);
+  remove_temp_files();
+  return test_failures();
+}
@@ -0,0 +1,78 @@
+#include "framebuffer.h"
+#include "obj_parser.h"
+#include "raycast.h"
+#include "test_util.h"
+#include <string.h>
+
+// A unit sphere in front of the camera, lit from above
+static const char sphere_scene[] = "v 0 0 0\n"
+                                   "v 0 0 -5\n"
+                                   "v 0 0 0\n"
+                                   "v 0 5 -5\n"
+                                   "vn 0 1 0\n"
+                                   "sp 1 1\n"
+                                   "c 2 3 1\n"
+                                   "lp 4\n";
+
+static char cell(const framebuffer *fb, int x, int y) {
+  return fb->cells[y * fb->width + x];
+}
+
+static void test_sphere_in_view(void) {
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, (char *)write_temp_file(sphere_scene)));
+  raycaster rc;
+  CHECK(raycaster_init(&rc, &scene, 1));
+  CHECK_EQ_INT(rc.light_count, 1);
+
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 40, 20));
+  raycaster_render(&rc, &fb, 0);
+  CHECK(cell(&fb, 20, 10) != ' ');
+  CHECK(cell(&fb, 0, 0) == ' ');
+  CHECK(cell(&fb, 39, 19) == ' ');
+  // the light is above, so the top of the sphere is brighter than the bottom
+  const char *ramp = " .:-=+*#%@";
+  int top = 20 * 40, bottom = 0;
+  for (int y = 0; y < fb.height; ++y)
+    if (cell(&fb, 20, y) != ' ') {
+      top = y < top ? y : top;
+      bottom = y;
+    }
+  CHECK(strchr(ramp, cell(&fb, 20, top + 1)) >
+        strchr(ramp, cell(&fb, 20, bottom - 1)));
+
+  framebuffer_free(&fb);
+  raycaster_free(&rc);
+  delete_obj_data(&scene);
+}
+
+static void test_threads_match(void) {
+  obj_scene_data scene;
+  CHECK(parse_obj_scene(&scene, "cornell_box.obj"));
+  raycaster single, many;
+  CHECK(raycaster_init(&single, &scene, 1));
+  CHECK(raycaster_init(&many, &scene, 4));
+  // the lamp is a face with an emissive material
+  CHECK(single.light_count >= 1);
+
+  framebuffer a, b;
+  CHECK(framebuffer_init(&a, 64, 24));
+  CHECK(framebuffer_init(&b, 64, 24));
+  raycaster_render(&single, &a, 0.3f);
+  raycaster_render(&many, &b, 0.3f);
+  CHECK(memcmp(a.cells, b.cells, (size_t)a.width * a.height) == 0);
+
+  framebuffer_free(&a);
+  framebuffer_free(&b);
+  raycaster_free(&single);
+  raycaster_free(&many);
+  delete_obj_data(&scene);
+}
+
+int main(void) {
+  RUN_TEST(test_sphere_in_view);
+  RUN_TEST(test_threads_match);
+  remove_temp_files();
+  return test_failures();
+}
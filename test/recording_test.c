@@ -0,0 +1,116 @@
+#include "framebuffer.h"
+#include "recording.h"
+#include "test_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// A moving diagonal line over a dotted background, a few cells change
+// from one frame to the next
+static void draw_frame(framebuffer *fb, int frame) {
+  framebuffer_clear(fb, '.');
+  for (int i = 0; i < fb->width * 2; ++i) {
+    fb->pen = (uint32_t)(i * 0x010203 + frame) & 0xFFFFFF;
+    int x = (i + frame) % (fb->width * 2), y = i % (fb->height * 4);
+    if (fb->mode == FRAMEBUFFER_ASCII)
+      framebuffer_put(fb, y / 4, x / 2, (char)('a' + frame % 26));
+    else
+      framebuffer_put_dot(fb, x, y);
+  }
+}
+
+static void round_trip(framebuffer_mode mode, framebuffer_color color) {
+  char path[] = "/tmp/recording_testXXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 30, 8));
+  CHECK(framebuffer_set_mode(&fb, mode));
+  CHECK(framebuffer_set_color(&fb, color));
+  const int frames = 2 * RECORDING_KEYFRAME_INTERVAL + 10;
+  uint64_t checksums[2 * RECORDING_KEYFRAME_INTERVAL + 10];
+  recording_writer w;
+  CHECK(recording_writer_open(&w, path, &fb));
+  for (int frame = 0; frame < frames; ++frame) {
+    // a resize halfway through starts over with a keyframe
+    if (frame == frames / 2)
+      CHECK(framebuffer_resize(&fb, 24, 10));
+    draw_frame(&fb, frame);
+    checksums[frame] = framebuffer_checksum(&fb);
+    CHECK(recording_writer_add(&w, &fb, frame * 0.04));
+  }
+  long long bytes = w.bytes;
+  CHECK(recording_writer_close(&w));
+  // mostly unchanged frames take a fraction of their cells
+  long long cell_bytes = color == FRAMEBUFFER_MONOCHROME ? 1 : 5;
+  CHECK(bytes < frames * 30 * 8 * cell_bytes / 2);
+
+  recording rec;
+  CHECK(recording_open(&rec, path));
+  CHECK(rec.mode == mode);
+  CHECK(rec.color_mode == color);
+  framebuffer played;
+  CHECK(recording_framebuffer(&rec, &played));
+  double seconds = -1;
+  for (int frame = 0; frame < frames; ++frame) {
+    CHECK_EQ_INT(recording_next(&rec, &played, &seconds), 1);
+    CHECK_EQ_INT(framebuffer_checksum(&played) == checksums[frame], 1);
+    CHECK(seconds > frame * 0.04 - 1e-6 && seconds < frame * 0.04 + 1e-6);
+  }
+  CHECK_EQ_INT(played.width, 24);
+  CHECK_EQ_INT(recording_next(&rec, &played, &seconds), 0);
+
+  // playing it again gives the same first frame
+  recording_rewind(&rec);
+  CHECK_EQ_INT(recording_next(&rec, &played, &seconds), 1);
+  CHECK_EQ_INT(framebuffer_checksum(&played) == checksums[0], 1);
+  recording_close(&rec);
+  framebuffer_free(&played);
+  framebuffer_free(&fb);
+  remove(path);
+}
+
+static void test_ascii_round_trip(void) {
+  round_trip(FRAMEBUFFER_ASCII, FRAMEBUFFER_MONOCHROME);
+}
+
+static void test_braille_color_round_trip(void) {
+  round_trip(FRAMEBUFFER_BRAILLE, FRAMEBUFFER_TRUECOLOR);
+}
+
+static void test_truncated_recording(void) {
+  char path[] = "/tmp/recording_testXXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 30, 8));
+  recording_writer w;
+  CHECK(recording_writer_open(&w, path, &fb));
+  draw_frame(&fb, 0);
+  CHECK(recording_writer_add(&w, &fb, 0));
+  long long size = w.bytes;
+  CHECK(recording_writer_close(&w));
+  CHECK(truncate(path, size - 3) == 0);
+
+  recording rec;
+  CHECK(recording_open(&rec, path));
+  framebuffer played;
+  CHECK(recording_framebuffer(&rec, &played));
+  double seconds;
+  CHECK_EQ_INT(recording_next(&rec, &played, &seconds), -1);
+  recording_close(&rec);
+  framebuffer_free(&played);
+  framebuffer_free(&fb);
+  remove(path);
+}
+
+int main(void) {
+  RUN_TEST(test_ascii_round_trip);
+  RUN_TEST(test_braille_color_round_trip);
+  RUN_TEST(test_truncated_recording);
+  return test_failures();
+}
@@ -0,0 +1,156 @@
+#include "scene_compare.h"
+#include <stdio.h>
+#include <string.h>
+
+#define REPORT(...)                                                            \
+  do {                                                                         \
+    fprintf(stderr, "%s: ", context);                                          \
+    fprintf(stderr, __VA_ARGS__);                                              \
+    fputc('\n', stderr);                                                       \
+    return 0;                                                                  \
+  } while (0)
+
+#define COMPARE_COUNT(field)                                                   \
+  if (expected->field != actual->field)                                        \
+  REPORT(#field " differs: %d vs %d", expected->field, actual->field)
+
+static int vectors_equal(obj_vector **a, obj_vector **b, int count,
+                         const char *name, const char *context) {
+  for (int i = 0; i < count; ++i)
+    for (int k = 0; k < 3; ++k)
+      if (a[i]->e[k] != b[i]->e[k])
+        REPORT("%s[%d].e[%d] differs: %.17g vs %.17g", name, i, k, a[i]->e[k],
+               b[i]->e[k]);
+  return 1;
+}
+
+static int ints_equal(const int *a, const int *b, int count, const char *name,
+                      int element, const char *context) {
+  for (int i = 0; i < count; ++i)
+    if (a[i] != b[i])
+      REPORT("%s of element %d differs at %d: %d vs %d", name, element, i,
+             a[i], b[i]);
+  return 1;
+}
+
+static int faces_equal(const obj_scene_data *expected,
+                       const obj_scene_data *actual, const char *context) {
+  for (int i = 0; i < expected->face_count; ++i) {
+    const obj_face *a = expected->face_list[i], *b = actual->face_list[i];
+    if (a->vertex_count != b->vertex_count)
+      REPORT("face %d vertex_count differs: %d vs %d", i, a->vertex_count,
+             b->vertex_count);
+    if (a->material_index != b->material_index)
+      REPORT("face %d material_index differs: %d vs %d", i, a->material_index,
+             b->material_index);
+    // only the used slots are meaningful
+    if (!ints_equal(a->vertex_index, b->vertex_index, a->vertex_count,
+                    "face vertex_index", i, context) ||
+        !ints_equal(a->texture_index, b->texture_index, a->vertex_count,
+                    "face texture_index", i, context) ||
+        !ints_equal(a->normal_index, b->normal_index, a->vertex_count,
+                    "face normal_index", i, context))
+      return 0;
+  }
+  return 1;
+}
+
+static int materials_equal(const obj_scene_data *expected,
+                           const obj_scene_data *actual, const char *context) {
+  for (int i = 0; i < expected->material_count; ++i) {
+    const obj_material *a = expected->material_list[i],
+                       *b = actual->material_list[i];
+    if (strcmp(a->name, b->name) != 0)
+      REPORT("material %d name differs: '%s' vs '%s'", i, a->name, b->name);
+    if (strcmp(a->texture_filename, b->texture_filename) != 0)
+      REPORT("material %d texture differs: '%s' vs '%s'", i,
+             a->texture_filename, b->texture_filename);
+    for (int k = 0; k < 3; ++k)
+      if (a->amb[k] != b->amb[k] || a->diff[k] != b->diff[k] ||
+          a->spec[k] != b->spec[k])
+        REPORT("material %d colour component %d differs", i, k);
+    if (a->reflect != b->reflect || a->trans != b->trans ||
+        a->shiny != b->shiny || a->glossy != b->glossy ||
+        a->refract_index != b->refract_index)
+      REPORT("material %d scalar properties differ", i);
+  }
+  return 1;
+}
+
+static int primitives_equal(const obj_scene_data *expected,
+                            const obj_scene_data *actual,
+                            const char *context) {
+  for (int i = 0; i < expected->sphere_count; ++i) {
+    const obj_sphere *a = expected->sphere_list[i], *b = actual->sphere_list[i];
+    if (a->pos_index != b->pos_index ||
+        a->up_normal_index != b->up_normal_index ||
+        a->equator_normal_index != b->equator_normal_index ||
+        a->material_index != b->material_index)
+      REPORT("sphere %d differs", i);
+  }
+  for (int i = 0; i < expected->plane_count; ++i) {
+    const obj_plane *a = expected->plane_list[i], *b = actual->plane_list[i];
+    if (a->pos_index != b->pos_index || a->normal_index != b->normal_index ||
+        a->rotation_normal_index != b->rotation_normal_index ||
+        a->material_index != b->material_index)
+      REPORT("plane %d differs", i);
+  }
+  for (int i = 0; i < expected->light_point_count; ++i) {
+    const obj_light_point *a = expected->light_point_list[i],
+                          *b = actual->light_point_list[i];
+    if (a->pos_index != b->pos_index || a->material_index != b->material_index)
+      REPORT("point light %d differs", i);
+  }
+  for (int i = 0; i < expected->light_disc_count; ++i) {
+    const obj_light_disc *a = expected->light_disc_list[i],
+                         *b = actual->light_disc_list[i];
+    if (a->pos_index != b->pos_index || a->normal_index != b->normal_index ||
+        a->material_index != b->material_index)
+      REPORT("disc light %d differs", i);
+  }
+  for (int i = 0; i < expected->light_quad_count; ++i) {
+    const obj_light_quad *a = expected->light_quad_list[i],
+                         *b = actual->light_quad_list[i];
+    if (a->material_index != b->material_index ||
+        !ints_equal(a->vertex_index, b->vertex_index, MAX_VERTEX_COUNT,
+                    "quad light vertex_index", i, context))
+      REPORT("quad light %d differs", i);
+  }
+  if ((expected->camera == NULL) != (actual->camera == NULL))
+    REPORT("camera presence differs");
+  if (expected->camera != NULL &&
+      (expected->camera->camera_pos_index != actual->camera->camera_pos_index ||
+       expected->camera->camera_look_point_index !=
+           actual->camera->camera_look_point_index ||
+       expected->camera->camera_up_norm_index !=
+           actual->camera->camera_up_norm_index))
+    REPORT("camera differs");
+  return 1;
+}
+
+int scenes_equal(const obj_scene_data *expected, const obj_scene_data *actual,
+                 const char *context) {
+  COMPARE_COUNT(vertex_count);
+  COMPARE_COUNT(vertex_normal_count);
+  COMPARE_COUNT(vertex_texture_count);
+  COMPARE_COUNT(face_count);
+  COMPARE_COUNT(sphere_count);
+  COMPARE_COUNT(plane_count);
+  COMPARE_COUNT(light_point_count);
+  COMPARE_COUNT(light_quad_count);
+  COMPARE_COUNT(light_disc_count);
+  COMPARE_COUNT(material_count);
+
+  return vectors_equal(expected->vertex_list, actual->vertex_list,
+                       expected->vertex_count, "vertex_list", context) &&
+         vectors_equal(expected->vertex_normal_list, actual->vertex_normal_list,
+                       expected->vertex_normal_count, "vertex_normal_list",
+                       context) &&
+         vectors_equal(expected->vertex_texture_list,
+                       actual->vertex_texture_list,
+                       expected->vertex_texture_count, "vertex_texture_list",
+                       context) &&
+         faces_equal(expected, actual, context) &&
+         materials_equal(expected, actual, context) &&
+         primitives_equal(expected, actual, context);
+}
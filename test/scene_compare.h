@@ -0,0 +1,12 @@
+#ifndef SCENE_COMPARE_H
+#define SCENE_COMPARE_H
+
+#include "obj_parser.h"
+
+// Compares two parsed scenes element by element. Returns 1 when equal,
+// otherwise prints the first difference prefixed with `context` and
+// returns 0. Vector components are compared exactly.
+int scenes_equal(const obj_scene_data *expected, const obj_scene_data *actual,
+                 const char *context);
+
+#endif
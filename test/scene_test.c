@@ -0,0 +1,74 @@
+#include "framebuffer.h"
+#include "render.h"
+#include "scene.h"
+#include "test_util.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char cube[] = "v -1 -1 -1\nv 1 -1 -1\nv 1 1 -1\nv -1 1 -1\n"
+                           "v -1 -1 1\nv 1 -1 1\nv 1 1 1\nv -1 1 1\n"
+                           "f 1 4 3 2\nf 5 6 7 8\nf 1 2 6 5\n"
+                           "f 4 8 7 3\nf 1 5 8 4\nf 2 3 7 6\n";
+
+// One spinning and one still cube side by side
+static int load_scene(scene *s) {
+  char text[512];
+  snprintf(text, sizeof(text),
+           "mesh cube %s 0.5\n"
+           "instance cube -1 0 4 0 0 0 1 1\n"
+           "instance cube 1 0 4 0 0 0 1 0\n",
+           write_temp_file(cube));
+  return scene_load(s, write_temp_file(text));
+}
+
+static void test_only_moving_instances_are_projected(void) {
+  scene s;
+  CHECK(load_scene(&s));
+  // the packed positions are the only copy of the vertices
+  CHECK_EQ_INT(s.meshes[0].vertex_count, 8);
+  CHECK(s.meshes[0].data.vertex_list == NULL);
+  CHECK_EQ_INT(s.meshes[0].data.face_count, 6);
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 60, 20));
+  render_stats stats = {0};
+
+  scene_update(&s, 0);
+  CHECK(scene_draw(&s, &fb, &stats));
+  CHECK_EQ_INT(stats.objects_projected, 2);
+
+  scene_update(&s, 0.5f);
+  CHECK(scene_draw(&s, &fb, &stats));
+  CHECK_EQ_INT(stats.objects_projected, 3);
+
+  // nothing moved, the framebuffer is left alone
+  scene_update(&s, 0.5f);
+  CHECK(!scene_draw(&s, &fb, &stats));
+  CHECK_EQ_INT(stats.frames_drawn, 2);
+
+  // the partial update matches drawing a fresh scene from scratch
+  scene fresh;
+  CHECK(load_scene(&fresh));
+  framebuffer expected;
+  CHECK(framebuffer_init(&expected, 60, 20));
+  scene_update(&fresh, 0.5f);
+  CHECK(scene_draw(&fresh, &expected, NULL));
+  CHECK(memcmp(fb.cells, expected.cells, 60 * 20) == 0);
+
+  // a new framebuffer size re-projects everything
+  framebuffer resized;
+  CHECK(framebuffer_init(&resized, 40, 12));
+  CHECK(scene_draw(&s, &resized, &stats));
+  CHECK_EQ_INT(stats.objects_projected, 5);
+
+  framebuffer_free(&fb);
+  framebuffer_free(&expected);
+  framebuffer_free(&resized);
+  scene_free(&s);
+  scene_free(&fresh);
+}
+
+int main(void) {
+  RUN_TEST(test_only_moving_instances_are_projected);
+  remove_temp_files();
+  return test_failures();
+}
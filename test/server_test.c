@@ -0,0 +1,124 @@
+#include "framebuffer.h"
+#include "server.h"
+#include "test_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int connect_client(const char *path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+  if (fd < 0 ||
+      connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    return -1;
+  return fd;
+}
+
+// Everything the server has written to fd so far
+static size_t receive(int fd, char *out, size_t size) {
+  size_t used = 0;
+  ssize_t n;
+  while (used < size &&
+         (n = recv(fd, out + used, size - used, MSG_DONTWAIT)) > 0)
+    used += (size_t)n;
+  return used;
+}
+
+static size_t count_clears(const char *data, size_t size) {
+  size_t count = 0;
+  for (size_t i = 0; i + 4 <= size; ++i)
+    count += memcmp(data + i, "\x1b[2J", 4) == 0;
+  return count;
+}
+
+// Every cell changes from one frame to the next
+static void draw_frame(framebuffer *fb, int frame) {
+  framebuffer_clear(fb, frame % 2 ? '#' : '.');
+}
+
+static void test_fan_out(void) {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/server_test_%d.sock", (int)getpid());
+  frame_server server;
+  CHECK(frame_server_open(&server, path));
+  int a = connect_client(path), b = connect_client(path);
+  CHECK(a >= 0 && b >= 0);
+  frame_server_poll(&server, 0.05);
+  CHECK_EQ_INT(server.client_count, 2);
+
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 40, 10));
+  for (int frame = 0; frame < 5; ++frame) {
+    draw_frame(&fb, frame);
+    framebuffer_put(&fb, frame, frame, 'x');
+    CHECK(frame_server_publish(&server, &fb));
+  }
+  // one full frame each, then only changes
+  CHECK_EQ_INT(server.keyframes_sent, 2);
+  static char got_a[1 << 16], got_b[1 << 16];
+  size_t size_a = receive(a, got_a, sizeof(got_a));
+  size_t size_b = receive(b, got_b, sizeof(got_b));
+  CHECK_EQ_INT(size_a, size_b);
+  CHECK(memcmp(got_a, got_b, size_a) == 0);
+  CHECK(memcmp(got_a, "\x1b[2J", 4) == 0);
+  CHECK_EQ_INT(count_clears(got_a, size_a), 1);
+
+  // a client that leaves is dropped
+  close(b);
+  frame_server_poll(&server, 0.05);
+  CHECK_EQ_INT(server.client_count, 1);
+  close(a);
+  framebuffer_free(&fb);
+  frame_server_close(&server);
+  CHECK(access(path, F_OK) != 0);
+}
+
+static void test_slow_client_skips_ahead(void) {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/server_test_%d.sock", (int)getpid());
+  frame_server server;
+  CHECK(frame_server_open(&server, path));
+  int slow = connect_client(path);
+  CHECK(slow >= 0);
+  frame_server_poll(&server, 0.05);
+  CHECK_EQ_INT(server.client_count, 1);
+
+  // far more than the socket and the backlog hold, without reading
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 200, 60));
+  const int frames = 200;
+  for (int frame = 0; frame < frames; ++frame) {
+    draw_frame(&fb, frame);
+    CHECK(frame_server_publish(&server, &fb));
+    const frame_client *c = server.clients[0];
+    CHECK(c->length - c->sent <= SERVER_CLIENT_BACKLOG);
+  }
+  CHECK(server.clients[0]->frames_skipped > 0);
+
+  // once it catches up it starts over from a full frame
+  static char got[4 << 20];
+  size_t size = 0;
+  for (int i = 0; i < 50; ++i) {
+    size += receive(slow, got + size, sizeof(got) - size);
+    frame_server_poll(&server, 0.002);
+  }
+  draw_frame(&fb, frames);
+  CHECK(frame_server_publish(&server, &fb));
+  size += receive(slow, got + size, sizeof(got) - size);
+  CHECK_EQ_INT(count_clears(got, size), 2);
+  CHECK(size < (size_t)frames * 200 * 60);
+
+  close(slow);
+  framebuffer_free(&fb);
+  frame_server_close(&server);
+}
+
+int main(void) {
+  RUN_TEST(test_fan_out);
+  RUN_TEST(test_slow_client_skips_ahead);
+  return test_failures();
+}
@@ -0,0 +1,69 @@
+#include "framebuffer.h"
+#include "terminal.h"
+#include "test_util.h"
+#include <string.h>
+#include <unistd.h>
+
+// Everything written to a pipe whose write end is closed
+static size_t drain(int fd, char *out, size_t size) {
+  size_t used = 0;
+  ssize_t n;
+  while (used < size - 1 && (n = read(fd, out + used, size - 1 - used)) > 0)
+    used += (size_t)n;
+  out[used] = '\0';
+  return used;
+}
+
+static void test_raw_sends_changed_cells(void) {
+  int pipe_fds[2];
+  CHECK(pipe(pipe_fds) == 0);
+  terminal_output t;
+  terminal_output_init(&t, pipe_fds[1]);
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 20, 3));
+  framebuffer_clear(&fb, '.');
+  char out[1024];
+
+  // the first frame clears the screen and sends every row, in one write
+  CHECK(terminal_output_frame(&t, &fb, 3, 20));
+  CHECK_EQ_INT(t.writes, 1);
+  close(pipe_fds[1]);
+  size_t n = drain(pipe_fds[0], out, sizeof(out));
+  CHECK_EQ_INT(n, 4 + 3 * (6 + 20));
+  CHECK(strncmp(out, "\x1b[2J\x1b[1;1H....................", 30) == 0);
+  close(pipe_fds[0]);
+
+  CHECK(pipe(pipe_fds) == 0);
+  t.fd = pipe_fds[1];
+  // an unchanged frame costs no syscall at all
+  CHECK(terminal_output_frame(&t, &fb, 3, 20));
+  CHECK_EQ_INT(t.writes, 1);
+
+  // changes close together share a run, distant ones get a cursor move
+  framebuffer_put(&fb, 1, 2, 'x');
+  framebuffer_put(&fb, 1, 5, 'x');
+  framebuffer_put(&fb, 2, 18, 'x');
+  CHECK(terminal_output_frame(&t, &fb, 3, 20));
+  CHECK_EQ_INT(t.writes, 2);
+  close(pipe_fds[1]);
+  drain(pipe_fds[0], out, sizeof(out));
+  CHECK(strcmp(out, "\x1b[2;3Hx..x\x1b[3;19Hx") == 0);
+  close(pipe_fds[0]);
+
+  // a smaller screen is sent in full again, clipped
+  CHECK(pipe(pipe_fds) == 0);
+  t.fd = pipe_fds[1];
+  CHECK(terminal_output_frame(&t, &fb, 1, 4));
+  close(pipe_fds[1]);
+  drain(pipe_fds[0], out, sizeof(out));
+  CHECK(strcmp(out, "\x1b[1;1H....") == 0);
+  close(pipe_fds[0]);
+
+  terminal_output_free(&t);
+  framebuffer_free(&fb);
+}
+
+int main(void) {
+  RUN_TEST(test_raw_sends_changed_cells);
+  return test_failures();
+}
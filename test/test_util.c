@@ -0,0 +1,35 @@
+#include "test_util.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_TEMP_FILES 64
+
+int test_failure_count = 0;
+
+static char temp_paths[MAX_TEMP_FILES][32];
+static int temp_count = 0;
+
+const char *write_temp_file(const char *contents) {
+  if (temp_count == MAX_TEMP_FILES)
+    return NULL;
+  char *path = temp_paths[temp_count];
+  strcpy(path, "/tmp/obj_test_XXXXXX");
+  int fd = mkstemp(path);
+  if (fd < 0)
+    return NULL;
+  size_t len = strlen(contents);
+  if (write(fd, contents, len) != (ssize_t)len) {
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+  ++temp_count;
+  return path;
+}
+
+void remove_temp_files(void) {
+  for (int i = 0; i < temp_count; ++i)
+    unlink(temp_paths[i]);
+  temp_count = 0;
+}
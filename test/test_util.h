@@ -0,0 +1,43 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdio.h>
+
+// Tiny assertion helpers: a failed CHECK reports and keeps going so one run
+// shows every failure, main() returns test_failures() as the exit code.
+
+extern int test_failure_count;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++test_failure_count;                                                    \
+    }                                                                          \
+  } while (0)
+
+#define CHECK_EQ_INT(a, b)                                                     \
+  do {                                                                         \
+    long long check_a_ = (long long)(a), check_b_ = (long long)(b);            \
+    if (check_a_ != check_b_) {                                                \
+      fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %s (%lld vs %lld)\n",     \
+              __FILE__, __LINE__, #a, #b, check_a_, check_b_);                 \
+      ++test_failure_count;                                                    \
+    }                                                                          \
+  } while (0)
+
+#define RUN_TEST(fn)                                                           \
+  do {                                                                         \
+    int failures_before_ = test_failure_count;                                 \
+    fn();                                                                      \
+    printf("%s %s\n", test_failure_count == failures_before_ ? "[ OK ]" : "[FAIL]", \
+           #fn);                                                               \
+  } while (0)
+
+static inline int test_failures(void) { return test_failure_count ? 1 : 0; }
+
+// Writes `contents` to a fresh temporary file and returns its path
+const char *write_temp_file(const char *contents);
+void remove_temp_files(void);
+
+#endif
@@ -0,0 +1,160 @@
+#include "render.h"
+#include "test_util.h"
+#include "texture.h"
+#include <stdio.h>
+#include <string.h>
+
+static int decode(texture *t, const char *data, size_t size) {
+  return texture_decode_pnm(t, (const unsigned char *)data, size);
+}
+
+static void test_decode_plain(void) {
+  texture t;
+  // comments and maxval 15 are scaled to 0-255
+  const char pgm[] = "P2 # plain graymap\n2 2\n15\n0 15\n# row two\n5 10\n";
+  CHECK(decode(&t, pgm, sizeof(pgm) - 1));
+  CHECK_EQ_INT(t.width, 2);
+  CHECK_EQ_INT(t.height, 2);
+  CHECK_EQ_INT(t.levels, 2);
+  CHECK_EQ_INT(t.texels[0], 0);
+  CHECK_EQ_INT(t.texels[1], 255);
+  CHECK_EQ_INT(t.texels[2], 85);
+  CHECK_EQ_INT(t.texels[3], 170);
+  // the 1x1 level averages them
+  CHECK_EQ_INT(t.texels[t.offsets[1]], 128);
+  texture_free(&t);
+
+  const char ppm[] = "P3\n1 1\n255\n255 0 0\n";
+  CHECK(decode(&t, ppm, sizeof(ppm) - 1));
+  CHECK_EQ_INT(t.texels[0], 76); // luma of pure red
+  texture_free(&t);
+}
+
+static void test_decode_binary(void) {
+  texture t;
+  const char pgm[] = "P5\n3 1\n255\n\x00\x80\xff";
+  CHECK(decode(&t, pgm, sizeof(pgm) - 1));
+  CHECK_EQ_INT(t.levels, 2);
+  CHECK_EQ_INT(t.texels[1], 128);
+  CHECK_EQ_INT(texture_level_width(&t, 1), 1);
+  texture_free(&t);
+
+  // 16-bit samples are big-endian
+  const char wide[] = "P6\n1 1\n65535\n\xff\xff\xff\xff\xff\xff";
+  CHECK(decode(&t, wide, sizeof(wide) - 1));
+  CHECK_EQ_INT(t.texels[0], 255);
+  texture_free(&t);
+}
+
+static void test_rejects_malformed(void) {
+  texture t;
+  const char truncated[] = "P5\n4 4\n255\n\x01\x02";
+  CHECK(!decode(&t, truncated, sizeof(truncated) - 1));
+  const char png[] = "\x89PNG\r\n";
+  CHECK(!decode(&t, png, sizeof(png) - 1));
+  const char missing[] = "P2\n2 1\n255\n7\n";
+  CHECK(!decode(&t, missing, sizeof(missing) - 1));
+  CHECK(t.texels == NULL);
+}
+
+static void test_mipmaps(void) {
+  // 5x3: every level halves, rounding down, until 1x1
+  char data[64] = "P5\n5 3\n255\n";
+  size_t header = strlen(data);
+  for (int i = 0; i < 15; ++i)
+    data[header + i] = (char)(i * 10);
+  texture t;
+  CHECK(decode(&t, data, header + 15));
+  CHECK_EQ_INT(t.levels, 3);
+  CHECK_EQ_INT(texture_level_width(&t, 1), 2);
+  CHECK_EQ_INT(texture_level_height(&t, 1), 1);
+  CHECK_EQ_INT(t.offsets[1], 15);
+  CHECK_EQ_INT(t.offsets[2], 17);
+  // (0 + 10 + 50 + 60) / 4
+  CHECK_EQ_INT(t.texels[t.offsets[1]], 30);
+  texture_free(&t);
+}
+
+static void test_sample_wraps(void) {
+  // top row dark, bottom row bright; v = 0 is the bottom
+  const char pgm[] = "P2\n2 2\n255\n0 50\n200 250\n";
+  texture t;
+  CHECK(decode(&t, pgm, sizeof(pgm) - 1));
+  CHECK_EQ_INT(texture_sample(&t, 0, 0.25f, 0.25f), 200);
+  CHECK_EQ_INT(texture_sample(&t, 0, 0.75f, 0.75f), 50);
+  CHECK_EQ_INT(texture_sample(&t, 0, 1.75f, -0.25f), 50);
+  CHECK_EQ_INT(texture_sample(&t, 0, -0.25f, 2.25f), 250);
+  CHECK_EQ_INT(texture_sample(&t, 1, 0.9f, 0.9f), 125);
+  texture_free(&t);
+}
+
+// A square at z = 1 covering most of a 20x10 framebuffer, left half of its
+// texture black and right half white, so both ends of the ramp show up
+static const char *textured_square(char *mtl, size_t mtl_size,
+                                   const char *image_path) {
+  snprintf(mtl, mtl_size,
+           "newmtl left\nKd 1 1 1\nmap_Ka %s\n"
+           "newmtl right\nKd 1 1 1\nmap_Ka %s\n"
+           "newmtl plain\nKd 0 0 0\n",
+           image_path, image_path);
+  return write_temp_file(mtl);
+}
+
+static void test_shared_texture_and_fill(void) {
+  const char *image = write_temp_file("P2\n2 1\n255\n0 255\n");
+  char mtl[256];
+  const char *mtl_path = textured_square(mtl, sizeof(mtl), image);
+  char obj[512];
+  snprintf(obj, sizeof(obj),
+           "mtllib %s\n"
+           "v -0.4 -0.4 1\nv 0.4 -0.4 1\nv 0.4 0.4 1\nv -0.4 0.4 1\n"
+           "v -0.4 -0.4 2\nv 0.4 -0.4 2\nv 0.4 0.4 2\n"
+           "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+           "usemtl left\nf 1/1 2/2 3/3 4/4\n"
+           // behind the square, hidden by the depth test
+           "usemtl plain\nf 5 6 7\n"
+           "usemtl right\n",
+           mtl_path);
+  const char *obj_path = write_temp_file(obj);
+  struct obj_scene_data model;
+  CHECK(parse_obj_scene(&model, (char *)obj_path));
+  texture_set textures;
+  CHECK(texture_set_load(&textures, &model, obj_path, false));
+  // both materials name one image, which is decoded once
+  CHECK_EQ_INT(textures.texture_count, 1);
+  CHECK(texture_set_get(&textures, 0) == texture_set_get(&textures, 1));
+  CHECK(texture_set_get(&textures, 0) != NULL);
+  CHECK(texture_set_get(&textures, 2) == NULL);
+
+  framebuffer fb;
+  CHECK(framebuffer_init(&fb, 20, 10));
+  framebuffer_clear(&fb, '.');
+  float depth[200];
+  draw_textured_faces(&fb, &model, &textures, NULL, 0, depth);
+  // rows 1-8, columns 2-17 are covered by the square
+  CHECK_EQ_INT(fb.cells[5 * 20 + 4], ' ');
+  CHECK_EQ_INT(fb.cells[5 * 20 + 15], '@');
+  CHECK_EQ_INT(fb.cells[0], '.');
+  CHECK_EQ_INT(fb.cells[5 * 20 + 19], '.');
+  CHECK(depth[5 * 20 + 10] == 1.f);
+
+  // without textures faces are filled flat with their diffuse brightness
+  framebuffer_clear(&fb, '.');
+  draw_textured_faces(&fb, &model, NULL, NULL, 0, depth);
+  CHECK_EQ_INT(fb.cells[5 * 20 + 4], '@');
+
+  framebuffer_free(&fb);
+  texture_set_free(&textures);
+  delete_obj_data(&model);
+}
+
+int main(void) {
+  RUN_TEST(test_decode_plain);
+  RUN_TEST(test_decode_binary);
+  RUN_TEST(test_rejects_malformed);
+  RUN_TEST(test_mipmaps);
+  RUN_TEST(test_sample_wraps);
+  RUN_TEST(test_shared_texture_and_fill);
+  remove_temp_files();
+  return test_failures();
+}
@@ -0,0 +1,112 @@
+#include "model.h"
+#include "test_util.h"
+#include "watcher.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *const triangle_obj = "mtllib %s/w.mtl\n"
+                                    "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+                                    "usemtl a\nf 1 2 3\n";
+static const char *const quad = "mtllib %s/w.mtl\n"
+                                "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+                                "usemtl a\nf 1 2 3 4\nf 1 2 3\n";
+
+static void write_file(const char *path, const char *format, const char *dir) {
+  FILE *out = fopen(path, "w");
+  fprintf(out, format, dir);
+  fclose(out);
+}
+
+static loaded_model *wait_for_reload(model_watcher *w) {
+  for (int i = 0; i < 200; ++i) {
+    loaded_model *m = model_watcher_take(w);
+    if (m != NULL)
+      return m;
+    usleep(10 * 1000);
+  }
+  return NULL;
+}
+
+static void test_reload_on_rename(void) {
+  char dir[] = "/tmp/watcher_test_XXXXXX";
+  CHECK(mkdtemp(dir) != NULL);
+  char obj_path[64], mtl_path[64], tmp_path[64];
+  snprintf(obj_path, sizeof(obj_path), "%s/w.obj", dir);
+  snprintf(mtl_path, sizeof(mtl_path), "%s/w.mtl", dir);
+  snprintf(tmp_path, sizeof(tmp_path), "%s/w.obj.tmp", dir);
+  write_file(mtl_path, "newmtl a\nKd 1 0 0\n", dir);
+  write_file(obj_path, triangle_obj, dir);
+
+  model_watcher w;
+  model_watcher_init(&w, obj_path);
+  loaded_model current;
+  CHECK(loaded_model_load(&current, obj_path, &w.mtl_cache, false));
+  CHECK_EQ_INT(current.source.face_count, 1);
+  CHECK(model_watcher_start(&w));
+
+  // save the way editors do: write elsewhere, then rename over the original
+  write_file(tmp_path, quad, dir);
+  CHECK(rename(tmp_path, obj_path) == 0);
+  loaded_model *reloaded = wait_for_reload(&w);
+  CHECK(reloaded != NULL);
+  if (reloaded != NULL) {
+    CHECK_EQ_INT(reloaded->source.face_count, 2);
+    CHECK_EQ_INT(reloaded->source.material_count, 1);
+    CHECK_EQ_INT(reloaded->source.face_list[0]->material_index, 0);
+    model_watcher_retire(&w, reloaded);
+  }
+
+  // the unchanged material library came from the cache, each load parses
+  // the file once
+  CHECK_EQ_INT(w.mtl_cache.misses, 1);
+  CHECK_EQ_INT(w.mtl_cache.hits, 1);
+  model_watcher_stop(&w);
+  loaded_model_free(&current);
+  unlink(obj_path);
+  unlink(mtl_path);
+  rmdir(dir);
+}
+
+// Bytes written to stdout and stderr while loading `path`
+static long printed_while_loading(const char *path, bool quiet) {
+  fflush(stdout);
+  fflush(stderr);
+  FILE *capture = tmpfile();
+  int saved_out = dup(STDOUT_FILENO), saved_err = dup(STDERR_FILENO);
+  dup2(fileno(capture), STDOUT_FILENO);
+  dup2(fileno(capture), STDERR_FILENO);
+  loaded_model m;
+  int loaded = loaded_model_load(&m, path, NULL, quiet);
+  fflush(stdout);
+  fflush(stderr);
+  dup2(saved_out, STDOUT_FILENO);
+  dup2(saved_err, STDERR_FILENO);
+  close(saved_out);
+  close(saved_err);
+  CHECK(loaded);
+  if (loaded)
+    loaded_model_free(&m);
+  fseek(capture, 0, SEEK_END);
+  long size = ftell(capture);
+  fclose(capture);
+  return size;
+}
+
+// Reloads run while the render loop owns the terminal, the parser and the
+// fit must not print over the frame
+static void test_quiet_load(void) {
+  const char *path = write_temp_file("mtllib /nonexistent/w.mtl\n"
+                                     "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+                                     "frobnicate\nf 1 2 3\n");
+  CHECK(printed_while_loading(path, false) > 0);
+  CHECK_EQ_INT(printed_while_loading(path, true), 0);
+}
+
+int main(void) {
+  RUN_TEST(test_reload_on_rename);
+  RUN_TEST(test_quiet_load);
+  remove_temp_files();
+  return test_failures();
+}
@@ -0,0 +1,215 @@
+#include "obj_parser.h"
+#include "obj_writer.h"
+#include "test_util.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int same_bits(double a, double b) { return memcmp(&a, &b, sizeof(a)) == 0; }
+
+static int reads_back(double value) {
+  char text[OBJ_DOUBLE_TEXT_SIZE + 1];
+  int length = obj_format_double(text, value);
+  return length == (int)strlen(text) && length <= OBJ_DOUBLE_TEXT_SIZE &&
+         same_bits(atof(text), value);
+}
+
+static void check_text(double value, const char *expected) {
+  char text[OBJ_DOUBLE_TEXT_SIZE + 1];
+  obj_format_double(text, value);
+  if (strcmp(text, expected) != 0)
+    fprintf(stderr, "%.17g written as %s, expected %s\n", value, text,
+            expected);
+  CHECK(strcmp(text, expected) == 0);
+}
+
+static void test_format_double(void) {
+  // decimals as short as they can be
+  check_text(0, "0");
+  check_text(-0.0, "-0");
+  check_text(1, "1");
+  check_text(0.5, "0.5");
+  check_text(0.1, "0.1");
+  check_text(-278.0, "-278");
+  check_text(123456.789, "123456.789");
+  check_text(0.00001, "0.00001");
+  check_text(0.000001, "1e-06");
+  check_text(-0.123456, "-0.123456");
+  check_text(4503599627370496.0, "4503599627370496");
+  check_text(0.1 + 0.2, "0.30000000000000004");
+
+  CHECK(reads_back(1e300));
+  CHECK(reads_back(-1.2345678901234567e-300));
+  CHECK(reads_back(5e-324));
+  CHECK(reads_back(1.7976931348623157e308));
+  CHECK(reads_back(INFINITY));
+  CHECK(reads_back(-INFINITY));
+  char text[OBJ_DOUBLE_TEXT_SIZE + 1];
+  obj_format_double(text, NAN);
+  CHECK(isnan(atof(text)));
+
+  // any bit pattern that is a number
+  uint64_t state = 12345;
+  int failures = 0;
+  for (int i = 0; i < 100000; ++i) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    double value;
+    memcpy(&value, &state, sizeof(value));
+    if (isfinite(value) && !reads_back(value))
+      ++failures;
+    // and typical coordinates written with a few decimals
+    double coordinate = (double)(int64_t)(state >> 40) / 1000.0 - 4000;
+    if (!reads_back(coordinate))
+      ++failures;
+  }
+  CHECK_EQ_INT(failures, 0);
+}
+
+static void check_same_scene(const obj_scene_data *a, const obj_scene_data *b) {
+  CHECK_EQ_INT(a->vertex_count, b->vertex_count);
+  CHECK_EQ_INT(a->vertex_normal_count, b->vertex_normal_count);
+  CHECK_EQ_INT(a->vertex_texture_count, b->vertex_texture_count);
+  CHECK_EQ_INT(a->face_count, b->face_count);
+  CHECK_EQ_INT(a->sphere_count, b->sphere_count);
+  CHECK_EQ_INT(a->plane_count, b->plane_count);
+  CHECK_EQ_INT(a->light_point_count, b->light_point_count);
+  CHECK_EQ_INT(a->light_disc_count, b->light_disc_count);
+  CHECK_EQ_INT(a->light_quad_count, b->light_quad_count);
+  CHECK_EQ_INT(a->material_count, b->material_count);
+  if (test_failure_count > 0)
+    return;
+  for (int i = 0; i < a->vertex_count; ++i)
+    CHECK(memcmp(a->vertex_list[i], b->vertex_list[i], sizeof(obj_vector)) == 0);
+  for (int i = 0; i < a->vertex_normal_count; ++i)
+    CHECK(memcmp(a->vertex_normal_list[i], b->vertex_normal_list[i],
+                 sizeof(obj_vector)) == 0);
+  for (int i = 0; i < a->vertex_texture_count; ++i)
+    CHECK(memcmp(a->vertex_texture_list[i], b->vertex_texture_list[i],
+                 sizeof(obj_vector)) == 0);
+  for (int i = 0; i < a->face_count; ++i)
+    CHECK(memcmp(a->face_list[i], b->face_list[i], sizeof(obj_face)) == 0);
+  for (int i = 0; i < a->sphere_count; ++i)
+    CHECK(memcmp(a->sphere_list[i], b->sphere_list[i], sizeof(obj_sphere)) == 0);
+  for (int i = 0; i < a->plane_count; ++i)
+    CHECK(memcmp(a->plane_list[i], b->plane_list[i], sizeof(obj_plane)) == 0);
+  for (int i = 0; i < a->light_point_count; ++i)
+    CHECK(memcmp(a->light_point_list[i], b->light_point_list[i],
+                 sizeof(obj_light_point)) == 0);
+  for (int i = 0; i < a->light_disc_count; ++i)
+    CHECK(memcmp(a->light_disc_list[i], b->light_disc_list[i],
+                 sizeof(obj_light_disc)) == 0);
+  for (int i = 0; i < a->light_quad_count; ++i)
+    CHECK(memcmp(a->light_quad_list[i], b->light_quad_list[i],
+                 sizeof(obj_light_quad)) == 0);
+  for (int i = 0; i < a->material_count; ++i) {
+    const obj_material *x = a->material_list[i], *y = b->material_list[i];
+    CHECK(memcmp(x->amb, y->amb, sizeof(x->amb)) == 0);
+    CHECK(memcmp(x->diff, y->diff, sizeof(x->diff)) == 0);
+    CHECK(memcmp(x->spec, y->spec, sizeof(x->spec)) == 0);
+    CHECK(same_bits(x->reflect, y->reflect) && same_bits(x->trans, y->trans));
+    CHECK(same_bits(x->shiny, y->shiny) && same_bits(x->glossy, y->glossy));
+    CHECK(same_bits(x->refract_index, y->refract_index));
+    CHECK(strcmp(x->name, y->name) == 0);
+    CHECK(strcmp(x->texture_filename, y->texture_filename) == 0);
+  }
+  CHECK((a->camera == NULL) == (b->camera == NULL));
+  if (a->camera != NULL && b->camera != NULL)
+    CHECK(memcmp(a->camera, b->camera, sizeof(obj_camera)) == 0);
+}
+
+// Every element the parser knows, with each kind of index reference
+static void test_round_trip(void) {
+  const char *mtl_path = write_temp_file("newmtl red\nKd 1 0 0\nNs 12.5\n"
+                                         "newmtl textured\nKa 0.1 0.2 0.3\n"
+                                         "map_Ka wood.ppm\nd 0.25\nr 0.7\n"
+                                         "sharpness 60\nNi 1.33\n");
+  char obj[2048];
+  snprintf(obj, sizeof(obj),
+           "mtllib %s\n"
+           "v 0.1 0.2 0.3\nv -1e-310 3.14159265358979 2.5e12\n"
+           "v 1 2 3\nv 4 5 6\nv 7 8 9\n"
+           "vn 0 0 1\nvn 0 1 0\nvt 0.25 0.75\nvt 1 1 0.5\n"
+           "f 1 2 3\n"
+           "usemtl red\nf 1/1 2/2 3/1 4/2\nf 1//1 2//2 3//1\n"
+           "usemtl textured\nf -1/-1/-1 -2/-2/-2 -3/1/2\n"
+           "usemtl\nf 2 3 4\n"
+           "usemtl red\nsp 1/1 1/2 2\npl 2 2 1/1 0/2\n"
+           "lp 5\nld 4 2\nlq 1 2 3 4\nlq 3 4 5\n"
+           "c 1 5 2\n",
+           mtl_path);
+  const char *obj_path = write_temp_file(obj);
+  obj_scene_data original;
+  CHECK(parse_obj_scene(&original, (char *)obj_path));
+  CHECK_EQ_INT(original.face_count, 5);
+  CHECK_EQ_INT(original.material_count, 2);
+
+  const char *out_obj = write_temp_file("");
+  const char *out_mtl = write_temp_file("");
+  CHECK(obj_write_scene(&original, out_obj, out_mtl));
+  obj_scene_data copy;
+  CHECK(parse_obj_scene(&copy, (char *)out_obj));
+  check_same_scene(&original, &copy);
+
+  // and written again it is the same text
+  const char *again = write_temp_file("");
+  CHECK(obj_write_scene(&copy, again, out_mtl));
+  FILE *first = fopen(out_obj, "rb"), *second = fopen(again, "rb");
+  char a[4096], b[4096];
+  size_t na = fread(a, 1, sizeof(a), first), nb = fread(b, 1, sizeof(b), second);
+  CHECK(na == nb && memcmp(a, b, na) == 0);
+  fclose(first);
+  fclose(second);
+
+  delete_obj_data(&copy);
+  delete_obj_data(&original);
+}
+
+// Without a material library every element loses its material
+static void test_without_materials(void) {
+  const char *mtl_path = write_temp_file("newmtl red\nKd 1 0 0\n");
+  char obj[256];
+  snprintf(obj, sizeof(obj), "mtllib %s\nv 0 0 0\nv 1 0 0\nv 0 1 0\n"
+                             "usemtl red\nf 1 2 3\n",
+           mtl_path);
+  obj_scene_data original;
+  CHECK(parse_obj_scene(&original, (char *)write_temp_file(obj)));
+  const char *out_obj = write_temp_file("");
+  CHECK(obj_write_scene(&original, out_obj, NULL));
+  obj_scene_data copy;
+  CHECK(parse_obj_scene(&copy, (char *)out_obj));
+  CHECK_EQ_INT(copy.material_count, 0);
+  CHECK_EQ_INT(copy.face_count, 1);
+  CHECK_EQ_INT(copy.face_list[0]->material_index, -1);
+  delete_obj_data(&copy);
+  delete_obj_data(&original);
+}
+
+static void test_unwritable(void) {
+  obj_scene_data empty;
+  memset(&empty, 0, sizeof(empty));
+  CHECK(!obj_write_scene(&empty, "/nonexistent/out.obj", NULL));
+}
+
+static void test_mtl_filename(void) {
+  char path[32];
+  obj_mtl_filename(path, sizeof(path), "out/model.obj");
+  CHECK(strcmp(path, "out/model.mtl") == 0);
+  // only the file name's extension is replaced
+  obj_mtl_filename(path, sizeof(path), "out.v2/model");
+  CHECK(strcmp(path, "out.v2/model.mtl") == 0);
+  obj_mtl_filename(path, 8, "a_long_name.obj");
+  CHECK(strcmp(path, "a_long_") == 0);
+}
+
+int main(void) {
+  RUN_TEST(test_format_double);
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_without_materials);
+  RUN_TEST(test_unwritable);
+  RUN_TEST(test_mtl_filename);
+  remove_temp_files();
+  return test_failures();
+}
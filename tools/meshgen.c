@@ -0,0 +1,428 @@
+#include "obj_writer.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Writes parametric OBJ meshes of arbitrary size for scale and soak testing.
+// Output goes through a large buffer with hand-rolled number formatting so
+// multi-GB files are limited by the disk, not by printf.
+
+#define WRITE_BUFFER_SIZE (1 << 20)
+#define PI 3.14159265358979323846
+
+typedef enum shape { SHAPE_SPHERE, SHAPE_TORUS, SHAPE_GRID, SHAPE_SOUP } shape;
+
+typedef struct meshgen_options {
+  shape shape;
+  int64_t faces;
+  bool normals;
+  bool texcoords;
+  bool negative;
+  bool quads;
+  int materials;
+  uint64_t seed;
+  const char *output;
+} meshgen_options;
+
+typedef struct writer {
+  FILE *file;
+  char *buffer;
+  size_t used;
+  uint64_t total;
+} writer;
+
+static void writer_flush(writer *w) {
+  if (w->used > 0 && fwrite(w->buffer, 1, w->used, w->file) != w->used) {
+    perror("write");
+    exit(EXIT_FAILURE);
+  }
+  w->total += w->used;
+  w->used = 0;
+}
+
+static void writer_reserve(writer *w, size_t bytes) {
+  if (w->used + bytes > WRITE_BUFFER_SIZE)
+    writer_flush(w);
+}
+
+static void write_str(writer *w, const char *s) {
+  size_t len = strlen(s);
+  writer_reserve(w, len);
+  memcpy(w->buffer + w->used, s, len);
+  w->used += len;
+}
+
+static void write_char(writer *w, char c) {
+  writer_reserve(w, 1);
+  w->buffer[w->used++] = c;
+}
+
+static void write_int(writer *w, int64_t value) {
+  char digits[24];
+  int n = 0;
+  uint64_t v = value < 0 ? (uint64_t)(-value) : (uint64_t)value;
+  do {
+    digits[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+  writer_reserve(w, (size_t)n + 1);
+  if (value < 0)
+    w->buffer[w->used++] = '-';
+  while (n > 0)
+    w->buffer[w->used++] = digits[--n];
+}
+
+// Fixed six decimals, which is what the parser's atof round-trips to float
+static void write_float(writer *w, double value) {
+  int64_t scaled = (int64_t)llround(value * 1e6);
+  if (scaled < 0) {
+    write_char(w, '-');
+    scaled = -scaled;
+  }
+  write_int(w, scaled / 1000000);
+  char frac[8];
+  int64_t rest = scaled % 1000000;
+  frac[0] = '.';
+  for (int i = 6; i >= 1; --i) {
+    frac[i] = (char)('0' + rest % 10);
+    rest /= 10;
+  }
+  frac[7] = '\0';
+  write_str(w, frac);
+}
+
+static void write_vector(writer *w, const char *tag, double x, double y,
+                         double z) {
+  write_str(w, tag);
+  write_char(w, ' ');
+  write_float(w, x);
+  write_char(w, ' ');
+  write_float(w, y);
+  write_char(w, ' ');
+  write_float(w, z);
+  write_char(w, '\n');
+}
+
+typedef struct face_writer {
+  writer *w;
+  const meshgen_options *opts;
+  int64_t vertex_total; // vertices written so far, for negative indices
+  int current_material;
+} face_writer;
+
+static void write_index(face_writer *fw, int64_t index) {
+  // index is 1-based; a negative reference counts back from the last vertex
+  if (fw->opts->negative)
+    write_int(fw->w, index - fw->vertex_total - 1);
+  else
+    write_int(fw->w, index);
+}
+
+static void write_face(face_writer *fw, const int64_t *indices, int count,
+                       int material) {
+  writer *w = fw->w;
+  if (fw->opts->materials > 0 && material != fw->current_material) {
+    write_str(w, "usemtl material_");
+    write_int(w, material);
+    write_char(w, '\n');
+    fw->current_material = material;
+  }
+  write_char(w, 'f');
+  for (int i = 0; i < count; ++i) {
+    write_char(w, ' ');
+    write_index(fw, indices[i]);
+    if (fw->opts->texcoords || fw->opts->normals) {
+      write_char(w, '/');
+      if (fw->opts->texcoords)
+        write_index(fw, indices[i]);
+      if (fw->opts->normals) {
+        write_char(w, '/');
+        write_index(fw, indices[i]);
+      }
+    }
+  }
+  write_char(w, '\n');
+}
+
+static int material_for_row(const meshgen_options *opts, int64_t row,
+                            int64_t rows) {
+  if (opts->materials <= 0)
+    return -1;
+  return (int)(row * opts->materials / rows);
+}
+
+// Emits the faces of a (rows x cols) vertex lattice whose columns may wrap
+static void write_lattice_faces(face_writer *fw, int64_t rows, int64_t cols,
+                                bool wrap_cols, bool wrap_rows) {
+  int64_t face_rows = wrap_rows ? rows : rows - 1;
+  int64_t face_cols = wrap_cols ? cols : cols - 1;
+  for (int64_t r = 0; r < face_rows; ++r) {
+    int material = material_for_row(fw->opts, r, face_rows);
+    for (int64_t c = 0; c < face_cols; ++c) {
+      int64_t r1 = (r + 1) % rows, c1 = (c + 1) % cols;
+      int64_t a = r * cols + c + 1, b = r * cols + c1 + 1;
+      int64_t d = r1 * cols + c + 1, e = r1 * cols + c1 + 1;
+      if (fw->opts->quads) {
+        int64_t quad[4] = {a, b, e, d};
+        write_face(fw, quad, 4, material);
+      } else {
+        int64_t t1[3] = {a, b, e};
+        int64_t t2[3] = {a, e, d};
+        write_face(fw, t1, 3, material);
+        write_face(fw, t2, 3, material);
+      }
+    }
+  }
+}
+
+static void write_vertex(face_writer *fw, double px, double py, double pz,
+                         double nx, double ny, double nz, double u, double v) {
+  write_vector(fw->w, "v", px, py, pz);
+  if (fw->opts->texcoords)
+    write_vector(fw->w, "vt", u, v, 0.0);
+  if (fw->opts->normals)
+    write_vector(fw->w, "vn", nx, ny, nz);
+  fw->vertex_total++;
+}
+
+// Picks a lattice resolution so the face count lands close to the target
+static int64_t lattice_side(const meshgen_options *opts, double aspect) {
+  double quads = opts->quads ? (double)opts->faces : opts->faces / 2.0;
+  int64_t side = (int64_t)llround(sqrt(quads / aspect));
+  return side < 2 ? 2 : side;
+}
+
+static void generate_sphere(face_writer *fw) {
+  int64_t stacks = lattice_side(fw->opts, 2.0);
+  int64_t slices = stacks * 2;
+  // poles are duplicated per slice so every row has the same layout
+  for (int64_t i = 0; i <= stacks; ++i) {
+    double theta = PI * i / stacks;
+    for (int64_t j = 0; j < slices; ++j) {
+      double phi = 2 * PI * j / slices;
+      double x = sin(theta) * cos(phi), y = cos(theta),
+             z = sin(theta) * sin(phi);
+      write_vertex(fw, x, y, z, x, y, z, (double)j / slices,
+                   (double)i / stacks);
+    }
+  }
+  write_lattice_faces(fw, stacks + 1, slices, true, false);
+}
+
+static void generate_torus(face_writer *fw) {
+  int64_t sides = lattice_side(fw->opts, 2.0);
+  int64_t rings = sides * 2;
+  const double major = 1.0, minor = 0.35;
+  for (int64_t i = 0; i < rings; ++i) {
+    double u = 2 * PI * i / rings;
+    for (int64_t j = 0; j < sides; ++j) {
+      double v = 2 * PI * j / sides;
+      double nx = cos(v) * cos(u), ny = sin(v), nz = cos(v) * sin(u);
+      write_vertex(fw, (major + minor * cos(v)) * cos(u), minor * sin(v),
+                   (major + minor * cos(v)) * sin(u), nx, ny, nz,
+                   (double)i / rings, (double)j / sides);
+    }
+  }
+  write_lattice_faces(fw, rings, sides, true, true);
+}
+
+static void generate_grid(face_writer *fw) {
+  int64_t side = lattice_side(fw->opts, 1.0) + 1;
+  for (int64_t i = 0; i < side; ++i)
+    for (int64_t j = 0; j < side; ++j)
+      write_vertex(fw, (double)j / (side - 1) - 0.5, 0.0,
+                   (double)i / (side - 1) - 0.5, 0.0, 1.0, 0.0,
+                   (double)j / (side - 1), (double)i / (side - 1));
+  write_lattice_faces(fw, side, side, false, false);
+}
+
+static uint64_t next_random(uint64_t *state) {
+  // xorshift64*, deterministic across platforms for a given seed
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+static double random_unit(uint64_t *state) {
+  return (next_random(state) >> 11) * (1.0 / 9007199254740992.0) * 2.0 - 1.0;
+}
+
+// Independent small triangles scattered in the unit cube; each face writes
+// its own vertices right before it, like streamed scanner output
+static void generate_soup(face_writer *fw) {
+  uint64_t state = fw->opts->seed ? fw->opts->seed : 1;
+  int arity = fw->opts->quads ? 4 : 3;
+  for (int64_t f = 0; f < fw->opts->faces; ++f) {
+    double cx = random_unit(&state), cy = random_unit(&state),
+           cz = random_unit(&state);
+    int64_t indices[4];
+    for (int k = 0; k < arity; ++k) {
+      double x = cx + random_unit(&state) * 0.02;
+      double y = cy + random_unit(&state) * 0.02;
+      double z = cz + random_unit(&state) * 0.02;
+      write_vertex(fw, x, y, z, 0.0, 0.0, 1.0, (x + 1) / 2, (y + 1) / 2);
+      indices[k] = fw->vertex_total;
+    }
+    write_face(fw, indices, arity,
+               material_for_row(fw->opts, f, fw->opts->faces));
+  }
+}
+
+static int write_materials(const meshgen_options *opts, const char *path) {
+  FILE *mtl = fopen(path, "w");
+  if (mtl == NULL) {
+    perror(path);
+    return 0;
+  }
+  for (int m = 0; m < opts->materials; ++m) {
+    double hue = (double)m / opts->materials;
+    fprintf(mtl, "newmtl material_%d\n", m);
+    fprintf(mtl, "Ka 0.1 0.1 0.1\n");
+    fprintf(mtl, "Kd %.3f %.3f %.3f\n", 0.5 + 0.5 * cos(2 * PI * hue),
+            0.5 + 0.5 * cos(2 * PI * (hue + 1.0 / 3)),
+            0.5 + 0.5 * cos(2 * PI * (hue + 2.0 / 3)));
+    fprintf(mtl, "Ks 1 1 1\nNs 10\n\n");
+  }
+  return fclose(mtl) == 0;
+}
+
+static void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] -o out.obj\n"
+          "  --shape sphere|torus|grid|soup   surface to generate (sphere)\n"
+          "  --faces N                        approximate face count (1000)\n"
+          "  --normals                        write vn and reference them\n"
+          "  --texcoords                      write vt and reference them\n"
+          "  --negative                       use negative (relative) indices\n"
+          "  --quads                          emit quads instead of triangles\n"
+          "  --materials K                    write K materials to a .mtl\n"
+          "  --seed S                         random seed for soup\n"
+          "  -o, --output FILE                output path\n",
+          program);
+}
+
+static int parse_args(meshgen_options *opts, int argc, char **argv) {
+  static const struct option long_options[] = {
+      {"shape", required_argument, NULL, 's'},
+      {"faces", required_argument, NULL, 'f'},
+      {"normals", no_argument, NULL, 'n'},
+      {"texcoords", no_argument, NULL, 't'},
+      {"negative", no_argument, NULL, 'r'},
+      {"quads", no_argument, NULL, 'q'},
+      {"materials", required_argument, NULL, 'm'},
+      {"seed", required_argument, NULL, 'S'},
+      {"output", required_argument, NULL, 'o'},
+      {NULL, 0, NULL, 0}};
+
+  memset(opts, 0, sizeof(*opts));
+  opts->faces = 1000;
+  opts->seed = 1;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "o:", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 's':
+      if (strcmp(optarg, "sphere") == 0)
+        opts->shape = SHAPE_SPHERE;
+      else if (strcmp(optarg, "torus") == 0)
+        opts->shape = SHAPE_TORUS;
+      else if (strcmp(optarg, "grid") == 0)
+        opts->shape = SHAPE_GRID;
+      else if (strcmp(optarg, "soup") == 0)
+        opts->shape = SHAPE_SOUP;
+      else {
+        fprintf(stderr, "Unknown shape '%s'\n", optarg);
+        return 0;
+      }
+      break;
+    case 'f':
+      opts->faces = strtoll(optarg, NULL, 10);
+      break;
+    case 'n':
+      opts->normals = true;
+      break;
+    case 't':
+      opts->texcoords = true;
+      break;
+    case 'r':
+      opts->negative = true;
+      break;
+    case 'q':
+      opts->quads = true;
+      break;
+    case 'm':
+      opts->materials = atoi(optarg);
+      break;
+    case 'S':
+      opts->seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'o':
+      opts->output = optarg;
+      break;
+    default:
+      return 0;
+    }
+  }
+  if (opts->output == NULL || opts->faces <= 0 || opts->materials < 0)
+    return 0;
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  meshgen_options opts;
+  if (!parse_args(&opts, argc, argv)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  writer w = {0};
+  w.file = fopen(opts.output, "wb");
+  w.buffer = malloc(WRITE_BUFFER_SIZE);
+  if (w.file == NULL || w.buffer == NULL) {
+    perror(opts.output);
+    return EXIT_FAILURE;
+  }
+
+  write_str(&w, "# generated by meshgen\n");
+  if (opts.materials > 0) {
+    char mtl_path[4096];
+    obj_mtl_filename(mtl_path, sizeof(mtl_path), opts.output);
+    if (!write_materials(&opts, mtl_path))
+      return EXIT_FAILURE;
+    write_str(&w, "mtllib ");
+    write_str(&w, mtl_path);
+    write_char(&w, '\n');
+  }
+
+  face_writer fw = {&w, &opts, 0, -1};
+  switch (opts.shape) {
+  case SHAPE_SPHERE:
+    generate_sphere(&fw);
+    break;
+  case SHAPE_TORUS:
+    generate_torus(&fw);
+    break;
+  case SHAPE_GRID:
+    generate_grid(&fw);
+    break;
+  case SHAPE_SOUP:
+    generate_soup(&fw);
+    break;
+  }
+
+  writer_flush(&w);
+  if (fclose(w.file) != 0) {
+    perror(opts.output);
+    return EXIT_FAILURE;
+  }
+  free(w.buffer);
+  fprintf(stderr, "wrote %" PRId64 " vertices, %" PRIu64 " bytes to %s\n",
+          fw.vertex_total, w.total, opts.output);
+  return EXIT_SUCCESS;
+}
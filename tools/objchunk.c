@@ -0,0 +1,26 @@
+#include "chunks.h"
+#include "timing.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Builds the chunk file that `main --chunks` renders from, for models too
+// large to load. Memory use stays flat however large the input is, the
+// work is done in scratch files next to the output.
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s in.obj out.chunks\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  double start = now_seconds();
+  chunk_build_stats stats;
+  if (!chunks_build(argv[1], argv[2], &stats))
+    return EXIT_FAILURE;
+  fprintf(stderr,
+          "%" PRIu64 " vertices, %" PRIu64 " faces (%" PRIu64 " dropped) "
+          "in %" PRIu32 " chunks, %" PRIu64 " bytes: built in %.2f s\n",
+          stats.vertices, stats.faces, stats.dropped_faces, stats.chunks,
+          stats.bytes, now_seconds() - start);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include "bounds.h"
+#include "obj_parser.h"
+#include "obj_writer.h"
+#include "timing.h"
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reads a model and writes it back as OBJ, optionally centred and scaled
+// and with faces dropped, which replaces hand-edited copies and
+// resample.sh. Without options the output parses to the same scene.
+
+typedef struct convert_options {
+  const char *input;
+  const char *output;
+  bool normalize;
+  float scale; // MODEL_SCALE_FIT fits the model into the view
+  int decimate;
+  bool materials;
+} convert_options;
+
+static void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] in.obj -o out.obj\n"
+          "  --normalize        centre the model and fit it into the view\n"
+          "  --scale S          centre the model and multiply it by S\n"
+          "  --decimate N       keep one face in N, as resample.sh did\n"
+          "  --no-materials     leave out materials, no .mtl is written\n"
+          "  -o, --output FILE  output path, materials go next to it as\n"
+          "                     .mtl\n",
+          program);
+}
+
+static int parse_args(convert_options *opts, int argc, char **argv) {
+  static const struct option long_options[] = {
+      {"normalize", no_argument, NULL, 'n'},
+      {"scale", required_argument, NULL, 's'},
+      {"decimate", required_argument, NULL, 'd'},
+      {"no-materials", no_argument, NULL, 'M'},
+      {"output", required_argument, NULL, 'o'},
+      {NULL, 0, NULL, 0}};
+
+  memset(opts, 0, sizeof(*opts));
+  opts->scale = MODEL_SCALE_FIT;
+  opts->decimate = 1;
+  opts->materials = true;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "o:", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 'n':
+      opts->normalize = true;
+      break;
+    case 's':
+      opts->normalize = true;
+      opts->scale = (float)atof(optarg);
+      if (opts->scale <= 0) {
+        fprintf(stderr, "Invalid scale '%s'\n", optarg);
+        return 0;
+      }
+      break;
+    case 'd':
+      opts->decimate = atoi(optarg);
+      if (opts->decimate < 1) {
+        fprintf(stderr, "Invalid face ratio '%s'\n", optarg);
+        return 0;
+      }
+      break;
+    case 'M':
+      opts->materials = false;
+      break;
+    case 'o':
+      opts->output = optarg;
+      break;
+    default:
+      return 0;
+    }
+  }
+  if (optind + 1 != argc || opts->output == NULL)
+    return 0;
+  opts->input = argv[optind];
+  return 1;
+}
+
+// Moves every kept face to the front and returns how many there are. The
+// dropped ones stay behind them so delete_obj_data still frees them.
+static int decimate_faces(obj_scene_data *scene, int ratio) {
+  int kept = 0;
+  for (int i = 0; i < scene->face_count; ++i) {
+    // the same faces resample.sh kept: every ratio-th, counting from 1
+    if ((i + 1) % ratio != 0)
+      continue;
+    obj_face *face = scene->face_list[i];
+    scene->face_list[i] = scene->face_list[kept];
+    scene->face_list[kept++] = face;
+  }
+  return kept;
+}
+
+int main(int argc, char **argv) {
+  convert_options opts;
+  if (!parse_args(&opts, argc, argv)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  double start = now_seconds();
+  obj_scene_data scene;
+  if (!parse_obj_scene(&scene, (char *)opts.input)) {
+    fprintf(stderr, "Could not parse %s\n", opts.input);
+    return EXIT_FAILURE;
+  }
+  double parsed = now_seconds();
+  if (opts.normalize)
+    center_and_scale_model(&scene, opts.scale, false);
+  int face_count = scene.face_count;
+  scene.face_count = decimate_faces(&scene, opts.decimate);
+
+  char mtl_path[4096];
+  obj_mtl_filename(mtl_path, sizeof(mtl_path), opts.output);
+  bool with_materials = opts.materials && scene.material_count > 0;
+
+  int ok = obj_write_scene(&scene, opts.output,
+                           with_materials ? mtl_path : NULL);
+  double written = now_seconds();
+  if (ok)
+    fprintf(stderr,
+            "%d vertices, %d of %d faces, %d materials: parsed in %.2f s, "
+            "written in %.2f s\n",
+            scene.vertex_count, scene.face_count, face_count,
+            with_materials ? scene.material_count : 0, parsed - start,
+            written - parsed);
+  else
+    fprintf(stderr, "Could not write %s\n", opts.output);
+  scene.face_count = face_count;
+  delete_obj_data(&scene);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}